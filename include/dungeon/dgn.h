@@ -160,4 +160,21 @@ static inline bool dgn_is_in_map(struct dgn *dgn, uint32_t x, uint32_t y, uint32
 struct dgn_cell **dgn_get_visible_cells(struct dgn *dgn, int x, int y, int z, int *nr_cells_out);
 void dgn_calc_lightmap(struct dgn *dgn);
 
+/*
+ * Wall collision for DrawField maps, in the (x, z) plane of one floor. Walls
+ * and closed or locked doors are segments on the cell edges, and cells with a
+ * ceiling are blocked by an octagonal pillar.
+ */
+struct line_segment {
+	vec2 p1;
+	vec2 p2;
+};
+
+#define DGN_MAX_WALL_SEGMENTS_PER_CELL 12
+
+bool dgn_segment_intersection(struct line_segment *seg1, struct line_segment *seg2, vec2 out_intersection);
+int dgn_wall_segments(struct dgn *dgn, struct line_segment *dst, int x, int y, int z, bool check_door);
+// Returns true if no wall on `floor` crosses the line from (px, py) to (qx, qy).
+bool dgn_check_look(struct dgn *dgn, float px, float py, float qx, float qy, int floor);
+
 #endif /* SYSTEM4_DGN_H */
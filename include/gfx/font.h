@@ -20,7 +20,9 @@
 #include "system4.h"
 #include "gfx/gfx.h"
 
+struct ain;
 struct fnl;
+struct glyph_cache;
 struct hash_table;
 
 // standard font weight values
@@ -49,6 +51,16 @@ struct glyph {
 	Texture t[NR_FONT_WEIGHTS];
 };
 
+// A rasterized glyph: an 8-bit coverage bitmap plus metrics. rect is the
+// glyph's block within the bitmap, which has a border on all sides.
+struct glyph_bitmap {
+	int width;
+	int height;
+	Rectangle rect;
+	float advance;
+	uint8_t *pixels;
+};
+
 struct font_size {
 	float size;
 	int y_offset;
@@ -66,9 +78,18 @@ struct font {
 	struct font_size *(*get_size)(struct font *font, float size);
 	float (*get_actual_size)(struct font *font, float size);
 	float (*get_actual_size_round_down)(struct font *font, float size);
-	bool (*get_glyph)(struct font_size *size, struct glyph *dst, uint32_t code, enum font_weight weight);
+	// Rasterize a glyph. The caller takes ownership of dst->pixels.
+	bool (*get_glyph)(struct font_size *size, struct glyph_bitmap *dst, uint32_t code, enum font_weight weight);
 	float (*size_char)(struct font_size *size, uint32_t code);
 	float (*size_char_kerning)(struct font_size *size, uint32_t code, uint32_t code_next);
+	// Mark a size as recently used (may be NULL). Sizes are cached in
+	// text styles, so this is called on every glyph lookup.
+	void (*touch_size)(struct font_size *size);
+	// persistent glyph cache (may be NULL)
+	struct glyph_cache *cache;
+	// Identifies what get_glyph produces besides the font file itself (e.g.
+	// the FreeType version and load flags). Part of the glyph cache key.
+	uint64_t render_key;
 };
 
 struct text_style {
@@ -155,6 +176,7 @@ SDL_Color gfx_get_font_color(void);
 void gfx_set_font_name(const char *name);
 
 struct font_size *gfx_font_get_size(unsigned face, float size);
+void gfx_font_size_free_glyphs(struct font_size *size);
 enum font_weight gfx_int_to_font_weight(int weight);
 float _gfx_render_text(Texture *dst, char *msg, struct text_render_metrics *tm);
 
@@ -168,6 +190,15 @@ float gfx_size_char_kerning(struct text_style *ts, uint32_t code, uint32_t code_
 float gfx_size_text(struct text_style *ts, const char *text);
 float gfx_get_actual_font_size(unsigned face, float size);
 float gfx_get_actual_font_size_round_down(unsigned face, float size);
+void gfx_prewarm_glyph_cache(struct ain *ain);
+
+struct glyph_cache *glyph_cache_open(const char *font_path, unsigned index, uint64_t render_key);
+bool glyph_cache_get(struct glyph_cache *cache, float size, uint32_t code,
+		enum font_weight weight, struct glyph_bitmap *out);
+void glyph_cache_put(struct glyph_cache *cache, float size, uint32_t code,
+		enum font_weight weight, struct glyph_bitmap *bitmap);
+typedef void (*glyph_cache_size_cb)(float size, enum font_weight weight, void *data);
+void glyph_cache_foreach_size(struct glyph_cache *cache, glyph_cache_size_cb cb, void *data);
 
 static inline float text_style_width(struct text_style *ts, const char *ch)
 {
@@ -72,6 +72,13 @@ struct gfx_vertex {
 	GLfloat u, v;
 };
 
+// Per-instance parameters for the *_instanced draw functions.
+struct gfx_instance {
+	// destination rectangle, line vector or ellipse center/radii
+	GLfloat x, y, w, h;
+	GLfloat r, g, b, a;
+};
+
 int gfx_init(void);
 void gfx_fini(void);
 
@@ -111,6 +118,7 @@ void gfx_init_texture_amap(struct texture *t, int w, int h, uint8_t *amap, SDL_C
 void gfx_init_texture_rmap(struct texture *t, int w, int h, uint8_t *rmap);
 void gfx_update_texture_with_pixels(struct texture *t, void *pixels);
 void gfx_copy_main_surface(struct texture *dst);
+void gfx_recopy_main_surface(struct texture *dst);
 void gfx_delete_texture(struct texture *t);
 GLuint gfx_set_framebuffer(GLenum target, Texture *t, int x, int y, int w, int h);
 void gfx_reset_framebuffer(GLenum target, GLuint fbo);
@@ -186,6 +194,10 @@ void gfx_copy_stretch_with_alpha_map(Texture *dst, int dx, int dy, int dw, int d
 void gfx_copy_grayscale(Texture *dst, int dx, int dy, Texture *src, int sx, int sy, int w, int h);
 void gfx_draw_line(Texture *dst, int x0, int y0, int x1, int y1, int r, int g, int b);
 void gfx_draw_line_to_amap(Texture *dst, int x0, int y0, int x1, int y1, int a);
+void gfx_draw_lines_to_amap_instanced(Texture *dst, struct gfx_instance *lines, int n);
+void gfx_draw_ellipses_instanced(Texture *dst, struct gfx_instance *ellipses, int n);
+void gfx_copy_stretch_blend_screen_instanced(Texture *dst, Texture *src, struct gfx_instance *rects, int n);
+void gfx_copy_stretch_blend_amap_instanced(Texture *dst, Texture *src, struct gfx_instance *rects, int n);
 void gfx_draw_glyph(Texture *dst, float dx, int dy, Texture *glyph, SDL_Color color, float scale_x, float bold_width, bool blend);
 void gfx_draw_glyph_to_pmap(Texture *dst, float dx, int dy, Texture *glyph, Rectangle glyph_pos, SDL_Color color, float scale_x);
 void gfx_draw_glyph_to_amap(Texture *dst, float dx, int dy, Texture *glyph, Rectangle glyph_pos, float scale_x);
@@ -0,0 +1,38 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#ifndef SYSTEM4_ID_HEAP_H
+#define SYSTEM4_ID_HEAP_H
+
+/*
+ * Hands out the lowest unused id, as a linear scan for a free slot would,
+ * without the scan. A zero-initialized id_heap starts at id 0.
+ */
+struct id_heap {
+	// one past the highest id handed out
+	int end;
+	// released ids below end, as a min-heap
+	int *free;
+	int nr_free;
+	int free_cap;
+};
+
+int id_heap_alloc(struct id_heap *heap);
+void id_heap_release(struct id_heap *heap, int id);
+void id_heap_reset(struct id_heap *heap, int end);
+void id_heap_delete(struct id_heap *heap);
+
+#endif /* SYSTEM4_ID_HEAP_H */
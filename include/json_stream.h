@@ -0,0 +1,110 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#ifndef XSYSTEM4_JSON_STREAM_H
+#define XSYSTEM4_JSON_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Streaming JSON writer and pull parser.
+ *
+ * These are used for large documents (e.g. VM images) where building a cJSON
+ * tree would be too slow and use too much memory. The output is compatible
+ * with cJSON: strings are written as raw bytes with only control characters,
+ * quotes and backslashes escaped, so SJIS text round-trips unchanged.
+ */
+
+#define JSON_WRITER_BUFFER_SIZE 65536
+#define JSON_WRITER_MAX_DEPTH 32
+
+struct json_writer {
+	FILE *f;
+	size_t len;
+	int depth;
+	bool after_key;
+	bool error;
+	bool first[JSON_WRITER_MAX_DEPTH];
+	char buf[JSON_WRITER_BUFFER_SIZE];
+};
+
+void json_writer_init(struct json_writer *w, FILE *f);
+// Flush buffered output. Returns false if any write failed.
+bool json_writer_finish(struct json_writer *w);
+void json_write_begin_object(struct json_writer *w);
+void json_write_end_object(struct json_writer *w);
+void json_write_begin_array(struct json_writer *w);
+void json_write_end_array(struct json_writer *w);
+void json_write_key(struct json_writer *w, const char *key);
+void json_write_int(struct json_writer *w, int64_t i);
+void json_write_string(struct json_writer *w, const char *s);
+void json_write_null(struct json_writer *w);
+
+enum json_token {
+	JSON_TOKEN_EOF,
+	JSON_TOKEN_ERROR,
+	JSON_TOKEN_OBJECT,
+	JSON_TOKEN_OBJECT_END,
+	JSON_TOKEN_ARRAY,
+	JSON_TOKEN_ARRAY_END,
+	JSON_TOKEN_STRING,
+	JSON_TOKEN_NUMBER,
+	JSON_TOKEN_TRUE,
+	JSON_TOKEN_FALSE,
+	JSON_TOKEN_NULL,
+};
+
+#define JSON_READER_BUFFER_SIZE 65536
+
+struct json_reader {
+	const char *p;
+	const char *end;
+	// when reading from a file, [p, end) is a window into buf
+	FILE *f;
+	char *buf;
+	size_t buf_cap;
+	bool eof;
+	// decoded string storage; valid until the next string is read
+	char *str;
+	size_t str_cap;
+	bool error;
+};
+
+void json_reader_init(struct json_reader *r, const char *data, size_t size);
+// Read from a file, holding only the current token in memory. The caller
+// closes the file after json_reader_fini.
+void json_reader_init_file(struct json_reader *r, FILE *f);
+void json_reader_fini(struct json_reader *r);
+// Get the type of the next value without consuming it.
+enum json_token json_reader_peek(struct json_reader *r);
+bool json_read_begin_object(struct json_reader *r);
+// Returns true and stores the next key in *key, or returns false at the end
+// of the object (or on error, which is recorded in r->error).
+bool json_read_object_next(struct json_reader *r, const char **key);
+bool json_read_begin_array(struct json_reader *r);
+// Returns true if the array has another element, false at the end of the
+// array (or on error, which is recorded in r->error).
+bool json_read_array_next(struct json_reader *r);
+bool json_read_int(struct json_reader *r, int *out);
+// The returned string is owned by the reader and is valid until the next call.
+const char *json_read_string(struct json_reader *r, size_t *len_out);
+bool json_read_null(struct json_reader *r);
+bool json_skip_value(struct json_reader *r);
+
+#endif /* XSYSTEM4_JSON_STREAM_H */
@@ -40,6 +40,8 @@ struct bgi *bgi_get(int no);
 void wai_load(const char *path);
 struct wai *wai_get(int no);
 
+typedef struct cJSON cJSON;
+
 void mixer_init(void);
 int mixer_get_numof(void);
 const char *mixer_get_name(int n);
@@ -53,6 +55,7 @@ struct sts_mixer_stream_t;
 int mixer_stream_play(struct sts_mixer_stream_t* stream, int volume);
 bool mixer_stream_set_volume(int voice, int volume);
 void mixer_stream_stop(int voice);
+cJSON *mixer_stats_to_json(bool reset);
 
 struct archive_data;
 struct channel;
@@ -27,5 +27,10 @@ cJSON *load_json(const char *filename);
 int save_globals(const char *keyname, const char *filename, const char *group_name, int *n);
 int load_globals(const char *keyname, const char *filename, const char *group_name, int *n);
 int delete_save_file(const char *filename);
+// Forget what save_globals last wrote to the file at path (a full path).
+void savedata_invalidate_file(const char *path);
+// Wait for a resume save being written in the background (see --async-save).
+// Must be called before anything else reads, writes or deletes save files.
+void vm_wait_for_save(void);
 
 #endif /* SYSTEM4_SAVEDATA_H */
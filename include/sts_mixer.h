@@ -148,6 +148,11 @@ void sts_mixer_stop_stream(sts_mixer_t* mixer, sts_mixer_stream_t* stream);
 // It will write audio data in the specified format and frequency of the mixer state.
 void sts_mixer_mix_audio(sts_mixer_t* mixer, void* output, unsigned int samples);
 
+// added in xsystem4: Like sts_mixer_mix_audio, but the existing contents of output are
+// mixed in at unity gain before the mixer gain is applied. Only STS_MIXER_SAMPLE_FORMAT_FLOAT
+// output is supported. This is used to mix sub-mixers in place into their parent's buffer.
+void sts_mixer_mix_audio_float_add(sts_mixer_t* mixer, float* output, unsigned int samples);
+
 
 #endif // __INCLUDED__STS_MIXER_H__
 
@@ -297,10 +302,45 @@ void sts_mixer_stop_stream(sts_mixer_t* mixer, sts_mixer_stream_t* stream) {
 }
 
 
-void sts_mixer_mix_audio(sts_mixer_t* mixer, void* output, unsigned int samples) {
+static void sts_mixer__mix_voices(sts_mixer_t* mixer, float advance, float* left, float* right) {
   sts_mixer_voice_t*  voice;
   unsigned int        i, position;
-  float               left, right, advance, sample;
+  float               sample;
+
+  for (i = 0; i < STS_MIXER_VOICES; ++i) {
+    voice = &mixer->voices[i];
+    if (voice->state == STS_MIXER_VOICE_PLAYING) {
+      position = (int)voice->position;
+      if (position < voice->sample->length) {
+        sample = sts_mixer__clamp_sample(sts_mixer__get_sample(voice->sample, position) * voice->gain);
+        *left += sts_mixer__clamp_sample(sample * (0.5f - voice->pan));
+        *right += sts_mixer__clamp_sample(sample * (0.5f + voice->pan));
+        voice->position += (float)voice->sample->frequency * advance * voice->pitch;
+      } else sts_mixer__reset_voice(mixer, i);
+    } else if (voice->state == STS_MIXER_VOICE_STREAMING) {
+      int status = 1;
+      position = ((int)voice->position) * 2;
+      if (position >= voice->stream->sample.length) {
+        // buffer empty...refill
+        status = voice->stream->callback(&voice->stream->sample, voice->stream->userdata);
+        voice->position = 0.0f;
+        position = 0;
+      }
+      // added in xsystem4: allow stopping stream via callback return value
+      if (status == STS_STREAM_COMPLETE) {
+        sts_mixer_stop_voice(mixer, i);
+      } else {
+        *left += sts_mixer__clamp_sample(sts_mixer__get_sample(&voice->stream->sample, position) * voice->gain);
+        *right += sts_mixer__clamp_sample(sts_mixer__get_sample(&voice->stream->sample, position + 1) * voice->gain);
+        voice->position += (float)voice->stream->sample.frequency * advance;
+      }
+    }
+  }
+}
+
+
+void sts_mixer_mix_audio(sts_mixer_t* mixer, void* output, unsigned int samples) {
+  float               left, right, advance;
   char*               out_8 = (char*)output;
   short*              out_16 = (short*)output;
   int*                out_32 = (int*)output;
@@ -310,35 +350,7 @@ void sts_mixer_mix_audio(sts_mixer_t* mixer, void* output, unsigned int samples)
   advance = 1.0f / (float)mixer->frequency;
   for (; samples > 0; --samples) {
     left = right = 0.0f;
-    for (i = 0; i < STS_MIXER_VOICES; ++i) {
-      voice = &mixer->voices[i];
-      if (voice->state == STS_MIXER_VOICE_PLAYING) {
-        position = (int)voice->position;
-        if (position < voice->sample->length) {
-          sample = sts_mixer__clamp_sample(sts_mixer__get_sample(voice->sample, position) * voice->gain);
-          left += sts_mixer__clamp_sample(sample * (0.5f - voice->pan));
-          right += sts_mixer__clamp_sample(sample * (0.5f + voice->pan));
-          voice->position += (float)voice->sample->frequency * advance * voice->pitch;
-        } else sts_mixer__reset_voice(mixer, i);
-      } else if (voice->state == STS_MIXER_VOICE_STREAMING) {
-        int status = 1;
-        position = ((int)voice->position) * 2;
-        if (position >= voice->stream->sample.length) {
-          // buffer empty...refill
-          status = voice->stream->callback(&voice->stream->sample, voice->stream->userdata);
-          voice->position = 0.0f;
-          position = 0;
-        }
-        // added in xsystem4: allow stopping stream via callback return value
-        if (status == STS_STREAM_COMPLETE) {
-          sts_mixer_stop_voice(mixer, i);
-        } else {
-          left += sts_mixer__clamp_sample(sts_mixer__get_sample(&voice->stream->sample, position) * voice->gain);
-          right += sts_mixer__clamp_sample(sts_mixer__get_sample(&voice->stream->sample, position + 1) * voice->gain);
-          voice->position += (float)voice->stream->sample.frequency * advance;
-        }
-      }
-    }
+    sts_mixer__mix_voices(mixer, advance, &left, &right);
 
     // write to buffer
     // NOTE: xsystem4 change: use mixer gain (not sure why this isn't implemented upstream...)
@@ -364,6 +376,20 @@ void sts_mixer_mix_audio(sts_mixer_t* mixer, void* output, unsigned int samples)
     }
   }
 }
+
+
+void sts_mixer_mix_audio_float_add(sts_mixer_t* mixer, float* output, unsigned int samples) {
+  float               left, right, advance;
+
+  advance = 1.0f / (float)mixer->frequency;
+  for (; samples > 0; --samples) {
+    left = output[0];
+    right = output[1];
+    sts_mixer__mix_voices(mixer, advance, &left, &right);
+    *output++ = sts_mixer__clamp_sample(left * mixer->gain);
+    *output++ = sts_mixer__clamp_sample(right * mixer->gain);
+  }
+}
 #endif // STS_MIXER_IMPLEMENTATION
 ////////////////////////////////////////////////////////////////////////////////
 //  EXAMPLE
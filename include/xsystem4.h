@@ -39,18 +39,26 @@ struct config {
 	char **mixer_channels;
 	int *mixer_volumes;
 	int default_volume;
+	int audio_buffer_size;
+	bool audio_low_latency;
+	bool audio_stats;
+	char *audio_capture_path;
 
 	char *bgi_path;
 	char *wai_path;
 	char *ex_path;
 	char *fnl_path;
 	char *font_paths[2];
+	bool glyph_cache;
 
 	bool joypad;
 	bool echo;
 	float text_x_scale;
 	bool manual_text_x_scale;
 	enum resume_save_format save_format;
+	bool save_async;
+	// zlib level for gsave/rsave files; -1 = per-format default
+	int save_compression_level;
 	int msgskip_delay;
 };
 
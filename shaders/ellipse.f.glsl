@@ -0,0 +1,31 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+
+in vec2 offset;
+flat in vec2 radii;
+flat in vec4 instance_color;
+out vec4 frag_color;
+
+void main() {
+        // Approximate distance to the outline: F(p) / |grad F(p)| where
+        // F(p) = (x/rx)^2 + (y/ry)^2 - 1
+        vec2 q = offset / (radii * radii);
+        float dist = abs(dot(offset, q) - 1.0) / (2.0 * length(q));
+        if (dist > 0.5)
+                discard;
+        frag_color = instance_color;
+}
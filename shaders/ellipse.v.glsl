@@ -0,0 +1,42 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+
+uniform mat4 view_transform;
+uniform sampler2D instance_data;
+
+in vec4 vertex_pos;
+out vec2 offset;
+flat out vec2 radii;
+flat out vec4 instance_color;
+
+// must match INSTANCE_DATA_WIDTH in draw.c
+const int INSTANCE_DATA_WIDTH = 1024;
+
+vec4 instance_texel(int i) {
+        return texelFetch(instance_data, ivec2(i % INSTANCE_DATA_WIDTH, i / INSTANCE_DATA_WIDTH), 0);
+}
+
+void main() {
+        // center and radii
+        vec4 e = instance_texel(gl_InstanceID * 2);
+        instance_color = instance_texel(gl_InstanceID * 2 + 1);
+        radii = e.zw;
+        // cover the ellipse with a one pixel margin; the center is the middle
+        // of pixel (x, y) so that offsets at fragment centers are integers
+        offset = (vertex_pos.xy * 2.0 - 1.0) * (e.zw + 1.0);
+        gl_Position = view_transform * vec4(e.xy + 0.5 + offset, 0.0, 1.0);
+}
@@ -0,0 +1,39 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+
+uniform mat4 view_transform;
+uniform sampler2D instance_data;
+
+in vec4 vertex_pos;
+in vec2 vertex_uv;
+out vec2 tex_coord;
+flat out vec4 instance_color;
+
+// must match INSTANCE_DATA_WIDTH in draw.c
+const int INSTANCE_DATA_WIDTH = 1024;
+
+vec4 instance_texel(int i) {
+        return texelFetch(instance_data, ivec2(i % INSTANCE_DATA_WIDTH, i / INSTANCE_DATA_WIDTH), 0);
+}
+
+void main() {
+        // destination rectangle, or the vector of a line
+        vec4 rect = instance_texel(gl_InstanceID * 2);
+        instance_color = instance_texel(gl_InstanceID * 2 + 1);
+        gl_Position = view_transform * vec4(rect.xy + vertex_pos.xy * rect.zw, 0.0, 1.0);
+        tex_coord = vertex_uv;
+}
@@ -26,6 +26,7 @@
 
 #include "asset_manager.h"
 #include "audio.h"
+#include "cJSON.h"
 #include "mixer.h"
 #include "xsystem4.h"
 
@@ -77,6 +78,10 @@ struct channel {
 	uint_least32_t loop_end;
 	atomic_uint loop_count;
 	struct fade fade;
+
+	// statistics (audio thread)
+	uint64_t decode_ticks;
+	uint64_t decode_frames;
 };
 
 struct mixer {
@@ -86,6 +91,7 @@ struct mixer {
 	atomic_bool muted;
 	float data[CHUNK_SIZE * 2];
 	char *name;
+	uint64_t decode_ticks;
 
 	struct mixer *parent;
 	struct mixer **children;
@@ -97,16 +103,93 @@ static struct mixer *mixers = NULL;
 static int nr_mixers = 0;
 
 static SDL_AudioDeviceID audio_device = 0;
+static int device_frequency = 44100;
+
+// When set, the final mix is also written to this file (see --audio-capture).
+static SNDFILE *capture_file = NULL;
+
+/*
+ * Performance counters. Updated from the audio thread; read with the audio
+ * device locked. Times are in SDL performance counter ticks.
+ */
+static struct audio_stats {
+	uint64_t callbacks;
+	uint64_t callback_ticks;
+	uint64_t max_callback_ticks;
+	uint64_t frames;
+	// callbacks which took longer than the audio they produced (the device
+	// runs dry if this keeps happening)
+	uint64_t deadline_misses;
+	// refills where the decoder returned fewer frames than requested
+	uint64_t short_reads;
+	// play requests that failed because the mixer had no free voice
+	uint64_t voice_overflows;
+} stats;
+
+// Incremented whenever mixer_stats_to_json resets the counters.
+static unsigned stats_generation = 0;
+
+/*
+ * In low latency mode, sub-mixers are not played as streams on their parent
+ * mixer (which would add a CHUNK_SIZE buffer of latency at each level of the
+ * hierarchy). Instead the whole tree is mixed in place in the audio callback.
+ */
+static bool low_latency = false;
+
+/*
+ * Mix a mixer and all of its children into `out`.
+ * `frames` must not exceed CHUNK_SIZE.
+ */
+static void mix_tree(struct mixer *mixer, float *out, unsigned frames)
+{
+	memset(out, 0, sizeof(float) * frames * 2);
+	for (int i = 0; i < mixer->nr_children; i++) {
+		struct mixer *child = mixer->children[i];
+		mix_tree(child, child->data, frames);
+		if (child->muted)
+			continue;
+		for (unsigned j = 0; j < frames * 2; j++) {
+			out[j] += child->data[j];
+		}
+	}
+	sts_mixer_mix_audio_float_add(&mixer->mixer, out, frames);
+}
 
 /*
  * The SDL2 audio callback.
  */
 static void audio_callback(possibly_unused void *data, Uint8 *stream, int len)
 {
-	sts_mixer_mix_audio(&master->mixer, stream, len / (sizeof(float) * 2));
+	uint64_t start = SDL_GetPerformanceCounter();
+	if (low_latency) {
+		float *out = (float*)stream;
+		unsigned frames = len / (sizeof(float) * 2);
+		while (frames > 0) {
+			unsigned n = min(frames, CHUNK_SIZE);
+			mix_tree(master, out, n);
+			out += n * 2;
+			frames -= n;
+		}
+	} else {
+		sts_mixer_mix_audio(&master->mixer, stream, len / (sizeof(float) * 2));
+	}
 	if (master->muted) {
 		memset(stream, 0, len);
 	}
+
+	uint64_t ticks = SDL_GetPerformanceCounter() - start;
+	uint64_t frames = len / (sizeof(float) * 2);
+	stats.callbacks++;
+	stats.callback_ticks += ticks;
+	stats.max_callback_ticks = max(stats.max_callback_ticks, ticks);
+	stats.frames += frames;
+	if (ticks > frames * SDL_GetPerformanceFrequency() / device_frequency)
+		stats.deadline_misses++;
+
+	// Not timed: capturing is a debugging aid, and file I/O would swamp
+	// the mixing time in the stats.
+	if (capture_file)
+		sf_writef_float(capture_file, (float*)stream, frames);
 }
 
 /*
@@ -208,10 +291,13 @@ static int refill_stream(sts_mixer_sample_t *sample, void *data)
 {
 	struct channel *ch = data;
 	uint_least32_t frames_read;
+	uint64_t start = SDL_GetPerformanceCounter();
 	memset(ch->data, 0, sizeof(float) * sample->length);
 
 	// read audio data from file
 	int r = cb_read_frames(ch, ch->data, CHUNK_SIZE, &frames_read);
+	if (r == STS_STREAM_CONTINUE && frames_read < CHUNK_SIZE)
+		stats.short_reads++;
 
 	// convert mono to stereo
 	if (ch->info.channels == 1) {
@@ -254,6 +340,10 @@ static int refill_stream(sts_mixer_sample_t *sample, void *data)
 		ch->voice = -1;
 	}
 
+	uint64_t ticks = SDL_GetPerformanceCounter() - start;
+	ch->decode_ticks += ticks;
+	ch->decode_frames += frames_read;
+	mixers[ch->mixer_no].decode_ticks += ticks;
 	return r;
 }
 
@@ -277,6 +367,12 @@ int channel_play(struct channel *ch)
 	}
 	memset(ch->data, 0, sizeof(ch->data));
 	ch->voice = sts_mixer_play_stream(&mixers[ch->mixer_no].mixer, &ch->stream, 1.0f);
+	if (ch->voice < 0)
+		stats.voice_overflows++;
+	// start at the end of the (empty) buffer so that the first mix refills it
+	// immediately, rather than playing a chunk of silence first
+	if (ch->voice >= 0)
+		mixers[ch->mixer_no].mixer.voices[ch->voice].position = CHUNK_SIZE;
 	SDL_UnlockAudioDevice(audio_device);
 	return 1;
 }
@@ -612,6 +708,140 @@ void channel_close(struct channel *ch)
 	free(ch);
 }
 
+static double ticks_to_us(uint64_t ticks)
+{
+	return (double)ticks * 1000000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+/*
+ * Log audio statistics for the last second. Runs on the SDL timer thread.
+ */
+static Uint32 log_stats(Uint32 interval, possibly_unused void *data)
+{
+	static struct audio_stats prev;
+	static unsigned prev_generation = 0;
+	SDL_LockAudioDevice(audio_device);
+	struct audio_stats cur = stats;
+	// the counters restarted from zero since the last call
+	if (stats_generation != prev_generation) {
+		memset(&prev, 0, sizeof(prev));
+		prev_generation = stats_generation;
+	}
+	int voices = 0;
+	for (int i = 0; i < nr_mixers; i++) {
+		voices += sts_mixer_get_active_voices(&mixers[i].mixer);
+	}
+	SDL_UnlockAudioDevice(audio_device);
+
+	double audio_us = (double)(cur.frames - prev.frames) * 1000000.0 / device_frequency;
+	double callback_us = ticks_to_us(cur.callback_ticks - prev.callback_ticks);
+	NOTICE("audio: %.1f%% load, %d voices, %u deadline misses, %u short reads, %u voice overflows",
+			audio_us > 0 ? callback_us * 100.0 / audio_us : 0.0, voices,
+			(unsigned)(cur.deadline_misses - prev.deadline_misses),
+			(unsigned)(cur.short_reads - prev.short_reads),
+			(unsigned)(cur.voice_overflows - prev.voice_overflows));
+	prev = cur;
+	return interval;
+}
+
+cJSON *mixer_stats_to_json(bool reset)
+{
+	cJSON *obj = cJSON_CreateObject();
+	SDL_LockAudioDevice(audio_device);
+
+	double audio_us = (double)stats.frames * 1000000.0 / device_frequency;
+	double callback_us = ticks_to_us(stats.callback_ticks);
+	cJSON_AddNumberToObject(obj, "callbacks", stats.callbacks);
+	cJSON_AddNumberToObject(obj, "callbackTimeUs", callback_us);
+	cJSON_AddNumberToObject(obj, "maxCallbackTimeUs", ticks_to_us(stats.max_callback_ticks));
+	cJSON_AddNumberToObject(obj, "audioTimeUs", audio_us);
+	cJSON_AddNumberToObject(obj, "load", audio_us > 0 ? callback_us / audio_us : 0.0);
+	cJSON_AddNumberToObject(obj, "deadlineMisses", stats.deadline_misses);
+	cJSON_AddNumberToObject(obj, "shortReads", stats.short_reads);
+	cJSON_AddNumberToObject(obj, "voiceOverflows", stats.voice_overflows);
+
+	cJSON *a_mixers = cJSON_AddArrayToObject(obj, "mixers");
+	for (int i = 0; i < nr_mixers; i++) {
+		struct mixer *m = &mixers[i];
+		cJSON *j_mixer = cJSON_CreateObject();
+		char *name = sjis2utf(m->name, 0);
+		cJSON_AddStringToObject(j_mixer, "name", name);
+		free(name);
+		cJSON_AddNumberToObject(j_mixer, "activeVoices", sts_mixer_get_active_voices(&m->mixer));
+		cJSON_AddNumberToObject(j_mixer, "decodeTimeUs", ticks_to_us(m->decode_ticks));
+		cJSON *a_channels = cJSON_AddArrayToObject(j_mixer, "channels");
+		for (int v = 0; v < STS_MIXER_VOICES; v++) {
+			sts_mixer_stream_t *stream = m->mixer.voices[v].stream;
+			if (!stream || stream->callback != refill_stream)
+				continue;
+			struct channel *ch = stream->userdata;
+			cJSON *j_ch = cJSON_CreateObject();
+			cJSON_AddNumberToObject(j_ch, "voice", v);
+			cJSON_AddNumberToObject(j_ch, "no", ch->no);
+			cJSON_AddNumberToObject(j_ch, "decodeTimeUs", ticks_to_us(ch->decode_ticks));
+			cJSON_AddNumberToObject(j_ch, "decodedFrames", ch->decode_frames);
+			cJSON_AddItemToArray(a_channels, j_ch);
+			if (reset) {
+				ch->decode_ticks = 0;
+				ch->decode_frames = 0;
+			}
+		}
+		cJSON_AddItemToArray(a_mixers, j_mixer);
+		if (reset)
+			m->decode_ticks = 0;
+	}
+
+	if (reset) {
+		memset(&stats, 0, sizeof(stats));
+		stats_generation++;
+	}
+	SDL_UnlockAudioDevice(audio_device);
+	return obj;
+}
+
+static void close_capture_file(void)
+{
+	SDL_LockAudioDevice(audio_device);
+	sf_close(capture_file);
+	capture_file = NULL;
+	SDL_UnlockAudioDevice(audio_device);
+}
+
+/*
+ * Open a WAV file to record the final mix to. Combined with the SDL "dummy"
+ * audio driver this allows mixer output to be recorded headlessly.
+ */
+static void open_capture_file(const char *path, int frequency)
+{
+	SF_INFO info = {
+		.samplerate = frequency,
+		.channels = 2,
+		.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT,
+	};
+	capture_file = sf_open(path, SFM_WRITE, &info);
+	if (!capture_file) {
+		WARNING("%s: %s", path, sf_strerror(NULL));
+		return;
+	}
+	atexit(close_capture_file);
+}
+
+/*
+ * Get the number of sample frames to request for the SDL audio buffer.
+ * SDL requires a power of 2.
+ */
+static Uint16 device_buffer_size(void)
+{
+	int size = config.audio_buffer_size;
+	if (size <= 0)
+		size = config.audio_low_latency ? 256 : CHUNK_SIZE;
+	size = clamp(64, 8192, size);
+	Uint16 pow2 = 64;
+	while (pow2 < size)
+		pow2 <<= 1;
+	return pow2;
+}
+
 #define SJIS_MASTER "\x83\x7d\x83\x58\x83\x5e\x81\x5b"
 #define SJIS_VOICE  "\x89\xb9\x90\xba"
 
@@ -669,9 +899,12 @@ void mixer_init(void)
 	}
 
 	// initialize mixer streams
+	low_latency = config.audio_low_latency;
 	for (int i = 0; i < nr_mixers; i++) {
-		if (&mixers[i] == master)
+		if (&mixers[i] == master || low_latency) {
+			mixers[i].voice = -1;
 			continue;
+		}
 		mixers[i].stream.userdata = &mixers[i];
 		mixers[i].stream.callback = refill_mixer;
 		mixers[i].stream.sample.frequency = 44100;
@@ -693,11 +926,27 @@ void mixer_init(void)
 		.format = AUDIO_F32,
 		.freq = 44100,
 		.channels = 2,
-		.samples = CHUNK_SIZE,
+		.samples = device_buffer_size(),
 		.callback = audio_callback,
 	};
 	audio_device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
+	if (!audio_device) {
+		WARNING("SDL_OpenAudioDevice failed: %s", SDL_GetError());
+		return;
+	}
+	device_frequency = have.freq;
+	if (config.audio_capture_path)
+		open_capture_file(config.audio_capture_path, have.freq);
+	if (low_latency) {
+		NOTICE("Low latency audio: %u frame buffer (%.1f ms)", have.samples,
+				(double)have.samples * 1000.0 / have.freq);
+	}
 	SDL_PauseAudioDevice(audio_device, 0);
+
+	if (config.audio_stats) {
+		SDL_InitSubSystem(SDL_INIT_TIMER);
+		SDL_AddTimer(1000, log_stats, NULL);
+	}
 }
 
 int mixer_get_numof(void)
@@ -764,6 +1013,8 @@ int mixer_stream_play(sts_mixer_stream_t* stream, int volume)
 	SDL_LockAudioDevice(audio_device);
 	float gain = clamp(0.0f, 1.0f, (float)volume / 100.0f);
 	int voice = sts_mixer_play_stream(&master->mixer, stream, gain);
+	if (voice < 0)
+		stats.voice_overflows++;
 	SDL_UnlockAudioDevice(audio_device);
 	return voice;
 }
@@ -39,6 +39,7 @@
 #include "gfx/gfx.h"
 #include "input.h"
 #include "json.h"
+#include "mixer.h"
 #include "msgqueue.h"
 #include "parts/parts_internal.h"
 #include "sact.h"
@@ -776,6 +777,18 @@ static void cmd_xsystem4_scene(cJSON *args, cJSON *resp)
 	send_response(resp, true);
 }
 
+// get audio performance counters
+static void cmd_xsystem4_audioStats(cJSON *args, cJSON *resp)
+{
+	bool reset = false;
+	if (args) {
+		cJSON *j_reset = cJSON_GetObjectItemCaseSensitive(args, "reset");
+		reset = cJSON_IsTrue(j_reset);
+	}
+	cJSON_AddItemToObjectCS(resp, "body", mixer_stats_to_json(reset));
+	send_response(resp, true);
+}
+
 static bool get_id(cJSON *args, const char *id_name, int *id_out)
 {
 	if (!args)
@@ -955,6 +968,7 @@ static struct {
 	{ "xsystem4.spriteTexture", cmd_xsystem4_spriteTexture, true },
 	{ "xsystem4.renderParts", cmd_xsystem4_renderParts, true },
 	{ "xsystem4.partsTexture", cmd_xsystem4_partsTexture, true },
+	{ "xsystem4.audioStats", cmd_xsystem4_audioStats, true },
 };
 
 static bool handle_request(cJSON *request)
@@ -78,6 +78,24 @@ static struct copy_shader amap_saturate_shader;
 static struct copy_shader blend_rmap_color_shader;
 static struct copy_shader dilate_shader;
 
+/*
+ * Instanced draws take their per-instance parameters from a float texture
+ * (two texels per instance) indexed by gl_InstanceID. Instanced vertex
+ * attributes would need GL 3.3, but the desktop context is 3.1.
+ */
+#define INSTANCE_DATA_WIDTH 1024
+
+struct instanced_shader {
+	Shader s;
+	GLint instance_data;
+};
+
+static struct instanced_shader instanced_fill_shader;
+static struct instanced_shader instanced_copy_shader;
+static struct instanced_shader ellipse_shader;
+static GLuint instance_texture;
+static int instance_texture_rows;
+
 static void prepare_copy_shader(struct gfx_render_job *job, void *data)
 {
 	struct copy_shader *s = (struct copy_shader*)job->shader;
@@ -101,6 +119,12 @@ static void load_copy_shader(struct copy_shader *s, const char *v_path, const ch
 	s->s.prepare = prepare_copy_shader;
 }
 
+static void load_instanced_shader(struct instanced_shader *s, const char *v_path, const char *f_path)
+{
+	gfx_load_shader(&s->s, v_path, f_path);
+	s->instance_data = glGetUniformLocation(s->s.program, "instance_data");
+}
+
 // load shaders
 void gfx_draw_init(void)
 {
@@ -159,6 +183,19 @@ void gfx_draw_init(void)
 
 	// shader that dilates every pixel (for bold/outline text rendering)
 	load_copy_shader(&dilate_shader, "shaders/render.v.glsl", "shaders/dilate.f.glsl");
+
+	// instanced shaders for particle effects
+	load_instanced_shader(&instanced_fill_shader, "shaders/instanced.v.glsl", "shaders/instanced_fill.f.glsl");
+	load_instanced_shader(&instanced_copy_shader, "shaders/instanced.v.glsl", "shaders/copy.f.glsl");
+
+	// instanced shader that draws ellipse outlines
+	load_instanced_shader(&ellipse_shader, "shaders/ellipse.v.glsl", "shaders/ellipse.f.glsl");
+
+	glGenTextures(1, &instance_texture);
+	glBindTexture(GL_TEXTURE_2D, instance_texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 static void run_draw_shader(Shader *s, Texture *dst, Texture *src, mat4 mw_transform, mat4 wv_transform, struct copy_data *data)
@@ -1155,6 +1192,117 @@ void gfx_draw_quadrilateral(Texture *dst, Texture *src, struct gfx_vertex vertic
 	restore_blend_mode();
 }
 
+static void upload_instances(struct gfx_instance *instances, int n)
+{
+	int texels = n * 2;
+	int rows = (texels + INSTANCE_DATA_WIDTH - 1) / INSTANCE_DATA_WIDTH;
+	int full_rows = texels / INSTANCE_DATA_WIDTH;
+	int rest = texels % INSTANCE_DATA_WIDTH;
+
+	glBindTexture(GL_TEXTURE_2D, instance_texture);
+	if (rows > instance_texture_rows) {
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, INSTANCE_DATA_WIDTH, rows, 0,
+				GL_RGBA, GL_FLOAT, NULL);
+		instance_texture_rows = rows;
+	}
+	if (full_rows) {
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, INSTANCE_DATA_WIDTH, full_rows,
+				GL_RGBA, GL_FLOAT, instances);
+	}
+	if (rest) {
+		GLfloat *data = (GLfloat*)instances + full_rows * INSTANCE_DATA_WIDTH * 4;
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, full_rows, rest, 1, GL_RGBA, GL_FLOAT, data);
+	}
+}
+
+/*
+ * Draw `n` instances of the unit rectangle (or the line from (0,0) to (1,1)
+ * if `mode` is GL_LINES) in a single draw call.
+ */
+static void run_instanced_shader(struct instanced_shader *s, GLenum mode, Texture *dst,
+		Texture *src, struct gfx_instance *instances, int n)
+{
+	if (n <= 0)
+		return;
+
+	glActiveTexture(GL_TEXTURE1);
+	upload_instances(instances, n);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, src ? src->handle : 0);
+
+	GLuint fbo = gfx_set_framebuffer(GL_DRAW_FRAMEBUFFER, dst, 0, 0, dst->w, dst->h);
+	mat4 wv_transform = WV_TRANSFORM(dst->w, dst->h);
+
+	glUseProgram(s->s.program);
+	glUniformMatrix4fv(s->s.view_transform, 1, GL_FALSE, wv_transform[0]);
+	glUniform1i(s->s.texture, 0);
+	glUniform1i(s->instance_data, 1);
+
+	// vertex_uv is unused (and optimized out) in some shaders
+	bool has_uv = (GLint)s->s.vertex_uv >= 0;
+	glBindVertexArray(sdl.gl.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, sdl.gl.vbo);
+	glEnableVertexAttribArray(s->s.vertex_pos);
+	glVertexAttribPointer(s->s.vertex_pos, 4, GL_FLOAT, GL_FALSE, sizeof(struct gfx_vertex), NULL);
+	if (has_uv) {
+		glEnableVertexAttribArray(s->s.vertex_uv);
+		glVertexAttribPointer(s->s.vertex_uv, 2, GL_FLOAT, GL_FALSE, sizeof(struct gfx_vertex),
+				(void*)offsetof(struct gfx_vertex, u));
+	}
+
+	if (mode == GL_LINES) {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sdl.gl.line_ibo);
+		glDrawElementsInstanced(GL_LINES, 2, GL_UNSIGNED_INT, NULL, n);
+	} else {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sdl.gl.rect_ibo);
+		glDrawElementsInstanced(GL_TRIANGLE_FAN, 4, GL_UNSIGNED_INT, NULL, n);
+	}
+
+	glDisableVertexAttribArray(s->s.vertex_pos);
+	if (has_uv)
+		glDisableVertexAttribArray(s->s.vertex_uv);
+	glBindVertexArray(0);
+	glUseProgram(0);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+
+	gfx_reset_framebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+}
+
+// Draw lines from (x, y) to (x + w, y + h) to the alpha map, with alpha `a`.
+void gfx_draw_lines_to_amap_instanced(Texture *dst, struct gfx_instance *lines, int n)
+{
+	glBlendFuncSeparate(GL_ZERO, GL_ONE, GL_ONE, GL_ZERO);
+	run_instanced_shader(&instanced_fill_shader, GL_LINES, dst, NULL, lines, n);
+	restore_blend_mode();
+}
+
+// Draw one pixel wide outlines of ellipses centered at (x, y) with radii
+// (w, h), overwriting the destination with the instance color.
+void gfx_draw_ellipses_instanced(Texture *dst, struct gfx_instance *ellipses, int n)
+{
+	glBlendFuncSeparate(GL_ONE, GL_ZERO, GL_ONE, GL_ZERO);
+	run_instanced_shader(&ellipse_shader, GL_TRIANGLE_FAN, dst, NULL, ellipses, n);
+	restore_blend_mode();
+}
+
+// Instanced gfx_copy_stretch_blend_screen of the whole of `src`.
+void gfx_copy_stretch_blend_screen_instanced(Texture *dst, Texture *src, struct gfx_instance *rects, int n)
+{
+	glBlendFuncSeparate(GL_ONE, GL_ONE_MINUS_SRC_COLOR, GL_ZERO, GL_ONE);
+	run_instanced_shader(&instanced_copy_shader, GL_TRIANGLE_FAN, dst, src, rects, n);
+	restore_blend_mode();
+}
+
+// Instanced gfx_copy_stretch_blend_amap of the whole of `src`.
+void gfx_copy_stretch_blend_amap_instanced(Texture *dst, Texture *src, struct gfx_instance *rects, int n)
+{
+	glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_DST_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	run_instanced_shader(&instanced_copy_shader, GL_TRIANGLE_FAN, dst, src, rects, n);
+	restore_blend_mode();
+}
+
 // XXX: Not an actual DrawGraph function; used for rendering text
 void gfx_draw_glyph(Texture *dst, float dx, int dy, Texture *glyph, SDL_Color color, float scale_x, float bold_width, bool blend)
 {
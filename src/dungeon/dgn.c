@@ -14,6 +14,7 @@
  * along with this program; if not, see <http://gnu.org/licenses/>.
  */
 
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 #include "system4.h"
@@ -22,6 +23,8 @@
 #include "dungeon/dgn.h"
 #include "vm.h"
 
+#define LOOK_EPSILON 1e-3f
+
 struct dgn *dgn_new(uint32_t size_x, uint32_t size_y, uint32_t size_z)
 {
 	struct dgn *dgn = xcalloc(1, sizeof(struct dgn));
@@ -628,3 +631,131 @@ void dgn_calc_lightmap(struct dgn *dgn)
 		cell->lightmap_east = calc_east_lightmap(dgn, cell, up, down, north, south);
 	}
 }
+
+// Finds the intersection between two line segments.
+bool dgn_segment_intersection(
+	struct line_segment *seg1, struct line_segment *seg2, vec2 out_intersection)
+{
+	// Let seg1 be P + t*r, and seg2 be Q + u*s for 0 <= t, u <= 1.
+	vec2 r, s;
+	glm_vec2_sub(seg1->p2, seg1->p1, r); // r = P2 - P1
+	glm_vec2_sub(seg2->p2, seg2->p1, s); // s = Q2 - Q1
+
+	float r_cross_s = glm_vec2_cross(r, s);
+	vec2 q_minus_p;
+	glm_vec2_sub(seg2->p1, seg1->p1, q_minus_p);
+
+	if (fabsf(r_cross_s) < 1e-8f) {
+		return false;  // The lines are parallel or collinear
+	}
+
+	// Solve for t and u
+	float t = glm_vec2_cross(q_minus_p, s) / r_cross_s;
+	float u = glm_vec2_cross(q_minus_p, r) / r_cross_s;
+
+	if (0.f <= t && t <= 1.f && 0.f <= u && u <= 1.f) {
+		// Intersection point is P + t*r
+		out_intersection[0] = seg1->p1[0] + t * r[0];
+		out_intersection[1] = seg1->p1[1] + t * r[1];
+		return true;
+	}
+	return false;
+}
+
+int dgn_wall_segments(struct dgn *dgn, struct line_segment *dst, int x, int y, int z, bool check_door)
+{
+	if (!dgn_is_in_map(dgn, x, y, z))
+		return 0;
+	struct dgn_cell *cell = dgn_cell_at(dgn, x, y, z);
+	int i = 0;
+	if (cell->north_wall != -1 || cell->north_door_lock ||
+	    (check_door && cell->north_door != -1 && cell->north_door_angle == 0.f)) {
+		dst[i].p1[0] = x - 0.5f;
+		dst[i].p1[1] = z + 0.5f;
+		dst[i].p2[0] = x + 0.5f;
+		dst[i].p2[1] = z + 0.5f;
+		i++;
+	}
+	if (cell->west_wall != -1 || cell->west_door_lock ||
+	    (check_door && cell->west_door != -1 && cell->west_door_angle == 0.f)) {
+		dst[i].p1[0] = x - 0.5f;
+		dst[i].p1[1] = z - 0.5f;
+		dst[i].p2[0] = x - 0.5f;
+		dst[i].p2[1] = z + 0.5f;
+		i++;
+	}
+	if (cell->south_wall != -1 || cell->south_door_lock ||
+	    (check_door && cell->south_door != -1 && cell->south_door_angle == 0.f)) {
+		dst[i].p1[0] = x - 0.5f;
+		dst[i].p1[1] = z - 0.5f;
+		dst[i].p2[0] = x + 0.5f;
+		dst[i].p2[1] = z - 0.5f;
+		i++;
+	}
+	if (cell->east_wall != -1 || cell->east_door_lock ||
+	    (check_door && cell->east_door != -1 && cell->east_door_angle == 0.f)) {
+		dst[i].p1[0] = x + 0.5f;
+		dst[i].p1[1] = z - 0.5f;
+		dst[i].p2[0] = x + 0.5f;
+		dst[i].p2[1] = z + 0.5f;
+		i++;
+	}
+	if (cell->ceiling != -1) {
+		// Add segments for an octagon.
+		float r = (cell->ceiling == 10) ? 0.35f : 0.5f;
+		float hr = 0.5f * r;
+
+		vec2 v[8];
+		v[0][0] = x - hr; v[0][1] = z - r;
+		v[1][0] = x + hr; v[1][1] = z - r;
+		v[2][0] = x + r;  v[2][1] = z - hr;
+		v[3][0] = x + r;  v[3][1] = z + hr;
+		v[4][0] = x + hr; v[4][1] = z + r;
+		v[5][0] = x - hr; v[5][1] = z + r;
+		v[6][0] = x - r;  v[6][1] = z + hr;
+		v[7][0] = x - r;  v[7][1] = z - hr;
+
+		for (int j = 0; j < 8; j++) {
+			glm_vec2_copy(v[j], dst[i].p1);
+			glm_vec2_copy(v[(j + 1) % 8], dst[i].p2);
+			i++;
+		}
+	}
+	return i;
+}
+
+bool dgn_check_look(struct dgn *dgn, float px, float py, float qx, float qy, int floor)
+{
+	struct line_segment sight_line = {{px, py}, {qx, qy}};
+	int min_x = roundf(min(px, qx));
+	int max_x = roundf(max(px, qx));
+	int min_y = roundf(min(py, qy));
+	int max_y = roundf(max(py, qy));
+
+	// Walk the grid column by column, visiting only the cells that the sight
+	// line passes through (or touches, within LOOK_EPSILON). A wall segment
+	// lies within the bounds of its cell, so cells the line doesn't reach
+	// can't block it.
+	float lo_x = min(px, qx);
+	float hi_x = max(px, qx);
+	float slope = px != qx ? (qy - py) / (qx - px) : 0.f;
+	for (int x = min_x; x <= max_x; x++) {
+		int y0 = min_y, y1 = max_y;
+		if (px != qx) {
+			float ya = py + (max(x - 0.5f, lo_x) - px) * slope;
+			float yb = py + (min(x + 0.5f, hi_x) - px) * slope;
+			y0 = max(y0, (int)ceilf(min(ya, yb) - 0.5f - LOOK_EPSILON));
+			y1 = min(y1, (int)floorf(max(ya, yb) + 0.5f + LOOK_EPSILON));
+		}
+		for (int y = y0; y <= y1; y++) {
+			struct line_segment segments[DGN_MAX_WALL_SEGMENTS_PER_CELL];
+			int nr_segments = dgn_wall_segments(dgn, segments, x, floor, y, true);
+			for (int i = 0; i < nr_segments; i++) {
+				vec2 v;
+				if (dgn_segment_intersection(&segments[i], &sight_line, v))
+					return false;
+			}
+		}
+	}
+	return true;
+}
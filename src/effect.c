@@ -278,11 +278,26 @@ static effect_fun effect_functions[NR_EFFECTS] = {
 	[EFFECT_ZOOM_IN_CROSSFADE] = effect_zoom_in_crossfade,
 };
 
+// Compile all effect shaders up front, so that the first frame of a
+// transition doesn't stall on shader compilation.
+static void load_effect_shaders(void)
+{
+	static bool loaded = false;
+	if (loaded)
+		return;
+	for (int i = 0; i < NR_EFFECTS; i++) {
+		if (effect_shaders[i] && !effect_shaders[i]->s.program)
+			load_effect_shader(effect_shaders[i]);
+	}
+	loaded = true;
+}
+
 void effect_update_texture(int type, Texture *dst, Texture *old, Texture *new, float rate)
 {
 	if (effect_functions[type]) {
 		effect_functions[type](dst, old, new, rate);
 	} else {
+		load_effect_shaders();
 		struct effect_shader *s = effect_shaders[type];
 		if (!s) {
 			if (effect_names[type])
@@ -291,12 +306,16 @@ void effect_update_texture(int type, Texture *dst, Texture *old, Texture *new, f
 				WARNING("Unimplemented effect: %d", type);
 			s = effect_shaders[EFFECT_BLUR_CROSSFADE];
 		}
-		if (!s->s.program)
-			load_effect_shader(s);
 		render_effect_shader(s, dst, old, new, rate);
 	}
 }
 
+static void free_effect_textures(void)
+{
+	gfx_delete_texture(&effect.old);
+	gfx_delete_texture(&effect.view);
+}
+
 int effect_init(enum effect type)
 {
 	if (type <= 0 || type >= NR_EFFECTS) {
@@ -308,27 +327,28 @@ int effect_init(enum effect type)
 		// nothing to do
 	}
 	else {
-		struct effect_shader *s = effect_shaders[type];
-		if (!s) {
+		load_effect_shaders();
+		if (!effect_shaders[type]) {
 			if (effect_names[type])
 				WARNING("Unimplemented effect: %s", effect_names[type]);
 			else
 				WARNING("Unimplemented effect: %d", type);
 			type = EFFECT_BLUR_CROSSFADE;
-			s = effect_shaders[type];
-		}
-		// load shader lazily
-		if (!s->s.program) {
-			load_effect_shader(s);
 		}
 	}
 
+	// effect.old and effect.view are kept between effects and only
+	// reallocated if the screen size changed since the last effect_init.
+	// They are freed at exit (before gfx_fini, which was registered first).
+	static bool registered = false;
+	if (!registered) {
+		atexit(free_effect_textures);
+		registered = true;
+	}
 	effect.on = true;
 	effect.type = type;
-	gfx_delete_texture(&effect.old);
-	gfx_delete_texture(&effect.view);
-	gfx_copy_main_surface(&effect.old);
-	gfx_copy_main_surface(&effect.view);
+	gfx_recopy_main_surface(&effect.old);
+	gfx_recopy_main_surface(&effect.view);
 	gfx_set_view(&effect.view);
 	return 1;
 }
@@ -342,10 +362,10 @@ int effect_update(float rate)
 	if (effect_functions[effect.type]) {
 		effect_functions[effect.type](&effect.view, &effect.old, gfx_main_surface(), rate);
 	} else {
-		Texture new;
-		gfx_copy_main_surface(&new);
-		render_effect_shader(effect_shaders[effect.type], &effect.view, &effect.old, &new, rate);
-		gfx_delete_texture(&new);
+		// the main surface is never attached to the effect framebuffer, so
+		// it can be sampled directly instead of being copied every frame
+		render_effect_shader(effect_shaders[effect.type], &effect.view, &effect.old,
+				gfx_main_surface(), rate);
 	}
 
 	gfx_swap();
@@ -356,7 +376,5 @@ int effect_fini(void)
 {
 	effect.on = false;
 	gfx_reset_view();
-	gfx_delete_texture(&effect.old);
-	gfx_delete_texture(&effect.view);
 	return 1;
 }
@@ -25,6 +25,7 @@
 #include "vm/heap.h"
 #include "vm/page.h"
 #include "xsystem4.h"
+#include "hll/hll.h"
 
 #define HLL_MAX_ARGS 64
 
@@ -769,6 +770,7 @@ void exit_libraries(void)
 {
 	if (libraries_initialized)
 		library_run_all("_ModuleFini");
+	hll_struct_members_fini();
 }
 
 void static_library_replace(struct static_library *lib, const char *name, void *fun)
@@ -130,7 +130,7 @@ static struct fnl_bitmap_glyph *fnl_get_bitmap_glyph(struct fnl_bitmap_size *bit
 
 #define GLYPH_BORDER_SIZE 4
 
-static bool fnl_font_get_glyph(struct font_size *_size, struct glyph *glyph, uint32_t code, enum font_weight weight)
+static bool fnl_font_get_glyph(struct font_size *_size, struct glyph_bitmap *glyph, uint32_t code, enum font_weight weight)
 {
 	struct fnl_font_size *size = (struct fnl_font_size*)_size;
 	unsigned index = fnl_char_to_index(code);
@@ -147,33 +147,42 @@ static bool fnl_font_get_glyph(struct font_size *_size, struct glyph *glyph, uin
 	const unsigned off_x = GLYPH_BORDER_SIZE;
 	const unsigned off_y = GLYPH_BORDER_SIZE;
 
-	// Sample each pixel in size->denominator`-sized blocks and compute the average.
-	// TODO: no need to sample every pixel; 4 should be fine?
+	// Box filter: average each `denominator`-sized block. Source rows are
+	// summed column-wise first (contiguous, vectorizable loops), then each
+	// group of `denominator` column sums is added up.
+	const unsigned d = size->denominator;
+	const unsigned src_width = block_width * d;
 	uint8_t *pixels = xcalloc(1, width * height);
-	unsigned *acc = xcalloc(block_width * block_height, sizeof(unsigned));
-	for (unsigned i = 0; i < block_width * block_height; i++) {
-		unsigned dst_row = i / block_width;
-		unsigned dst_col = i % block_width;
-		for (unsigned r = 0; r < size->denominator; r++) {
-			unsigned src_row = dst_row * size->denominator + r;
-			for (unsigned c = 0; c < size->denominator; c++) {
-				unsigned src_col = dst_col * size->denominator + c;
-				acc[i] += fullsize->pixels[src_row*fullsize->width + src_col];
-			}
+	unsigned *col_sums = xmalloc(max(src_width, 1) * sizeof(unsigned));
+	for (unsigned dst_row = 0; dst_row < block_height; dst_row++) {
+		const uint8_t *src = fullsize->pixels + dst_row * d * fullsize->width;
+		for (unsigned c = 0; c < src_width; c++)
+			col_sums[c] = src[c];
+		for (unsigned r = 1; r < d; r++) {
+			src += fullsize->width;
+			for (unsigned c = 0; c < src_width; c++)
+				col_sums[c] += src[c];
+		}
+		uint8_t *dst = pixels + (dst_row + off_y) * width + off_x;
+		for (unsigned dst_col = 0; dst_col < block_width; dst_col++) {
+			const unsigned *sums = col_sums + dst_col * d;
+			unsigned acc = 0;
+			for (unsigned c = 0; c < d; c++)
+				acc += sums[c];
+			dst[dst_col] = acc / (d * d);
 		}
-		uint8_t p = acc[i] / (size->denominator * size->denominator);
-		pixels[(dst_row+off_y)*width + (dst_col+off_x)] = p;
 	}
 
-	gfx_init_texture_rmap(&glyph->t[weight], width, height, pixels);
+	glyph->width = width;
+	glyph->height = height;
+	glyph->pixels = pixels;
 	glyph->rect.x = off_x;
 	glyph->rect.y = off_y;
 	glyph->rect.w = block_width;
 	glyph->rect.h = block_height;
 	glyph->advance = fullsize->advance / (float)size->denominator;
 
-	free(pixels);
-	free(acc);
+	free(col_sums);
 	return true;
 }
 
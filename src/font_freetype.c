@@ -30,16 +30,58 @@
 #include "gfx/font.h"
 #include "xsystem4.h"
 
-#define MAX_FONT_SIZES 64
+// Font sizes are kept in a hash table keyed on the (rounded) pixel size.
+// Only the MAX_RESIDENT_SIZES most recently used sizes keep their glyph
+// textures and metric caches; older sizes are trimmed, but the font_size
+// itself stays valid because callers hold on to it. A size counts as used
+// when it is requested, when a glyph is looked up and when text is measured.
+#define MAX_RESIDENT_SIZES 32
+
+// Advances for code points in the BMP are cached in lazily allocated pages.
+#define ADVANCE_PAGE_BITS 8
+#define ADVANCE_PAGE_SIZE (1 << ADVANCE_PAGE_BITS)
+#define NR_ADVANCE_PAGES (0x10000 / ADVANCE_PAGE_SIZE)
+
+// Kerning pairs are memoized in an open-addressed hash table which is
+// cleared when it reaches KERNING_CACHE_MAX entries.
+#define KERNING_CACHE_MAX 16384
+#define KERNING_EMPTY 0xFFFFFFFF
+
+struct kerning_entry {
+	uint32_t pair;
+	float kerning;
+};
+
+struct ft_font_size {
+	struct font_size super;
+	// LRU list of resident sizes
+	struct ft_font_size *prev;
+	struct ft_font_size *next;
+	bool resident;
+	// NR_ADVANCE_PAGES page pointers, allocated on first use
+	float **advances;
+	unsigned nr_kerning;
+	unsigned kerning_cap;
+	struct kerning_entry *kerning;
+};
 
 struct font_ft {
 	struct font super;
 	FT_Face font;
 	unsigned current_size;
-	unsigned nr_sizes;
-	struct font_size sizes[MAX_FONT_SIZES];
+	struct hash_table *size_table;
+	struct ft_font_size *lru_head;
+	struct ft_font_size *lru_tail;
+	unsigned nr_resident;
 };
 
+// FT_Load_Char flags used to rasterize glyphs
+#define FT_RENDER_FLAGS FT_LOAD_RENDER
+
+// FT_Bitmap_Embolden strengths (in 26.6 pixels) for bold and heavy glyphs
+#define BOLD_STRENGTH 64
+#define HEAVY_STRENGTH 128
+
 static FT_Library ft_lib;
 
 static bool is_half_width(uint32_t code)
@@ -63,24 +105,84 @@ void ft_font_init(void)
 	}
 }
 
+// Free glyph textures and metric caches of a size that fell out of the LRU.
+static void ft_font_size_trim(struct ft_font_size *size)
+{
+	gfx_font_size_free_glyphs(&size->super);
+	if (size->advances) {
+		for (int i = 0; i < NR_ADVANCE_PAGES; i++) {
+			free(size->advances[i]);
+		}
+		free(size->advances);
+		size->advances = NULL;
+	}
+	free(size->kerning);
+	size->kerning = NULL;
+	size->kerning_cap = 0;
+	size->nr_kerning = 0;
+}
+
+static void lru_unlink(struct font_ft *font, struct ft_font_size *size)
+{
+	if (size->prev)
+		size->prev->next = size->next;
+	else
+		font->lru_head = size->next;
+	if (size->next)
+		size->next->prev = size->prev;
+	else
+		font->lru_tail = size->prev;
+	size->prev = size->next = NULL;
+}
+
+static void lru_touch(struct font_ft *font, struct ft_font_size *size)
+{
+	if (font->lru_head == size)
+		return;
+	if (size->resident) {
+		lru_unlink(font, size);
+	} else {
+		size->resident = true;
+		font->nr_resident++;
+	}
+
+	size->next = font->lru_head;
+	if (font->lru_head)
+		font->lru_head->prev = size;
+	font->lru_head = size;
+	if (!font->lru_tail)
+		font->lru_tail = size;
+
+	while (font->nr_resident > MAX_RESIDENT_SIZES) {
+		struct ft_font_size *victim = font->lru_tail;
+		lru_unlink(font, victim);
+		victim->resident = false;
+		font->nr_resident--;
+		ft_font_size_trim(victim);
+	}
+}
+
 static struct font_size *ft_font_get_size(struct font *_font, float size)
 {
 	struct font_ft *font = (struct font_ft*)_font;
 	size = roundf(size);
-	for (int i = 0; i < font->nr_sizes; i++) {
-		if (fabsf(font->sizes[i].size - size) < 0.01) {
-			return &font->sizes[i];
-		}
+
+	struct ht_slot *slot = ht_put_int(font->size_table, (int)size, NULL);
+	struct ft_font_size *fs = slot->value;
+	if (!fs) {
+		fs = xcalloc(1, sizeof(struct ft_font_size));
+		fs->super.size = size;
+		fs->super.y_offset = -roundf(size * 0.15f);
+		fs->super.font = _font;
+		slot->value = fs;
 	}
+	lru_touch(font, fs);
+	return &fs->super;
+}
 
-	if (font->nr_sizes + 1 >= MAX_FONT_SIZES)
-		ERROR("Exceeded maximum number of font sizes");
-	struct font_size *fs = &font->sizes[font->nr_sizes++];
-	fs->size = size;
-	fs->y_offset = -roundf(size * 0.15f);
-	fs->font = _font;
-	fs->glyph_table = ht_create(4096);
-	return fs;
+static void ft_font_touch_size(struct font_size *size)
+{
+	lru_touch((struct font_ft*)size->font, (struct ft_font_size*)size);
 }
 
 static float ft_font_get_actual_size(struct font *_, float size)
@@ -93,9 +195,9 @@ static float ft_font_get_actual_size(struct font *_, float size)
 // FIXME: the outline rendering code should be fixed so this isn't necessary.
 #define GLYPH_BORDER_SIZE 4
 
-// Convert a glyph rendered by FreeType to a block-sized texture.
+// Convert a glyph rendered by FreeType to a block-sized bitmap.
 // Block size is size x 1.5*size (full-width) or size/2 x 1.5*size (half-width)
-static Rectangle init_glyph_texture(Texture *dst, FT_Bitmap *glyph, int bitmap_left, int bitmap_top, int size, bool half_width)
+static void init_glyph_bitmap(struct glyph_bitmap *dst, FT_Bitmap *glyph, int bitmap_left, int bitmap_top, int size, bool half_width)
 {
 	// calculate block size and offsets
 	int block_width = max(half_width ? size/2 : size, max(0, bitmap_left) + glyph->width);
@@ -114,11 +216,10 @@ static Rectangle init_glyph_texture(Texture *dst, FT_Bitmap *glyph, int bitmap_l
 		}
 	}
 
-	// create texture from block-size bitmap
-	gfx_init_texture_rmap(dst, width, height, bitmap);
-	free(bitmap);
-
-	return (Rectangle) {
+	dst->width = width;
+	dst->height = height;
+	dst->pixels = bitmap;
+	dst->rect = (Rectangle) {
 		.x = GLYPH_BORDER_SIZE,
 		.y = GLYPH_BORDER_SIZE,
 		.w = block_width,
@@ -134,28 +235,26 @@ static void ft_font_set_size(struct font_ft *font, unsigned size)
 	font->current_size = size;
 }
 
-static bool ft_font_get_glyph(struct font_size *size, struct glyph *glyph, uint32_t code, enum font_weight weight)
+static bool ft_font_get_glyph(struct font_size *size, struct glyph_bitmap *glyph, uint32_t code, enum font_weight weight)
 {
-	Texture *t = &glyph->t[weight];
-
 	// render bitmap
 	bool half_width = is_half_width(code);
 	struct font_ft *font = (struct font_ft*)size->font;
 	ft_font_set_size(font, size->size);
-	if (FT_Load_Char(font->font, code, FT_LOAD_RENDER)) {
+	if (FT_Load_Char(font->font, code, FT_RENDER_FLAGS)) {
 		WARNING("Failed to load glyph for codepoint 0x%x", code);
 		return false;
 	}
 	if (weight != FONT_WEIGHT_NORMAL) {
-		int bold_weight = weight == FONT_WEIGHT_HEAVY ? 128 : 64;
+		int bold_weight = weight == FONT_WEIGHT_HEAVY ? HEAVY_STRENGTH : BOLD_STRENGTH;
 		FT_GlyphSlot_Own_Bitmap(font->font->glyph);
 		FT_Bitmap_Embolden(ft_lib, &font->font->glyph->bitmap, bold_weight, 0);
 	}
 
-	// create texture from bitmap
+	// copy to block-sized bitmap
 	FT_Bitmap *bitmap = &font->font->glyph->bitmap;
 	if (bitmap->pixel_mode == FT_PIXEL_MODE_GRAY) {
-		glyph->rect = init_glyph_texture(t, bitmap, font->font->glyph->bitmap_left,
+		init_glyph_bitmap(glyph, bitmap, font->font->glyph->bitmap_left,
 				font->font->glyph->bitmap_top, size->size, half_width);
 	} else if (bitmap->pixel_mode == FT_PIXEL_MODE_MONO) {
 		FT_Bitmap tmp;
@@ -170,7 +269,7 @@ static bool ft_font_get_glyph(struct font_size *size, struct glyph *glyph, uint3
 			if (tmp.buffer[i])
 				tmp.buffer[i] = 255;
 		}
-		glyph->rect = init_glyph_texture(t, &tmp, font->font->glyph->bitmap_left,
+		init_glyph_bitmap(glyph, &tmp, font->font->glyph->bitmap_left,
 				font->font->glyph->bitmap_top, size->size, half_width);
 		FT_Bitmap_Done(ft_lib, &tmp);
 	} else {
@@ -187,26 +286,118 @@ static float ft_font_size_char(struct font_size *size, uint32_t code)
 	return is_half_width(code) ? size->size / 2 : size->size;
 }
 
-static float ft_font_size_char_kerning(struct font_size *size, uint32_t code,
-		uint32_t code_next)
+static float ft_font_get_advance(struct ft_font_size *size, uint32_t code)
 {
-	struct font_ft *font = (struct font_ft*)size->font;
-	ft_font_set_size(font, size->size);
-
-	FT_UInt index = FT_Get_Char_Index(font->font, code);
-	FT_UInt next_index = FT_Get_Char_Index(font->font, code_next);
+	float *page = NULL;
+	if (code < 0x10000) {
+		if (!size->advances)
+			size->advances = xcalloc(NR_ADVANCE_PAGES, sizeof(float*));
+		float **p = &size->advances[code >> ADVANCE_PAGE_BITS];
+		if (!*p) {
+			*p = xmalloc(ADVANCE_PAGE_SIZE * sizeof(float));
+			for (int i = 0; i < ADVANCE_PAGE_SIZE; i++)
+				(*p)[i] = -1.f;
+		}
+		page = *p;
+		float advance = page[code & (ADVANCE_PAGE_SIZE - 1)];
+		if (advance >= 0.f)
+			return advance;
+	}
 
+	struct font_ft *font = (struct font_ft*)size->super.font;
+	ft_font_set_size(font, size->super.size);
 	FT_Fixed advance;
-	FT_Get_Advance(font->font, index, FT_LOAD_DEFAULT, &advance);
+	FT_Get_Advance(font->font, FT_Get_Char_Index(font->font, code), FT_LOAD_DEFAULT, &advance);
 
-	if (!FT_HAS_KERNING(font->font)) {
-		return advance / 65536.f;
+	float r = advance / 65536.f;
+	if (page)
+		page[code & (ADVANCE_PAGE_SIZE - 1)] = r;
+	return r;
+}
+
+static struct kerning_entry *kerning_lookup(struct ft_font_size *size, uint32_t pair)
+{
+	unsigned mask = size->kerning_cap - 1;
+	unsigned i = (pair * 2654435761u) & mask;
+	while (size->kerning[i].pair != KERNING_EMPTY && size->kerning[i].pair != pair)
+		i = (i + 1) & mask;
+	return &size->kerning[i];
+}
+
+static void kerning_reset(struct ft_font_size *size, unsigned cap)
+{
+	free(size->kerning);
+	size->kerning = xmalloc(cap * sizeof(struct kerning_entry));
+	for (unsigned i = 0; i < cap; i++)
+		size->kerning[i].pair = KERNING_EMPTY;
+	size->kerning_cap = cap;
+	size->nr_kerning = 0;
+}
+
+static void kerning_grow(struct ft_font_size *size)
+{
+	struct kerning_entry *old = size->kerning;
+	unsigned old_cap = size->kerning_cap;
+	size->kerning = NULL;
+	kerning_reset(size, old_cap * 2);
+	for (unsigned i = 0; i < old_cap; i++) {
+		if (old[i].pair != KERNING_EMPTY) {
+			*kerning_lookup(size, old[i].pair) = old[i];
+			size->nr_kerning++;
+		}
+	}
+	free(old);
+}
+
+static float ft_font_get_kerning(struct ft_font_size *size, uint32_t code, uint32_t code_next)
+{
+	// only pairs within the BMP are memoized
+	bool cacheable = code < 0xFFFF && code_next < 0xFFFF;
+	uint32_t pair = (code << 16) | code_next;
+	struct kerning_entry *e = NULL;
+	if (cacheable) {
+		if (!size->kerning)
+			kerning_reset(size, 256);
+		e = kerning_lookup(size, pair);
+		if (e->pair == pair)
+			return e->kerning;
 	}
 
+	struct font_ft *font = (struct font_ft*)size->super.font;
+	ft_font_set_size(font, size->super.size);
+	FT_UInt index = FT_Get_Char_Index(font->font, code);
+	FT_UInt next_index = FT_Get_Char_Index(font->font, code_next);
 	FT_Vector delta;
 	FT_Get_Kerning(font->font, index, next_index, FT_KERNING_DEFAULT, &delta);
+	float kerning = delta.x / 64.f;
+
+	if (cacheable) {
+		if (size->nr_kerning >= KERNING_CACHE_MAX) {
+			kerning_reset(size, size->kerning_cap);
+			e = kerning_lookup(size, pair);
+		} else if ((size->nr_kerning + 1) * 2 > size->kerning_cap) {
+			kerning_grow(size);
+			e = kerning_lookup(size, pair);
+		}
+		e->pair = pair;
+		e->kerning = kerning;
+		size->nr_kerning++;
+	}
+	return kerning;
+}
 
-	return (advance / 65536.f) + (delta.x / 64.f);
+static float ft_font_size_char_kerning(struct font_size *_size, uint32_t code,
+		uint32_t code_next)
+{
+	struct ft_font_size *size = (struct ft_font_size*)_size;
+	struct font_ft *font = (struct font_ft*)size->super.font;
+	lru_touch(font, size);
+
+	float advance = ft_font_get_advance(size, code);
+	if (!FT_HAS_KERNING(font->font)) {
+		return advance;
+	}
+	return advance + ft_font_get_kerning(size, code, code_next);
 }
 
 struct font *ft_font_load(const char *path)
@@ -243,11 +434,21 @@ struct font *ft_font_load(const char *path)
 		return NULL;
 	}
 
+	font->size_table = ht_create(64);
 	font->super.get_size = ft_font_get_size;
 	font->super.get_actual_size = ft_font_get_actual_size;
 	font->super.get_actual_size_round_down = ft_font_get_actual_size;
 	font->super.get_glyph = ft_font_get_glyph;
 	font->super.size_char = ft_font_size_char;
 	font->super.size_char_kerning = ft_font_size_char_kerning;
+	font->super.touch_size = ft_font_touch_size;
+
+	// Glyphs from a different FreeType release (or with different render
+	// options) may rasterize differently, so they get their own cache.
+	FT_Int major, minor, patch;
+	FT_Library_Version(ft_lib, &major, &minor, &patch);
+	font->super.render_key = (uint64_t)(major << 16 | minor << 8 | patch) << 32
+		| (uint64_t)FT_RENDER_FLAGS << 16
+		| BOLD_STRENGTH << 8 | HEAVY_STRENGTH;
 	return &font->super;
 }
@@ -0,0 +1,324 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <SDL.h>
+
+#include "system4.h"
+#include "system4/file.h"
+#include "system4/hashtable.h"
+
+#include "gfx/font.h"
+#include "xsystem4.h"
+
+/*
+ * Persistent glyph cache.
+ *
+ * Rasterized glyphs are appended to a per-font file in the xsystem4 home
+ * directory so that later runs can upload them directly instead of
+ * rasterizing them again. The file name is a hash of the font file's path,
+ * size and modification time and of the font's render key (the rasterizer
+ * library version and render options), so replacing a font or upgrading
+ * FreeType starts a new cache. GLYPH_CACHE_VERSION must be bumped whenever
+ * xsystem4's own rasterizing code changes its output.
+ */
+
+#define GLYPH_CACHE_MAGIC "XGC\0"
+#define GLYPH_CACHE_VERSION 1
+#define GLYPH_CACHE_MAX_DIM 4096
+
+struct glyph_cache_header {
+	char magic[4];
+	uint32_t version;
+};
+
+// followed by width * height bytes of coverage data, padded to a multiple of
+// 4 bytes so that the next record is aligned
+struct glyph_record {
+	float size;
+	uint32_t code;
+	uint32_t weight;
+	int32_t width;
+	int32_t height;
+	int32_t rect_x;
+	int32_t rect_y;
+	int32_t rect_w;
+	int32_t rect_h;
+	float advance;
+};
+
+struct glyph_cache_size {
+	float size;
+	bool weights[NR_FONT_WEIGHTS];
+	// (code * NR_FONT_WEIGHTS + weight) -> struct glyph_record*
+	struct hash_table *glyphs;
+};
+
+struct glyph_cache {
+	char *path;
+	FILE *out;
+	bool write_failed;
+	uint8_t *data;
+	size_t data_size;
+	size_t valid_size;
+	unsigned nr_sizes;
+	struct glyph_cache_size *sizes;
+};
+
+// Caches are shared between fonts loaded from the same file.
+static struct glyph_cache **caches = NULL;
+static unsigned nr_caches = 0;
+
+// Index value for glyphs written during this session. Their data isn't kept
+// in memory; the slot only prevents writing them twice.
+static char written_marker;
+
+static uint64_t hash_font_file(const char *path, unsigned index, uint64_t render_key)
+{
+	uint64_t file_size, mtime;
+	struct stat s;
+	if (stat_utf8(path, &s) == 0) {
+		file_size = s.st_size;
+		mtime = s.st_mtime;
+	} else {
+		// e.g. an Android asset, which can't be stat'ed
+		SDL_RWops *rw = SDL_RWFromFile(path, "rb");
+		if (!rw)
+			return 0;
+		Sint64 size = SDL_RWsize(rw);
+		SDL_RWclose(rw);
+		if (size < 0)
+			return 0;
+		file_size = size;
+		mtime = 0;
+	}
+
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for (const char *p = path; *p; p++) {
+		h = (h ^ (uint8_t)*p) * 0x100000001b3ULL;
+	}
+	h = (h ^ index) * 0x100000001b3ULL;
+	h = (h ^ GLYPH_CACHE_VERSION) * 0x100000001b3ULL;
+	h = (h ^ render_key) * 0x100000001b3ULL;
+	h = (h ^ file_size) * 0x100000001b3ULL;
+	h = (h ^ mtime) * 0x100000001b3ULL;
+	return h;
+}
+
+static struct glyph_cache_size *get_size(struct glyph_cache *cache, float size, bool create)
+{
+	for (unsigned i = 0; i < cache->nr_sizes; i++) {
+		if (fabsf(cache->sizes[i].size - size) < 0.01f)
+			return &cache->sizes[i];
+	}
+	if (!create)
+		return NULL;
+
+	cache->sizes = xrealloc_array(cache->sizes, cache->nr_sizes, cache->nr_sizes + 1,
+			sizeof(struct glyph_cache_size));
+	struct glyph_cache_size *s = &cache->sizes[cache->nr_sizes++];
+	s->size = size;
+	s->glyphs = ht_create(1024);
+	return s;
+}
+
+static size_t record_size(int width, int height)
+{
+	return sizeof(struct glyph_record) + (((size_t)width * height + 3) & ~(size_t)3);
+}
+
+static int glyph_key(uint32_t code, enum font_weight weight)
+{
+	return code * NR_FONT_WEIGHTS + weight;
+}
+
+static void index_file(struct glyph_cache *cache)
+{
+	cache->valid_size = 0;
+	if (cache->data_size < sizeof(struct glyph_cache_header))
+		return;
+	struct glyph_cache_header *header = (struct glyph_cache_header*)cache->data;
+	if (memcmp(header->magic, GLYPH_CACHE_MAGIC, 4) || header->version != GLYPH_CACHE_VERSION)
+		return;
+
+	size_t pos = sizeof(struct glyph_cache_header);
+	while (cache->data_size - pos >= sizeof(struct glyph_record)) {
+		struct glyph_record *rec = (struct glyph_record*)(cache->data + pos);
+		if (rec->width <= 0 || rec->width > GLYPH_CACHE_MAX_DIM
+				|| rec->height <= 0 || rec->height > GLYPH_CACHE_MAX_DIM
+				|| rec->weight >= NR_FONT_WEIGHTS)
+			break;
+		size_t rec_size = record_size(rec->width, rec->height);
+		if (cache->data_size - pos < rec_size)
+			break;
+
+		struct glyph_cache_size *s = get_size(cache, rec->size, true);
+		s->weights[rec->weight] = true;
+		ht_put_int(s->glyphs, glyph_key(rec->code, rec->weight), rec);
+		pos += rec_size;
+	}
+	cache->valid_size = pos;
+	if (pos < cache->data_size)
+		WARNING("Glyph cache '%s' is truncated or corrupt", display_utf0(cache->path));
+}
+
+struct glyph_cache *glyph_cache_open(const char *font_path, unsigned index, uint64_t render_key)
+{
+	uint64_t hash = hash_font_file(font_path, index, render_key);
+	if (!hash)
+		return NULL;
+
+	char *dir = xmalloc(strlen(config.home_dir) + strlen("/glyph-cache") + 1);
+	strcpy(dir, config.home_dir);
+	strcat(dir, "/glyph-cache");
+	if (mkdir_p(dir)) {
+		WARNING("Failed to create glyph cache directory '%s'", display_utf0(dir));
+		free(dir);
+		return NULL;
+	}
+
+	char *path = xmalloc(strlen(dir) + 1 + 16 + strlen(".bin") + 1);
+	sprintf(path, "%s/%016llx.bin", dir, (unsigned long long)hash);
+	free(dir);
+
+	for (unsigned i = 0; i < nr_caches; i++) {
+		if (!strcmp(caches[i]->path, path)) {
+			free(path);
+			return caches[i];
+		}
+	}
+
+	struct glyph_cache *cache = xcalloc(1, sizeof(struct glyph_cache));
+	cache->path = path;
+	cache->data = file_read(cache->path, &cache->data_size);
+	if (cache->data)
+		index_file(cache);
+
+	caches = xrealloc_array(caches, nr_caches, nr_caches + 1, sizeof(struct glyph_cache*));
+	caches[nr_caches++] = cache;
+	return cache;
+}
+
+bool glyph_cache_get(struct glyph_cache *cache, float size, uint32_t code,
+		enum font_weight weight, struct glyph_bitmap *out)
+{
+	struct glyph_cache_size *s = get_size(cache, size, false);
+	if (!s)
+		return false;
+	struct glyph_record *rec = ht_get_int(s->glyphs, glyph_key(code, weight), NULL);
+	if (!rec || (void*)rec == &written_marker)
+		return false;
+
+	out->width = rec->width;
+	out->height = rec->height;
+	out->rect = (Rectangle) { rec->rect_x, rec->rect_y, rec->rect_w, rec->rect_h };
+	out->advance = rec->advance;
+	out->pixels = (uint8_t*)(rec + 1);
+	return true;
+}
+
+static bool open_output(struct glyph_cache *cache)
+{
+	if (cache->out)
+		return true;
+	if (cache->write_failed)
+		return false;
+
+	if (cache->valid_size && cache->valid_size == cache->data_size) {
+		cache->out = file_open_utf8(cache->path, "ab");
+	} else {
+		// new file, or the existing file needs its bad tail dropped
+		cache->out = file_open_utf8(cache->path, "wb");
+		if (cache->out) {
+			bool ok;
+			if (cache->valid_size) {
+				ok = fwrite(cache->data, cache->valid_size, 1, cache->out) == 1;
+			} else {
+				struct glyph_cache_header header = { .version = GLYPH_CACHE_VERSION };
+				memcpy(header.magic, GLYPH_CACHE_MAGIC, 4);
+				ok = fwrite(&header, sizeof(header), 1, cache->out) == 1;
+			}
+			if (!ok) {
+				fclose(cache->out);
+				cache->out = NULL;
+			}
+		}
+	}
+	if (!cache->out) {
+		WARNING("Failed to open glyph cache '%s': %s", display_utf0(cache->path),
+				strerror(errno));
+		cache->write_failed = true;
+		return false;
+	}
+	return true;
+}
+
+void glyph_cache_put(struct glyph_cache *cache, float size, uint32_t code,
+		enum font_weight weight, struct glyph_bitmap *bitmap)
+{
+	if (bitmap->width <= 0 || bitmap->width > GLYPH_CACHE_MAX_DIM
+			|| bitmap->height <= 0 || bitmap->height > GLYPH_CACHE_MAX_DIM)
+		return;
+
+	struct glyph_cache_size *s = get_size(cache, size, true);
+	struct ht_slot *slot = ht_put_int(s->glyphs, glyph_key(code, weight), NULL);
+	if (slot->value)
+		return;
+	if (!open_output(cache))
+		return;
+
+	struct glyph_record rec = {
+		.size = size,
+		.code = code,
+		.weight = weight,
+		.width = bitmap->width,
+		.height = bitmap->height,
+		.rect_x = bitmap->rect.x,
+		.rect_y = bitmap->rect.y,
+		.rect_w = bitmap->rect.w,
+		.rect_h = bitmap->rect.h,
+		.advance = bitmap->advance,
+	};
+	static const uint8_t padding[4] = {0};
+	size_t data_size = (size_t)rec.width * rec.height;
+	size_t pad = record_size(rec.width, rec.height) - sizeof(rec) - data_size;
+	if (fwrite(&rec, sizeof(rec), 1, cache->out) != 1
+			|| fwrite(bitmap->pixels, data_size, 1, cache->out) != 1
+			|| (pad && fwrite(padding, pad, 1, cache->out) != 1)
+			|| fflush(cache->out)) {
+		WARNING("Failed to write glyph cache '%s': %s", display_utf0(cache->path),
+				strerror(errno));
+		fclose(cache->out);
+		cache->out = NULL;
+		cache->write_failed = true;
+		return;
+	}
+	slot->value = &written_marker;
+	s->weights[weight] = true;
+}
+
+void glyph_cache_foreach_size(struct glyph_cache *cache, glyph_cache_size_cb cb, void *data)
+{
+	for (unsigned i = 0; i < cache->nr_sizes; i++) {
+		for (int w = 0; w < NR_FONT_WEIGHTS; w++) {
+			if (cache->sizes[i].weights[w])
+				cb(cache->sizes[i].size, w, data);
+		}
+	}
+}
@@ -15,10 +15,12 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <math.h>
 
 #include "system4.h"
+#include "system4/hashtable.h"
 #include "system4/string.h"
 #include "system4/utfsjis.h"
 #include "vm/heap.h"
@@ -34,8 +36,31 @@
  *       StoatSpriteEngine/ChipmunkSpriteEngine.
  */
 
+/*
+ * Rendered characters are shared between all sprites displaying the same
+ * character in the same style. The sprite borrows the texture handle from the
+ * cache entry, so it must be released with charsprite_free_sprite rather than
+ * sprite_free.
+ */
+struct charsprite_texture_key {
+	char ch[4];
+	struct text_style ts;
+};
+
+struct charsprite_texture {
+	struct charsprite_texture_key key;
+	struct texture texture;
+	unsigned ref;
+	// next entry with the same hash
+	struct charsprite_texture *next;
+};
+
+// hash -> struct charsprite_texture*
+static struct hash_table *charsprite_textures = NULL;
+
 struct charsprite {
 	struct sact_sprite sp;
+	struct charsprite_texture *texture;
 	// NOTE: even though we only render a single character, we need to store an
 	//       arbitrary string because CharSprite_GetChar returns it.
 	struct string *ch;
@@ -112,9 +137,94 @@ int CharSpriteManager_CreateHandle(void)
 	return handle;
 }
 
-static void charsprite_free(struct charsprite *cs)
+static void charsprite_texture_key_init(struct charsprite_texture_key *key,
+		const char *ch, struct text_style *ts)
+{
+	// zero-fill so that padding doesn't affect hashing/comparison
+	memset(key, 0, sizeof(*key));
+	strcpy(key->ch, ch);
+	key->ts.face = ts->face;
+	key->ts.size = ts->size;
+	key->ts.bold_width = ts->bold_width;
+	key->ts.weight = ts->weight;
+	key->ts.edge_left = ts->edge_left;
+	key->ts.edge_up = ts->edge_up;
+	key->ts.edge_right = ts->edge_right;
+	key->ts.edge_down = ts->edge_down;
+	key->ts.color = ts->color;
+	key->ts.edge_color = ts->edge_color;
+	key->ts.scale_x = ts->scale_x;
+	key->ts.space_scale_x = ts->space_scale_x;
+	key->ts.font_spacing = ts->font_spacing;
+}
+
+static int charsprite_texture_hash(struct charsprite_texture_key *key)
+{
+	const uint8_t *p = (const uint8_t*)key;
+	uint32_t h = 2166136261u;
+	for (size_t i = 0; i < sizeof(*key); i++) {
+		h = (h ^ p[i]) * 16777619u;
+	}
+	return h;
+}
+
+static struct charsprite_texture *charsprite_texture_get(char *ch, struct text_style *ts)
+{
+	struct charsprite_texture_key key;
+	charsprite_texture_key_init(&key, ch, ts);
+
+	if (!charsprite_textures)
+		charsprite_textures = ht_create(1024);
+	struct ht_slot *slot = ht_put_int(charsprite_textures, charsprite_texture_hash(&key), NULL);
+	for (struct charsprite_texture *t = slot->value; t; t = t->next) {
+		if (!memcmp(&t->key, &key, sizeof(key))) {
+			t->ref++;
+			return t;
+		}
+	}
+
+	struct charsprite_texture *t = xcalloc(1, sizeof(struct charsprite_texture));
+	t->key = key;
+	t->ref = 1;
+	t->next = slot->value;
+	slot->value = t;
+
+	int w = ceilf(text_style_width(ts, ch));
+	int h = ts->size + ts->size/2;
+	gfx_init_texture_rgba(&t->texture, w, h, COLOR(0, 0, 0, 0));
+	gfx_render_text(&t->texture, 0.0f, 0, ch, ts, false);
+	return t;
+}
+
+static void charsprite_texture_unref(struct charsprite_texture *t)
 {
+	if (--t->ref)
+		return;
+
+	struct ht_slot *slot = ht_put_int(charsprite_textures, charsprite_texture_hash(&t->key), NULL);
+	struct charsprite_texture **p = (struct charsprite_texture**)&slot->value;
+	while (*p != t)
+		p = &(*p)->next;
+	*p = t->next;
+
+	gfx_delete_texture(&t->texture);
+	free(t);
+}
+
+// Release the sprite, returning its borrowed texture to the cache.
+static void charsprite_free_sprite(struct charsprite *cs)
+{
+	if (cs->texture) {
+		cs->sp.texture = (struct texture) {0};
+		charsprite_texture_unref(cs->texture);
+		cs->texture = NULL;
+	}
 	sprite_free(&cs->sp);
+}
+
+static void charsprite_free(struct charsprite *cs)
+{
+	charsprite_free_sprite(cs);
 	if (cs->ch) {
 		free_string(cs->ch);
 	}
@@ -176,11 +286,14 @@ static void charsprite_render(struct charsprite *cs)
 		ch[2] = 0;
 	}
 
-	int w = ceilf(text_style_width(&cs->ts, ch));
-	int h = cs->ts.size + cs->ts.size/2;
-	sprite_init_color(&cs->sp, w, h, 0, 0, 0, 0);
-	sprite_get_texture(&cs->sp); // XXX: force initialization of texture
-	gfx_render_text(&cs->sp.texture, 0.0f, 0, ch, &cs->ts, false);
+	struct charsprite_texture *t = charsprite_texture_get(ch, &cs->ts);
+	if (cs->texture) {
+		cs->sp.texture = (struct texture) {0};
+		charsprite_texture_unref(cs->texture);
+	}
+	cs->texture = t;
+	sprite_init_color(&cs->sp, t->texture.w, t->texture.h, 0, 0, 0, 0);
+	cs->sp.texture = t->texture;
 	sprite_dirty(&cs->sp);
 }
 
@@ -189,17 +302,18 @@ void CharSpriteManager_Rebuild(void)
 	if (!loaded)
 		return;
 
-	charsprite_manager_free(&chars);
-	chars = load_chars;
-
-	// reset visibility
-	for (unsigned i = 0; i < chars.size; i++) {
-		if (!chars.sprites[i])
+	// Render the loaded sprites before freeing the old ones, so that
+	// textures shared between them are kept instead of re-rendered.
+	for (unsigned i = 0; i < load_chars.size; i++) {
+		if (!load_chars.sprites[i])
 			continue;
-		charsprite_render(chars.sprites[i]);
-		sprite_set_show(&chars.sprites[i]->sp, chars.sprites[i]->show);
+		charsprite_render(load_chars.sprites[i]);
+		sprite_set_show(&load_chars.sprites[i]->sp, load_chars.sprites[i]->show);
 	}
 
+	charsprite_manager_free(&chars);
+	chars = load_chars;
+
 	memset(&load_chars, 0, sizeof(load_chars));
 	loaded = false;
 }
@@ -329,7 +443,7 @@ bool CharSpriteManager_Load(struct page **data)
 		// insert charsprite into array
 		int handle = iarray_read(&r) - 2000;
 		if (handle < 0 || (unsigned)handle >= csm.size || csm.sprites[handle]) {
-			sprite_free(&cs->sp);
+			charsprite_free_sprite(cs);
 			free(cs);
 			goto error;
 		}
@@ -361,7 +475,7 @@ error:
 void CharSprite_Release(int handle)
 {
 	struct charsprite *sp = charsprite_get(handle);
-	sprite_free(&sp->sp);
+	charsprite_free_sprite(sp);
 }
 
 static void CASColor_to_SDL_Color(SDL_Color *color, int page_no)
@@ -395,7 +509,7 @@ void CharSprite_SetChar(int handle, struct string **s, struct page **property)
 	CASCharSpriteProperty_to_text_style(&sp->ts, *property);
 
 	if (charsprite_allocated(sp)) {
-		sprite_free(&sp->sp);
+		charsprite_free_sprite(sp);
 	}
 	if (sp->ch) {
 		free_string(sp->ch);
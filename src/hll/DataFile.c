@@ -20,6 +20,7 @@
 
 #include "system4/archive.h"
 #include "system4/buffer.h"
+#include "system4/hashtable.h"
 #include "system4/mt19937int.h"
 #include "system4/string.h"
 
@@ -43,9 +44,18 @@ struct gdat_row {
 	uint32_t nr_cols;
 };
 
+// Lookup tables for SarchString/SarchInt, built on the first search of a
+// column. Values are (row + 1) of the first row containing the key.
+struct gdat_index {
+	struct hash_table *strings;
+	struct hash_table *ints;
+};
+
 struct gdat_table {
 	struct gdat_row *rows;
 	uint32_t nr_rows;
+	struct gdat_index *indices;
+	uint32_t nr_indices;
 };
 
 struct gdat {
@@ -74,10 +84,18 @@ static void gdat_free(struct gdat *dat)
 	}
 	if (dat->tables) {
 		for (uint32_t i = 0; i < dat->nr_tables; i++) {
-			for (uint32_t j = 0; j < dat->tables[i].nr_rows; j++) {
-				free(dat->tables[i].rows[j].cols);
+			struct gdat_table *tbl = &dat->tables[i];
+			for (uint32_t j = 0; j < tbl->nr_rows; j++) {
+				free(tbl->rows[j].cols);
 			}
-			free(dat->tables[i].rows);
+			free(tbl->rows);
+			for (uint32_t j = 0; j < tbl->nr_indices; j++) {
+				if (tbl->indices[j].strings)
+					ht_free(tbl->indices[j].strings);
+				if (tbl->indices[j].ints)
+					ht_free_int(tbl->indices[j].ints);
+			}
+			free(tbl->indices);
 		}
 		free(dat->tables);
 	}
@@ -216,6 +234,54 @@ static struct gdat_col *gdat_get_column(struct gdat *dat, int table, int row, in
 	return &r->cols[col];
 }
 
+static struct gdat_index *gdat_get_index(struct gdat_table *tbl, uint32_t col)
+{
+	if (col >= tbl->nr_indices) {
+		tbl->indices = xrealloc_array(tbl->indices, tbl->nr_indices, col + 1,
+				sizeof(struct gdat_index));
+		tbl->nr_indices = col + 1;
+	}
+	return &tbl->indices[col];
+}
+
+static struct hash_table *gdat_string_index(struct gdat *dat, struct gdat_table *tbl, uint32_t col)
+{
+	struct gdat_index *index = gdat_get_index(tbl, col);
+	if (index->strings)
+		return index->strings;
+
+	index->strings = ht_create(tbl->nr_rows ? tbl->nr_rows : 1);
+	for (uint32_t i = 0; i < tbl->nr_rows; i++) {
+		struct gdat_row *row = &tbl->rows[i];
+		if (col >= row->nr_cols || row->cols[col].type != GDAT_STRING)
+			continue;
+		if (row->cols[col].index >= dat->nr_strings)
+			continue;
+		// ht_put keeps the existing value, so the first match wins
+		ht_put(index->strings, dat->strings[row->cols[col].index]->text,
+				(void*)(uintptr_t)(i + 1));
+	}
+	return index->strings;
+}
+
+static struct hash_table *gdat_int_index(struct gdat *dat, struct gdat_table *tbl, uint32_t col)
+{
+	struct gdat_index *index = gdat_get_index(tbl, col);
+	if (index->ints)
+		return index->ints;
+
+	index->ints = ht_create(tbl->nr_rows ? tbl->nr_rows : 1);
+	for (uint32_t i = 0; i < tbl->nr_rows; i++) {
+		struct gdat_row *row = &tbl->rows[i];
+		if (col >= row->nr_cols || row->cols[col].type != GDAT_INT)
+			continue;
+		if (row->cols[col].index >= dat->nr_ints)
+			continue;
+		ht_put_int(index->ints, dat->ints[row->cols[col].index], (void*)(uintptr_t)(i + 1));
+	}
+	return index->ints;
+}
+
 // for debug
 possibly_unused static void gdat_dump_as_json(struct gdat *dat, FILE *fp)
 {
@@ -324,14 +390,8 @@ static int DataFile_SarchString(int label, int horizontal, struct string *data)
 		return -1;
 	if (horizontal < 0)
 		return -1;
-	for (uint32_t i = 0; i < tbl->nr_rows; i++) {
-		struct gdat_row *row = &tbl->rows[i];
-		if ((uint32_t)horizontal < row->nr_cols &&
-			row->cols[horizontal].type == GDAT_STRING &&
-			!strcmp(current_gdat->strings[row->cols[horizontal].index]->text, data->text))
-			return i;
-	}
-	return -1;
+	struct hash_table *index = gdat_string_index(current_gdat, tbl, horizontal);
+	return (int)(uintptr_t)ht_get(index, data->text, NULL) - 1;
 }
 
 static int DataFile_SarchInt(int label, int horizontal, int data)
@@ -341,14 +401,8 @@ static int DataFile_SarchInt(int label, int horizontal, int data)
 		return -1;
 	if (horizontal < 0)
 		return -1;
-	for (uint32_t i = 0; i < tbl->nr_rows; i++) {
-		struct gdat_row *row = &tbl->rows[i];
-		if ((uint32_t)horizontal < row->nr_cols &&
-			row->cols[horizontal].type == GDAT_INT &&
-			current_gdat->ints[row->cols[horizontal].index] == data)
-			return i;
-	}
-	return -1;
+	struct hash_table *index = gdat_int_index(current_gdat, tbl, horizontal);
+	return (int)(uintptr_t)ht_get_int(index, data, NULL) - 1;
 }
 
 static int DataFile_GetInt(int label, int vartical, int horizontal)
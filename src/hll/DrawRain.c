@@ -33,6 +33,8 @@ struct draw_rain_plugin {
 	float angle;
 	uint32_t timestamp;
 	bool started;
+	struct gfx_instance *lines;
+	int lines_cap;
 };
 
 static struct draw_rain_plugin *get_draw_rain_plugin(int surface)
@@ -45,8 +47,10 @@ static struct draw_rain_plugin *get_draw_rain_plugin(int surface)
 	return (struct draw_rain_plugin *)sp->plugin;
 }
 
-static void DrawRain_free(struct draw_plugin *plugin)
+static void DrawRain_free(struct draw_plugin *_plugin)
 {
+	struct draw_rain_plugin *plugin = (struct draw_rain_plugin *)_plugin;
+	free(plugin->lines);
 	free(plugin);
 }
 
@@ -65,16 +69,26 @@ static void DrawRain_update(struct sact_sprite *sp)
 	// the speed is very small.
 	struct texture *dst = sprite_get_texture(sp);
 	gfx_fill_amap(dst, 0, 0, dst->w, dst->h, 0);
+	int nr_lines = plugin->nr_lines / 10;
+	if (nr_lines > plugin->lines_cap) {
+		plugin->lines = xrealloc_array(plugin->lines, plugin->lines_cap, nr_lines,
+				sizeof(struct gfx_instance));
+		plugin->lines_cap = nr_lines;
+	}
 	float rad = plugin->angle * GLM_PIf / 180.f;
-	for (int i = 0; i < plugin->nr_lines / 10; i++) {
+	for (int i = 0; i < nr_lines; i++) {
 		int x1 = rand() % dst->w;
 		int y1 = rand() % dst->h;
 		int len = rand() % plugin->length;
 		int x2 = x1 + len * sinf(rad);
 		int y2 = y1 - len * cosf(rad);
 		int alpha = 128 + rand() % 128;
-		gfx_draw_line_to_amap(dst, x1, y1, x2, y2, alpha);
+		plugin->lines[i] = (struct gfx_instance) {
+			.x = x1, .y = y1, .w = x2 - x1, .h = y2 - y1,
+			.a = alpha / 255.f
+		};
 	}
+	gfx_draw_lines_to_amap_instanced(dst, plugin->lines, nr_lines);
 	sprite_dirty(sp);
 }
 
@@ -39,6 +39,7 @@ struct draw_ripple_plugin {
 	int clip_surface;
 	int nr_ripples;
 	struct ripple *ripples;
+	struct gfx_instance *instances;
 	uint32_t timestamp;
 };
 
@@ -56,67 +57,10 @@ static void DrawRipple_free(struct draw_plugin *_plugin)
 {
 	struct draw_ripple_plugin *plugin = (struct draw_ripple_plugin *)_plugin;
 	free(plugin->ripples);
+	free(plugin->instances);
 	free(plugin);
 }
 
-static void draw_point(uint32_t *pixels, int w, int h, int x, int y)
-{
-	if (x < 0 || x >= w || y < 0 || y >= h)
-		return;
-	pixels[y * w + x] = 0xffffffff;
-}
-
-static void draw_ellipse(uint32_t *pixels, int dst_w, int dst_h, int cx, int cy, int rx, int ry)
-{
-	// Midpoint Ellipse Algorithm.
-	if (rx == 0 || ry == 0)
-		return;
-	const int rx2 = rx * rx;
-	const int ry2 = ry * ry;
-	int x = 0;
-	int y = ry;
-	int px = 0;
-	int py = 2 * rx2 * y;
-
-	// Region 1
-	int p = ry2 - (rx2 * ry) + (0.25 * rx2);
-	while (px < py) {
-		draw_point(pixels, dst_w, dst_h, cx + x, cy + y);
-		draw_point(pixels, dst_w, dst_h, cx - x, cy + y);
-		draw_point(pixels, dst_w, dst_h, cx + x, cy - y);
-		draw_point(pixels, dst_w, dst_h, cx - x, cy - y);
-		x++;
-		px += 2 * ry2;
-		if (p < 0) {
-			p += ry2 + px;
-		} else {
-			y--;
-			py -= 2 * rx2;
-			p += ry2 + px - py;
-		}
-	}
-
-	// Region 2
-	p = ry2 * (x + 0.5) * (x + 0.5) + rx2 * (y - 1) * (y - 1) - rx2 * ry2;
-	while (y > 0) {
-		draw_point(pixels, dst_w, dst_h, cx + x, cy + y);
-		draw_point(pixels, dst_w, dst_h, cx - x, cy + y);
-		draw_point(pixels, dst_w, dst_h, cx + x, cy - y);
-		draw_point(pixels, dst_w, dst_h, cx - x, cy - y);
-		y--;
-		py -= 2 * rx2;
-		if (p > 0) {
-			p += rx2 - py;
-		} else {
-			x++;
-			px += 2 * ry2;
-			p += rx2 - py + px;
-		}
-	}
-	draw_point(pixels, dst_w, dst_h, cx + rx, cy);
-	draw_point(pixels, dst_w, dst_h, cx - rx, cy);
-}
-
 static void DrawRipple_update(struct sact_sprite *sp)
 {
 	struct draw_ripple_plugin *plugin = (struct draw_ripple_plugin *)sp->plugin;
@@ -128,7 +72,7 @@ static void DrawRipple_update(struct sact_sprite *sp)
 	plugin->timestamp = timestamp;
 
 	struct texture *dst = sprite_get_texture(sp);
-	uint32_t *pixels = xcalloc(dst->w * dst->h, 4);
+	int n = 0;
 	for (int i = 0; i < plugin->nr_ripples; i++) {
 		struct ripple *r = &plugin->ripples[i];
 		float rate = (float)(timestamp - r->start_time) / plugin->time;
@@ -138,10 +82,18 @@ static void DrawRipple_update(struct sact_sprite *sp)
 			r->start_time += plugin->time * floorf(rate);
 			continue;
 		}
-		draw_ellipse(pixels, dst->w, dst->h, r->x, r->y, plugin->width * rate, plugin->height * rate);
+		int rx = plugin->width * rate;
+		int ry = plugin->height * rate;
+		if (rx == 0 || ry == 0)
+			continue;
+		plugin->instances[n++] = (struct gfx_instance) {
+			.x = (int)r->x, .y = (int)r->y, .w = rx, .h = ry,
+			.r = 1.f, .g = 1.f, .b = 1.f, .a = 1.f
+		};
 	}
-	gfx_update_texture_with_pixels(dst, pixels);
-	free(pixels);
+	// the ring outlines are computed per fragment in the ellipse shader
+	gfx_fill_with_alpha(dst, 0, 0, dst->w, dst->h, 0, 0, 0, 0);
+	gfx_draw_ellipses_instanced(dst, plugin->instances, n);
 	struct texture *clip = sprite_get_texture(sact_get_sprite(plugin->clip_surface));
 	gfx_blend_da_daxsa(dst, 0, 0, clip, 0, 0, clip->w, clip->h);
 	sprite_dirty(sp);
@@ -231,6 +183,7 @@ static void DrawRipple_Start(int surface)
 	if (plugin->ripples)
 		return;  // already started
 	plugin->ripples = xmalloc(plugin->nr_ripples * sizeof(struct ripple));
+	plugin->instances = xmalloc(plugin->nr_ripples * sizeof(struct gfx_instance));
 	struct sact_sprite *sp = sact_get_sprite(surface);
 	uint32_t now = SDL_GetTicks();
 	for (int i = 0; i < plugin->nr_ripples; i++) {
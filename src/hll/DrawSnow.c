@@ -52,6 +52,7 @@ struct draw_snow_plugin {
 	int max_amp;
 	int nr_particles;
 	struct snowflake *particles;
+	struct gfx_instance *instances;
 	uint32_t timestamp;
 };
 
@@ -74,6 +75,7 @@ static void DrawSnow_free(struct draw_plugin *_plugin)
 {
 	struct draw_snow_plugin *plugin = (struct draw_snow_plugin *)_plugin;
 	free(plugin->particles);
+	free(plugin->instances);
 	free(plugin);
 }
 
@@ -97,6 +99,7 @@ static void DrawSnow_render(struct sact_sprite *sp)
 	struct texture *dst = gfx_main_surface();
 	plugin->timestamp = SDL_GetTicks();
 	uint32_t timestamp = 30000 + plugin->timestamp;
+	int n = 0;
 	for (int i = 0; i < plugin->nr_particles; i++) {
 		struct snowflake *p = &plugin->particles[i];
 		float rate = (float)(timestamp % p->total_time) / p->total_time;
@@ -106,16 +109,20 @@ static void DrawSnow_render(struct sact_sprite *sp)
 			continue;
 		int dw = src->w * p->scale;
 		int dh = src->h * p->scale;
-		int dx = sp->rect.x + x - dw / 2;
-		int dy = sp->rect.y + y - dh / 2;
-		switch (plugin->type) {
-		case DRAW_SNOW_SCREEN_BLEND:
-			gfx_copy_stretch_blend_screen(dst, dx, dy, dw, dh, src, 0, 0, src->w, src->h);
-			break;
-		case DRAW_SNOW_ALPHA_BLEND:
-			gfx_copy_stretch_blend_amap(dst, dx, dy, dw, dh, src, 0, 0, src->w, src->h);
-			break;
-		}
+		plugin->instances[n++] = (struct gfx_instance) {
+			.x = sp->rect.x + x - dw / 2,
+			.y = sp->rect.y + y - dh / 2,
+			.w = dw,
+			.h = dh
+		};
+	}
+	switch (plugin->type) {
+	case DRAW_SNOW_SCREEN_BLEND:
+		gfx_copy_stretch_blend_screen_instanced(dst, src, plugin->instances, n);
+		break;
+	case DRAW_SNOW_ALPHA_BLEND:
+		gfx_copy_stretch_blend_amap_instanced(dst, src, plugin->instances, n);
+		break;
 	}
 }
 
@@ -168,6 +175,7 @@ static void DrawSnow_Start(int sprite)
 	if (plugin->particles)
 		return;  // already started
 	plugin->particles = xcalloc(plugin->nr_particles, sizeof(struct snowflake));
+	plugin->instances = xcalloc(plugin->nr_particles, sizeof(struct gfx_instance));
 	struct sact_sprite *sp = sact_get_sprite(sprite);
 	for (int i = 0; i < plugin->nr_particles; i++) {
 		struct snowflake *p = &plugin->particles[i];
@@ -23,7 +23,6 @@
 #include <zlib.h>
 
 #include "system4.h"
-#include "system4/buffer.h"
 #include "system4/file.h"
 #include "system4/little_endian.h"
 #include "system4/string.h"
@@ -41,12 +40,221 @@ enum file_mode {
 
 static FILE *current_file = NULL;
 static enum file_mode current_mode;
-// Buffer for reading from / writing to binary format
-static struct buffer contents;
 // Buffer for reading from JSON format
 static char *json_contents = NULL;
 static size_t json_cursor = 0;
 
+/*
+ * The binary format is a 4-byte uncompressed size followed by a zlib stream.
+ * Values are deflated/inflated through fixed-size buffers while walking the
+ * pages, so the uncompressed data is never held in memory as a whole.
+ */
+#define STREAM_BUFFER_SIZE 65536
+
+static struct {
+	z_stream z;
+	bool active;
+	bool error;
+	// read: decompressed data, valid in [pos, len)
+	// write: pending uncompressed data, valid in [0, len)
+	size_t pos;
+	size_t len;
+	uint8_t data[STREAM_BUFFER_SIZE];
+	// read: compressed input; write: compressed output
+	uint8_t zbuf[STREAM_BUFFER_SIZE];
+	// for reading strings
+	char *str;
+	size_t str_cap;
+} stream;
+
+static bool stream_init_write(void)
+{
+	memset(&stream.z, 0, sizeof(stream.z));
+	if (deflateInit(&stream.z, Z_DEFAULT_COMPRESSION) != Z_OK) {
+		WARNING("File.Open: deflateInit failed");
+		return false;
+	}
+	// uncompressed size is filled in when the file is closed
+	static const uint8_t size_placeholder[4] = {0};
+	if (fwrite(size_placeholder, 4, 1, current_file) != 1) {
+		WARNING("File.Open: fwrite failed: %s", strerror(errno));
+		deflateEnd(&stream.z);
+		return false;
+	}
+	stream.active = true;
+	stream.error = false;
+	stream.pos = stream.len = 0;
+	return true;
+}
+
+static bool stream_deflate(int flush)
+{
+	stream.z.next_in = stream.data;
+	stream.z.avail_in = stream.len;
+	int r;
+	do {
+		stream.z.next_out = stream.zbuf;
+		stream.z.avail_out = STREAM_BUFFER_SIZE;
+		r = deflate(&stream.z, flush);
+		if (r == Z_STREAM_ERROR)
+			return false;
+		size_t n = STREAM_BUFFER_SIZE - stream.z.avail_out;
+		if (n && fwrite(stream.zbuf, n, 1, current_file) != 1) {
+			WARNING("File.Write: fwrite failed: %s", strerror(errno));
+			return false;
+		}
+	} while (stream.z.avail_out == 0 || (flush == Z_FINISH && r != Z_STREAM_END));
+	stream.len = 0;
+	return true;
+}
+
+static void stream_write(const void *data, size_t size)
+{
+	const uint8_t *p = data;
+	while (size && !stream.error) {
+		size_t n = min(size, STREAM_BUFFER_SIZE - stream.len);
+		memcpy(stream.data + stream.len, p, n);
+		stream.len += n;
+		p += n;
+		size -= n;
+		if (stream.len == STREAM_BUFFER_SIZE && !stream_deflate(Z_NO_FLUSH))
+			stream.error = true;
+	}
+}
+
+static bool stream_finish_write(void)
+{
+	bool ok = !stream.error && stream_deflate(Z_FINISH);
+	if (ok) {
+		uint8_t size[4];
+		LittleEndian_putDW(size, 0, stream.z.total_in);
+		if (fseek(current_file, 0, SEEK_SET) || fwrite(size, 4, 1, current_file) != 1) {
+			WARNING("File.Close: failed to write header: %s", strerror(errno));
+			ok = false;
+		}
+	}
+	deflateEnd(&stream.z);
+	stream.active = false;
+	return ok;
+}
+
+static bool stream_init_read(const uint8_t *data, size_t size)
+{
+	memset(&stream.z, 0, sizeof(stream.z));
+	if (inflateInit(&stream.z) != Z_OK) {
+		WARNING("File.Read: inflateInit failed");
+		return false;
+	}
+	// the first chunk of the file was already read to detect the format
+	memcpy(stream.zbuf, data, size);
+	stream.z.next_in = stream.zbuf;
+	stream.z.avail_in = size;
+	stream.active = true;
+	stream.error = false;
+	stream.pos = stream.len = 0;
+	return true;
+}
+
+static bool stream_fill(void)
+{
+	stream.pos = stream.len = 0;
+	while (!stream.len) {
+		if (!stream.z.avail_in) {
+			size_t n = fread(stream.zbuf, 1, STREAM_BUFFER_SIZE, current_file);
+			if (!n)
+				return false;
+			stream.z.next_in = stream.zbuf;
+			stream.z.avail_in = n;
+		}
+		stream.z.next_out = stream.data;
+		stream.z.avail_out = STREAM_BUFFER_SIZE;
+		int r = inflate(&stream.z, Z_NO_FLUSH);
+		stream.len = STREAM_BUFFER_SIZE - stream.z.avail_out;
+		if (r == Z_STREAM_END)
+			return stream.len > 0;
+		if (r != Z_OK && r != Z_BUF_ERROR)
+			return false;
+	}
+	return true;
+}
+
+static void stream_read(void *dst, size_t size)
+{
+	uint8_t *p = dst;
+	while (size) {
+		if (stream.pos == stream.len && (stream.error || !stream_fill())) {
+			if (!stream.error)
+				WARNING("File.Read: unexpected end of data");
+			stream.error = true;
+			memset(p, 0, size);
+			return;
+		}
+		size_t n = min(size, stream.len - stream.pos);
+		memcpy(p, stream.data + stream.pos, n);
+		stream.pos += n;
+		p += n;
+		size -= n;
+	}
+}
+
+static int32_t stream_read_int32(void)
+{
+	uint8_t b[4];
+	stream_read(b, 4);
+	return LittleEndian_getDW(b, 0);
+}
+
+static float stream_read_float(void)
+{
+	union { int32_t i; float f; } v = { .i = stream_read_int32() };
+	return v.f;
+}
+
+static struct string *stream_read_string(void)
+{
+	size_t len = 0;
+	for (;;) {
+		char c;
+		stream_read(&c, 1);
+		if (stream.error || !c)
+			break;
+		if (len + 1 >= stream.str_cap) {
+			size_t new_cap = stream.str_cap ? stream.str_cap * 2 : 256;
+			stream.str = xrealloc(stream.str, new_cap);
+			stream.str_cap = new_cap;
+		}
+		stream.str[len++] = c;
+	}
+	return make_string(stream.str ? stream.str : "", len);
+}
+
+static void stream_write_int32(int32_t i)
+{
+	uint8_t b[4];
+	LittleEndian_putDW(b, 0, i);
+	stream_write(b, 4);
+}
+
+static void stream_write_float(float f)
+{
+	union { int32_t i; float f; } v = { .f = f };
+	stream_write_int32(v.i);
+}
+
+static void stream_close(void)
+{
+	if (stream.active) {
+		if (current_mode == FILE_WRITE)
+			deflateEnd(&stream.z);
+		else
+			inflateEnd(&stream.z);
+		stream.active = false;
+	}
+	free(stream.str);
+	stream.str = NULL;
+	stream.str_cap = 0;
+}
+
 static void read_page(struct page *page);
 static void write_page(struct page *page);
 
@@ -56,14 +264,14 @@ static void read_value(union vm_value *v, enum ain_data_type type)
 	case AIN_INT:
 	case AIN_BOOL:
 	case AIN_LONG_INT:
-		v->i = buffer_read_int32(&contents);
+		v->i = stream_read_int32();
 		break;
 	case AIN_FLOAT:
-		v->f = buffer_read_float(&contents);
+		v->f = stream_read_float();
 		break;
 	case AIN_STRING:
 		variable_fini(*v, type, true);
-		v->i = heap_alloc_string(buffer_read_string(&contents));
+		v->i = heap_alloc_string(stream_read_string());
 		break;
 	case AIN_STRUCT:
 	case AIN_ARRAY_TYPE:
@@ -104,13 +312,16 @@ static void write_value(union vm_value v, enum ain_data_type type)
 	case AIN_INT:
 	case AIN_BOOL:
 	case AIN_LONG_INT:
-		buffer_write_int32(&contents, v.i);
+		stream_write_int32(v.i);
 		break;
 	case AIN_FLOAT:
-		buffer_write_float(&contents, v.f);
+		stream_write_float(v.f);
 		break;
 	case AIN_STRING:
-		buffer_write_cstringz(&contents, heap_get_string(v.i)->text);
+		{
+			struct string *str = heap_get_string(v.i);
+			stream_write(str->text, str->size + 1);
+		}
 		break;
 	case AIN_STRUCT:
 	case AIN_ARRAY_TYPE:
@@ -158,14 +369,19 @@ static int File_Open(struct string *filename, int type)
 	}
 	if (current_file) {
 		WARNING("Previously opened file wasn't closed");
+		stream_close();
 		fclose(current_file);
 	}
 
+	vm_wait_for_save();
 	char *path = unix_path(filename->text);
 	current_file = file_open_utf8(path, mode);
 	current_mode = type;
 	if (!current_file) {
 		WARNING("Failed to open file '%s': %s", display_utf0(path), strerror(errno));
+	} else if (type == FILE_WRITE && !stream_init_write()) {
+		fclose(current_file);
+		current_file = NULL;
 	}
 
 	free(path);
@@ -178,23 +394,11 @@ static int File_Close(void)
 		VM_ERROR("File.Close called, but no open file");
 	}
 	int r = 1;
-	if (current_mode == FILE_WRITE) {
-		size_t raw_size = contents.index;
-		unsigned long compressed_size = compressBound(raw_size);
-		uint8_t *buf = xmalloc(4 + compressed_size);
-		LittleEndian_putDW(buf, 0, raw_size);
-		int r = compress2(buf + 4, &compressed_size, contents.buf, raw_size, Z_DEFAULT_COMPRESSION);
-		if (r != Z_OK) {
-			WARNING("File.Close: compress2 failed");
+	if (current_mode == FILE_WRITE && stream.active) {
+		if (!stream_finish_write())
 			r = 0;
-		} else {
-			if (fwrite(buf, 4 + compressed_size, 1, current_file) != 1) {
-				WARNING("File.Close: fwrite failed: %s", strerror(errno));
-				r = 0;
-			}
-		}
-		free(buf);
 	}
+	stream_close();
 	if (fclose(current_file))
 		r = 0;
 	current_file = NULL;
@@ -202,9 +406,6 @@ static int File_Close(void)
 		free(json_contents);
 	json_contents = NULL;
 	json_cursor = 0;
-	if (contents.buf)
-		free(contents.buf);
-	buffer_init(&contents, NULL, 0);
 	return r;
 }
 
@@ -222,40 +423,36 @@ static int File_Read(struct page **_page)
 		VM_ERROR("File.Read called, but file wasn't opened for reading");
 	}
 
-	// read file into memory if needed
-	if (!json_contents && !contents.buf) {
-		fseek(current_file, 0, SEEK_END);
-		size_t file_size = ftell(current_file);
-		fseek(current_file, 0, SEEK_SET);
-
-		uint8_t *buf = xmalloc(file_size + 1);
-		if (fread(buf, file_size, 1, current_file) != 1) {
-			WARNING("File.Read failed (fread): %s", strerror(errno));
-			free(buf);
-			return 0;
-		}
-		buf[file_size] = '\0';
+	// detect the file format on the first read
+	if (!json_contents && !stream.active) {
+		uint8_t header[6];
+		size_t n = fread(header, 1, sizeof(header), current_file);
 
 		// Check if it's ZLIB compressed
-		if (file_size > 6 && buf[4] == 0x78 && buf[5] == 0x9c) {
-			unsigned long raw_size = LittleEndian_getDW(buf, 0);
-			uint8_t *raw_buf = xmalloc(raw_size);
-			int r = uncompress(raw_buf, &raw_size, buf + 4, file_size);
-			free(buf);
-			if (r != Z_OK) {
-				WARNING("File.Read failed to uncompress");
-				free(raw_buf);
+		if (n == 6 && header[4] == 0x78 && header[5] == 0x9c) {
+			if (!stream_init_read(header + 4, 2))
 				return 0;
-			}
-			buffer_init(&contents, raw_buf, raw_size);
 		} else {
 			// JSON format created by old versions of xsystem4
-			json_contents = (char*)buf;
+			fseek(current_file, 0, SEEK_END);
+			size_t file_size = ftell(current_file);
+			fseek(current_file, 0, SEEK_SET);
+
+			char *buf = xmalloc(file_size + 1);
+			if (file_size && fread(buf, file_size, 1, current_file) != 1) {
+				WARNING("File.Read failed (fread): %s", strerror(errno));
+				free(buf);
+				return 0;
+			}
+			buf[file_size] = '\0';
+			json_contents = buf;
 		}
 	}
 
-	if (contents.buf) {
+	if (stream.active) {
 		read_page(page);
+		if (stream.error)
+			return 0;
 	} else {
 		const char *end;
 		cJSON *json = cJSON_ParseWithOpts(json_contents+json_cursor, &end, false);
@@ -334,6 +531,7 @@ static int File_GetTime(struct string *filename, struct page **page)
 
 static int File_Delete(struct string *name)
 {
+	vm_wait_for_save();
 	char *path = unix_path(name->text);
 	if (remove_utf8(path)) {
 		WARNING("remove: %s", strerror(errno));
@@ -27,6 +27,7 @@
 #include "effect.h"
 #include "gfx/gfx.h"
 #include "gfx/font.h"
+#include "id_heap.h"
 #include "input.h"
 #include "vm.h"
 #include "xsystem4.h"
@@ -38,10 +39,15 @@ struct gpx_surface {
 	bool has_pixel;
 	bool has_alpha;
 	int no;
+	// CPU copy of the texture for pixel-only surfaces, read back on the first
+	// GetPixsel and dropped whenever the surface is drawn to
+	uint8_t *pixels;
 };
 
 static struct gpx_surface **surfaces = NULL;
 static int nr_surfaces = 0;
+// the lowest free surface number is reused first
+static struct id_heap surface_ids;
 
 static struct {
 	char *text;
@@ -53,14 +59,12 @@ static struct gpx_surface *create_surface(int width, int height)
 {
 	if (width <= 0 || height <= 0)
 		return NULL;
-	int sf_no;
-	for (sf_no = 0; surfaces[sf_no]; sf_no++) {
-		if (sf_no + 1 == nr_surfaces) {
-			int new_nr_surfaces = nr_surfaces + 256;
-			surfaces = xrealloc(surfaces, sizeof(struct gpx_surface *) * new_nr_surfaces);
-			memset(surfaces + nr_surfaces, 0, sizeof(struct gpx_surface *) * (new_nr_surfaces - nr_surfaces));
-			nr_surfaces = new_nr_surfaces;
-		}
+	int sf_no = id_heap_alloc(&surface_ids);
+	if (sf_no == nr_surfaces) {
+		int new_nr_surfaces = nr_surfaces + 256;
+		surfaces = xrealloc(surfaces, sizeof(struct gpx_surface *) * new_nr_surfaces);
+		memset(surfaces + nr_surfaces, 0, sizeof(struct gpx_surface *) * (new_nr_surfaces - nr_surfaces));
+		nr_surfaces = new_nr_surfaces;
 	}
 	struct gpx_surface *sf = xcalloc(1, sizeof(struct gpx_surface));
 	surfaces[sf_no] = sf;
@@ -78,19 +82,38 @@ static void free_surface(struct gpx_surface *sf)
 		VM_ERROR("Double free of gpx_surface");
 	surfaces[sf->no] = NULL;
 	gfx_delete_texture(&sf->texture);
+	free(sf->pixels);
 	free(sf);
 }
 
+static struct gpx_surface *get_surface(int sf_no)
+{
+	if (sf_no < 0 || sf_no >= surface_ids.end)
+		return NULL;
+	return surfaces[sf_no];
+}
+
 static struct texture *get_texture(int sf_no)
 {
-	if (sf_no < 0 || sf_no >= nr_surfaces || !surfaces[sf_no])
+	struct gpx_surface *sf = get_surface(sf_no);
+	if (!sf)
 		return NULL;
-	struct gpx_surface *sf = surfaces[sf_no];
 	if (!sf->texture.handle)
 		gfx_init_texture_rgba(&sf->texture, sf->w, sf->h, (SDL_Color){0, 0, 0, 255});
 	return &sf->texture;
 }
 
+// Get the texture of a surface that is about to be drawn to.
+static struct texture *get_dst_texture(int sf_no)
+{
+	struct texture *t = get_texture(sf_no);
+	if (t && surfaces[sf_no]->pixels) {
+		free(surfaces[sf_no]->pixels);
+		surfaces[sf_no]->pixels = NULL;
+	}
+	return t;
+}
+
 static void Gpx2Plus_Init(possibly_unused void *imainsystem, possibly_unused struct string *link_file_name)
 {
 	// already initialized
@@ -102,8 +125,7 @@ static void Gpx2Plus_Init(possibly_unused void *imainsystem, possibly_unused str
 	audio_init();
 
 	nr_surfaces = 256;
-	surfaces = xmalloc(sizeof(struct gpx_surface*) * 256);
-	memset(surfaces, 0, sizeof(struct gpx_surface*) * 256);
+	surfaces = xcalloc(nr_surfaces, sizeof(struct gpx_surface*));
 
 	// create main surface
 	Texture *t = gfx_main_surface();
@@ -140,30 +162,34 @@ static int Gpx2Plus_CreatePixelOnly(int width, int height, possibly_unused int b
 
 static int Gpx2Plus_IsPixel(int surface)
 {
-	if (surface < 0 || surface >= nr_surfaces || !surfaces[surface])
+	struct gpx_surface *sf = get_surface(surface);
+	if (!sf)
 		return 0;
-	return surfaces[surface]->has_pixel ? 1 : 0;
+	return sf->has_pixel ? 1 : 0;
 }
 
 static int Gpx2Plus_IsAlpha(int surface)
 {
-	if (surface < 0 || surface >= nr_surfaces || !surfaces[surface])
+	struct gpx_surface *sf = get_surface(surface);
+	if (!sf)
 		return 0;
-	return surfaces[surface]->has_alpha ? 1 : 0;
+	return sf->has_alpha ? 1 : 0;
 }
 
 static int Gpx2Plus_GetWidth(int surface)
 {
-	if (surface < 0 || surface >= nr_surfaces || !surfaces[surface])
+	struct gpx_surface *sf = get_surface(surface);
+	if (!sf)
 		return 0;
-	return surfaces[surface]->w;
+	return sf->w;
 }
 
 static int Gpx2Plus_GetHeight(int surface)
 {
-	if (surface < 0 || surface >= nr_surfaces || !surfaces[surface])
+	struct gpx_surface *sf = get_surface(surface);
+	if (!sf)
 		return 0;
-	return surfaces[surface]->h;
+	return sf->h;
 }
 
 // int GetCreatedSurface(void);
@@ -171,11 +197,25 @@ static int Gpx2Plus_GetHeight(int surface)
 
 static int Gpx2Plus_GetPixsel(int surface, int x, int y)
 {
-	struct texture *t = get_texture(surface);
-	if (!t)
+	struct gpx_surface *sf = get_surface(surface);
+	if (!sf)
+		return 0;
+	// surfaces that were never drawn to are black
+	if (!sf->texture.handle)
+		return 0;
+	if (sf->has_alpha) {
+		SDL_Color c = gfx_get_pixel(&sf->texture, x, y);
+		return c.r << 16 | c.g << 8 | c.b;
+	}
+
+	// Pixel-only surfaces are typically lookup maps that are read many times
+	// per frame, so read the whole texture back once and answer from memory.
+	if (x < 0 || x >= sf->w || y < 0 || y >= sf->h)
 		return 0;
-	SDL_Color c = gfx_get_pixel(t, x, y);
-	return c.r << 16 | c.g << 8 | c.b;
+	if (!sf->pixels)
+		sf->pixels = gfx_get_pixels(&sf->texture);
+	uint8_t *p = sf->pixels + ((size_t)y * sf->w + x) * 4;
+	return p[0] << 16 | p[1] << 8 | p[2];
 }
 
 static int Gpx2Plus_LoadCG(int cg_num)
@@ -201,22 +241,24 @@ static int Gpx2Plus_LoadCG(int cg_num)
 static void Gpx2Plus_Free(int surface)
 {
 	// surface 0 (main surface) cannot be freed
-	if (surface <= 0 || surface >= nr_surfaces || !surfaces[surface])
+	if (surface <= 0 || surface >= surface_ids.end || !surfaces[surface])
 		return;
 	free_surface(surfaces[surface]);
+	id_heap_release(&surface_ids, surface);
 }
 
 static void Gpx2Plus_FreeAll(void)
 {
-	for (int i = 1; i < nr_surfaces; i++) {
+	for (int i = 1; i < surface_ids.end; i++) {
 		if (surfaces[i])
 			free_surface(surfaces[i]);
 	}
+	id_heap_reset(&surface_ids, 1);
 }
 
 static void Gpx2Plus_Copy(int destSurface, int dx, int dy, int srcSurface, int sx, int sy, int width, int height)
 {
-	struct texture *dst = get_texture(destSurface);
+	struct texture *dst = get_dst_texture(destSurface);
 	struct texture *src = get_texture(srcSurface);
 	if (!dst || !src)
 		return;
@@ -225,7 +267,7 @@ static void Gpx2Plus_Copy(int destSurface, int dx, int dy, int srcSurface, int s
 
 static void Gpx2Plus_CopyBright(int destSurface, int dx, int dy, int srcSurface, int sx, int sy, int width, int height, int rate)
 {
-	struct texture *dst = get_texture(destSurface);
+	struct texture *dst = get_dst_texture(destSurface);
 	struct texture *src = get_texture(srcSurface);
 	if (!dst || !src)
 		return;
@@ -234,7 +276,7 @@ static void Gpx2Plus_CopyBright(int destSurface, int dx, int dy, int srcSurface,
 
 static void Gpx2Plus_CopyAMap(int destSurface, int dx, int dy, int srcSurface, int sx, int sy, int width, int height)
 {
-	struct texture *dst = get_texture(destSurface);
+	struct texture *dst = get_dst_texture(destSurface);
 	struct texture *src = get_texture(srcSurface);
 	if (!dst || !src)
 		return;
@@ -243,7 +285,7 @@ static void Gpx2Plus_CopyAMap(int destSurface, int dx, int dy, int srcSurface, i
 
 static void Gpx2Plus_CopySprite(int destSurface, int dx, int dy, int srcSurface, int sx, int sy, int width, int height, int r, int g, int b)
 {
-	struct texture *dst = get_texture(destSurface);
+	struct texture *dst = get_dst_texture(destSurface);
 	struct texture *src = get_texture(srcSurface);
 	if (!dst || !src)
 		return;
@@ -253,7 +295,7 @@ static void Gpx2Plus_CopySprite(int destSurface, int dx, int dy, int srcSurface,
 
 static void Gpx2Plus_Blend(int destSurface, int dx, int dy, int srcSurface, int sx, int sy, int width, int height, int alpha)
 {
-	struct texture *dst = get_texture(destSurface);
+	struct texture *dst = get_dst_texture(destSurface);
 	struct texture *src = get_texture(srcSurface);
 	if (!dst || !src)
 		return;
@@ -265,7 +307,7 @@ static void Gpx2Plus_Blend(int destSurface, int dx, int dy, int srcSurface, int
 
 static void Gpx2Plus_BlendAMap(int destSurface, int dx, int dy, int srcSurface, int sx, int sy, int width, int height)
 {
-	struct texture *dst = get_texture(destSurface);
+	struct texture *dst = get_dst_texture(destSurface);
 	struct texture *src = get_texture(srcSurface);
 	if (!dst || !src)
 		return;
@@ -278,7 +320,7 @@ HLL_WARN_UNIMPLEMENTED( , void, Gpx2Plus, BlendAMapColorAlpha, int destSurface,
 
 static void Gpx2Plus_BlendAMapAlpha(int destSurface, int dx, int dy, int srcSurface, int sx, int sy, int width, int height, int alpha)
 {
-	struct texture *dst = get_texture(destSurface);
+	struct texture *dst = get_dst_texture(destSurface);
 	struct texture *src = get_texture(srcSurface);
 	if (!dst || !src)
 		return;
@@ -294,7 +336,7 @@ static void Gpx2Plus_BlendAMapAlpha(int destSurface, int dx, int dy, int srcSurf
 
 static void Gpx2Plus_Fill(int surface, int x, int y, int width, int height, int r, int g, int b)
 {
-	struct texture *dst = get_texture(surface);
+	struct texture *dst = get_dst_texture(surface);
 	if (!dst)
 		return;
 	gfx_fill(dst, x, y, width, height, r, g, b);
@@ -302,7 +344,7 @@ static void Gpx2Plus_Fill(int surface, int x, int y, int width, int height, int
 
 static void Gpx2Plus_FillAlphaColor(int surface, int x, int y, int width, int height, int r, int g, int b, int rate)
 {
-	struct texture *dst = get_texture(surface);
+	struct texture *dst = get_dst_texture(surface);
 	if (!dst)
 		return;
 	gfx_fill_alpha_color(dst, x, y, width, height, r, g, b, rate);
@@ -310,7 +352,7 @@ static void Gpx2Plus_FillAlphaColor(int surface, int x, int y, int width, int he
 
 static void Gpx2Plus_FillAMap(int surface, int x, int y, int width, int height, int alpha)
 {
-	struct texture *dst = get_texture(surface);
+	struct texture *dst = get_dst_texture(surface);
 	if (!dst)
 		return;
 	gfx_fill_amap(dst, x, y, width, height, alpha);
@@ -328,7 +370,7 @@ static void Gpx2Plus_FillAMap(int surface, int x, int y, int width, int height,
 
 static void Gpx2Plus_CopyStretch(int surface, int dx, int dy, int dWidth, int dHeight, int srcSurface, int sx, int sy, int sWidth, int sHeight)
 {
-	struct texture *dst = get_texture(surface);
+	struct texture *dst = get_dst_texture(surface);
 	struct texture *src = get_texture(srcSurface);
 	if (!dst || !src)
 		return;
@@ -339,7 +381,7 @@ static void Gpx2Plus_CopyStretch(int surface, int dx, int dy, int dWidth, int dH
 
 static void Gpx2Plus_CopyStretchBlendAMap(int surface, int dx, int dy, int dWidth, int dHeight, int srcSurface, int sx, int sy, int sWidth, int sHeight)
 {
-	struct texture *dst = get_texture(surface);
+	struct texture *dst = get_dst_texture(surface);
 	struct texture *src = get_texture(srcSurface);
 	if (!dst || !src)
 		return;
@@ -351,7 +393,7 @@ static void Gpx2Plus_CopyStretchBlendAMap(int surface, int dx, int dy, int dWidt
 
 static void Gpx2Plus_CopyStretchReduce(int destSurface, int dx, int dy, int dWidth, int dHeight, int srcSurface, int sx, int sy, int sWidth, int sHeight)
 {
-	struct texture *dst = get_texture(destSurface);
+	struct texture *dst = get_dst_texture(destSurface);
 	struct texture *src = get_texture(srcSurface);
 	if (!dst || !src)
 		return;
@@ -362,7 +404,7 @@ static void Gpx2Plus_CopyStretchReduceAMap(int destSurface, int dx, int dy, int
 {
 	if (game_daibanchou_en)
 		sWidth /= 2;
-	struct texture *dst = get_texture(destSurface);
+	struct texture *dst = get_dst_texture(destSurface);
 	struct texture *src = get_texture(srcSurface);
 	if (!dst || !src)
 		return;
@@ -371,7 +413,7 @@ static void Gpx2Plus_CopyStretchReduceAMap(int destSurface, int dx, int dy, int
 
 static void Gpx2Plus_CopyReverseLR(int destSurface, int dx, int dy, int srcSurface, int sx, int sy, int width, int height)
 {
-	struct texture *dst = get_texture(destSurface);
+	struct texture *dst = get_dst_texture(destSurface);
 	struct texture *src = get_texture(srcSurface);
 	if (!dst || !src)
 		return;
@@ -380,7 +422,7 @@ static void Gpx2Plus_CopyReverseLR(int destSurface, int dx, int dy, int srcSurfa
 
 static void Gpx2Plus_CopyReverseUD(int destSurface, int dx, int dy, int srcSurface, int sx, int sy, int width, int height)
 {
-	struct texture *dst = get_texture(destSurface);
+	struct texture *dst = get_dst_texture(destSurface);
 	struct texture *src = get_texture(srcSurface);
 	if (!dst || !src)
 		return;
@@ -389,7 +431,7 @@ static void Gpx2Plus_CopyReverseUD(int destSurface, int dx, int dy, int srcSurfa
 
 static void Gpx2Plus_CopyReverseAMapLR(int destSurface, int dx, int dy, int srcSurface, int sx, int sy, int width, int height)
 {
-	struct texture *dst = get_texture(destSurface);
+	struct texture *dst = get_dst_texture(destSurface);
 	struct texture *src = get_texture(srcSurface);
 	if (!dst || !src)
 		return;
@@ -414,7 +456,7 @@ static void Gpx2Plus_Update(int x, int y, int width, int height)
 
 static void Gpx2Plus_DrawText(int surface, int x, int y, struct string *text)
 {
-	struct texture *dst = get_texture(surface);
+	struct texture *dst = get_dst_texture(surface);
 	if (!dst)
 		return;
 	gfx_draw_text_to_pmap(dst, x, y, text->text);
@@ -422,7 +464,7 @@ static void Gpx2Plus_DrawText(int surface, int x, int y, struct string *text)
 
 static void Gpx2Plus_DrawTextToAMap(int surface, int x, int y, struct string *text)
 {
-	struct texture *dst = get_texture(surface);
+	struct texture *dst = get_dst_texture(surface);
 	if (!dst)
 		return;
 	gfx_draw_text_to_amap(dst, x, y, text->text);
@@ -522,7 +564,7 @@ static int calculate_line_height(int current_size, const char *s)
 
 static void Gpx2Plus_MsgDraw(int surface, int x, int y)
 {
-	struct texture *dst = get_texture(surface);
+	struct texture *dst = get_dst_texture(surface);
 	if (!dst)
 		return;
 
@@ -688,7 +730,7 @@ static gpx_effect_callback gpx_effects[NR_EFFECTS] = {
 
 static int fullscreen_effect(int effect, int dst_surf, int src_surf, int ms)
 {
-	Texture *dst = get_texture(0);
+	Texture *dst = get_dst_texture(0);
 	Texture *old = get_texture(dst_surf);
 	Texture *new = get_texture(src_surf);
 	for (int i = 0; i < ms; i += 16) {
@@ -707,7 +749,7 @@ static int Gpx2Plus_EffectCopy(int effect, int wx, int wy,
 							   int width, int height, int totalTime)
 {
 	struct gpx_effect_params params = {
-		.dst = get_texture(0),           .dx = wx, .dy = wy,
+		.dst = get_dst_texture(0),       .dx = wx, .dy = wy,
 		.old = get_texture(destSurface), .ox = dx, .oy = dy,
 		.new = get_texture(srcSurface),  .nx = sx, .ny = sy,
 		.w = width, .h = height
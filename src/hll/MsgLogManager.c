@@ -21,43 +21,73 @@
 #include "hll.h"
 #include "MsgLogManager.h"
 
+// The log is a ring buffer holding the most recent msg_log_max entries.
+// When full, adding an entry overwrites the oldest one. String entries hold
+// a reference to the VM's string rather than a copy of its text, so appending
+// never copies text, and entries stay put once the buffer is at capacity.
+static struct msg_log_entry *msg_log = NULL;
 static size_t msg_log_size = 0;
-static size_t msg_log_i = 0;
-struct msg_log_entry *msg_log = NULL;
+static size_t msg_log_start = 0;
+static size_t msg_log_n = 0;
 
 #define LOG_MAX 2048
+static size_t msg_log_max = LOG_MAX;
 
-static void msg_log_alloc(void)
+struct msg_log_entry *msg_log_get(int i)
 {
-	if (msg_log_i < msg_log_size)
-		return;
-	if (!msg_log_size)
-		msg_log_size = 1;
+	// i < msg_log_size, so a single wrap suffices (and avoids a division)
+	size_t j = msg_log_start + i;
+	return &msg_log[j < msg_log_size ? j : j - msg_log_size];
+}
 
-	// rotate log
-	if (msg_log_i >= LOG_MAX) {
-		for (size_t i = 0; i < msg_log_i - LOG_MAX/2; i++) {
-			if (msg_log[i].data_type == MSG_LOG_STRING)
-				free_string(msg_log[i].s);
-		}
-		memcpy(msg_log, msg_log + (msg_log_i - LOG_MAX/2), sizeof(struct msg_log_entry) * LOG_MAX/2);
-		msg_log_i = LOG_MAX/2;
-		return;
+static void msg_log_entry_fini(struct msg_log_entry *e)
+{
+	if (e->data_type == MSG_LOG_STRING)
+		free_string(e->s);
+}
+
+// Reallocate the log with room for `size` entries, keeping the newest ones.
+static void msg_log_resize(size_t size)
+{
+	while (msg_log_n > size) {
+		msg_log_entry_fini(msg_log_get(0));
+		msg_log_start = msg_log_start + 1 < msg_log_size ? msg_log_start + 1 : 0;
+		msg_log_n--;
 	}
 
-	msg_log = xrealloc(msg_log, sizeof(struct msg_log_entry) * msg_log_size * 2);
-	msg_log_size *= 2;
+	struct msg_log_entry *log = xcalloc(size, sizeof(struct msg_log_entry));
+	for (size_t i = 0; i < msg_log_n; i++) {
+		log[i] = *msg_log_get(i);
+	}
+	free(msg_log);
+	msg_log = log;
+	msg_log_size = size;
+	msg_log_start = 0;
+}
+
+static struct msg_log_entry *msg_log_alloc(void)
+{
+	if (msg_log_n == msg_log_size) {
+		if (msg_log_size < msg_log_max) {
+			msg_log_resize(msg_log_size ? min(msg_log_size * 2, msg_log_max) : 1);
+		} else {
+			// drop the oldest entry
+			msg_log_entry_fini(msg_log_get(0));
+			msg_log_start = msg_log_start + 1 < msg_log_size ? msg_log_start + 1 : 0;
+			msg_log_n--;
+		}
+	}
+	return msg_log_get(msg_log_n++);
 }
 
 int MsgLogManager_Numof(void)
 {
-	return msg_log_i;
+	return msg_log_n;
 }
 
 static void MsgLogManager_AddInt(int type, int value)
 {
-	msg_log_alloc();
-	msg_log[msg_log_i++] = (struct msg_log_entry) {
+	*msg_log_alloc() = (struct msg_log_entry) {
 		.data_type = MSG_LOG_INT,
 		.type = type,
 		.i = value
@@ -66,8 +96,7 @@ static void MsgLogManager_AddInt(int type, int value)
 
 static void MsgLogManager_AddString(int type, struct string *str)
 {
-	msg_log_alloc();
-	msg_log[msg_log_i++] = (struct msg_log_entry) {
+	*msg_log_alloc() = (struct msg_log_entry) {
 		.data_type = MSG_LOG_STRING,
 		.type = type,
 		.s = string_ref(str)
@@ -79,9 +108,19 @@ HLL_WARN_UNIMPLEMENTED(0, int,  MsgLogManager, GetInt, int index);
 HLL_WARN_UNIMPLEMENTED( , void, MsgLogManager, GetString, int index, struct string **str);
 HLL_WARN_UNIMPLEMENTED(0, int,  MsgLogManager, Save, struct string *filename);
 HLL_WARN_UNIMPLEMENTED(0, int,  MsgLogManager, Load, struct string *filename);
-HLL_WARN_UNIMPLEMENTED( , void, MsgLogManager, SetLineMax, int line_max);
 HLL_WARN_UNIMPLEMENTED(0, int,  MsgLogManager, GetInterface, void);
 
+static void MsgLogManager_SetLineMax(int line_max)
+{
+	if (line_max <= 0) {
+		WARNING("Invalid log size: %d", line_max);
+		return;
+	}
+	msg_log_max = line_max;
+	if (msg_log_size > msg_log_max)
+		msg_log_resize(msg_log_max);
+}
+
 HLL_LIBRARY(MsgLogManager,
 	    HLL_EXPORT(Numof, MsgLogManager_Numof),
 	    HLL_EXPORT(AddInt, MsgLogManager_AddInt),
@@ -31,6 +31,7 @@ struct msg_log_entry {
 	};
 };
 
-extern struct msg_log_entry *msg_log;
+// Get the i-th entry of the log, oldest first.
+struct msg_log_entry *msg_log_get(int i);
 
 #endif /* SYSTEM4_MSGLOGMANAGER_H */
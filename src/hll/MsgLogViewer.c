@@ -92,13 +92,14 @@ static void MsgLogViewer_ConvertFromMsgLogManager(possibly_unused int msg_log_ma
 	MsgLogViewer_Clear();
 
 	for (int i = 0; i < log_size; i++) {
-		if (msg_log[i].data_type == MSG_LOG_INT) {
-			if (msg_log[i].type == 1102) {
+		struct msg_log_entry *e = msg_log_get(i);
+		if (e->data_type == MSG_LOG_INT) {
+			if (e->type == 1102) {
 				log_viewer_push(&EMPTY_STRING, 0, 0);
 			}
 		}
-		if (msg_log[i].data_type == MSG_LOG_STRING) {
-			log_viewer_push(msg_log[i].s, 0, 0);
+		if (e->data_type == MSG_LOG_STRING) {
+			log_viewer_push(e->s, 0, 0);
 		}
 	}
 }
@@ -45,11 +45,6 @@ static inline int to_grid_coord(float f) {
 	return roundf(f / 2.f);
 }
 
-struct line_segment {
-	vec2 p1;
-	vec2 p2;
-};
-
 TAILQ_HEAD(player_move_tailq, player_move_point);
 struct player_move_point {
 	vec3 position;
@@ -61,20 +56,9 @@ struct player_move_point {
 static struct player_move_tailq player_move_queue = TAILQ_HEAD_INITIALIZER(player_move_queue);
 static int draw_field_sprite_number = 0;
 
-static int find_struct_slot(struct ain_struct *s, const char *name)
-{
-	for (int i = 0; i < s->nr_members; i++) {
-		if (strcmp(s->members[i].name, name) == 0)
-			return i;
-	}
-	VM_ERROR("Cannot find slot %s in struct %s", name, s->name);
-}
-
 static union vm_value *struct_get_var(struct page *page, const char *name)
 {
-	assert(page->type == STRUCT_PAGE);
-	struct ain_struct *s = &ain->structures[page->index];
-	return &page->values[find_struct_slot(s, name)];
+	return hll_struct_member(page, name);
 }
 
 static char *dungeon_data_path(int id)
@@ -390,7 +374,7 @@ static bool PastelChime2_DungeonDataLoad(int id, struct page **dungeon)
 		free(path);
 		return false;
 	}
-	int slot_m_dsd = find_struct_slot(&ain->structures[(*dungeon)->index], "m_dsd");
+	int slot_m_dsd = hll_struct_member_slot((*dungeon)->index, "m_dsd");
 	struct page *m_dsd = read_struct(&r, true);
 	variable_set(*dungeon, slot_m_dsd, AIN_STRUCT, vm_int(heap_alloc_page(m_dsd)));
 	struct page *map_size = heap_get_page(struct_get_var(m_dsd, "xyzMapSize")->i);
@@ -575,36 +559,6 @@ static bool PastelChime2_DungeonDataFromSaveData(int save_data_index)
 	return true;
 }
 
-// Finds the intersection between two line segments.
-static bool check_line_segment_intersection(
-	struct line_segment *seg1, struct line_segment *seg2, vec2 out_intersection)
-{
-	// Let seg1 be P + t*r, and seg2 be Q + u*s for 0 <= t, u <= 1.
-	vec2 r, s;
-	glm_vec2_sub(seg1->p2, seg1->p1, r); // r = P2 - P1
-	glm_vec2_sub(seg2->p2, seg2->p1, s); // s = Q2 - Q1
-
-	float r_cross_s = glm_vec2_cross(r, s);
-	vec2 q_minus_p;
-	glm_vec2_sub(seg2->p1, seg1->p1, q_minus_p);
-
-	if (fabsf(r_cross_s) < 1e-8f) {
-		return false;  // The lines are parallel or collinear
-	}
-
-	// Solve for t and u
-	float t = glm_vec2_cross(q_minus_p, s) / r_cross_s;
-	float u = glm_vec2_cross(q_minus_p, r) / r_cross_s;
-
-	if (0.f <= t && t <= 1.f && 0.f <= u && u <= 1.f) {
-		// Intersection point is P + t*r
-		out_intersection[0] = seg1->p1[0] + t * r[0];
-		out_intersection[1] = seg1->p1[1] + t * r[1];
-		return true;
-	}
-	return false;
-}
-
 // Finds the intersection point of a line segment and a circle that is closest
 // to the start of the segment.
 static bool find_closest_segment_circle_intersection(
@@ -653,70 +607,6 @@ static bool find_closest_segment_circle_intersection(
 	return true;
 }
 
-#define MAX_WALL_SEGMENTS_PER_CELL 12
-
-static int get_wall_segments(struct dgn *dgn, struct line_segment *dst, int x, int y, int z, bool check_door)
-{
-	if (!dgn_is_in_map(dgn, x, y, z))
-		return 0;
-	struct dgn_cell *cell = dgn_cell_at(dgn, x, y, z);
-	int i = 0;
-	if (cell->north_wall != -1 || cell->north_door_lock ||
-	    (check_door && cell->north_door != -1 && cell->north_door_angle == 0.f)) {
-		dst[i].p1[0] = x - 0.5f;
-		dst[i].p1[1] = z + 0.5f;
-		dst[i].p2[0] = x + 0.5f;
-		dst[i].p2[1] = z + 0.5f;
-		i++;
-	}
-	if (cell->west_wall != -1 || cell->west_door_lock ||
-	    (check_door && cell->west_door != -1 && cell->west_door_angle == 0.f)) {
-		dst[i].p1[0] = x - 0.5f;
-		dst[i].p1[1] = z - 0.5f;
-		dst[i].p2[0] = x - 0.5f;
-		dst[i].p2[1] = z + 0.5f;
-		i++;
-	}
-	if (cell->south_wall != -1 || cell->south_door_lock ||
-	    (check_door && cell->south_door != -1 && cell->south_door_angle == 0.f)) {
-		dst[i].p1[0] = x - 0.5f;
-		dst[i].p1[1] = z - 0.5f;
-		dst[i].p2[0] = x + 0.5f;
-		dst[i].p2[1] = z - 0.5f;
-		i++;
-	}
-	if (cell->east_wall != -1 || cell->east_door_lock ||
-	    (check_door && cell->east_door != -1 && cell->east_door_angle == 0.f)) {
-		dst[i].p1[0] = x + 0.5f;
-		dst[i].p1[1] = z - 0.5f;
-		dst[i].p2[0] = x + 0.5f;
-		dst[i].p2[1] = z + 0.5f;
-		i++;
-	}
-	if (cell->ceiling != -1) {
-		// Add segments for an octagon.
-		float r = (cell->ceiling == 10) ? 0.35f : 0.5f;
-		float hr = 0.5f * r;
-
-		vec2 v[8];
-		v[0][0] = x - hr; v[0][1] = z - r;
-		v[1][0] = x + hr; v[1][1] = z - r;
-		v[2][0] = x + r;  v[2][1] = z - hr;
-		v[3][0] = x + r;  v[3][1] = z + hr;
-		v[4][0] = x + hr; v[4][1] = z + r;
-		v[5][0] = x - hr; v[5][1] = z + r;
-		v[6][0] = x - r;  v[6][1] = z + hr;
-		v[7][0] = x - r;  v[7][1] = z - hr;
-
-		for (int j = 0; j < 8; j++) {
-			glm_vec2_copy(v[j], dst[i].p1);
-			glm_vec2_copy(v[(j + 1) % 8], dst[i].p2);
-			i++;
-		}
-	}
-	return i;
-}
-
 static bool PastelChime2_Field_SetSprite(int draw_field_sprite_number_)
 {
 	draw_field_sprite_number = draw_field_sprite_number_;
@@ -728,25 +618,7 @@ static bool PastelChime2_Field_CheckLook(float px, float py, float qx, float qy,
 	struct dungeon_context *ctx = dungeon_get_context(draw_field_sprite_number);
 	if (!ctx || !ctx->dgn)
 		return false;
-
-	struct line_segment sight_line = {{px, py}, {qx, qy}};
-	int min_x = roundf(min(px, qx));
-    int max_x = roundf(max(px, qx));
-	int min_y = roundf(min(py, qy));
-	int max_y = roundf(max(py, qy));
-
-	for (int y = min_y; y <= max_y; y++) {
-		for (int x = min_x; x <= max_x; x++) {
-			struct line_segment segments[MAX_WALL_SEGMENTS_PER_CELL];
-			int nr_segments = get_wall_segments(ctx->dgn, segments, x, floor, y, true);
-			for (int i = 0; i < nr_segments; i++) {
-				vec2 v;
-				if (check_line_segment_intersection(&segments[i], &sight_line, v))
-					return false;
-			}
-		}
-	}
-	return true;
+	return dgn_check_look(ctx->dgn, px, py, qx, qy, floor);
 }
 
 static void PastelChime2_Field_GetDoors(struct page **dst, int floor)
@@ -762,16 +634,16 @@ static void PastelChime2_Field_GetDoors(struct page **dst, int floor)
 
 	int struct_type = ain_get_struct(ain, "door_t");
 	struct ain_struct *s = &ain->structures[struct_type];
-	int slot_nx = find_struct_slot(s, "nX");
-	int slot_ny = find_struct_slot(s, "nY");
-	int slot_ndir = find_struct_slot(s, "nDir");
-	int slot_nlock = find_struct_slot(s, "nLock");
-	int slot_fx1 = find_struct_slot(s, "fX1");
-	int slot_fy1 = find_struct_slot(s, "fY1");
-	int slot_fx2 = find_struct_slot(s, "fX2");
-	int slot_fy2 = find_struct_slot(s, "fY2");
-	int slot_fxc = find_struct_slot(s, "fXc");
-	int slot_fyc = find_struct_slot(s, "fYc");
+	int slot_nx = hll_struct_member_slot(struct_type, "nX");
+	int slot_ny = hll_struct_member_slot(struct_type, "nY");
+	int slot_ndir = hll_struct_member_slot(struct_type, "nDir");
+	int slot_nlock = hll_struct_member_slot(struct_type, "nLock");
+	int slot_fx1 = hll_struct_member_slot(struct_type, "fX1");
+	int slot_fy1 = hll_struct_member_slot(struct_type, "fY1");
+	int slot_fx2 = hll_struct_member_slot(struct_type, "fX2");
+	int slot_fy2 = hll_struct_member_slot(struct_type, "fY2");
+	int slot_fxc = hll_struct_member_slot(struct_type, "fXc");
+	int slot_fyc = hll_struct_member_slot(struct_type, "fYc");
 
 	struct page *array = NULL;
 	for (int z = 0; z < ctx->dgn->size_z; z++) {
@@ -1365,7 +1237,7 @@ static bool judge_hit_wall(
 		glm_vec2_add(wall->p1, offset, wall_offset_seg.p1);
 		glm_vec2_add(wall->p2, offset, wall_offset_seg.p2);
 
-		if (check_line_segment_intersection(move_seg, &wall_offset_seg, hit_out)) {
+		if (dgn_segment_intersection(move_seg, &wall_offset_seg, hit_out)) {
 			*slide_line_out = wall_offset_seg;
 			return true;
 		}
@@ -1464,11 +1336,11 @@ static bool PastelChime2_Field_CalcMove(
 	// character's current position.
 	int cx = roundf(old_x);
 	int cy = roundf(old_y);
-	struct line_segment segments[9 * MAX_WALL_SEGMENTS_PER_CELL];
+	struct line_segment segments[9 * DGN_MAX_WALL_SEGMENTS_PER_CELL];
 	int nr_segments = 0;
 	for (int y = -1; y <= 1; y++) {
 		for (int x = -1; x <= 1; x++) {
-			nr_segments += get_wall_segments(ctx->dgn, segments + nr_segments, cx + x, floor, cy + y, check_door);
+			nr_segments += dgn_wall_segments(ctx->dgn, segments + nr_segments, cx + x, floor, cy + y, check_door);
 		}
 	}
 
@@ -1800,8 +1672,8 @@ static struct page *make_pos_t_array(struct dgn *dgn, uint8_t *cell_flags, int f
 {
 	int struct_type = ain_get_struct(ain, "pos_t");
 	struct ain_struct *s = &ain->structures[struct_type];
-	int slot_x = find_struct_slot(s, "x");
-	int slot_y = find_struct_slot(s, "y");
+	int slot_x = hll_struct_member_slot(struct_type, "x");
+	int slot_y = hll_struct_member_slot(struct_type, "y");
 
 	int nr_points = 0;
 	for (int i = 0; i < dgn->size_z * dgn->size_x; i++) {
@@ -0,0 +1,71 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "system4.h"
+#include "system4/ain.h"
+#include "system4/hashtable.h"
+#include "vm.h"
+#include "vm/page.h"
+#include "hll.h"
+
+// struct type -> (member name -> slot + 1)
+static struct hash_table **struct_members = NULL;
+static int nr_struct_members = 0;
+
+int hll_struct_member_slot(int struct_type, const char *name)
+{
+	if (struct_type < 0 || struct_type >= ain->nr_structures)
+		VM_ERROR("Invalid struct type: %d", struct_type);
+	if (!struct_members) {
+		nr_struct_members = ain->nr_structures;
+		struct_members = xcalloc(nr_struct_members, sizeof(struct hash_table*));
+	}
+
+	struct ain_struct *s = &ain->structures[struct_type];
+	struct hash_table *members = struct_members[struct_type];
+	if (!members) {
+		members = ht_create(s->nr_members ? s->nr_members : 1);
+		for (int i = 0; i < s->nr_members; i++) {
+			ht_put(members, s->members[i].name, (void*)(intptr_t)(i + 1));
+		}
+		struct_members[struct_type] = members;
+	}
+
+	int slot = (intptr_t)ht_get(members, name, NULL) - 1;
+	if (slot < 0)
+		VM_ERROR("Cannot find slot %s in struct %s", name, s->name);
+	return slot;
+}
+
+union vm_value *hll_struct_member(struct page *page, const char *name)
+{
+	if (page->type != STRUCT_PAGE)
+		VM_ERROR("Not a struct page");
+	return &page->values[hll_struct_member_slot(page->index, name)];
+}
+
+void hll_struct_members_fini(void)
+{
+	for (int i = 0; i < nr_struct_members; i++) {
+		if (struct_members[i])
+			ht_free(struct_members[i]);
+	}
+	free(struct_members);
+	struct_members = NULL;
+	nr_struct_members = 0;
+}
@@ -26,6 +26,15 @@
 
 void static_library_replace(struct static_library *lib, const char *name, void *fun);
 
+/*
+ * Look up a struct member by name. The member names of each struct are
+ * hashed the first time the struct is used, so HLLs that access game
+ * structs by name don't have to scan the member list on every access.
+ */
+int hll_struct_member_slot(int struct_type, const char *name);
+union vm_value *hll_struct_member(struct page *page, const char *name);
+void hll_struct_members_fini(void);
+
 #define HLL_WARN_UNIMPLEMENTED(rval, rtype, libname, fname, ...)	\
 	static rtype libname ## _ ## fname(__VA_ARGS__) {		\
 		WARNING("Unimplemented HLL function: " #libname "." #fname); \
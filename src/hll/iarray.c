@@ -29,6 +29,88 @@
  * integer arrays.
  */
 
+enum iarray_kind {
+	IARRAY_SCALAR,
+	IARRAY_VOID,
+	IARRAY_STRING,
+	IARRAY_STRUCT,
+	IARRAY_ARRAY,
+	IARRAY_UNSUPPORTED,
+};
+
+struct iarray_member {
+	enum iarray_kind kind;
+	struct ain_type *type;
+};
+
+// Cached per-struct serialization plan, so that each (de)serialized struct
+// doesn't need to resolve the ain types of its members again.
+struct iarray_plan {
+	int nr_members;
+	// true if every member is serialized as a single int
+	bool scalar_only;
+	struct iarray_member *members;
+};
+
+// struct type -> plan
+static struct iarray_plan **plans = NULL;
+
+static enum iarray_kind type_kind(enum ain_data_type type)
+{
+	switch (type) {
+	case AIN_INT:
+	case AIN_FLOAT:
+	case AIN_BOOL:
+		return IARRAY_SCALAR;
+	case AIN_VOID:
+		return IARRAY_VOID;
+	case AIN_STRING:
+		return IARRAY_STRING;
+	case AIN_STRUCT:
+		return IARRAY_STRUCT;
+	case AIN_ARRAY_INT:
+	case AIN_ARRAY_FLOAT:
+	case AIN_ARRAY_STRING:
+	case AIN_ARRAY_STRUCT:
+	case AIN_ARRAY_BOOL:
+		return IARRAY_ARRAY;
+	default:
+		return IARRAY_UNSUPPORTED;
+	}
+}
+
+static struct iarray_plan *get_plan(int struct_type)
+{
+	if (!plans)
+		plans = xcalloc(ain->nr_structures, sizeof(struct iarray_plan*));
+	if (plans[struct_type])
+		return plans[struct_type];
+
+	struct ain_struct *s = &ain->structures[struct_type];
+	struct iarray_plan *plan = xmalloc(sizeof(struct iarray_plan));
+	plan->nr_members = s->nr_members;
+	plan->scalar_only = true;
+	plan->members = xcalloc(s->nr_members, sizeof(struct iarray_member));
+	for (int i = 0; i < s->nr_members; i++) {
+		plan->members[i].type = &s->members[i].type;
+		plan->members[i].kind = type_kind(s->members[i].type.data);
+		if (plan->members[i].kind != IARRAY_SCALAR)
+			plan->scalar_only = false;
+	}
+	plans[struct_type] = plan;
+	return plan;
+}
+
+// Element type of an array with type `t`.
+static struct ain_type array_element_type(enum ain_data_type data, int struc, int rank)
+{
+	return (struct ain_type) {
+		.data = rank > 1 ? data : array_type(data),
+		.struc = struc,
+		.rank = rank - 1
+	};
+}
+
 void iarray_init_writer(struct iarray_writer *w, const char *header)
 {
 	w->data = xmalloc(1024 * sizeof(int));
@@ -51,15 +133,18 @@ void iarray_free_writer(struct iarray_writer *w)
 	w->data = NULL;
 }
 
+static void iarray_reserve(struct iarray_writer *w, unsigned n)
+{
+	if (w->size + n <= w->allocated)
+		return;
+	unsigned allocated = max(w->allocated * 2, w->size + n);
+	w->data = xrealloc(w->data, allocated * sizeof(int));
+	w->allocated = allocated;
+}
+
 void iarray_write(struct iarray_writer *w, int data)
 {
-	if (!w->allocated) {
-		w->data = xmalloc(1024 * sizeof(int));
-		w->allocated = 1024;
-	} else if (w->size >= w->allocated) {
-		w->data = xrealloc(w->data, w->allocated * 2 * sizeof(int));
-		w->allocated *= 2;
-	}
+	iarray_reserve(w, 1);
 	w->data[w->size++] = data;
 }
 
@@ -77,18 +162,33 @@ void iarray_write_float(struct iarray_writer *w, float data)
 	iarray_write(w, cast.i);
 }
 
+/*
+ * Values are written in a single pass. Strings, scalar arrays and structs
+ * whose members are all scalars reserve their whole size first and are then
+ * stored without further capacity checks; everything else is written through
+ * iarray_write.
+ */
+
+// The caller has reserved space for `data`.
+static inline void put(struct iarray_writer *w, int data)
+{
+	w->data[w->size++] = data;
+}
+
 void iarray_write_string(struct iarray_writer *w, struct string *s)
 {
+	// at most one int per byte, plus the terminator
+	iarray_reserve(w, s->size + 1);
 	for (char *p = s->text; *p ;p++) {
 		if (SJIS_2BYTE(*p)) {
 			int c = (uint8_t)p[0] | ((uint8_t)p[1] << 8);
-			iarray_write(w, c);
+			put(w, c);
 			p++;
 		} else {
-			iarray_write(w, *p);
+			put(w, *p);
 		}
 	}
-	iarray_write(w, 0);
+	put(w, 0);
 }
 
 void iarray_write_string_or_null(struct iarray_writer *w, struct string *s)
@@ -96,29 +196,23 @@ void iarray_write_string_or_null(struct iarray_writer *w, struct string *s)
 	iarray_write_string(w, s ? s : &EMPTY_STRING);
 }
 
-static void iarray_write_value(struct iarray_writer *w, struct ain_type *t, int value)
+static void iarray_write_value(struct iarray_writer *w, enum iarray_kind kind, struct ain_type *t, int value)
 {
-	switch (t->data) {
-	case AIN_VOID:
-	case AIN_INT:
-	case AIN_FLOAT:
-	case AIN_BOOL:
+	switch (kind) {
+	case IARRAY_SCALAR:
+	case IARRAY_VOID:
 		iarray_write(w, value);
 		break;
-	case AIN_STRING:
+	case IARRAY_STRING:
 		iarray_write_string(w, heap_get_string(value));
 		break;
-	case AIN_STRUCT:
+	case IARRAY_STRUCT:
 		iarray_write_struct(w, heap_get_page(value), false);
 		break;
-	case AIN_ARRAY_INT:
-	case AIN_ARRAY_FLOAT:
-	case AIN_ARRAY_STRING:
-	case AIN_ARRAY_STRUCT:
-	case AIN_ARRAY_BOOL:
+	case IARRAY_ARRAY:
 		iarray_write_array(w, heap_get_page(value));
 		break;
-	default:
+	case IARRAY_UNSUPPORTED:
 		VM_ERROR("Unsupported data type for serialization: %d", t->data);
 	}
 }
@@ -126,12 +220,22 @@ static void iarray_write_value(struct iarray_writer *w, struct ain_type *t, int
 void iarray_write_struct(struct iarray_writer *w, struct page *page, bool with_type)
 {
 	assert(page->type == STRUCT_PAGE);
-	struct ain_struct *s = &ain->structures[page->index];
-	assert(s->nr_members == page->nr_vars);
-	for (int i = 0; i < s->nr_members; i++) {
+	struct iarray_plan *plan = get_plan(page->index);
+	assert(plan->nr_members == page->nr_vars);
+	if (plan->scalar_only) {
+		iarray_reserve(w, plan->nr_members * (with_type ? 2 : 1));
+		for (int i = 0; i < plan->nr_members; i++) {
+			if (with_type)
+				put(w, plan->members[i].type->data);
+			put(w, page->values[i].i);
+		}
+		return;
+	}
+	for (int i = 0; i < plan->nr_members; i++) {
+		struct iarray_member *m = &plan->members[i];
 		if (with_type)
-			iarray_write(w, s->members[i].type.data);
-		iarray_write_value(w, &s->members[i].type, page->values[i].i);
+			iarray_write(w, m->type->data);
+		iarray_write_value(w, m->kind, m->type, page->values[i].i);
 	}
 }
 
@@ -144,15 +248,20 @@ void iarray_write_array(struct iarray_writer *w, struct page *page)
 
 	assert(page->type == ARRAY_PAGE);
 
-	struct ain_type t = {
-		.data = page->array.rank > 1 ? page->a_type : array_type(page->a_type),
-		.struc = page->array.struct_type,
-		.rank = page->array.rank - 1
-	};
+	struct ain_type t = array_element_type(page->a_type, page->array.struct_type, page->array.rank);
+	enum iarray_kind kind = type_kind(t.data);
 
+	if (kind == IARRAY_SCALAR) {
+		iarray_reserve(w, 1 + page->nr_vars);
+		put(w, page->nr_vars);
+		for (int i = 0; i < page->nr_vars; i++) {
+			put(w, page->values[i].i);
+		}
+		return;
+	}
 	iarray_write(w, page->nr_vars);
 	for (int i = 0; i < page->nr_vars; i++) {
-		iarray_write_value(w, &t, page->values[i].i);
+		iarray_write_value(w, kind, &t, page->values[i].i);
 	}
 }
 
@@ -270,58 +379,69 @@ struct string *iarray_read_string_or_null(struct iarray_reader *r)
 	return s;
 }
 
-static int32_t iarray_read_member(struct iarray_reader *r, struct ain_type *t)
+static int32_t iarray_read_member(struct iarray_reader *r, enum iarray_kind kind, struct ain_type *t)
 {
-	switch (t->data) {
-	case AIN_INT:
-	case AIN_FLOAT:
-	case AIN_BOOL:
+	switch (kind) {
+	case IARRAY_SCALAR:
 		return iarray_read(r);
-	case AIN_STRING:
+	case IARRAY_STRING:
 		return heap_alloc_string(iarray_read_string(r));
-	case AIN_STRUCT:
+	case IARRAY_STRUCT:
 		return heap_alloc_page(iarray_read_struct(r, t->struc, false));
-	case AIN_ARRAY_INT:
-	case AIN_ARRAY_FLOAT:
-	case AIN_ARRAY_STRING:
-	case AIN_ARRAY_STRUCT:
-	case AIN_ARRAY_BOOL:
+	case IARRAY_ARRAY:
 		return heap_alloc_page(iarray_read_array(r, t));
-	default:
-		VM_ERROR("Unsupported data type for (de)serialization: %d", t->data);
+	case IARRAY_VOID:
+	case IARRAY_UNSUPPORTED:
+		break;
 	}
+	VM_ERROR("Unsupported data type for (de)serialization: %d", t->data);
+}
+
+// Copy `n` scalars at once, if the input has enough data left.
+static bool iarray_read_scalars(struct iarray_reader *r, union vm_value *dst, int n)
+{
+	if (n < 0 || r->size - r->pos < (unsigned)n)
+		return false;
+	for (int i = 0; i < n; i++) {
+		dst[i].i = r->data[r->pos + i].i;
+	}
+	r->pos += n;
+	return true;
 }
 
 struct page *iarray_read_struct(struct iarray_reader *r, int struct_type, bool with_type)
 {
-	struct ain_struct *s = &ain->structures[struct_type];
-	struct page *page = alloc_page(STRUCT_PAGE, struct_type, s->nr_members);
-	for (int i = 0; i < s->nr_members; i++) {
+	struct iarray_plan *plan = get_plan(struct_type);
+	struct page *page = alloc_page(STRUCT_PAGE, struct_type, plan->nr_members);
+	if (plan->scalar_only && !with_type
+			&& iarray_read_scalars(r, page->values, plan->nr_members))
+		return page;
+	for (int i = 0; i < plan->nr_members; i++) {
+		struct iarray_member *m = &plan->members[i];
 		if (with_type) {
 			int type = iarray_read(r);
-			if (type != s->members[i].type.data)
+			if (type != m->type->data)
 				VM_ERROR("iarray_read_struct: type mismatch");
 		}
-		page->values[i].i = iarray_read_member(r, &s->members[i].type);
+		page->values[i].i = iarray_read_member(r, m->kind, m->type);
 	}
 	return page;
 }
 
 struct page *iarray_read_array(struct iarray_reader *r, struct ain_type *t)
 {
-	struct ain_type next_t = {
-		.data = t->rank > 1 ? t->data : array_type(t->data),
-		.struc = t->struc,
-		.rank = t->rank - 1
-	};
+	struct ain_type next_t = array_element_type(t->data, t->struc, t->rank);
+	enum iarray_kind kind = type_kind(next_t.data);
 
 	int nr_vars = iarray_read(r);
 	struct page *page = alloc_page(ARRAY_PAGE, t->data, nr_vars);
 	page->array.struct_type = t->struc;
 	page->array.rank = t->rank;
 
+	if (kind == IARRAY_SCALAR && iarray_read_scalars(r, page->values, nr_vars))
+		return page;
 	for (int i = 0; i < nr_vars; i++) {
-		page->values[i].i = iarray_read_member(r, &next_t);
+		page->values[i].i = iarray_read_member(r, kind, &next_t);
 	}
 	return page;
 }
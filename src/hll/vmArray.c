@@ -37,22 +37,14 @@ static void check_array(struct page *array)
 //int vmArray_GetOr(struct page *array, int index);
 //int vmArray_GetXor(struct page *array, int index);
 
-static void transform(struct page *array, int index, int (*func)(int, void *), void *data)
-{
-	if (!array)
-		return;
-	check_array(array);
-
-	if (index >= 0) {
-		for (int i = index; i < array->nr_vars; i++) {
-			array->values[i].i = func(array->values[i].i, data);
-		}
-	} else {
-		for (int i = -index - 1; i >= 0; --i) {
-			array->values[i].i = func(array->values[i].i, data);
-		}
-	}
-}
+/*
+ * The element-wise operations are generated per operator by the macros below,
+ * so that each loop works on plain integers with no indirect call per element
+ * and can be vectorized by the compiler.
+ *
+ * A non-negative index selects the elements [index, nr_vars). A negative index
+ * selects the elements [0, -index - 1], visited from the last to the first.
+ */
 
 static inline int32_t clamp(int64_t val)
 {
@@ -63,341 +55,327 @@ static inline int32_t clamp(int64_t val)
 	return val;
 }
 
-static int trans_add(int x, void *data)
-{
-	int64_t y = *(int*)data;
-	return clamp(x + y);
-}
-
-static int trans_sub(int x, void *data)
-{
-	int64_t y = *(int*)data;
-	return clamp(x - y);
-}
-
-static int trans_mul(int x, void *data)
-{
-	int64_t y = *(int*)data;
-	return clamp(x * y);
-}
-
-static int trans_div(int x, void *data)
-{
-	int64_t y = *(int*)data;
-	return clamp(x / y);
-}
+// array[i] = OP(array[i], num)
+#define DEFINE_TRANSFORM_NUM(name, OP)					\
+	static void name(struct page *array, int index, int num)	\
+	{								\
+		if (!array)						\
+			return;						\
+		check_array(array);					\
+		int begin = index >= 0 ? index : 0;			\
+		int end = index >= 0 ? array->nr_vars : -index;		\
+		union vm_value *v = array->values;			\
+		for (int i = begin; i < end; i++) {			\
+			v[i].i = OP(v[i].i, num);			\
+		}							\
+	}
 
-static int trans_and(int x, void *data)
-{
-	int y = *(int*)data;
-	return x & y;
-}
+// d_array[i] = OP(d_array[i], s_array[k]), where k counts the elements
+// visited so far (in visiting order).
+#define DEFINE_TRANSFORM_ARRAY(name, OP)				\
+	static void name(struct page *d_array, int index, struct page *s_array) \
+	{								\
+		if (!d_array)						\
+			return;						\
+		check_array(d_array);					\
+		union vm_value *d = d_array->values;			\
+		union vm_value *s = s_array->values;			\
+		if (index >= 0) {					\
+			for (int i = index; i < d_array->nr_vars; i++) { \
+				d[i].i = OP(d[i].i, s[i - index].i);	\
+			}						\
+		} else {						\
+			int n = -index;					\
+			for (int k = 0; k < n; k++) {			\
+				d[n - 1 - k].i = OP(d[n - 1 - k].i, s[k].i); \
+			}						\
+		}							\
+	}
 
-static int trans_or(int x, void *data)
-{
-	int y = *(int*)data;
-	return x | y;
-}
-
-static int trans_xor(int x, void *data)
-{
-	int y = *(int*)data;
-	return x ^ y;
-}
+#define OP_ADD(x, y) clamp((int64_t)(x) + (y))
+#define OP_SUB(x, y) clamp((int64_t)(x) - (y))
+#define OP_MUL(x, y) clamp((int64_t)(x) * (y))
+#define OP_DIV(x, y) clamp((int64_t)(x) / (y))
+#define OP_DIV_ARRAY(x, y) ((y) ? (x) / (y) : (x))
+#define OP_AND(x, y) ((x) & (y))
+#define OP_OR(x, y) ((x) | (y))
+#define OP_XOR(x, y) ((x) ^ (y))
+
+DEFINE_TRANSFORM_NUM(transform_add, OP_ADD)
+DEFINE_TRANSFORM_NUM(transform_sub, OP_SUB)
+DEFINE_TRANSFORM_NUM(transform_mul, OP_MUL)
+DEFINE_TRANSFORM_NUM(transform_div, OP_DIV)
+DEFINE_TRANSFORM_NUM(transform_and, OP_AND)
+DEFINE_TRANSFORM_NUM(transform_or, OP_OR)
+DEFINE_TRANSFORM_NUM(transform_xor, OP_XOR)
+
+DEFINE_TRANSFORM_ARRAY(transform_add_array, OP_ADD)
+DEFINE_TRANSFORM_ARRAY(transform_sub_array, OP_SUB)
+DEFINE_TRANSFORM_ARRAY(transform_mul_array, OP_MUL)
+DEFINE_TRANSFORM_ARRAY(transform_div_array, OP_DIV_ARRAY)
+DEFINE_TRANSFORM_ARRAY(transform_and_array, OP_AND)
+DEFINE_TRANSFORM_ARRAY(transform_or_array, OP_OR)
+DEFINE_TRANSFORM_ARRAY(transform_xor_array, OP_XOR)
 
 static void vmArray_AddNum(struct page **array, int index, int num)
 {
-	transform(*array, index, trans_add, &num);
+	transform_add(*array, index, num);
 }
 
 static void vmArray_SubNum(struct page **array, int index, int num)
 {
-	transform(*array, index, trans_sub, &num);
+	transform_sub(*array, index, num);
 }
 
 static void vmArray_MulNum(struct page **array, int index, int num)
 {
-	transform(*array, index, trans_mul, &num);
+	transform_mul(*array, index, num);
 }
 
 static void vmArray_DivNum(struct page **array, int index, int num)
 {
 	if (num != 0)
-		transform(*array, index, trans_div, &num);
+		transform_div(*array, index, num);
 }
 
 static void vmArray_AndNum(struct page **array, int index, int num)
 {
-	transform(*array, index, trans_and, &num);
+	transform_and(*array, index, num);
 }
 
 static void vmArray_OrNum(struct page **array, int index, int num)
 {
-	transform(*array, index, trans_or, &num);
+	transform_or(*array, index, num);
 }
 
 static void vmArray_XorNum(struct page **array, int index, int num)
 {
-	transform(*array, index, trans_xor, &num);
+	transform_xor(*array, index, num);
 }
 
 //void vmArray_MinNum(struct page **array, int index, int num);
 //void vmArray_MaxNum(struct page **array, int index, int num);
 
-struct vmarray_iter {
-	struct page *array;
-	int index;
-};
-
-static int trans_add_array(int x, void *data)
-{
-	struct vmarray_iter *iter = data;
-	return clamp((int64_t)x + iter->array->values[iter->index++].i);
-}
-
-static int trans_sub_array(int x, void *data)
-{
-	struct vmarray_iter *iter = data;
-	return clamp((int64_t)x - iter->array->values[iter->index++].i);
-}
-
-static int trans_mul_array(int x, void *data)
-{
-	struct vmarray_iter *iter = data;
-	return clamp((int64_t)x * iter->array->values[iter->index++].i);
-}
-
-static int trans_div_array(int x, void *data)
-{
-	struct vmarray_iter *iter = data;
-	int rhs = iter->array->values[iter->index++].i;
-	return rhs ? x / rhs : x;
-}
-
-static int trans_and_array(int x, void *data)
-{
-	struct vmarray_iter *iter = data;
-	return x & iter->array->values[iter->index++].i;
-}
-
-static int trans_or_array(int x, void *data)
-{
-	struct vmarray_iter *iter = data;
-	return x | iter->array->values[iter->index++].i;
-}
-
-static int trans_xor_array(int x, void *data)
-{
-	struct vmarray_iter *iter = data;
-	return x ^ iter->array->values[iter->index++].i;
-}
-
 static void vmArray_AddArray(struct page **d_array, int index, struct page *s_array)
 {
-	struct vmarray_iter iter = { s_array, 0 };
-	transform(*d_array, index, trans_add_array, &iter);
+	transform_add_array(*d_array, index, s_array);
 }
 
 static void vmArray_SubArray(struct page **d_array, int index, struct page *s_array)
 {
-	struct vmarray_iter iter = { s_array, 0 };
-	transform(*d_array, index, trans_sub_array, &iter);
+	transform_sub_array(*d_array, index, s_array);
 }
 
 static void vmArray_MulArray(struct page **d_array, int index, struct page *s_array)
 {
-	struct vmarray_iter iter = { s_array, 0 };
-	transform(*d_array, index, trans_mul_array, &iter);
+	transform_mul_array(*d_array, index, s_array);
 }
 
 static void vmArray_DivArray(struct page **d_array, int index, struct page *s_array)
 {
-	struct vmarray_iter iter = { s_array, 0 };
-	transform(*d_array, index, trans_div_array, &iter);
+	transform_div_array(*d_array, index, s_array);
 }
 
 static void vmArray_AndArray(struct page **d_array, int index, struct page *s_array)
 {
-	struct vmarray_iter iter = { s_array, 0 };
-	transform(*d_array, index, trans_and_array, &iter);
+	transform_and_array(*d_array, index, s_array);
 }
 
 static void vmArray_OrArray(struct page **d_array, int index, struct page *s_array)
 {
-	struct vmarray_iter iter = { s_array, 0 };
-	transform(*d_array, index, trans_or_array, &iter);
+	transform_or_array(*d_array, index, s_array);
 }
 
 static void vmArray_XorArray(struct page **d_array, int index, struct page *s_array)
 {
-	struct vmarray_iter iter = { s_array, 0 };
-	transform(*d_array, index, trans_xor_array, &iter);
+	transform_xor_array(*d_array, index, s_array);
 }
 
 //void vmArray_MinArray(struct page **d_array, int index, struct page *s_array);
 //void vmArray_MaxArray(struct page **d_array, int index, struct page *s_array);
 
-static bool pred_equal(int x, void *data)
-{
-	int y = *(int*)data;
-	return x == y;
-}
-
-static bool pred_not_equal(int x, void *data)
-{
-	int y = *(int*)data;
-	return x != y;
-}
+// Predicates take the element x and the arguments lo and hi (hi is only used
+// by the range predicate).
+#define PRED_EQU(x, lo, hi) ((x) == (lo))
+#define PRED_NOT(x, lo, hi) ((x) != (lo))
+#define PRED_LOW(x, lo, hi) ((x) <= (lo))
+#define PRED_HIGH(x, lo, hi) ((lo) <= (x))
+#define PRED_RANGE(x, lo, hi) ((lo) <= (x) && (x) <= (hi))
+
+// count the elements in [index, nr_vars) matching PRED
+#define DEFINE_COUNT_IF(name, PRED)					\
+	static int name(struct page *array, int index, int lo, int hi)	\
+	{								\
+		if (!array)						\
+			return 0;					\
+		check_array(array);					\
+		union vm_value *v = array->values;			\
+		int count = 0;						\
+		for (int i = index; i < array->nr_vars; i++) {		\
+			count += PRED(v[i].i, lo, hi) ? 1 : 0;		\
+		}							\
+		return count;						\
+	}
 
-static bool pred_low(int x, void *data)
-{
-	int y = *(int*)data;
-	return x <= y;
-}
+// replace the elements in [index, nr_vars) matching PRED with n
+#define DEFINE_REPLACE(name, PRED)					\
+	static void name(struct page *array, int index, int n, int lo, int hi) \
+	{								\
+		if (!array)						\
+			return;						\
+		check_array(array);					\
+		union vm_value *v = array->values;			\
+		for (int i = index; i < array->nr_vars; i++) {		\
+			v[i].i = PRED(v[i].i, lo, hi) ? n : v[i].i;	\
+		}							\
+	}
 
-static bool pred_high(int x, void *data)
-{
-	int y = *(int*)data;
-	return y <= x;
-}
+// find the first element matching PRED, in visiting order
+#define DEFINE_FIND(name, PRED)						\
+	static int name(struct page *array, int index, int lo, int hi, int *out_index) \
+	{								\
+		if (!array)						\
+			return 0;					\
+		check_array(array);					\
+		union vm_value *v = array->values;			\
+		if (index >= 0) {					\
+			for (int i = index; i < array->nr_vars; i++) {	\
+				if (PRED(v[i].i, lo, hi)) {		\
+					*out_index = i;			\
+					return 1;			\
+				}					\
+			}						\
+		} else {						\
+			for (int i = -index - 1; i >= 0; --i) {		\
+				if (PRED(v[i].i, lo, hi)) {		\
+					*out_index = i;			\
+					return 1;			\
+				}					\
+			}						\
+		}							\
+		return 0;						\
+	}
 
-struct range {
-	int min;
-	int max;
-};
+// d_array[i] = PRED(s_array[i]) ? 1 : 0
+#define DEFINE_MAP_PREDICATE(name, PRED)				\
+	static void name(struct page *s_array, int index, int lo, int hi, struct page *d_array) \
+	{								\
+		if (!s_array || !d_array)				\
+			return;						\
+		check_array(s_array);					\
+		check_array(d_array);					\
+		union vm_value *s = s_array->values;			\
+		union vm_value *d = d_array->values;			\
+		int begin = index >= 0 ? index : 0;			\
+		int end = index >= 0 ? s_array->nr_vars : -index;	\
+		for (int i = begin; i < end; i++) {			\
+			d[i].i = PRED(s[i].i, lo, hi) ? 1 : 0;		\
+		}							\
+	}
 
-static bool pred_in_range(int x, void *data)
-{
-	struct range *r = data;
-	return r->min <= x && x <= r->max;
-}
+// d_array[i] = 1 if PRED(s_array[i])
+#define DEFINE_SET_IF(name, PRED)					\
+	static void name(struct page *s_array, int index, int lo, int hi, struct page *d_array) \
+	{								\
+		if (!s_array || !d_array)				\
+			return;						\
+		check_array(s_array);					\
+		check_array(d_array);					\
+		union vm_value *s = s_array->values;			\
+		union vm_value *d = d_array->values;			\
+		int begin = index >= 0 ? index : 0;			\
+		int end = index >= 0 ? s_array->nr_vars : -index;	\
+		for (int i = begin; i < end; i++) {			\
+			d[i].i = PRED(s[i].i, lo, hi) ? 1 : d[i].i;	\
+		}							\
+	}
 
-static int count_if(struct page *array, int index, bool (*pred)(int, void *), void *data)
-{
-	if (!array)
-		return 0;
-	check_array(array);
+#define DEFINE_PREDICATE_OPS(suffix, PRED)		\
+	DEFINE_COUNT_IF(count_if_ ## suffix, PRED)	\
+	DEFINE_REPLACE(replace_ ## suffix, PRED)	\
+	DEFINE_FIND(find_ ## suffix, PRED)		\
+	DEFINE_MAP_PREDICATE(map_ ## suffix, PRED)	\
+	DEFINE_SET_IF(set_if_ ## suffix, PRED)
 
-	int count = 0;
-	for (int i = index; i < array->nr_vars; i++) {
-		if (pred(array->values[i].i, data))
-			count++;
-	}
-	return count;
-}
+DEFINE_PREDICATE_OPS(equ, PRED_EQU)
+DEFINE_PREDICATE_OPS(not, PRED_NOT)
+DEFINE_PREDICATE_OPS(low, PRED_LOW)
+DEFINE_PREDICATE_OPS(high, PRED_HIGH)
+DEFINE_PREDICATE_OPS(range, PRED_RANGE)
 
 static int vmArray_EnumEquNum(struct page *array, int index, int num)
 {
-	return count_if(array, index, pred_equal, &num);
+	return count_if_equ(array, index, num, 0);
 }
 
 static int vmArray_EnumNotNum(struct page *array, int index, int num)
 {
-	return count_if(array, index, pred_not_equal, &num);
+	return count_if_not(array, index, num, 0);
 }
 
 static int vmArray_EnumLowNum(struct page *array, int index, int num)
 {
-	return count_if(array, index, pred_low, &num);
+	return count_if_low(array, index, num, 0);
 }
 
 static int vmArray_EnumHighNum(struct page *array, int index, int num)
 {
-	return count_if(array, index, pred_high, &num);
+	return count_if_high(array, index, num, 0);
 }
 
 static int vmArray_EnumRangeNum(struct page *array, int index, int min, int max)
 {
-	struct range r = { .min = min, .max = max };
-	return count_if(array, index, pred_in_range, &r);
-}
-
-static void replace(struct page *array, int index, int n, bool (*pred)(int, void *), void *data)
-{
-	if (!array)
-		return;
-	check_array(array);
-
-	for (int i = index; i < array->nr_vars; i++) {
-		if (pred(array->values[i].i, data))
-			array->values[i].i = n;
-	}
+	return count_if_range(array, index, min, max);
 }
 
 static void vmArray_ChangeEquNum(struct page **array, int index, int num, int exg)
 {
-	replace(*array, index, exg, pred_equal, &num);
+	replace_equ(*array, index, exg, num, 0);
 }
 
 static void vmArray_ChangeNotNum(struct page **array, int index, int num, int exg)
 {
-	replace(*array, index, exg, pred_not_equal, &num);
+	replace_not(*array, index, exg, num, 0);
 }
 
 static void vmArray_ChangeLowNum(struct page **array, int index, int num, int exg)
 {
-	replace(*array, index, exg, pred_low, &num);
+	replace_low(*array, index, exg, num, 0);
 }
 
 static void vmArray_ChangeHighNum(struct page **array, int index, int num, int exg)
 {
-	replace(*array, index, exg, pred_high, &num);
+	replace_high(*array, index, exg, num, 0);
 }
 
 static void vmArray_ChangeRangeNum(struct page **array, int index, int min, int max, int exg)
 {
-	struct range r = { .min = min, .max = max };
-	replace(*array, index, exg, pred_in_range, &r);
-}
-
-static int find(struct page *array, int index, bool (*pred)(int, void *), void *data, int *out_index)
-{
-	if (!array)
-		return 0;
-	check_array(array);
-
-	if (index >= 0) {
-		for (int i = index; i < array->nr_vars; i++) {
-			if (pred(array->values[i].i, data)) {
-				*out_index = i;
-				return 1;
-			}
-		}
-	} else {
-		for (int i = -index - 1; i >= 0; --i) {
-			if (pred(array->values[i].i, data)) {
-				*out_index = i;
-				return 1;
-			}
-		}
-	}
-	return 0;
+	replace_range(*array, index, exg, min, max);
 }
 
 static int vmArray_GrepEquNum(struct page *array, int index, int num, int *out_index)
 {
-	return find(array, index, pred_equal, &num, out_index);
+	return find_equ(array, index, num, 0, out_index);
 }
 
 static int vmArray_GrepNotNum(struct page *array, int index, int num, int *out_index)
 {
-	return find(array, index, pred_not_equal, &num, out_index);
+	return find_not(array, index, num, 0, out_index);
 }
 
 static int vmArray_GrepLowNum(struct page *array, int index, int num, int *out_index)
 {
-	return find(array, index, pred_low, &num, out_index);
+	return find_low(array, index, num, 0, out_index);
 }
 
 static int vmArray_GrepHighNum(struct page *array, int index, int num, int *out_index)
 {
-	return find(array, index, pred_high, &num, out_index);
+	return find_high(array, index, num, 0, out_index);
 }
 
 static int vmArray_GrepRangeNum(struct page *array, int index, int min, int max, int *out_index)
 {
-	struct range r = { .min = min, .max = max };
-	return find(array, index, pred_in_range, &r, out_index);
+	return find_range(array, index, min, max, out_index);
 }
 
 static int vmArray_GrepLowOrder(struct page *s_array, int index, struct page **d_array_, int *out_index)
@@ -452,48 +430,29 @@ static int vmArray_GrepHighOrder(struct page *s_array, int index, struct page **
 	return 1;
 }
 
-static void map_predicate(struct page *s_array, int index, bool (*pred)(int, void *), void *data, struct page *d_array)
-{
-	if (!s_array || !d_array)
-		return;
-	check_array(s_array);
-	check_array(d_array);
-
-	if (index >= 0) {
-		for (int i = index; i < s_array->nr_vars; i++) {
-			d_array->values[i].i = pred(s_array->values[i].i, data) ? 1 : 0;
-		}
-	} else {
-		for (int i = -index - 1; i >= 0; --i) {
-			d_array->values[i].i = pred(s_array->values[i].i, data) ? 1 : 0;
-		}
-	}
-}
-
 static void vmArray_SetEquNum(struct page *s_array, int index, int num, struct page **d_array)
 {
-	map_predicate(s_array, index, pred_equal, &num, *d_array);
+	map_equ(s_array, index, num, 0, *d_array);
 }
 
 static void vmArray_SetNotNum(struct page *s_array, int index, int num, struct page **d_array)
 {
-	map_predicate(s_array, index, pred_not_equal, &num, *d_array);
+	map_not(s_array, index, num, 0, *d_array);
 }
 
 static void vmArray_SetLowNum(struct page *s_array, int index, int num, struct page **d_array)
 {
-	map_predicate(s_array, index, pred_low, &num, *d_array);
+	map_low(s_array, index, num, 0, *d_array);
 }
 
 static void vmArray_SetHighNum(struct page *s_array, int index, int num, struct page **d_array)
 {
-	map_predicate(s_array, index, pred_high, &num, *d_array);
+	map_high(s_array, index, num, 0, *d_array);
 }
 
 static void vmArray_SetRangeNum(struct page *s_array, int index, int min, int max, struct page **d_array)
 {
-	struct range r = { .min = min, .max = max };
-	map_predicate(s_array, index, pred_in_range, &r, *d_array);
+	map_range(s_array, index, min, max, *d_array);
 }
 
 //void vmArray_AndEquNum(struct page *pISVMArray, int index, int num, struct page **pIDVMArray);
@@ -502,50 +461,29 @@ static void vmArray_SetRangeNum(struct page *s_array, int index, int min, int ma
 //void vmArray_AndHighNum(struct page *pISVMArray, int index, int num, struct page **pIDVMArray);
 //void vmArray_AndRangeNum(struct page *pISVMArray, int index, int nMin, int nMax, struct page **pIDVMArray);
 
-static void set_if(struct page *s_array, int index, bool (*pred)(int, void *), void *data, struct page *d_array)
-{
-	if (!s_array || !d_array)
-		return;
-	check_array(s_array);
-	check_array(d_array);
-
-	if (index >= 0) {
-		for (int i = index; i < s_array->nr_vars; i++) {
-			if (pred(s_array->values[i].i, data))
-				d_array->values[i].i = 1;
-		}
-	} else {
-		for (int i = -index - 1; i >= 0; --i) {
-			if (pred(s_array->values[i].i, data))
-				d_array->values[i].i = 1;
-		}
-	}
-}
-
 static void vmArray_OrEquNum(struct page *s_array, int index, int num, struct page **d_array)
 {
-	set_if(s_array, index, pred_equal, &num, *d_array);
+	set_if_equ(s_array, index, num, 0, *d_array);
 }
 
 static void vmArray_OrNotNum(struct page *s_array, int index, int num, struct page **d_array)
 {
-	set_if(s_array, index, pred_not_equal, &num, *d_array);
+	set_if_not(s_array, index, num, 0, *d_array);
 }
 
 static void vmArray_OrLowNum(struct page *s_array, int index, int num, struct page **d_array)
 {
-	set_if(s_array, index, pred_low, &num, *d_array);
+	set_if_low(s_array, index, num, 0, *d_array);
 }
 
 static void vmArray_OrHighNum(struct page *s_array, int index, int num, struct page **d_array)
 {
-	set_if(s_array, index, pred_high, &num, *d_array);
+	set_if_high(s_array, index, num, 0, *d_array);
 }
 
 static void vmArray_OrRangeNum(struct page *s_array, int index, int min, int max, struct page **d_array)
 {
-	struct range r = { .min = min, .max = max };
-	set_if(s_array, index, pred_in_range, &r, *d_array);
+	set_if_range(s_array, index, min, max, *d_array);
 }
 
 // Find num by visiting elements spirally around (x, y).
@@ -25,6 +25,7 @@
 
 #include "hll.h"
 #include "id_pool.h"
+#include "savedata.h"
 #include "vm/heap.h"
 #include "vm/page.h"
 #include "xsystem4.h"
@@ -152,6 +153,7 @@ static int vmFile_EnumHandle(void)
 
 static int vmFile_Open(struct string *string, int type)
 {
+	vm_wait_for_save();
 	struct vm_file *vf = xcalloc(1, sizeof(struct vm_file));
 	char *path = savedir_path(string->text);
 	vf->path = path;
@@ -167,6 +169,7 @@ static int vmFile_Open(struct string *string, int type)
 		}
 		buffer_init(&vf->buf, data, len);
 	} else if (type == VM_FILE_WRITE) {
+		savedata_invalidate_file(path);
 		vf->fp = file_open_utf8(path, "wb");
 		if (!vf->fp) {
 			WARNING("Failed to open file '%s': %s", display_utf0(path), strerror(errno));
@@ -361,7 +364,9 @@ static int vmFile_SeekFloat(int handle, int pos, int absolute)
 
 static int vmFile_Delete(struct string *string)
 {
+	vm_wait_for_save();
 	char *path = savedir_path(string->text);
+	savedata_invalidate_file(path);
 	int r = !remove_utf8(path);
 	free(path);
 	return r;
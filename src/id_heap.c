@@ -0,0 +1,99 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include "system4.h"
+#include "id_heap.h"
+
+static void free_push(struct id_heap *heap, int id)
+{
+	if (heap->nr_free == heap->free_cap) {
+		int new_cap = heap->free_cap ? heap->free_cap * 2 : 256;
+		heap->free = xrealloc_array(heap->free, heap->free_cap, new_cap, sizeof(int));
+		heap->free_cap = new_cap;
+	}
+	int *free_ids = heap->free;
+	int i = heap->nr_free++;
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+		if (free_ids[parent] <= id)
+			break;
+		free_ids[i] = free_ids[parent];
+		i = parent;
+	}
+	free_ids[i] = id;
+}
+
+static int free_pop(struct id_heap *heap)
+{
+	int *free_ids = heap->free;
+	int top = free_ids[0];
+	int last = free_ids[--heap->nr_free];
+	int n = heap->nr_free;
+	int i = 0;
+	for (;;) {
+		int child = i * 2 + 1;
+		if (child >= n)
+			break;
+		if (child + 1 < n && free_ids[child + 1] < free_ids[child])
+			child++;
+		if (last <= free_ids[child])
+			break;
+		free_ids[i] = free_ids[child];
+		i = child;
+	}
+	if (n)
+		free_ids[i] = last;
+	return top;
+}
+
+/*
+ * Get the lowest id that is not in use. Ids below `end` are in use unless
+ * they were released.
+ */
+int id_heap_alloc(struct id_heap *heap)
+{
+	if (heap->nr_free)
+		return free_pop(heap);
+	return heap->end++;
+}
+
+/*
+ * Return an id to the heap. The id must be in use.
+ */
+void id_heap_release(struct id_heap *heap, int id)
+{
+	free_push(heap, id);
+}
+
+/*
+ * Forget all released ids. The next id handed out is `end`.
+ */
+void id_heap_reset(struct id_heap *heap, int end)
+{
+	heap->end = end;
+	heap->nr_free = 0;
+}
+
+void id_heap_delete(struct id_heap *heap)
+{
+	free(heap->free);
+	heap->free = NULL;
+	heap->nr_free = 0;
+	heap->free_cap = 0;
+	heap->end = 0;
+}
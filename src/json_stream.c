@@ -0,0 +1,636 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "system4.h"
+
+#include "json_stream.h"
+
+/*
+ * Writer
+ */
+
+static void writer_flush(struct json_writer *w)
+{
+	if (w->len && !w->error) {
+		if (fwrite(w->buf, w->len, 1, w->f) != 1)
+			w->error = true;
+	}
+	w->len = 0;
+}
+
+static void writer_put(struct json_writer *w, const char *data, size_t len)
+{
+	if (w->len + len > JSON_WRITER_BUFFER_SIZE) {
+		writer_flush(w);
+		if (len > JSON_WRITER_BUFFER_SIZE) {
+			if (!w->error && fwrite(data, len, 1, w->f) != 1)
+				w->error = true;
+			return;
+		}
+	}
+	memcpy(w->buf + w->len, data, len);
+	w->len += len;
+}
+
+static void writer_putc(struct json_writer *w, char c)
+{
+	if (w->len == JSON_WRITER_BUFFER_SIZE)
+		writer_flush(w);
+	w->buf[w->len++] = c;
+}
+
+// Top-level containers and their direct children are put on separate lines
+// so that the output stays diffable; everything deeper is written compactly.
+#define PRETTY_DEPTH 2
+
+static void writer_newline(struct json_writer *w)
+{
+	writer_putc(w, '\n');
+	for (int i = 0; i < w->depth; i++)
+		writer_putc(w, '\t');
+}
+
+/*
+ * Emit the separator (and possibly whitespace) preceding a value or key.
+ */
+static void begin_value(struct json_writer *w)
+{
+	if (w->after_key) {
+		w->after_key = false;
+		return;
+	}
+	if (w->depth == 0)
+		return;
+	if (!w->first[w->depth])
+		writer_putc(w, ',');
+	w->first[w->depth] = false;
+	if (w->depth <= PRETTY_DEPTH)
+		writer_newline(w);
+}
+
+static void begin_container(struct json_writer *w, char c)
+{
+	begin_value(w);
+	writer_putc(w, c);
+	if (++w->depth >= JSON_WRITER_MAX_DEPTH)
+		ERROR("JSON nesting too deep");
+	w->first[w->depth] = true;
+}
+
+static void end_container(struct json_writer *w, char c)
+{
+	bool empty = w->first[w->depth];
+	w->depth--;
+	if (!empty && w->depth < PRETTY_DEPTH)
+		writer_newline(w);
+	writer_putc(w, c);
+}
+
+void json_writer_init(struct json_writer *w, FILE *f)
+{
+	w->f = f;
+	w->len = 0;
+	w->depth = 0;
+	w->after_key = false;
+	w->error = false;
+	w->first[0] = true;
+}
+
+bool json_writer_finish(struct json_writer *w)
+{
+	writer_putc(w, '\n');
+	writer_flush(w);
+	return !w->error;
+}
+
+void json_write_begin_object(struct json_writer *w)
+{
+	begin_container(w, '{');
+}
+
+void json_write_end_object(struct json_writer *w)
+{
+	end_container(w, '}');
+}
+
+void json_write_begin_array(struct json_writer *w)
+{
+	begin_container(w, '[');
+}
+
+void json_write_end_array(struct json_writer *w)
+{
+	end_container(w, ']');
+}
+
+static void write_string(struct json_writer *w, const char *s)
+{
+	static const char hex[] = "0123456789abcdef";
+	writer_putc(w, '"');
+	const char *run = s;
+	for (; *s; s++) {
+		unsigned char c = *s;
+		if (c >= 0x20 && c != '"' && c != '\\')
+			continue;
+		writer_put(w, run, s - run);
+		run = s + 1;
+		writer_putc(w, '\\');
+		switch (c) {
+		case '"':  writer_putc(w, '"'); break;
+		case '\\': writer_putc(w, '\\'); break;
+		case '\b': writer_putc(w, 'b'); break;
+		case '\f': writer_putc(w, 'f'); break;
+		case '\n': writer_putc(w, 'n'); break;
+		case '\r': writer_putc(w, 'r'); break;
+		case '\t': writer_putc(w, 't'); break;
+		default:
+			writer_put(w, "u00", 3);
+			writer_putc(w, hex[c >> 4]);
+			writer_putc(w, hex[c & 0xf]);
+			break;
+		}
+	}
+	writer_put(w, run, s - run);
+	writer_putc(w, '"');
+}
+
+void json_write_key(struct json_writer *w, const char *key)
+{
+	begin_value(w);
+	write_string(w, key);
+	writer_putc(w, ':');
+	w->after_key = true;
+}
+
+void json_write_int(struct json_writer *w, int64_t i)
+{
+	char buf[24];
+	begin_value(w);
+	int len = snprintf(buf, sizeof(buf), "%" PRId64, i);
+	writer_put(w, buf, len);
+}
+
+void json_write_string(struct json_writer *w, const char *s)
+{
+	begin_value(w);
+	write_string(w, s);
+}
+
+void json_write_null(struct json_writer *w)
+{
+	begin_value(w);
+	writer_put(w, "null", 4);
+}
+
+/*
+ * Reader
+ */
+
+void json_reader_init(struct json_reader *r, const char *data, size_t size)
+{
+	r->p = data;
+	r->end = data + size;
+	r->f = NULL;
+	r->buf = NULL;
+	r->buf_cap = 0;
+	r->eof = true;
+	r->str = NULL;
+	r->str_cap = 0;
+	r->error = false;
+}
+
+void json_reader_init_file(struct json_reader *r, FILE *f)
+{
+	json_reader_init(r, NULL, 0);
+	r->f = f;
+	r->buf = xmalloc(JSON_READER_BUFFER_SIZE);
+	r->buf_cap = JSON_READER_BUFFER_SIZE;
+	r->p = r->end = r->buf;
+	r->eof = false;
+}
+
+void json_reader_fini(struct json_reader *r)
+{
+	free(r->buf);
+	r->buf = NULL;
+	r->buf_cap = 0;
+	free(r->str);
+	r->str = NULL;
+	r->str_cap = 0;
+}
+
+/*
+ * Make at least `need` bytes available at r->p, reading more of the file if
+ * necessary. Returns false if the input ends first. Pointers into the
+ * buffer are invalidated.
+ */
+static bool fill(struct json_reader *r, size_t need)
+{
+	size_t avail = r->end - r->p;
+	if (avail >= need)
+		return true;
+	if (r->eof)
+		return false;
+
+	memmove(r->buf, r->p, avail);
+	if (need > r->buf_cap) {
+		while (r->buf_cap < need)
+			r->buf_cap *= 2;
+		r->buf = xrealloc(r->buf, r->buf_cap);
+	}
+	while (avail < need && !r->eof) {
+		size_t n = fread(r->buf + avail, 1, r->buf_cap - avail, r->f);
+		if (n == 0) {
+			if (ferror(r->f))
+				r->error = true;
+			r->eof = true;
+		}
+		avail += n;
+	}
+	r->p = r->buf;
+	r->end = r->buf + avail;
+	return avail >= need;
+}
+
+/*
+ * Length of the run of characters from `chars` at r->p. The whole run is
+ * buffered on return.
+ */
+static size_t token_length(struct json_reader *r, const char *chars)
+{
+	size_t n = 0;
+	while (true) {
+		size_t avail = r->end - r->p;
+		while (n < avail && r->p[n] && strchr(chars, r->p[n]))
+			n++;
+		if (n < avail || !fill(r, n + 1))
+			return n;
+	}
+}
+
+/*
+ * Skip whitespace and separators. Commas and colons carry no information
+ * for a pull parser that already knows the structure it is reading.
+ */
+static void skip_ws(struct json_reader *r)
+{
+	while (r->p < r->end || fill(r, 1)) {
+		switch (*r->p) {
+		case ' ':
+		case '\t':
+		case '\n':
+		case '\r':
+		case ',':
+		case ':':
+			r->p++;
+			break;
+		default:
+			return;
+		}
+	}
+}
+
+enum json_token json_reader_peek(struct json_reader *r)
+{
+	if (r->error)
+		return JSON_TOKEN_ERROR;
+	skip_ws(r);
+	if (r->p >= r->end)
+		return JSON_TOKEN_EOF;
+	switch (*r->p) {
+	case '{': return JSON_TOKEN_OBJECT;
+	case '}': return JSON_TOKEN_OBJECT_END;
+	case '[': return JSON_TOKEN_ARRAY;
+	case ']': return JSON_TOKEN_ARRAY_END;
+	case '"': return JSON_TOKEN_STRING;
+	case 't': return JSON_TOKEN_TRUE;
+	case 'f': return JSON_TOKEN_FALSE;
+	case 'n': return JSON_TOKEN_NULL;
+	case '-':
+	case '0': case '1': case '2': case '3': case '4':
+	case '5': case '6': case '7': case '8': case '9':
+		return JSON_TOKEN_NUMBER;
+	}
+	return JSON_TOKEN_ERROR;
+}
+
+static bool expect(struct json_reader *r, enum json_token t)
+{
+	if (json_reader_peek(r) != t) {
+		r->error = true;
+		return false;
+	}
+	r->p++;
+	return true;
+}
+
+static bool expect_literal(struct json_reader *r, const char *lit)
+{
+	size_t len = strlen(lit);
+	if (!fill(r, len) || strncmp(r->p, lit, len)) {
+		r->error = true;
+		return false;
+	}
+	r->p += len;
+	return true;
+}
+
+bool json_read_begin_object(struct json_reader *r)
+{
+	return expect(r, JSON_TOKEN_OBJECT);
+}
+
+bool json_read_object_next(struct json_reader *r, const char **key)
+{
+	switch (json_reader_peek(r)) {
+	case JSON_TOKEN_OBJECT_END:
+		r->p++;
+		return false;
+	case JSON_TOKEN_STRING:
+		*key = json_read_string(r, NULL);
+		return *key != NULL;
+	default:
+		r->error = true;
+		return false;
+	}
+}
+
+bool json_read_begin_array(struct json_reader *r)
+{
+	return expect(r, JSON_TOKEN_ARRAY);
+}
+
+bool json_read_array_next(struct json_reader *r)
+{
+	switch (json_reader_peek(r)) {
+	case JSON_TOKEN_ARRAY_END:
+		r->p++;
+		return false;
+	case JSON_TOKEN_EOF:
+	case JSON_TOKEN_ERROR:
+		r->error = true;
+		return false;
+	default:
+		return true;
+	}
+}
+
+bool json_read_int(struct json_reader *r, int *out)
+{
+	if (json_reader_peek(r) != JSON_TOKEN_NUMBER) {
+		r->error = true;
+		return false;
+	}
+
+	// buffer the whole number
+	token_length(r, "+-.eE0123456789");
+
+	// fast path: plain integer
+	const char *p = r->p;
+	bool negative = *p == '-';
+	if (negative)
+		p++;
+	int64_t v = 0;
+	while (p < r->end && *p >= '0' && *p <= '9' && v <= INT64_MAX / 10 - 10) {
+		v = v * 10 + (*p - '0');
+		p++;
+	}
+	if (p == r->end || (*p != '.' && *p != 'e' && *p != 'E' && !(*p >= '0' && *p <= '9'))) {
+		if (negative)
+			v = -v;
+		*out = v > INT_MAX ? INT_MAX : v < INT_MIN ? INT_MIN : v;
+		r->p = p;
+		return true;
+	}
+
+	// slow path: same conversion as cJSON's valueint
+	char buf[64];
+	size_t len = 0;
+	for (p = r->p; p < r->end && len < sizeof(buf) - 1 && strchr("+-.eE0123456789", *p); p++)
+		buf[len++] = *p;
+	buf[len] = '\0';
+	char *endptr;
+	double d = strtod(buf, &endptr);
+	if (endptr == buf) {
+		r->error = true;
+		return false;
+	}
+	r->p += endptr - buf;
+	if (d >= INT_MAX)
+		*out = INT_MAX;
+	else if (d <= (double)INT_MIN)
+		*out = INT_MIN;
+	else
+		*out = (int)d;
+	return true;
+}
+
+static void str_reserve(struct json_reader *r, size_t size)
+{
+	if (size <= r->str_cap)
+		return;
+	size_t cap = r->str_cap ? r->str_cap : 256;
+	while (cap < size)
+		cap *= 2;
+	r->str = xrealloc(r->str, cap);
+	r->str_cap = cap;
+}
+
+static int hex_digit(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+static bool read_hex4(struct json_reader *r, unsigned *out)
+{
+	if (r->end - r->p < 4)
+		return false;
+	unsigned v = 0;
+	for (int i = 0; i < 4; i++) {
+		int d = hex_digit(r->p[i]);
+		if (d < 0)
+			return false;
+		v = (v << 4) | d;
+	}
+	r->p += 4;
+	*out = v;
+	return true;
+}
+
+/*
+ * Decode a \u escape (the "\u" has already been consumed) and append it to
+ * the string buffer as UTF-8, as cJSON does.
+ */
+static bool read_unicode_escape(struct json_reader *r, size_t *len)
+{
+	unsigned cp;
+	if (!read_hex4(r, &cp))
+		return false;
+	if (cp >= 0xDC00 && cp <= 0xDFFF)
+		return false;
+	if (cp >= 0xD800 && cp <= 0xDBFF) {
+		unsigned lo;
+		if (r->end - r->p < 2 || r->p[0] != '\\' || r->p[1] != 'u')
+			return false;
+		r->p += 2;
+		if (!read_hex4(r, &lo) || lo < 0xDC00 || lo > 0xDFFF)
+			return false;
+		cp = 0x10000 + (((cp & 0x3FF) << 10) | (lo & 0x3FF));
+	}
+
+	char *out = r->str + *len;
+	if (cp < 0x80) {
+		out[0] = cp;
+		*len += 1;
+	} else if (cp < 0x800) {
+		out[0] = 0xC0 | (cp >> 6);
+		out[1] = 0x80 | (cp & 0x3F);
+		*len += 2;
+	} else if (cp < 0x10000) {
+		out[0] = 0xE0 | (cp >> 12);
+		out[1] = 0x80 | ((cp >> 6) & 0x3F);
+		out[2] = 0x80 | (cp & 0x3F);
+		*len += 3;
+	} else {
+		out[0] = 0xF0 | (cp >> 18);
+		out[1] = 0x80 | ((cp >> 12) & 0x3F);
+		out[2] = 0x80 | ((cp >> 6) & 0x3F);
+		out[3] = 0x80 | (cp & 0x3F);
+		*len += 4;
+	}
+	return true;
+}
+
+const char *json_read_string(struct json_reader *r, size_t *len_out)
+{
+	if (!expect(r, JSON_TOKEN_STRING))
+		return NULL;
+
+	// find the end of the string to size the buffer (escapes only shrink);
+	// this also brings the whole string into the buffer
+	size_t n = 0;
+	while (true) {
+		size_t avail = r->end - r->p;
+		while (n < avail && r->p[n] != '"') {
+			if (r->p[n] == '\\')
+				n++;
+			n++;
+		}
+		if (n < avail)
+			break;
+		if (!fill(r, n + 1)) {
+			r->error = true;
+			return NULL;
+		}
+	}
+	str_reserve(r, n + 1);
+
+	size_t len = 0;
+	while (*r->p != '"') {
+		const char *run = r->p;
+		while (*r->p != '"' && *r->p != '\\')
+			r->p++;
+		memcpy(r->str + len, run, r->p - run);
+		len += r->p - run;
+		if (*r->p == '"')
+			break;
+
+		r->p++;
+		switch (*r->p++) {
+		case '"':  r->str[len++] = '"'; break;
+		case '\\': r->str[len++] = '\\'; break;
+		case '/':  r->str[len++] = '/'; break;
+		case 'b':  r->str[len++] = '\b'; break;
+		case 'f':  r->str[len++] = '\f'; break;
+		case 'n':  r->str[len++] = '\n'; break;
+		case 'r':  r->str[len++] = '\r'; break;
+		case 't':  r->str[len++] = '\t'; break;
+		case 'u':
+			if (read_unicode_escape(r, &len))
+				break;
+			// fallthrough
+		default:
+			r->error = true;
+			return NULL;
+		}
+	}
+	r->p++;
+	r->str[len] = '\0';
+	if (len_out)
+		*len_out = len;
+	return r->str;
+}
+
+bool json_read_null(struct json_reader *r)
+{
+	if (json_reader_peek(r) != JSON_TOKEN_NULL) {
+		r->error = true;
+		return false;
+	}
+	return expect_literal(r, "null");
+}
+
+static bool skip_value(struct json_reader *r, int depth)
+{
+	if (depth > 512) {
+		r->error = true;
+		return false;
+	}
+	const char *key;
+	int i;
+	switch (json_reader_peek(r)) {
+	case JSON_TOKEN_OBJECT:
+		r->p++;
+		while (json_read_object_next(r, &key)) {
+			if (!skip_value(r, depth + 1))
+				return false;
+		}
+		return !r->error;
+	case JSON_TOKEN_ARRAY:
+		r->p++;
+		while (json_read_array_next(r)) {
+			if (!skip_value(r, depth + 1))
+				return false;
+		}
+		return !r->error;
+	case JSON_TOKEN_STRING:
+		return json_read_string(r, NULL) != NULL;
+	case JSON_TOKEN_NUMBER:
+		return json_read_int(r, &i);
+	case JSON_TOKEN_TRUE:
+		return expect_literal(r, "true");
+	case JSON_TOKEN_FALSE:
+		return expect_literal(r, "false");
+	case JSON_TOKEN_NULL:
+		return expect_literal(r, "null");
+	default:
+		r->error = true;
+		return false;
+	}
+}
+
+bool json_skip_value(struct json_reader *r)
+{
+	return skip_value(r, 0);
+}
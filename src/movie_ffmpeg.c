@@ -24,6 +24,7 @@
 #include <libavformat/avformat.h>
 #include <libavutil/fifo.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
 #include <libswscale/swscale.h>
 
 #include "system4.h"
@@ -35,7 +36,15 @@
 #include "sts_mixer.h"
 #include "xsystem4.h"
 
-#define PRELOAD_PACKETS 10
+// Maximum number of packets in each decoder's queue. The demuxer thread waits
+// for room before queueing another packet.
+#define MAX_QUEUED_PACKETS 64
+// Length of the silence played when the audio decoder falls behind.
+#define SILENCE_SAMPLES 1024
+// Number of decoded video frames buffered ahead of presentation.
+#define FRAME_QUEUE_SIZE 4
+
+static Shader movie_shader;
 
 struct decoder {
 	AVStream *stream;
@@ -45,20 +54,41 @@ struct decoder {
 	bool finished;
 };
 
+/*
+ * Ring buffer of decoded video frames. Written by the video decoder thread
+ * and consumed by movie_draw.
+ */
+struct frame_queue {
+	AVFrame *frames[FRAME_QUEUE_SIZE];
+	int head;
+	int count;
+	bool eof;
+	// Set along with eof if decoding stopped before the end of the stream.
+	bool error;
+};
+
 struct movie_context {
 	AVFormatContext *format_ctx;
 	bool format_eof;
-	SDL_mutex *format_mutex;  // also protects video.queue and audio.queue
+
+	// Protects video.queue, audio.queue, the decoders' finished flags,
+	// frames and quit.
+	SDL_mutex *queue_mutex;
+	SDL_cond *queue_cond;
+	bool quit;
+
+	SDL_Thread *demux_thread;
+	SDL_Thread *video_thread;
 
 	struct decoder video;
 	struct decoder audio;
 
-	struct texture temp_surface;
+	struct frame_queue frames;
+	GLuint textures[3];  // Y, Cb, Cr
 
-	bool has_pending_video_frame;
+	// Used (on the video decoder thread) only for pixel formats that
+	// can't be uploaded directly as Y/Cb/Cr planes.
 	struct SwsContext *sws_ctx;
-	AVFrame *sws_frame;
-	void *sws_buf;
 
 	sts_mixer_stream_t sts_stream;
 	int bytes_per_sample;
@@ -72,6 +102,67 @@ struct movie_context {
 	SDL_mutex *timer_mutex;
 };
 
+static void prepare_movie_shader(struct gfx_render_job *job, void *data)
+{
+	struct movie_context *mc = data;
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, mc->textures[0]);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, mc->textures[1]);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, mc->textures[2]);
+}
+
+static void load_movie_shader(void)
+{
+	gfx_load_shader(&movie_shader, "shaders/render.v.glsl", "shaders/movie.f.glsl");
+	glUseProgram(movie_shader.program);
+	glUniform1i(glGetUniformLocation(movie_shader.program, "texture_y"), 0);
+	glUniform1i(glGetUniformLocation(movie_shader.program, "texture_cb"), 1);
+	glUniform1i(glGetUniformLocation(movie_shader.program, "texture_cr"), 2);
+	movie_shader.prepare = prepare_movie_shader;
+}
+
+static void update_texture(GLuint unit, GLuint texture, int w, int h, uint8_t *data, int linesize)
+{
+	glActiveTexture(unit);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, linesize);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, w, h, 0, GL_RED, GL_UNSIGNED_BYTE, data);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+/*
+ * Returns true if the frame can be uploaded directly as three 8-bit planes
+ * for conversion in the movie shader. The shader expects limited range
+ * (rec601) data, so full range (YUVJ) frames are converted with swscale.
+ */
+static bool is_planar_yuv(AVFrame *frame)
+{
+	if (frame->color_range == AVCOL_RANGE_JPEG)
+		return false;
+	switch (frame->format) {
+	case AV_PIX_FMT_YUV420P:
+	case AV_PIX_FMT_YUV422P:
+	case AV_PIX_FMT_YUV444P:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool is_full_range(AVFrame *frame)
+{
+	switch (frame->format) {
+	case AV_PIX_FMT_YUVJ420P:
+	case AV_PIX_FMT_YUVJ422P:
+	case AV_PIX_FMT_YUVJ444P:
+		return true;
+	default:
+		return frame->color_range == AVCOL_RANGE_JPEG;
+	}
+}
+
 static void free_decoder(struct decoder *dec)
 {
 	if (dec->ctx)
@@ -88,7 +179,7 @@ static void free_decoder(struct decoder *dec)
 	}
 }
 
-static bool init_decoder(struct decoder *dec, AVStream *stream)
+static bool init_decoder(struct decoder *dec, AVStream *stream, bool threaded)
 {
 	if (!stream)
 		return false;
@@ -99,67 +190,200 @@ static bool init_decoder(struct decoder *dec, AVStream *stream)
 	dec->ctx = avcodec_alloc_context3(codec);
 	if (avcodec_parameters_to_context(dec->ctx, stream->codecpar) < 0)
 		return false;
+	if (threaded) {
+		// let FFmpeg pick the number of threads
+		dec->ctx->thread_count = 0;
+		dec->ctx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+	}
 	if (avcodec_open2(dec->ctx, codec, NULL) != 0)
 		return false;
 	dec->frame = av_frame_alloc();
-	dec->queue = av_fifo_alloc2(0, sizeof(AVPacket*), AV_FIFO_FLAG_AUTO_GROW);
+	// one extra slot for the end of stream marker
+	dec->queue = av_fifo_alloc2(MAX_QUEUED_PACKETS + 1, sizeof(AVPacket*), 0);
 	return true;
 }
 
-static void read_packet(struct movie_context *mc)
+/*
+ * Demuxer thread. Reads packets from the container and distributes them to
+ * the video and audio packet queues, waiting while the destination queue is
+ * full. A NULL packet is queued on both queues at end of file.
+ */
+static int demux_thread(void *data)
 {
-	if (mc->format_eof)
-		return;
-
+	struct movie_context *mc = data;
 	AVPacket *packet = av_packet_alloc();
 
-	while (av_read_frame(mc->format_ctx, packet) == 0) {
-		if (packet->stream_index == mc->video.stream->index) {
-			av_fifo_write(mc->video.queue, &packet, 1);
-			return;
-		} else if (packet->stream_index == mc->audio.stream->index) {
-			av_fifo_write(mc->audio.queue, &packet, 1);
-			return;
+	while (!mc->format_eof) {
+		if (av_read_frame(mc->format_ctx, packet) != 0) {
+			mc->format_eof = true;
+			AVPacket *eof = NULL;
+			SDL_LockMutex(mc->queue_mutex);
+			av_fifo_write(mc->video.queue, &eof, 1);
+			av_fifo_write(mc->audio.queue, &eof, 1);
+			SDL_CondBroadcast(mc->queue_cond);
+			SDL_UnlockMutex(mc->queue_mutex);
+			break;
+		}
+
+		struct decoder *dec = NULL;
+		if (packet->stream_index == mc->video.stream->index)
+			dec = &mc->video;
+		else if (packet->stream_index == mc->audio.stream->index)
+			dec = &mc->audio;
+		if (!dec) {
+			av_packet_unref(packet);
+			continue;
+		}
+
+		SDL_LockMutex(mc->queue_mutex);
+		while (!mc->quit && av_fifo_can_read(dec->queue) >= MAX_QUEUED_PACKETS)
+			SDL_CondWait(mc->queue_cond, mc->queue_mutex);
+		if (mc->quit) {
+			SDL_UnlockMutex(mc->queue_mutex);
+			break;
 		}
-		av_packet_unref(packet);
+		av_fifo_write(dec->queue, &packet, 1);
+		SDL_CondBroadcast(mc->queue_cond);
+		SDL_UnlockMutex(mc->queue_mutex);
+		packet = av_packet_alloc();
 	}
+
 	av_packet_free(&packet);
-	packet = NULL;
-	mc->format_eof = true;
-	av_fifo_write(mc->video.queue, &packet, 1);
-	av_fifo_write(mc->audio.queue, &packet, 1);
+	return 0;
 }
 
-static void preload_packets(struct movie_context *mc)
+/*
+ * Take the next packet from a decoder's queue. If `wait` is true, waits for
+ * the demuxer thread when the queue is empty; otherwise returns false.
+ * *packet is set to NULL at end of stream (or when shutting down).
+ */
+static bool dequeue_packet(struct decoder *dec, struct movie_context *mc, bool wait, AVPacket **packet)
 {
-	SDL_LockMutex(mc->format_mutex);
-	while (!mc->format_eof && (av_fifo_can_read(mc->video.queue) + av_fifo_can_read(mc->audio.queue) < PRELOAD_PACKETS))
-		read_packet(mc);
-	SDL_UnlockMutex(mc->format_mutex);
+	*packet = NULL;
+	SDL_LockMutex(mc->queue_mutex);
+	if (!wait && !mc->quit && av_fifo_can_read(dec->queue) == 0) {
+		SDL_UnlockMutex(mc->queue_mutex);
+		return false;
+	}
+	while (!mc->quit && av_fifo_can_read(dec->queue) == 0)
+		SDL_CondWait(mc->queue_cond, mc->queue_mutex);
+	if (!mc->quit) {
+		av_fifo_read(dec->queue, packet, 1);
+		SDL_CondBroadcast(mc->queue_cond);
+	}
+	SDL_UnlockMutex(mc->queue_mutex);
+	return true;
 }
 
-static bool decode_frame(struct decoder *dec, struct movie_context *mc)
+enum decode_result {
+	DECODE_FRAME,
+	// no packet was queued (only when not waiting)
+	DECODE_PENDING,
+	// end of stream
+	DECODE_END,
+	DECODE_ERROR,
+};
+
+static enum decode_result decode_frame(struct decoder *dec, struct movie_context *mc, bool wait)
 {
 	int ret;
 	while ((ret = avcodec_receive_frame(dec->ctx, dec->frame)) == AVERROR(EAGAIN)) {
-		SDL_LockMutex(mc->format_mutex);
 		AVPacket *packet;
-		while (av_fifo_can_read(dec->queue) == 0)
-			read_packet(mc);
-		av_fifo_read(dec->queue, &packet, 1);
-		SDL_UnlockMutex(mc->format_mutex);
-
+		if (!dequeue_packet(dec, mc, wait, &packet))
+			return DECODE_PENDING;
 		if ((ret = avcodec_send_packet(dec->ctx, packet)) != 0) {
 			WARNING("avcodec_send_packet failed: %d", ret);
-			return false;
+			av_packet_free(&packet);
+			return DECODE_ERROR;
 		}
 		av_packet_free(&packet);
 	}
 	if (ret == AVERROR_EOF)
-		dec->finished = true;
-	else if (ret)
+		return DECODE_END;
+	if (ret) {
 		WARNING("avcodec_receive_frame failed: %d", ret);
-	return ret == 0;
+		return DECODE_ERROR;
+	}
+	return DECODE_FRAME;
+}
+
+/*
+ * Convert a decoded frame to YUV420P. Only used for pixel formats which the
+ * movie shader can't handle directly.
+ */
+static bool convert_frame(struct movie_context *mc, AVFrame *dst, AVFrame *src)
+{
+	mc->sws_ctx = sws_getCachedContext(mc->sws_ctx,
+			src->width, src->height, src->format,
+			src->width, src->height, AV_PIX_FMT_YUV420P,
+			SWS_BILINEAR, NULL, NULL, NULL);
+	if (!mc->sws_ctx)
+		return false;
+	// swscale knows that YUVJ formats are full range, but frames can also be
+	// tagged as full range via color_range.
+	int *inv_table, *table, src_range, dst_range, brightness, contrast, saturation;
+	if (sws_getColorspaceDetails(mc->sws_ctx, &inv_table, &src_range, &table, &dst_range,
+				&brightness, &contrast, &saturation) >= 0) {
+		sws_setColorspaceDetails(mc->sws_ctx, inv_table, is_full_range(src), table, 0,
+				brightness, contrast, saturation);
+	}
+	dst->format = AV_PIX_FMT_YUV420P;
+	dst->width = src->width;
+	dst->height = src->height;
+	if (av_frame_get_buffer(dst, 0) < 0)
+		return false;
+	av_frame_copy_props(dst, src);
+	sws_scale(mc->sws_ctx, (const uint8_t**)src->data, src->linesize, 0, src->height,
+			dst->data, dst->linesize);
+	return true;
+}
+
+/*
+ * Video decoder thread. Decodes frames into the frame queue, blocking while
+ * the queue is full.
+ */
+static int video_thread(void *data)
+{
+	struct movie_context *mc = data;
+	struct frame_queue *q = &mc->frames;
+	enum decode_result result;
+	bool error = false;
+
+	while ((result = decode_frame(&mc->video, mc, true)) == DECODE_FRAME) {
+		SDL_LockMutex(mc->queue_mutex);
+		while (!mc->quit && q->count == FRAME_QUEUE_SIZE)
+			SDL_CondWait(mc->queue_cond, mc->queue_mutex);
+		if (mc->quit) {
+			SDL_UnlockMutex(mc->queue_mutex);
+			break;
+		}
+		AVFrame *slot = q->frames[(q->head + q->count) % FRAME_QUEUE_SIZE];
+		SDL_UnlockMutex(mc->queue_mutex);
+
+		// The slot is owned by this thread until count is incremented.
+		if (is_planar_yuv(mc->video.frame)) {
+			av_frame_move_ref(slot, mc->video.frame);
+		} else {
+			bool ok = convert_frame(mc, slot, mc->video.frame);
+			av_frame_unref(mc->video.frame);
+			if (!ok) {
+				WARNING("Failed to convert video frame");
+				av_frame_unref(slot);
+				error = true;
+				break;
+			}
+		}
+
+		SDL_LockMutex(mc->queue_mutex);
+		q->count++;
+		SDL_UnlockMutex(mc->queue_mutex);
+	}
+
+	SDL_LockMutex(mc->queue_mutex);
+	q->eof = true;
+	q->error = error || result == DECODE_ERROR;
+	SDL_UnlockMutex(mc->queue_mutex);
+	return 0;
 }
 
 static int audio_callback(sts_mixer_sample_t *sample, void *data)
@@ -167,7 +391,24 @@ static int audio_callback(sts_mixer_sample_t *sample, void *data)
 	struct movie_context *mc = data;
 	assert(sample == &mc->sts_stream.sample);
 
-	if (!decode_frame(&mc->audio, mc)) {
+	// This runs on the audio thread, so never wait for the demuxer.
+	switch (decode_frame(&mc->audio, mc, false)) {
+	case DECODE_FRAME:
+		break;
+	case DECODE_PENDING:
+		// The demuxer fell behind; play silence rather than blocking
+		// the audio thread.
+		if (!sample->data) {
+			sample->length = SILENCE_SAMPLES * 2;
+			sample->data = xmalloc(sample->length * mc->bytes_per_sample);
+		}
+		memset(sample->data, 0, sample->length * mc->bytes_per_sample);
+		return STS_STREAM_CONTINUE;
+	case DECODE_END:
+	case DECODE_ERROR:
+		SDL_LockMutex(mc->queue_mutex);
+		mc->audio.finished = true;
+		SDL_UnlockMutex(mc->queue_mutex);
 		free(sample->data);
 		sample->length = 0;
 		sample->data = NULL;
@@ -243,12 +484,12 @@ struct movie_context *movie_load(const char *filename)
 			break;
 		}
 	}
-	if (!init_decoder(&mc->video, video_stream)) {
+	if (!init_decoder(&mc->video, video_stream, true)) {
 		WARNING("Cannot initialize video decoder");
 		movie_free(mc);
 		return NULL;
 	}
-	if (!init_decoder(&mc->audio, audio_stream)) {
+	if (!init_decoder(&mc->audio, audio_stream, false)) {
 		WARNING("Cannot initialize audio decoder");
 		movie_free(mc);
 		return NULL;
@@ -257,11 +498,31 @@ struct movie_context *movie_load(const char *filename)
 	NOTICE("video: %d x %d, %s", mc->video.ctx->width, mc->video.ctx->height, av_get_pix_fmt_name(mc->video.ctx->pix_fmt));
 	NOTICE("audio: %d hz, %d channels, %s", mc->audio.ctx->sample_rate, mc->audio.ctx->ch_layout.nb_channels, av_get_sample_fmt_name(mc->audio.ctx->sample_fmt));
 
-	mc->format_mutex = SDL_CreateMutex();
+	if (!movie_shader.program)
+		load_movie_shader();
+
+	glGenTextures(3, mc->textures);
+	for (int i = 0; i < 3; i++) {
+		glBindTexture(GL_TEXTURE_2D, mc->textures[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	for (int i = 0; i < FRAME_QUEUE_SIZE; i++) {
+		mc->frames.frames[i] = av_frame_alloc();
+	}
+
+	mc->queue_mutex = SDL_CreateMutex();
+	mc->queue_cond = SDL_CreateCond();
 	mc->timer_mutex = SDL_CreateMutex();
 	mc->volume = 100;
 
-	preload_packets(mc);
+	// Start decoding right away so that frames are ready by the time
+	// the movie starts playing.
+	mc->demux_thread = SDL_CreateThread(demux_thread, "MovieDemux", mc);
+	mc->video_thread = SDL_CreateThread(video_thread, "MovieVideo", mc);
 	return mc;
 }
 
@@ -272,24 +533,37 @@ void movie_free(struct movie_context *mc)
 	if (mc->sts_stream.sample.data)
 		free(mc->sts_stream.sample.data);
 
+	if (mc->queue_mutex) {
+		SDL_LockMutex(mc->queue_mutex);
+		mc->quit = true;
+		SDL_CondBroadcast(mc->queue_cond);
+		SDL_UnlockMutex(mc->queue_mutex);
+	}
+	if (mc->demux_thread)
+		SDL_WaitThread(mc->demux_thread, NULL);
+	if (mc->video_thread)
+		SDL_WaitThread(mc->video_thread, NULL);
+
 	if (mc->format_ctx)
 		avformat_close_input(&mc->format_ctx);
-	if (mc->format_mutex)
-		SDL_DestroyMutex(mc->format_mutex);
+	if (mc->queue_mutex)
+		SDL_DestroyMutex(mc->queue_mutex);
+	if (mc->queue_cond)
+		SDL_DestroyCond(mc->queue_cond);
 	if (mc->timer_mutex)
 		SDL_DestroyMutex(mc->timer_mutex);
 
 	free_decoder(&mc->video);
 	free_decoder(&mc->audio);
 
-	if (mc->temp_surface.handle)
-		gfx_delete_texture(&mc->temp_surface);
+	for (int i = 0; i < FRAME_QUEUE_SIZE; i++) {
+		if (mc->frames.frames[i])
+			av_frame_free(&mc->frames.frames[i]);
+	}
+	if (mc->textures[0])
+		glDeleteTextures(3, mc->textures);
 	if (mc->sws_ctx)
 		sws_freeContext(mc->sws_ctx);
-	if (mc->sws_frame)
-		av_frame_free(&mc->sws_frame);
-	if (mc->sws_buf)
-		av_free(mc->sws_buf);
 
 	free(mc);
 }
@@ -323,57 +597,97 @@ bool movie_play(struct movie_context *mc)
 	return true;
 }
 
-bool movie_draw(struct movie_context *mc, struct sact_sprite *sprite)
+static double frame_time(struct movie_context *mc, AVFrame *frame)
 {
-	struct texture *texture;
-	if (sprite) {
-		texture = sprite_get_texture(sprite);
-	} else {
-		if (!mc->temp_surface.handle)
-			gfx_init_texture_blank(&mc->temp_surface, config.view_width, config.view_height);
-		texture = &mc->temp_surface;
-	}
+	return av_q2d(mc->video.stream->time_base) * frame->best_effort_timestamp;
+}
 
-	if (!mc->sws_ctx) {
-		mc->sws_ctx = sws_getContext(
-			mc->video.ctx->width, mc->video.ctx->height, mc->video.ctx->pix_fmt,
-			texture->w, texture->h, AV_PIX_FMT_RGBA, SWS_BICUBIC, NULL, NULL, NULL);
-		mc->sws_frame = av_frame_alloc();
-		int size = av_image_get_buffer_size(AV_PIX_FMT_RGBA, texture->w, texture->h, 1);
-		mc->sws_buf = av_malloc(size);
-		av_image_fill_arrays(
-			mc->sws_frame->data, mc->sws_frame->linesize,
-			mc->sws_buf, AV_PIX_FMT_RGBA, texture->w, texture->h, 1);
-	}
+/*
+ * Pop the frame at the head of the frame queue.
+ * Must be called with queue_mutex held.
+ */
+static void pop_frame(struct movie_context *mc)
+{
+	struct frame_queue *q = &mc->frames;
+	av_frame_unref(q->frames[q->head]);
+	q->head = (q->head + 1) % FRAME_QUEUE_SIZE;
+	q->count--;
+	SDL_CondBroadcast(mc->queue_cond);
+}
 
-	// Decode a frame, unless we already have one.
-	if (!mc->has_pending_video_frame && !decode_frame(&mc->video, mc))
-		return mc->video.finished;
+bool movie_draw(struct movie_context *mc, struct sact_sprite *sprite)
+{
+	struct frame_queue *q = &mc->frames;
 
-	// If the frame's timestamp is in the future, save the frame and return.
-	double pts = av_q2d(mc->video.stream->time_base) * mc->video.frame->best_effort_timestamp;
 	SDL_LockMutex(mc->timer_mutex);
 	double now = mc->stream_time + (SDL_GetTicks() - mc->wall_time_ms) / 1000.0;
 	SDL_UnlockMutex(mc->timer_mutex);
-	if (pts > now) {
-		mc->has_pending_video_frame = true;
-		// We have spare time, let's buffer some packets.
-		preload_packets(mc);
-		return true;
+
+	SDL_LockMutex(mc->queue_mutex);
+	if (q->count == 0) {
+		// Either the decoder is behind (keep showing the current frame)
+		// or the video is finished.
+		if (q->eof)
+			mc->video.finished = true;
+		bool error = q->error;
+		SDL_UnlockMutex(mc->queue_mutex);
+		return !error;
 	}
+	// Skip frames that are already late.
+	while (q->count > 1 && frame_time(mc, q->frames[(q->head + 1) % FRAME_QUEUE_SIZE]) <= now)
+		pop_frame(mc);
+	AVFrame *frame = q->frames[q->head];
+	SDL_UnlockMutex(mc->queue_mutex);
+
+	// If the frame's timestamp is in the future, keep it for later.
+	// The head frame is not touched by the decoder thread, so it's safe to
+	// read without holding the lock.
+	if (frame_time(mc, frame) > now)
+		return true;
 
-	// Convert to RGB and update the texture.
-	sws_scale(mc->sws_ctx, (const uint8_t **)mc->video.frame->data, mc->video.frame->linesize,
-		 0, mc->video.ctx->height, mc->sws_frame->data, mc->sws_frame->linesize);
-	gfx_update_texture_with_pixels(texture, mc->sws_buf);
-	mc->has_pending_video_frame = false;
+	// Upload the Y/Cb/Cr planes.
+	const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+	int cw = AV_CEIL_RSHIFT(frame->width, desc->log2_chroma_w);
+	int ch = AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h);
+	update_texture(GL_TEXTURE0, mc->textures[0], frame->width, frame->height, frame->data[0], frame->linesize[0]);
+	update_texture(GL_TEXTURE1, mc->textures[1], cw, ch, frame->data[1], frame->linesize[1]);
+	update_texture(GL_TEXTURE2, mc->textures[2], cw, ch, frame->data[2], frame->linesize[2]);
 
+	SDL_LockMutex(mc->queue_mutex);
+	pop_frame(mc);
+	SDL_UnlockMutex(mc->queue_mutex);
+
+	float w, h;
+	GLuint fbo;
 	if (sprite) {
-		sprite_dirty(sprite);
+		struct texture *texture = sprite_get_texture(sprite);
+		w = texture->w;
+		h = texture->h;
+		fbo = gfx_set_framebuffer(GL_DRAW_FRAMEBUFFER, texture, 0, 0, w, h);
 	} else {
 		// Draw directly to the main framebuffer.
+		w = config.view_width;
+		h = config.view_height;
 		gfx_clear();
-		gfx_render_texture(&mc->temp_surface, NULL);
+	}
+
+	mat4 world_transform = WORLD_TRANSFORM(w, h, 0, 0);
+	mat4 wv_transform = WV_TRANSFORM(w, h);
+
+	struct gfx_render_job job = {
+		.shader = &movie_shader,
+		.shape = GFX_RECTANGLE,
+		.texture = 0,
+		.world_transform = world_transform[0],
+		.view_transform = wv_transform[0],
+		.data = mc
+	};
+	gfx_render(&job);
+
+	if (sprite) {
+		gfx_reset_framebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+		sprite_dirty(sprite);
+	} else {
 		gfx_swap();
 	}
 
@@ -382,7 +696,10 @@ bool movie_draw(struct movie_context *mc, struct sact_sprite *sprite)
 
 bool movie_is_end(struct movie_context *mc)
 {
-	return mc->video.finished && mc->audio.finished;
+	SDL_LockMutex(mc->queue_mutex);
+	bool end = mc->video.finished && mc->audio.finished;
+	SDL_UnlockMutex(mc->queue_mutex);
+	return end;
 }
 
 int movie_get_position(struct movie_context *mc)
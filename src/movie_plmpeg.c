@@ -34,16 +34,64 @@
 #define PL_MPEG_IMPLEMENTATION
 #include "pl_mpeg.h"
 
+#define VIDEO_RING_SIZE 3
+#define AUDIO_RING_SIZE 16
+
 static Shader movie_shader;
 
+struct plane_buffer {
+	unsigned width, height;
+	size_t size;
+	uint8_t *data;
+};
+
+struct video_slot {
+	double time;
+	struct plane_buffer planes[3];  // Y, Cb, Cr
+};
+
+struct audio_slot {
+	double time;
+	float samples[PLM_AUDIO_SAMPLES_PER_FRAME * 2];
+};
+
+/*
+ * Decoded frames are passed from the decoder thread to the consumers (the VM
+ * thread for video, the mixer callback for audio) through these rings. Each
+ * slot is owned by the decoder thread while it is outside [head, head+count),
+ * and its buffers are reused from frame to frame.
+ */
+struct video_ring {
+	struct video_slot slots[VIDEO_RING_SIZE];
+	int head;
+	int count;
+	bool eof;
+	// Set along with eof if decoding stopped before the end of the stream.
+	bool error;
+};
+
+struct audio_ring {
+	struct audio_slot slots[AUDIO_RING_SIZE];
+	int head;
+	int count;
+	bool eof;
+};
+
 struct movie_context {
 	plm_t *plm;
-	SDL_mutex *decoder_mutex;
+	SDL_Thread *decoder_thread;
+
+	// Protects video, audio and quit.
+	SDL_mutex *ring_mutex;
+	SDL_cond *ring_cond;
+	bool quit;
+	struct video_ring video;
+	struct audio_ring audio;
 
-	plm_frame_t *pending_video_frame;
 	GLuint textures[3];  // Y, Cb, Cr
 
 	sts_mixer_stream_t sts_stream;
+	float audio_buf[PLM_AUDIO_SAMPLES_PER_FRAME * 2];
 	int voice;
 	int volume;
 
@@ -54,26 +102,129 @@ struct movie_context {
 	SDL_mutex *timer_mutex;
 };
 
+static void copy_plane(struct plane_buffer *dst, plm_plane_t *src)
+{
+	size_t size = (size_t)src->width * src->height;
+	if (size > dst->size) {
+		free(dst->data);
+		dst->data = xmalloc(size);
+		dst->size = size;
+	}
+	dst->width = src->width;
+	dst->height = src->height;
+	memcpy(dst->data, src->data, size);
+}
+
+/*
+ * Decoder thread. Keeps the video and audio rings filled.
+ */
+static int decoder_thread(void *data)
+{
+	struct movie_context *mc = data;
+	struct video_ring *video = &mc->video;
+	struct audio_ring *audio = &mc->audio;
+
+	while (true) {
+		SDL_LockMutex(mc->ring_mutex);
+		bool need_video, need_audio;
+		while (true) {
+			need_video = !video->eof && video->count < VIDEO_RING_SIZE;
+			need_audio = !audio->eof && audio->count < AUDIO_RING_SIZE;
+			if (mc->quit || need_video || need_audio || (video->eof && audio->eof))
+				break;
+			SDL_CondWait(mc->ring_cond, mc->ring_mutex);
+		}
+		if (mc->quit || (video->eof && audio->eof)) {
+			SDL_UnlockMutex(mc->ring_mutex);
+			break;
+		}
+		struct video_slot *vslot = &video->slots[(video->head + video->count) % VIDEO_RING_SIZE];
+		struct audio_slot *aslot = &audio->slots[(audio->head + audio->count) % AUDIO_RING_SIZE];
+		SDL_UnlockMutex(mc->ring_mutex);
+
+		bool video_eof = false, video_error = false, audio_eof = false;
+		if (need_video) {
+			plm_frame_t *frame = plm_decode_video(mc->plm);
+			if (frame) {
+				vslot->time = frame->time;
+				copy_plane(&vslot->planes[0], &frame->y);
+				copy_plane(&vslot->planes[1], &frame->cb);
+				copy_plane(&vslot->planes[2], &frame->cr);
+			} else {
+				video_eof = true;
+				video_error = !plm_video_has_ended(mc->plm->video_decoder);
+			}
+		}
+		if (need_audio) {
+			plm_samples_t *samples = plm_decode_audio(mc->plm);
+			if (samples) {
+				aslot->time = samples->time;
+				memcpy(aslot->samples, samples->interleaved, sizeof(aslot->samples));
+			} else {
+				audio_eof = true;
+			}
+		}
+
+		SDL_LockMutex(mc->ring_mutex);
+		if (need_video) {
+			if (video_eof) {
+				video->eof = true;
+				video->error = video_error;
+			}
+			else
+				video->count++;
+		}
+		if (need_audio) {
+			if (audio_eof)
+				audio->eof = true;
+			else
+				audio->count++;
+		}
+		SDL_CondBroadcast(mc->ring_cond);
+		SDL_UnlockMutex(mc->ring_mutex);
+	}
+	return 0;
+}
+
 static int audio_callback(sts_mixer_sample_t *sample, void *data)
 {
 	struct movie_context *mc = data;
+	struct audio_ring *audio = &mc->audio;
 	assert(sample == &mc->sts_stream.sample);
 
-	SDL_LockMutex(mc->decoder_mutex);
-	plm_samples_t *frame = plm_decode_audio(mc->plm);
-	SDL_UnlockMutex(mc->decoder_mutex);
-	if (!frame) {
-		sample->length = 0;
-		sample->data = NULL;
-		mc->voice = -1;
-		return STS_STREAM_COMPLETE;
+	sample->length = PLM_AUDIO_SAMPLES_PER_FRAME * 2;
+	sample->data = mc->audio_buf;
+
+	SDL_LockMutex(mc->ring_mutex);
+	if (audio->count == 0) {
+		bool eof = audio->eof;
+		SDL_UnlockMutex(mc->ring_mutex);
+		if (eof) {
+			sample->length = 0;
+			sample->data = NULL;
+			mc->voice = -1;
+			return STS_STREAM_COMPLETE;
+		}
+		// The decoder fell behind; play silence rather than blocking
+		// the audio thread.
+		memset(mc->audio_buf, 0, sizeof(mc->audio_buf));
+		return STS_STREAM_CONTINUE;
 	}
-	sample->length = frame->count * 2;
-	sample->data = frame->interleaved;
+	struct audio_slot *slot = &audio->slots[audio->head];
+	SDL_UnlockMutex(mc->ring_mutex);
 
-	// Update the timestamp.
+	memcpy(mc->audio_buf, slot->samples, sizeof(mc->audio_buf));
+	double time = slot->time;
+
+	SDL_LockMutex(mc->ring_mutex);
+	audio->head = (audio->head + 1) % AUDIO_RING_SIZE;
+	audio->count--;
+	SDL_CondBroadcast(mc->ring_cond);
+	SDL_UnlockMutex(mc->ring_mutex);
+
+	// Update the timestamp. Video is synchronized to this clock.
 	SDL_LockMutex(mc->timer_mutex);
-	mc->stream_time = frame->time;
+	mc->stream_time = time;
 	mc->wall_time_ms = SDL_GetTicks();
 	SDL_UnlockMutex(mc->timer_mutex);
 	return STS_STREAM_CONTINUE;
@@ -100,7 +251,7 @@ static void load_movie_shader()
 	movie_shader.prepare = prepare_movie_shader;
 }
 
-static void update_texture(GLuint unit, GLuint texture, plm_plane_t *plane)
+static void update_texture(GLuint unit, GLuint texture, struct plane_buffer *plane)
 {
 	glActiveTexture(unit);
 	glBindTexture(GL_TEXTURE_2D, texture);
@@ -146,9 +297,12 @@ struct movie_context *movie_load(const char *filename)
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	}
 
-	mc->decoder_mutex = SDL_CreateMutex();
+	mc->ring_mutex = SDL_CreateMutex();
+	mc->ring_cond = SDL_CreateCond();
 	mc->timer_mutex = SDL_CreateMutex();
 	mc->volume = 100;
+
+	mc->decoder_thread = SDL_CreateThread(decoder_thread, "MovieDecoder", mc);
 	return mc;
 }
 
@@ -157,12 +311,27 @@ void movie_free(struct movie_context *mc)
 	if (mc->voice >= 0)
 		mixer_stream_stop(mc->voice);
 
+	if (mc->decoder_thread) {
+		SDL_LockMutex(mc->ring_mutex);
+		mc->quit = true;
+		SDL_CondBroadcast(mc->ring_cond);
+		SDL_UnlockMutex(mc->ring_mutex);
+		SDL_WaitThread(mc->decoder_thread, NULL);
+	}
+
 	if (mc->plm)
 		plm_destroy(mc->plm);
 	if (mc->textures[0])
 		glDeleteTextures(3, mc->textures);
-	if (mc->decoder_mutex)
-		SDL_DestroyMutex(mc->decoder_mutex);
+	for (int i = 0; i < VIDEO_RING_SIZE; i++) {
+		for (int j = 0; j < 3; j++) {
+			free(mc->video.slots[i].planes[j].data);
+		}
+	}
+	if (mc->ring_mutex)
+		SDL_DestroyMutex(mc->ring_mutex);
+	if (mc->ring_cond)
+		SDL_DestroyCond(mc->ring_cond);
 	if (mc->timer_mutex)
 		SDL_DestroyMutex(mc->timer_mutex);
 	free(mc);
@@ -183,30 +352,43 @@ bool movie_play(struct movie_context *mc)
 
 bool movie_draw(struct movie_context *mc, struct sact_sprite *sprite)
 {
-	// Decode a frame, unless we already have one.
-	plm_frame_t *frame = mc->pending_video_frame;
-	mc->pending_video_frame = NULL;
-	if (!frame) {
-		SDL_LockMutex(mc->decoder_mutex);
-		frame = plm_decode_video(mc->plm);
-		SDL_UnlockMutex(mc->decoder_mutex);
-		if (!frame)
-			return plm_video_has_ended(mc->plm->video_decoder);
-	}
+	struct video_ring *video = &mc->video;
 
-	// If the frame's timestamp is in the future, save the frame and return.
 	SDL_LockMutex(mc->timer_mutex);
 	double now = mc->stream_time + (SDL_GetTicks() - mc->wall_time_ms) / 1000.0;
 	SDL_UnlockMutex(mc->timer_mutex);
-	if (frame->time > now) {
-		mc->pending_video_frame = frame;
-		return true;
+
+	SDL_LockMutex(mc->ring_mutex);
+	if (video->count == 0) {
+		// Either the decoder is behind (keep showing the current frame)
+		// or the video has ended.
+		bool error = video->error;
+		SDL_UnlockMutex(mc->ring_mutex);
+		return !error;
 	}
+	// Skip frames that are already late.
+	while (video->count > 1 && video->slots[(video->head + 1) % VIDEO_RING_SIZE].time <= now) {
+		video->head = (video->head + 1) % VIDEO_RING_SIZE;
+		video->count--;
+		SDL_CondBroadcast(mc->ring_cond);
+	}
+	struct video_slot *frame = &video->slots[video->head];
+	SDL_UnlockMutex(mc->ring_mutex);
+
+	// If the frame's timestamp is in the future, leave it in the ring.
+	if (frame->time > now)
+		return true;
 
 	// Render the frame.
-	update_texture(GL_TEXTURE0, mc->textures[0], &frame->y);
-	update_texture(GL_TEXTURE1, mc->textures[1], &frame->cb);
-	update_texture(GL_TEXTURE2, mc->textures[2], &frame->cr);
+	update_texture(GL_TEXTURE0, mc->textures[0], &frame->planes[0]);
+	update_texture(GL_TEXTURE1, mc->textures[1], &frame->planes[1]);
+	update_texture(GL_TEXTURE2, mc->textures[2], &frame->planes[2]);
+
+	SDL_LockMutex(mc->ring_mutex);
+	video->head = (video->head + 1) % VIDEO_RING_SIZE;
+	video->count--;
+	SDL_CondBroadcast(mc->ring_cond);
+	SDL_UnlockMutex(mc->ring_mutex);
 
 	float w, h;
 	GLuint fbo;
@@ -247,7 +429,10 @@ bool movie_draw(struct movie_context *mc, struct sact_sprite *sprite)
 
 bool movie_is_end(struct movie_context *mc)
 {
-	return plm_has_ended(mc->plm);
+	SDL_LockMutex(mc->ring_mutex);
+	bool ended = mc->video.eof && !mc->video.count && mc->audio.eof && !mc->audio.count;
+	SDL_UnlockMutex(mc->ring_mutex);
+	return ended;
 }
 
 int movie_get_position(struct movie_context *mc)
@@ -21,6 +21,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <SDL.h>
 #include "cJSON.h"
 
 #include "system4.h"
@@ -28,6 +29,7 @@
 #include "system4/savefile.h"
 #include "system4/string.h"
 
+#include "json_stream.h"
 #include "savedata.h"
 #include "vm.h"
 #include "vm/heap.h"
@@ -56,102 +58,108 @@ static enum page_type string_to_page_type(const char *str)
 	VM_ERROR("Invalid page type: %s", str);
 }
 
-static cJSON *value_to_json(union vm_value v)
+static void write_json_page(struct json_writer *w, struct page *page)
 {
-	return cJSON_CreateNumber(v.i);
-}
-
-static int get_number(int i, void *data)
-{
-	return ((union vm_value*)data)[i].i;
-}
-
-static cJSON *resume_page_to_json(struct page *page)
-{
-	if (!page)
-		return cJSON_CreateNull();
-
-	cJSON *json = cJSON_CreateObject();
-	cJSON_AddStringToObject(json, "type", page_type_strtab[page->type]);
-	cJSON_AddNumberToObject(json, "subtype", page->index);
-	if (page->type == ARRAY_PAGE) {
-		cJSON_AddNumberToObject(json, "struct-type", page->array.struct_type);
-		cJSON_AddNumberToObject(json, "rank", page->array.rank);
+	if (!page) {
+		json_write_null(w);
+		return;
 	}
 
-	cJSON *values = cJSON_CreateIntArray_cb(page->nr_vars, get_number, page->values);
-
-	cJSON_AddItemToObject(json, "values", values);
-	return json;
-}
-
-static cJSON *heap_item_to_json(int i, possibly_unused void *_)
-{
-	if (!heap[i].ref)
-		return NULL;
-
-	cJSON *item = cJSON_CreateArray();
-	cJSON_AddItemToArray(item, cJSON_CreateNumber(i));
-	cJSON_AddItemToArray(item, cJSON_CreateNumber(heap[i].ref));
-	switch (heap[i].type) {
-	case VM_PAGE:
-		cJSON_AddItemToArray(item, resume_page_to_json(heap[i].page));
-		break;
-	case VM_STRING:
-		cJSON_AddItemToArray(item, cJSON_CreateString(heap[i].s->text));
-		break;
+	json_write_begin_object(w);
+	json_write_key(w, "type");
+	json_write_string(w, page_type_strtab[page->type]);
+	json_write_key(w, "subtype");
+	json_write_int(w, page->index);
+	if (page->type == ARRAY_PAGE) {
+		json_write_key(w, "struct-type");
+		json_write_int(w, page->array.struct_type);
+		json_write_key(w, "rank");
+		json_write_int(w, page->array.rank);
 	}
-	if (ain->nr_delegates > 0) {
-		cJSON_AddItemToArray(item, cJSON_CreateNumber(heap[i].seq));
+	json_write_key(w, "values");
+	json_write_begin_array(w);
+	for (int i = 0; i < page->nr_vars; i++) {
+		json_write_int(w, page->values[i].i);
 	}
-	return item;
-}
-
-static cJSON *heap_to_json(void)
-{
-	return cJSON_CreateArray_cb(heap_size, heap_item_to_json, NULL);
+	json_write_end_array(w);
+	json_write_end_object(w);
 }
 
-static cJSON *funcall_to_json(struct function_call *call)
+static void write_json_heap(struct json_writer *w)
 {
-	cJSON *json = cJSON_CreateObject();
-	cJSON_AddNumberToObject(json, "function", call->fno);
-	cJSON_AddNumberToObject(json, "return-address", call->return_address);
-	cJSON_AddNumberToObject(json, "local-page", call->page_slot);
-	cJSON_AddNumberToObject(json, "struct-page", call->struct_page);
-	return json;
+	json_write_begin_array(w);
+	for (size_t i = 0; i < heap_size; i++) {
+		if (!heap[i].ref)
+			continue;
+		json_write_begin_array(w);
+		json_write_int(w, i);
+		json_write_int(w, heap[i].ref);
+		switch (heap[i].type) {
+		case VM_PAGE:
+			write_json_page(w, heap[i].page);
+			break;
+		case VM_STRING:
+			json_write_string(w, heap[i].s->text);
+			break;
+		}
+		if (ain->nr_delegates > 0) {
+			json_write_int(w, heap[i].seq);
+		}
+		json_write_end_array(w);
+	}
+	json_write_end_array(w);
 }
 
-static cJSON *call_stack_to_json(void)
+static void write_json_call_stack(struct json_writer *w)
 {
-	cJSON *json = cJSON_CreateArray();
+	json_write_begin_array(w);
 	for (int i = 0; i < call_stack_ptr; i++) {
-		cJSON_AddItemToArray(json, funcall_to_json(&call_stack[i]));
+		struct function_call *call = &call_stack[i];
+		json_write_begin_object(w);
+		json_write_key(w, "function");
+		json_write_int(w, call->fno);
+		json_write_key(w, "return-address");
+		json_write_int(w, call->return_address);
+		json_write_key(w, "local-page");
+		json_write_int(w, call->page_slot);
+		json_write_key(w, "struct-page");
+		json_write_int(w, call->struct_page);
+		json_write_end_object(w);
 	}
-	return json;
+	json_write_end_array(w);
 }
 
-static cJSON *stack_to_json(void)
+static void write_json_stack(struct json_writer *w)
 {
-	cJSON *json = cJSON_CreateArray();
+	json_write_begin_array(w);
 	for (int i = 0; i < stack_ptr; i++) {
-		cJSON_AddItemToArray(json, value_to_json(stack[i]));
+		json_write_int(w, stack[i].i);
 	}
-	return json;
+	json_write_end_array(w);
 }
 
-static cJSON *vm_image_to_json(const char *key)
+/*
+ * Write the VM image directly from the heap, without building a cJSON tree
+ * first. The output has the same structure as the cJSON representation.
+ */
+static void write_json_image(struct json_writer *w, const char *key)
 {
-	cJSON *image = cJSON_CreateObject();
-	cJSON_AddStringToObject(image, "key", key);
-	cJSON_AddItemToObject(image, "heap", heap_to_json());
-	cJSON_AddItemToObject(image, "call-stack", call_stack_to_json());
-	cJSON_AddItemToObject(image, "stack", stack_to_json());
-	cJSON_AddNumberToObject(image, "ip", instr_ptr);
+	json_write_begin_object(w);
+	json_write_key(w, "key");
+	json_write_string(w, key);
+	json_write_key(w, "heap");
+	write_json_heap(w);
+	json_write_key(w, "call-stack");
+	write_json_call_stack(w);
+	json_write_key(w, "stack");
+	write_json_stack(w);
+	json_write_key(w, "ip");
+	json_write_int(w, instr_ptr);
 	if (ain->nr_delegates > 0) {
-		cJSON_AddNumberToObject(image, "next_seq", heap_next_seq);
+		json_write_key(w, "next_seq");
+		json_write_int(w, heap_next_seq);
 	}
-	return image;
+	json_write_end_object(w);
 }
 
 static struct rsave_heap_frame *frame_page_to_rsave(struct page *page, int slot)
@@ -376,37 +384,132 @@ static struct rsave *vm_image_to_rsave(const char *key)
 	return save;
 }
 
+static FILE *open_rsave_file(const char *full_path)
+{
+	FILE *fp = file_open_utf8(full_path, "wb");
+	if (!fp)
+		WARNING("Failed to open save file %s: %s", display_utf0(full_path), strerror(errno));
+	return fp;
+}
+
+static void write_rsave_file(struct rsave *save, FILE *fp)
+{
+	bool encrypt = true;
+	int compression_level = config.save_compression_level >= 0 ? config.save_compression_level : 1;
+	enum savefile_error error = rsave_write(save, fp, encrypt, compression_level);
+	if (error != SAVEFILE_SUCCESS)
+		WARNING("Failed to write save file: %s", savefile_strerror(error));
+	fclose(fp);
+}
+
+/*
+ * Asynchronous saving.
+ *
+ * The VM image is copied into a struct rsave on the VM thread, which is cheap
+ * compared to compressing and writing it. The rsave owns all of its data, so
+ * the VM can keep running (and mutating the heap) while a worker thread
+ * encodes and writes the snapshot. The file itself is opened on the VM thread
+ * so that failing to open it is still reported to the caller. Only one save
+ * is in flight at a time; anything that touches save files waits for it
+ * first (see vm_wait_for_save).
+ */
+
+struct save_job {
+	struct rsave *save;
+	FILE *fp;
+};
+
+static SDL_Thread *save_thread = NULL;
+
+static int save_thread_main(void *data)
+{
+	struct save_job *job = data;
+	write_rsave_file(job->save, job->fp);
+	rsave_free(job->save);
+	free(job);
+	return 0;
+}
+
+void vm_wait_for_save(void)
+{
+	if (!save_thread)
+		return;
+	SDL_WaitThread(save_thread, NULL);
+	save_thread = NULL;
+}
+
+static bool start_save_thread(struct rsave *save, FILE *fp)
+{
+	static bool atexit_registered = false;
+	if (!atexit_registered) {
+		atexit(vm_wait_for_save);
+		atexit_registered = true;
+	}
+
+	struct save_job *job = xmalloc(sizeof(struct save_job));
+	job->save = save;
+	job->fp = fp;
+	save_thread = SDL_CreateThread(save_thread_main, "save", job);
+	if (!save_thread) {
+		WARNING("SDL_CreateThread failed: %s", SDL_GetError());
+		free(job);
+		return false;
+	}
+	return true;
+}
+
 static int save_rsave_image(const char *key, const char *path)
 {
+	// the previous save must finish before its file can be overwritten
+	vm_wait_for_save();
+
 	struct rsave *save = vm_image_to_rsave(key);
 	if (!save)
 		return 0;
 	char *full_path = savedir_path(path);
-	FILE *fp = file_open_utf8(full_path, "wb");
+	FILE *fp = open_rsave_file(full_path);
+	free(full_path);
 	if (!fp) {
-		WARNING("Failed to open save file %s: %s", display_utf0(full_path), strerror(errno));
-		free(full_path);
 		rsave_free(save);
 		return 0;
 	}
-	free(full_path);
 
-	bool encrypt = true;
-	int compression_level = 1;
-	enum savefile_error error = rsave_write(save, fp, encrypt, compression_level);
-	if (error != SAVEFILE_SUCCESS)
-		WARNING("Failed to write save file: %s", savefile_strerror(error));
-	fclose(fp);
+	if (config.save_async && start_save_thread(save, fp))
+		return 1;
+
+	write_rsave_file(save, fp);
 	rsave_free(save);
 	return 1;
 }
 
 static int save_json_image(const char *key, const char *path)
 {
-	cJSON *image = vm_image_to_json(key);
-	int r = save_json(path, image);
-	cJSON_Delete(image);
-	return r;
+	vm_wait_for_save();
+	char *full_path = savedir_path(path);
+	FILE *f = file_open_utf8(full_path, "w");
+	if (!f) {
+		WARNING("Failed to open save file: %s: %s", display_utf0(path), strerror(errno));
+		free(full_path);
+		return 0;
+	}
+	free(full_path);
+
+	struct json_writer *w = xmalloc(sizeof(struct json_writer));
+	json_writer_init(w, f);
+	write_json_image(w, key);
+	bool ok = json_writer_finish(w);
+	free(w);
+
+	if (!ok) {
+		WARNING("Failed to write save file: %s", strerror(errno));
+		fclose(f);
+		return 0;
+	}
+	if (fclose(f)) {
+		WARNING("Error writing save to file: %s: %s", display_utf0(path), strerror(errno));
+		return 0;
+	}
+	return 1;
 }
 
 int vm_save_image(const char *key, const char *path)
@@ -451,47 +554,6 @@ static cJSON *_type_check(const char *file, const char *func, int line, int type
 
 #define type_check(type, json) _type_check(__FILE__, __func__, __LINE__, type, json)
 
-static void load_json_page(int slot, cJSON *json)
-{
-	int struct_type = 0, rank = 0;
-
-	// unpack
-	cJSON *type    = type_check(cJSON_String, cJSON_GetObjectItem(json, "type"));
-	cJSON *subtype = type_check(cJSON_Number, cJSON_GetObjectItem(json, "subtype"));
-	cJSON *values  = type_check(cJSON_Array,  cJSON_GetObjectItem(json, "values"));
-
-	enum page_type page_type = string_to_page_type(cJSON_GetStringValue(type));
-	if (page_type == ARRAY_PAGE) {
-		cJSON *_struct_type = type_check(cJSON_Number, cJSON_GetObjectItem(json, "struct-type"));
-		cJSON *_rank        = type_check(cJSON_Number, cJSON_GetObjectItem(json, "rank"));
-		struct_type = _struct_type->valueint;
-		rank = _rank->valueint;
-	}
-
-	// allocate page
-	struct page *page = alloc_page(page_type, subtype->valueint, cJSON_GetArraySize(values));
-	page->array.struct_type = struct_type;
-	page->array.rank = rank;
-
-	// init page variables
-	int i = 0;
-	cJSON *item;
-	cJSON_ArrayForEach(item, values) {
-		page->values[i].i = item->valueint;
-		i++;
-	}
-
-	heap[slot].page = page;
-	heap[slot].type = VM_PAGE;
-}
-
-static void load_json_string(int slot, cJSON *json)
-{
-	const char *str = cJSON_GetStringValue(json);
-	heap[slot].s = make_string(str, strlen(str));
-	heap[slot].type = VM_STRING;
-}
-
 static void delete_heap(void)
 {
 	// free heap
@@ -533,38 +595,159 @@ static void alloc_heap_slot(int slot)
 	heap_free_ptr++;
 }
 
-static void load_json_heap(cJSON *json)
+/*
+ * Streaming JSON loader. Heap pages are filled directly from the file
+ * contents rather than via an intermediate cJSON tree.
+ */
+
+static void json_check(struct json_reader *r)
+{
+	if (r->error)
+		invalid_save_data("Malformed JSON");
+}
+
+static int json_expect_int(struct json_reader *r)
+{
+	int i;
+	if (!json_read_int(r, &i))
+		invalid_save_data("Expected number");
+	return i;
+}
+
+static const char *json_expect_string(struct json_reader *r, size_t *len)
+{
+	const char *s = json_read_string(r, len);
+	if (!s)
+		invalid_save_data("Expected string");
+	return s;
+}
+
+static void json_expect_object(struct json_reader *r)
 {
+	if (!json_read_begin_object(r))
+		invalid_save_data("Expected object");
+}
+
+static void json_expect_array(struct json_reader *r)
+{
+	if (!json_read_begin_array(r))
+		invalid_save_data("Expected array");
+}
+
+struct json_values {
+	union vm_value *values;
+	int nr_values;
+	int cap;
+};
+
+static void load_json_page(struct json_reader *r, int slot, struct json_values *tmp)
+{
+	enum page_type page_type = 0;
+	int subtype = 0, struct_type = 0, rank = 0;
+	bool have_type = false, have_subtype = false, have_values = false;
+	bool have_struct_type = false, have_rank = false;
+
+	const char *key;
+	json_expect_object(r);
+	while (json_read_object_next(r, &key)) {
+		if (!strcmp(key, "type")) {
+			page_type = string_to_page_type(json_expect_string(r, NULL));
+			have_type = true;
+		} else if (!strcmp(key, "subtype")) {
+			subtype = json_expect_int(r);
+			have_subtype = true;
+		} else if (!strcmp(key, "struct-type")) {
+			struct_type = json_expect_int(r);
+			have_struct_type = true;
+		} else if (!strcmp(key, "rank")) {
+			rank = json_expect_int(r);
+			have_rank = true;
+		} else if (!strcmp(key, "values")) {
+			tmp->nr_values = 0;
+			json_expect_array(r);
+			while (json_read_array_next(r)) {
+				if (tmp->nr_values == tmp->cap) {
+					tmp->cap = tmp->cap ? tmp->cap * 2 : 256;
+					tmp->values = xrealloc_array(tmp->values, tmp->nr_values, tmp->cap,
+							sizeof(union vm_value));
+				}
+				tmp->values[tmp->nr_values++].i = json_expect_int(r);
+			}
+			have_values = true;
+		} else {
+			json_skip_value(r);
+		}
+		json_check(r);
+	}
+	json_check(r);
+
+	if (!have_type || !have_subtype || !have_values)
+		invalid_save_data("Invalid page data");
+	if (page_type == ARRAY_PAGE && (!have_struct_type || !have_rank))
+		invalid_save_data("Invalid array page data");
+
+	struct page *page = alloc_page(page_type, subtype, tmp->nr_values);
+	page->array.struct_type = page_type == ARRAY_PAGE ? struct_type : 0;
+	page->array.rank = page_type == ARRAY_PAGE ? rank : 0;
+	memcpy(page->values, tmp->values, tmp->nr_values * sizeof(union vm_value));
+
+	heap[slot].page = page;
+	heap[slot].type = VM_PAGE;
+}
+
+static void load_json_heap(struct json_reader *r)
+{
+	struct json_values tmp = {0};
 	delete_heap();
 
-	cJSON *item;
-	cJSON_ArrayForEach(item, json) {
-		type_check(cJSON_Array, item);
-		if (cJSON_GetArraySize(item) < 3)
+	json_expect_array(r);
+	while (json_read_array_next(r)) {
+		json_expect_array(r);
+		if (!json_read_array_next(r))
+			invalid_save_data("Invalid heap data");
+		int slot = json_expect_int(r);
+		if (!json_read_array_next(r))
+			invalid_save_data("Invalid heap data");
+		int ref = json_expect_int(r);
+		if (!json_read_array_next(r))
 			invalid_save_data("Invalid heap data");
-
-		int slot = type_check(cJSON_Number, cJSON_GetArrayItem(item, 0))->valueint;
-		int ref  = type_check(cJSON_Number, cJSON_GetArrayItem(item, 1))->valueint;
-		cJSON *value = cJSON_GetArrayItem(item, 2);
-		int seq = ain->nr_delegates > 0
-			? type_check(cJSON_Number, cJSON_GetArrayItem(item, 3))->valueint
-			: slot;
 
 		alloc_heap_slot(slot);
 		heap[slot].ref = ref;
-		heap[slot].seq = seq;
-
-		if (cJSON_IsString(value)) {
-			load_json_string(slot, value);
-		} else if (cJSON_IsObject(value)) {
-			load_json_page(slot, value);
-		} else if (cJSON_IsNull(value)) {
+		heap[slot].seq = slot;
+
+		size_t len;
+		switch (json_reader_peek(r)) {
+		case JSON_TOKEN_STRING: {
+			const char *str = json_expect_string(r, &len);
+			heap[slot].s = make_string(str, len);
+			heap[slot].type = VM_STRING;
+			break;
+		}
+		case JSON_TOKEN_OBJECT:
+			load_json_page(r, slot, &tmp);
+			break;
+		case JSON_TOKEN_NULL:
+			json_read_null(r);
 			heap[slot].type = VM_PAGE;
 			heap[slot].page = NULL;
-		} else {
+			break;
+		default:
 			invalid_save_data("Invalid heap data");
 		}
+
+		if (ain->nr_delegates > 0) {
+			if (!json_read_array_next(r))
+				invalid_save_data("Invalid heap data");
+			heap[slot].seq = json_expect_int(r);
+		}
+		while (json_read_array_next(r)) {
+			json_skip_value(r);
+		}
+		json_check(r);
 	}
+	json_check(r);
+	free(tmp.values);
 }
 
 static int resolve_func_symbol(struct rsave_symbol *sym)
@@ -716,19 +899,38 @@ static void load_rsave_heap(struct rsave *save)
 	heap_next_seq = save->next_seq;
 }
 
-static void load_json_call_stack(cJSON *json)
+static void load_json_call_stack(struct json_reader *r)
 {
 	call_stack_ptr = 0;
-	cJSON *item;
-	cJSON_ArrayForEach(item, json) {
-		type_check(cJSON_Object, item);
-		call_stack[call_stack_ptr++] = (struct function_call) {
-			.fno            = type_check(cJSON_Number, cJSON_GetObjectItem(item, "function"))->valueint,
-			.return_address = type_check(cJSON_Number, cJSON_GetObjectItem(item, "return-address"))->valueint,
-			.page_slot      = type_check(cJSON_Number, cJSON_GetObjectItem(item, "local-page"))->valueint,
-			.struct_page    = type_check(cJSON_Number, cJSON_GetObjectItem(item, "struct-page"))->valueint,
-		};
+	json_expect_array(r);
+	while (json_read_array_next(r)) {
+		struct function_call call = {0};
+		unsigned fields = 0;
+		const char *key;
+		json_expect_object(r);
+		while (json_read_object_next(r, &key)) {
+			if (!strcmp(key, "function")) {
+				call.fno = json_expect_int(r);
+				fields |= 1;
+			} else if (!strcmp(key, "return-address")) {
+				call.return_address = json_expect_int(r);
+				fields |= 2;
+			} else if (!strcmp(key, "local-page")) {
+				call.page_slot = json_expect_int(r);
+				fields |= 4;
+			} else if (!strcmp(key, "struct-page")) {
+				call.struct_page = json_expect_int(r);
+				fields |= 8;
+			} else {
+				json_skip_value(r);
+			}
+		}
+		json_check(r);
+		if (fields != 0xF)
+			invalid_save_data("Invalid call stack data");
+		call_stack[call_stack_ptr++] = call;
 	}
+	json_check(r);
 }
 
 static void load_rsave_call_stack(struct rsave *save)
@@ -769,15 +971,15 @@ static void load_rsave_call_stack(struct rsave *save)
 	instr_ptr = return_address - 6;
 }
 
-static void load_json_stack(cJSON *json)
+static void load_json_stack(struct json_reader *r)
 {
 	stack_ptr = 0;
 
-	cJSON *item;
-	cJSON_ArrayForEach(item, json) {
-		type_check(cJSON_Number, item);
-		stack_push_value(vm_int(item->valueint));
+	json_expect_array(r);
+	while (json_read_array_next(r)) {
+		stack_push_value(vm_int(json_expect_int(r)));
 	}
+	json_check(r);
 	// Pop the arguments of SYS_RESUME_SAVE.
 	//heap_unref(stack_pop().i);
 	//heap_unref(stack_pop().i);
@@ -816,22 +1018,67 @@ static cJSON *read_json_image(const char *keyname, const char *path)
 
 static void load_json_image(const char *key, const char *path)
 {
-	cJSON *save = read_json_image(key, path);
-	if (!save) {
+	char *full_path = savedir_path(path);
+	FILE *f = file_open_utf8(full_path, "rb");
+	free(full_path);
+	if (!f) {
 		VM_ERROR("Failed to read VM image: '%s'", display_sjis0(path));
 	}
-	cJSON *ip = type_check(cJSON_Number, cJSON_GetObjectItem(save, "ip"));
-	load_json_heap(type_check(cJSON_Array, cJSON_GetObjectItem(save, "heap")));
-	load_json_call_stack(type_check(cJSON_Array, cJSON_GetObjectItem(save, "call-stack")));
-	load_json_stack(type_check(cJSON_Array, cJSON_GetObjectItem(save, "stack")));
-	instr_ptr = ip->valueint;
+
+	struct json_reader r;
+	json_reader_init_file(&r, f);
+
+	// "ip" and "next_seq" are applied last so that member order doesn't matter
+	int ip = 0, next_seq = 0;
+	bool have_key = false, have_heap = false, have_call_stack = false;
+	bool have_stack = false, have_ip = false, have_next_seq = false;
+
+	const char *name;
+	json_expect_object(&r);
+	while (json_read_object_next(&r, &name)) {
+		if (!strcmp(name, "key")) {
+			if (strcmp(key, json_expect_string(&r, NULL)))
+				invalid_save_data("Key doesn't match");
+			have_key = true;
+			continue;
+		}
+		// The key must be checked before the current VM state is replaced.
+		if (!have_key)
+			invalid_save_data("Missing key");
+		if (!strcmp(name, "heap")) {
+			load_json_heap(&r);
+			have_heap = true;
+		} else if (!strcmp(name, "call-stack")) {
+			load_json_call_stack(&r);
+			have_call_stack = true;
+		} else if (!strcmp(name, "stack")) {
+			load_json_stack(&r);
+			have_stack = true;
+		} else if (!strcmp(name, "ip")) {
+			ip = json_expect_int(&r);
+			have_ip = true;
+		} else if (!strcmp(name, "next_seq")) {
+			next_seq = json_expect_int(&r);
+			have_next_seq = true;
+		} else {
+			json_skip_value(&r);
+		}
+		json_check(&r);
+	}
+	json_check(&r);
+	json_reader_fini(&r);
+	fclose(f);
+
+	if (!have_key || !have_heap || !have_call_stack || !have_stack || !have_ip)
+		invalid_save_data("Incomplete VM image");
+	instr_ptr = ip;
 	if (ain->nr_delegates > 0) {
-		cJSON *next_seq = type_check(cJSON_Number, cJSON_GetObjectItem(save, "next_seq"));
-		heap_next_seq = next_seq->valueint;
+		if (!have_next_seq)
+			invalid_save_data("Missing next_seq");
+		heap_next_seq = next_seq;
 	} else {
 		heap_next_seq = heap_size;
 	}
-	cJSON_Delete(save);
 }
 
 static enum savefile_error load_rsave_image(const char *key, const char *path)
@@ -853,6 +1100,8 @@ static enum savefile_error load_rsave_image(const char *key, const char *path)
 
 void vm_load_image(const char *key, const char *path)
 {
+	vm_wait_for_save();
+
 	// First, try to read as a rsave.
 	enum savefile_error error = load_rsave_image(key, path);
 	switch (error) {
@@ -934,6 +1183,8 @@ static struct page *load_rsave_image_comments(const char *key, const char *path,
 
 struct page *vm_load_image_comments(const char *key, const char *path, int *success)
 {
+	vm_wait_for_save();
+
 	// First, try to read as a rsave.
 	enum savefile_error error;
 	struct page *page = load_rsave_image_comments(key, path, &error);
@@ -984,21 +1235,13 @@ static int write_rsave_image_comments(const char *key, const char *path, struct
 		save->comments[i] = xstrdup(heap_get_string(comments->values[i].i)->text);
 	}
 
-	FILE *fp = file_open_utf8(full_path, "wb");
+	FILE *fp = open_rsave_file(full_path);
+	free(full_path);
 	if (!fp) {
-		WARNING("Failed to open save file %s: %s", display_utf0(full_path), strerror(errno));
-		free(full_path);
 		rsave_free(save);
 		return 0;
 	}
-	free(full_path);
-
-	bool encrypt = true;
-	int compression_level = 1;
-	error = rsave_write(save, fp, encrypt, compression_level);
-	if (error != SAVEFILE_SUCCESS)
-		WARNING("Failed to write save file: %s", savefile_strerror(error));
-	fclose(fp);
+	write_rsave_file(save, fp);
 	rsave_free(save);
 	return 1;
 }
@@ -1028,6 +1271,8 @@ static int write_json_image_comments(const char *key, const char *path, struct p
 
 int vm_write_image_comments(const char *key, const char *path, struct page *comments)
 {
+	vm_wait_for_save();
+
 	switch (config.save_format) {
 	case SAVE_FORMAT_RSM:
 		return write_rsave_image_comments(key, path, comments);
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/stat.h>
 #include "cJSON.h"
 
 #include "system4.h"
@@ -44,6 +45,7 @@ static int current_global;
 
 int save_json(const char *filename, cJSON *json)
 {
+	vm_wait_for_save();
 	char *path = savedir_path(filename);
 	FILE *f = file_open_utf8(path, "w");
 	if (!f) {
@@ -71,6 +73,7 @@ int save_json(const char *filename, cJSON *json)
 
 cJSON *load_json(const char *filename)
 {
+	vm_wait_for_save();
 	char *path = savedir_path(filename);
 	char *json = file_read(path, NULL);
 	free(path);
@@ -183,6 +186,167 @@ static int32_t add_value_to_gsave(enum ain_data_type type, union vm_value val, s
 	}
 }
 
+/*
+ * Fingerprints of the last data written to each gsave file.
+ *
+ * Games often call save_globals for a group whose contents haven't changed
+ * since the last save (e.g. system settings on every scene change). Pages
+ * reachable from globals are modified through generic page stores that don't
+ * know which global (if any) they belong to, so instead of tracking dirty
+ * globals we hash the reachable data, which is much cheaper than building,
+ * compressing and writing a gsave, and skip the write if nothing changed.
+ */
+
+struct gsave_fingerprint {
+	char *path;
+	uint64_t hash;
+	// the file's size and mtime after it was written, to detect other writers
+	off_t size;
+	time_t mtime;
+};
+
+static struct gsave_fingerprint *fingerprints = NULL;
+static int nr_fingerprints = 0;
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static uint64_t hash_bytes(uint64_t h, const void *data, size_t size)
+{
+	const uint8_t *p = data;
+	for (size_t i = 0; i < size; i++) {
+		h = (h ^ p[i]) * FNV_PRIME;
+	}
+	return h;
+}
+
+static uint64_t hash_int(uint64_t h, int32_t v)
+{
+	return hash_bytes(h, &v, sizeof(v));
+}
+
+static uint64_t hash_value(uint64_t h, enum ain_data_type type, union vm_value val);
+
+static uint64_t hash_array(uint64_t h, struct page *page)
+{
+	if (!page)
+		return hash_int(h, -1);
+	h = hash_int(h, page->array.rank);
+	h = hash_int(h, page->nr_vars);
+	if (page->array.rank > 1) {
+		for (int i = 0; i < page->nr_vars; i++) {
+			h = hash_array(h, heap_get_page(page->values[i].i));
+		}
+	} else if (page->nr_vars > 0) {
+		enum ain_data_type type = variable_type(page, 0, NULL, NULL);
+		h = hash_int(h, type);
+		for (int i = 0; i < page->nr_vars; i++) {
+			h = hash_value(h, type, page->values[i]);
+		}
+	}
+	return h;
+}
+
+static uint64_t hash_value(uint64_t h, enum ain_data_type type, union vm_value val)
+{
+	switch (type) {
+	case AIN_VOID:
+	case AIN_INT:
+	case AIN_BOOL:
+	case AIN_FUNC_TYPE:
+	case AIN_DELEGATE:
+	case AIN_LONG_INT:
+	case AIN_FLOAT:
+		return hash_int(h, val.i);
+	case AIN_STRING:
+		{
+			struct string *s = heap[val.i].s;
+			h = hash_int(h, s->size);
+			return hash_bytes(h, s->text, s->size);
+		}
+	case AIN_STRUCT:
+		{
+			struct page *page = heap_get_page(val.i);
+			if (!page)
+				return hash_int(h, -1);
+			struct ain_struct *st = &ain->structures[page->index];
+			h = hash_int(h, page->index);
+			for (int i = 0; i < page->nr_vars; i++) {
+				h = hash_value(h, st->members[i].type.data, page->values[i]);
+			}
+			return h;
+		}
+	case AIN_ARRAY_TYPE:
+		return hash_array(h, heap_get_page(val.i));
+	default:
+		return h;
+	}
+}
+
+static uint64_t globals_fingerprint(const char *keyname, const char *group_name, int group)
+{
+	uint64_t h = FNV_OFFSET_BASIS;
+	h = hash_bytes(h, keyname, strlen(keyname) + 1);
+	if (group_name)
+		h = hash_bytes(h, group_name, strlen(group_name) + 1);
+	for (int i = 0; i < ain->nr_globals; i++) {
+		if (group >= 0 && ain->globals[i].group_index != group)
+			continue;
+		h = hash_int(h, i);
+		h = hash_value(h, ain->globals[i].type.data, global_get(i));
+	}
+	return h;
+}
+
+static struct gsave_fingerprint *get_fingerprint(const char *path)
+{
+	for (int i = 0; i < nr_fingerprints; i++) {
+		if (!strcmp(fingerprints[i].path, path))
+			return &fingerprints[i];
+	}
+	return NULL;
+}
+
+void savedata_invalidate_file(const char *path)
+{
+	struct gsave_fingerprint *fp = get_fingerprint(path);
+	if (!fp)
+		return;
+	free(fp->path);
+	*fp = fingerprints[--nr_fingerprints];
+}
+
+static void set_fingerprint(const char *path, uint64_t hash)
+{
+	ustat s;
+	if (stat_utf8(path, &s) < 0) {
+		savedata_invalidate_file(path);
+		return;
+	}
+
+	struct gsave_fingerprint *fp = get_fingerprint(path);
+	if (!fp) {
+		fingerprints = xrealloc_array(fingerprints, nr_fingerprints, nr_fingerprints + 1,
+				sizeof(struct gsave_fingerprint));
+		fp = &fingerprints[nr_fingerprints++];
+		fp->path = xstrdup(path);
+	}
+	fp->hash = hash;
+	fp->size = s.st_size;
+	fp->mtime = s.st_mtime;
+}
+
+static bool fingerprint_matches(const char *path, uint64_t hash)
+{
+	struct gsave_fingerprint *fp = get_fingerprint(path);
+	if (!fp || fp->hash != hash)
+		return false;
+	ustat s;
+	if (stat_utf8(path, &s) < 0)
+		return false;
+	return s.st_size == fp->size && s.st_mtime == fp->mtime;
+}
+
 static int get_gsave_version(void)
 {
 	if (AIN_VERSION_GTE(ain, 6, 0)) {
@@ -209,6 +373,17 @@ int save_globals(const char *keyname, const char *filename, const char *group_na
 		nr_vars = ain->nr_globals;
 	}
 
+	// skip the write if the file already holds this exact data
+	vm_wait_for_save();
+	char *path = savedir_path(filename);
+	uint64_t hash = globals_fingerprint(keyname, group_name, group);
+	if (fingerprint_matches(path, hash)) {
+		free(path);
+		if (n_out)
+			*n_out = nr_vars;
+		return 1;
+	}
+
 	struct gsave *save = gsave_create(get_gsave_version(), keyname, ain->nr_globals, group_name);
 	gsave_add_globals_record(save, nr_vars);
 
@@ -222,23 +397,29 @@ int save_globals(const char *keyname, const char *filename, const char *group_na
 		global++;
 	}
 
-	char *path = savedir_path(filename);
 	FILE *fp = file_open_utf8(path, "wb");
 	if (!fp) {
 		WARNING("Failed to open save file %s: %s", display_utf0(path), strerror(errno));
+		savedata_invalidate_file(path);
 		free(path);
 		gsave_free(save);
 		return 0;
 	}
-	free(path);
 
 	bool encrypt = !AIN_VERSION_GTE(ain, 6, 0);
 	int compression_level = AIN_VERSION_GTE(ain, 6, 0) ? 1 : 9;
+	if (config.save_compression_level >= 0)
+		compression_level = config.save_compression_level;
 	enum savefile_error error = gsave_write(save, fp, encrypt, compression_level);
 	if (error != SAVEFILE_SUCCESS)
 		WARNING("Failed to write save file: %s", savefile_strerror(error));
 	fclose(fp);
 	gsave_free(save);
+	if (error == SAVEFILE_SUCCESS)
+		set_fingerprint(path, hash);
+	else
+		savedata_invalidate_file(path);
+	free(path);
 	if (n_out)
 		*n_out = nr_vars;
 	return error == SAVEFILE_SUCCESS;
@@ -566,6 +747,7 @@ int load_globals_from_gsave(struct gsave *save, const char *keyname, const char
 
 int load_globals(const char *keyname, const char *filename, const char *group_name, int *n)
 {
+	vm_wait_for_save();
 	char *path = savedir_path(filename);
 	int retval;
 
@@ -592,7 +774,9 @@ int load_globals(const char *keyname, const char *filename, const char *group_na
 
 int delete_save_file(const char *filename)
 {
+	vm_wait_for_save();
 	char *path = savedir_path(filename);
+	savedata_invalidate_file(path);
 	if (!file_exists(path)) {
 		free(path);
 		return 0;
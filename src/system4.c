@@ -59,11 +59,17 @@ struct config config = {
 	.mixer_nr_channels = 0,
 	.mixer_channels = NULL,
 	.default_volume = 100,
+	.audio_buffer_size = 0,
+	.audio_low_latency = false,
+	.audio_stats = false,
+	.audio_capture_path = NULL,
 	.joypad = false,
 	.echo = false,
 	.text_x_scale = 1.0,
 	.manual_text_x_scale = false,
 	.save_format = SAVE_FORMAT_RSM,
+	.save_async = false,
+	.save_compression_level = -1,
 	.msgskip_delay = 0,
 
 	.bgi_path = NULL,
@@ -71,6 +77,7 @@ struct config config = {
 	.ex_path = NULL,
 	.fnl_path = NULL,
 	.font_paths = { NULL, NULL },
+	.glyph_cache = false,
 };
 
 static struct string *ini_string(struct ini_entry *entry)
@@ -181,6 +188,8 @@ static void read_user_config_file(const char *path)
 				config.manual_text_x_scale = true;
 				config.text_x_scale = f;
 			}
+		} else if (!strcmp(ini[i].name->text, "glyph-cache")) {
+			config.glyph_cache = ini_boolean(&ini[i]);
 		} else if (!strcmp(ini[i].name->text, "msgskip-delay")) {
 			config.msgskip_delay = ini_integer(&ini[i]);
 			if (config.msgskip_delay < 0) {
@@ -188,6 +197,17 @@ static void read_user_config_file(const char *path)
 						ini_string(&ini[i])->text);
 				config.msgskip_delay = 0;
 			}
+		} else if (!strcmp(ini[i].name->text, "audio-buffer-size")) {
+			config.audio_buffer_size = ini_integer(&ini[i]);
+			if (config.audio_buffer_size < 0) {
+				WARNING("Invalid value for audio-buffer-size in config: %d",
+						config.audio_buffer_size);
+				config.audio_buffer_size = 0;
+			}
+		} else if (!strcmp(ini[i].name->text, "low-latency-audio")) {
+			config.audio_low_latency = ini_boolean(&ini[i]);
+		} else if (!strcmp(ini[i].name->text, "audio-stats")) {
+			config.audio_stats = ini_boolean(&ini[i]);
 		} else if (!strcmp(ini[i].name->text, "save-folder")) {
 			free(config.save_dir);
 			config.save_dir = xstrdup(ini_string(&ini[i])->text);
@@ -200,6 +220,15 @@ static void read_user_config_file(const char *path)
 				WARNING("Invalid value for save-format in config: \"%s\"",
 						ini_string(&ini[i])->text);
 			}
+		} else if (!strcmp(ini[i].name->text, "async-save")) {
+			config.save_async = ini_boolean(&ini[i]);
+		} else if (!strcmp(ini[i].name->text, "save-compression-level")) {
+			int level = ini_integer(&ini[i]);
+			if (level < 0 || level > 9) {
+				WARNING("Invalid value for save-compression-level in config: %d", level);
+			} else {
+				config.save_compression_level = level;
+			}
 		}
 		ini_free_entry(&ini[i]);
 	}
@@ -367,10 +396,18 @@ static void usage(void)
 	puts("        --font-gothic    Specify the path to the gothic font to use");
 	puts("        --font-fnl       Specify the path to a .fnl font library to use");
 	puts("        --font-x-scale   Specify the x scale for text rendering (1.0 = default scale)");
+	puts("        --glyph-cache    Keep rasterized glyphs in a cache that persists across runs");
+	puts("        --prewarm-glyphs Add all characters in the game's text to the glyph cache and exit");
 	puts("    -j, --joypad         Enable joypad");
 	puts("        --msgskip-delay  Specify the delay in ms to add when skipping messages with CTRL");
 	puts("        --save-folder    Override save folder location");
 	puts("        --save-format    Specify the resume save file format. json (default) or rsm");
+	puts("        --async-save     Write resume saves on a background thread");
+	puts("        --save-compression  Specify the zlib level (0-9) for save files");
+	puts("        --audio-buffer   Specify the audio device buffer size in sample frames");
+	puts("        --low-latency-audio  Mix sub-mixers in place to reduce audio latency");
+	puts("        --audio-stats    Log audio performance statistics every second");
+	puts("        --audio-capture  Record the audio output to the specified WAV file");
 #ifdef DEBUGGER_ENABLED
 	puts("        --nodebug        Disable debugger");
 	puts("        --debug          Start in debugger");
@@ -398,10 +435,18 @@ enum {
 	LOPT_FONT_GOTHIC,
 	LOPT_FONT_FNL,
 	LOPT_FONT_X_SCALE,
+	LOPT_GLYPH_CACHE,
+	LOPT_PREWARM_GLYPHS,
 	LOPT_JOYPAD,
 	LOPT_MSGSKIP_DELAY,
 	LOPT_SAVE_FOLDER,
 	LOPT_SAVE_FORMAT,
+	LOPT_ASYNC_SAVE,
+	LOPT_SAVE_COMPRESSION,
+	LOPT_AUDIO_BUFFER,
+	LOPT_LOW_LATENCY_AUDIO,
+	LOPT_AUDIO_STATS,
+	LOPT_AUDIO_CAPTURE,
 #ifdef DEBUGGER_ENABLED
 	LOPT_NODEBUG,
 	LOPT_DEBUG,
@@ -429,6 +474,13 @@ int main(int argc, char *argv[])
 	char *joypad = NULL;
 	char *savedir = NULL;
 	char *debug_info_path = NULL;
+	int audio_buffer = 0;
+	bool low_latency_audio = false;
+	bool audio_stats = false;
+	bool async_save = false;
+	bool glyph_cache = false;
+	bool prewarm_glyphs = false;
+	int save_compression = -1;
 
 	while (1) {
 		static struct option long_options[] = {
@@ -440,10 +492,18 @@ int main(int argc, char *argv[])
 			{ "font-gothic",   required_argument, 0, LOPT_FONT_GOTHIC },
 			{ "font-fnl",      required_argument, 0, LOPT_FONT_FNL },
 			{ "font-x-scale",  required_argument, 0, LOPT_FONT_X_SCALE },
+			{ "glyph-cache",   no_argument,       0, LOPT_GLYPH_CACHE },
+			{ "prewarm-glyphs", no_argument,      0, LOPT_PREWARM_GLYPHS },
 			{ "joypad",        optional_argument, 0, LOPT_JOYPAD },
 			{ "msgskip-delay", required_argument, 0, LOPT_MSGSKIP_DELAY },
 			{ "save-folder",   required_argument, 0, LOPT_SAVE_FOLDER },
 			{ "save-format",   required_argument, 0, LOPT_SAVE_FORMAT },
+			{ "async-save",    no_argument,       0, LOPT_ASYNC_SAVE },
+			{ "save-compression", required_argument, 0, LOPT_SAVE_COMPRESSION },
+			{ "audio-buffer",  required_argument, 0, LOPT_AUDIO_BUFFER },
+			{ "low-latency-audio", no_argument,   0, LOPT_LOW_LATENCY_AUDIO },
+			{ "audio-stats",   no_argument,       0, LOPT_AUDIO_STATS },
+			{ "audio-capture", required_argument, 0, LOPT_AUDIO_CAPTURE },
 #ifdef DEBUGGER_ENABLED
 			{ "nodebug",       no_argument,       0, LOPT_NODEBUG },
 			{ "debug",         no_argument,       0, LOPT_DEBUG },
@@ -492,6 +552,12 @@ int main(int argc, char *argv[])
 				config.text_x_scale = 1.0;
 			}
 			break;
+		case LOPT_GLYPH_CACHE:
+			glyph_cache = true;
+			break;
+		case LOPT_PREWARM_GLYPHS:
+			prewarm_glyphs = true;
+			break;
 		case 'j':
 		case LOPT_JOYPAD:
 			joypad = optarg ? optarg : "on";
@@ -515,6 +581,36 @@ int main(int argc, char *argv[])
 				WARNING("Invalid value for --save-format option: \"%s\"", optarg);
 			}
 			break;
+		case LOPT_ASYNC_SAVE:
+			async_save = true;
+			break;
+		case LOPT_SAVE_COMPRESSION: {
+			char *end;
+			long level = strtol(optarg, &end, 10);
+			if (end == optarg || *end || level < 0 || level > 9) {
+				WARNING("Invalid value for --save-compression: \"%s\"", optarg);
+				save_compression = -1;
+			} else {
+				save_compression = level;
+			}
+			break;
+		}
+		case LOPT_AUDIO_BUFFER:
+			audio_buffer = atoi(optarg);
+			if (audio_buffer <= 0) {
+				WARNING("Invalid value for --audio-buffer: \"%s\"", optarg);
+				audio_buffer = 0;
+			}
+			break;
+		case LOPT_LOW_LATENCY_AUDIO:
+			low_latency_audio = true;
+			break;
+		case LOPT_AUDIO_STATS:
+			audio_stats = true;
+			break;
+		case LOPT_AUDIO_CAPTURE:
+			config.audio_capture_path = optarg;
+			break;
 #ifdef DEBUGGER_ENABLED
 		case LOPT_NODEBUG:
 			dbg_enabled = false;
@@ -577,6 +673,18 @@ int main(int argc, char *argv[])
 		free(config.save_dir);
 		config.save_dir = strdup(savedir);
 	}
+	if (audio_buffer)
+		config.audio_buffer_size = audio_buffer;
+	if (low_latency_audio)
+		config.audio_low_latency = true;
+	if (audio_stats)
+		config.audio_stats = true;
+	if (async_save)
+		config.save_async = true;
+	if (glyph_cache || prewarm_glyphs)
+		config.glyph_cache = true;
+	if (save_compression >= 0)
+		config.save_compression_level = save_compression;
 
 	if (!(ain = ain_open(ainfile, &err))) {
 		ERROR("%s", ain_strerror(err));
@@ -590,6 +698,11 @@ int main(int argc, char *argv[])
 
 	mkdir_p(config.save_dir);
 	apply_game_specific_hacks(ain);
+	if (prewarm_glyphs) {
+		gfx_prewarm_glyph_cache(ain);
+		ain_free(ain);
+		return 0;
+	}
 	if (config.msgskip_delay)
 		set_msgskip_delay(ain, config.msgskip_delay);
 	asset_manager_init();
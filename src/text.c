@@ -15,6 +15,7 @@
  */
 
 #include "system4.h"
+#include "system4/ain.h"
 #include "system4/fnl.h"
 #include "system4/hashtable.h"
 #include "system4/string.h"
@@ -58,16 +59,22 @@ static struct font *load_font(enum font_face type)
 		[FONT_MINCHO] = XSYS4_DATA_DIR "/" DEFAULT_FONT_MINCHO
 	};
 
-	struct font *font;
-	// user specified font
-	if (config.font_paths[type] && (font = ft_font_load(config.font_paths[type])))
-		return font;
-	// installed default font
-	if ((font = ft_font_load(default_font_paths[type])))
-		return font;
-	// local default font
-	if ((font = ft_font_load(local_font_paths[type])))
-		return font;
+	const char *paths[] = {
+		// user specified font
+		config.font_paths[type],
+		// installed default font
+		default_font_paths[type],
+		// local default font
+		local_font_paths[type],
+	};
+	for (int i = 0; i < 3; i++) {
+		struct font *font;
+		if (paths[i] && (font = ft_font_load(paths[i]))) {
+			if (config.glyph_cache)
+				font->cache = glyph_cache_open(paths[i], 0, font->render_key);
+			return font;
+		}
+	}
 	ERROR("Failed to load %s font", type == FONT_GOTHIC ? "gothic" : "mincho");
 }
 
@@ -89,6 +96,9 @@ void gfx_font_init(void)
 			ERROR("No fonts in .fnl font library '%s'", config.fnl_path);
 		for (unsigned i = 0; i < fnl->nr_fonts && i < MAX_FNL_FONTS; i++) {
 			font_fnl[i] = fnl_font_load(fnl, i);
+			if (font_fnl[i] && config.glyph_cache)
+				font_fnl[i]->cache = glyph_cache_open(config.fnl_path, i,
+						font_fnl[i]->render_key);
 		}
 	}
 	font_initialized = true;
@@ -124,6 +134,8 @@ static struct font_size *text_style_font_size(struct text_style *ts)
 
 static struct glyph *font_get_glyph(struct font_size *size, uint32_t code, enum font_weight weight)
 {
+	if (size->font->touch_size)
+		size->font->touch_size(size);
 	if (!size->glyph_table)
 		size->glyph_table = ht_create(4096);
 	// return cached glyph if available
@@ -133,10 +145,45 @@ static struct glyph *font_get_glyph(struct font_size *size, uint32_t code, enum
 	// alloc if necessary
 	if (!slot->value)
 		slot->value = xcalloc(1, sizeof(struct glyph));
-	// render glyph
-	if (!size->font->get_glyph(size, slot->value, code, weight))
-		return NULL;
-	return slot->value;
+	struct glyph *glyph = slot->value;
+
+	// load from the persistent cache, or render glyph
+	struct glyph_bitmap bitmap;
+	struct glyph_cache *cache = size->font->cache;
+	bool cached = cache && glyph_cache_get(cache, size->size, code, weight, &bitmap);
+	if (!cached) {
+		if (!size->font->get_glyph(size, &bitmap, code, weight))
+			return NULL;
+		if (cache)
+			glyph_cache_put(cache, size->size, code, weight, &bitmap);
+	}
+
+	gfx_init_texture_rmap(&glyph->t[weight], bitmap.width, bitmap.height, bitmap.pixels);
+	glyph->rect = bitmap.rect;
+	glyph->advance = bitmap.advance;
+	if (!cached)
+		free(bitmap.pixels);
+	return glyph;
+}
+
+static void free_glyph(void *_glyph)
+{
+	struct glyph *glyph = _glyph;
+	if (!glyph)
+		return;
+	for (int i = 0; i < NR_FONT_WEIGHTS; i++) {
+		gfx_delete_texture(&glyph->t[i]);
+	}
+	free(glyph);
+}
+
+void gfx_font_size_free_glyphs(struct font_size *size)
+{
+	if (!size->glyph_table)
+		return;
+	ht_foreach_value(size->glyph_table, free_glyph);
+	ht_free_int(size->glyph_table);
+	size->glyph_table = NULL;
 }
 
 static float font_size_char(struct font_size *size, uint32_t code)
@@ -185,6 +232,69 @@ float gfx_size_text(struct text_style *ts, const char *text)
 	return x;
 }
 
+struct prewarm_data {
+	struct font *font;
+	struct ain *ain;
+	unsigned nr_glyphs;
+};
+
+static void prewarm_text(struct font_size *size, enum font_weight weight, const char *text,
+		unsigned *nr_glyphs)
+{
+	struct glyph_cache *cache = size->font->cache;
+	struct glyph_bitmap bitmap;
+	while (*text) {
+		uint32_t code = char_to_code(text, size->font->charmap);
+		text = sjis_skip_char(text);
+		if (glyph_cache_get(cache, size->size, code, weight, &bitmap))
+			continue;
+		if (!size->font->get_glyph(size, &bitmap, code, weight))
+			continue;
+		glyph_cache_put(cache, size->size, code, weight, &bitmap);
+		free(bitmap.pixels);
+		(*nr_glyphs)++;
+	}
+}
+
+static void prewarm_size(float size, enum font_weight weight, void *_data)
+{
+	struct prewarm_data *data = _data;
+	struct font_size *font_size = data->font->get_size(data->font, size);
+	for (int i = 0; i < data->ain->nr_strings; i++) {
+		prewarm_text(font_size, weight, data->ain->strings[i]->text, &data->nr_glyphs);
+	}
+	for (int i = 0; i < data->ain->nr_messages; i++) {
+		prewarm_text(font_size, weight, data->ain->messages[i]->text, &data->nr_glyphs);
+	}
+}
+
+/*
+ * Rasterize every character in the AIN's string and message tables into the
+ * persistent glyph cache, for each size/weight combination that the cache
+ * has seen in earlier runs.
+ */
+void gfx_prewarm_glyph_cache(struct ain *ain)
+{
+	gfx_font_init();
+
+	struct font *fonts[2 + MAX_FNL_FONTS];
+	int nr_fonts = 0;
+	fonts[nr_fonts++] = font_ttf[FONT_GOTHIC];
+	fonts[nr_fonts++] = font_ttf[FONT_MINCHO];
+	for (int i = 0; i < MAX_FNL_FONTS; i++) {
+		if (font_fnl[i])
+			fonts[nr_fonts++] = font_fnl[i];
+	}
+
+	for (int i = 0; i < nr_fonts; i++) {
+		if (!fonts[i]->cache)
+			continue;
+		struct prewarm_data data = { .font = fonts[i], .ain = ain };
+		glyph_cache_foreach_size(fonts[i]->cache, prewarm_size, &data);
+		NOTICE("Glyph cache: rasterized %u glyphs for font %d", data.nr_glyphs, i);
+	}
+}
+
 float gfx_get_actual_font_size(unsigned face, float size)
 {
 	struct font *font = get_font(face);
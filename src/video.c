@@ -674,6 +674,22 @@ void gfx_copy_main_surface(struct texture *dst)
 	glCopyTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 0, 0, main_surface.w, main_surface.h, 0);
 }
 
+/*
+ * Like gfx_copy_main_surface, but `dst` must be either zero-initialized or a
+ * texture previously filled by this function. Its storage is reused if the
+ * size of the main surface hasn't changed.
+ */
+void gfx_recopy_main_surface(struct texture *dst)
+{
+	if (dst->handle && dst->w == main_surface.w && dst->h == main_surface.h) {
+		glBindTexture(GL_TEXTURE_2D, dst->handle);
+		glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, main_surface.w, main_surface.h);
+		return;
+	}
+	gfx_delete_texture(dst);
+	gfx_copy_main_surface(dst);
+}
+
 void gfx_delete_texture(struct texture *t)
 {
 	if (t->handle)
@@ -621,6 +621,7 @@ static void system_call(enum syscall_code code)
 	}
 	case SYS_EXISTS_SAVE_FILE: {
 		int slot = stack_pop().i;
+		vm_wait_for_save();
 		char *path = savedir_path(heap_get_string(slot)->text);
 		stack_push(file_exists(path));
 		heap_unref(slot);
@@ -712,8 +713,10 @@ static void system_call(enum syscall_code code)
 	case SYS_COPY_SAVE_FILE: { // system.CopySaveFile(string szDestFileName, string szSourceFileName)
 		int src = stack_pop().i;
 		int dst = stack_pop().i;
+		vm_wait_for_save();
 		char *u_src = savedir_path(heap_get_string(src)->text);
 		char *u_dst = savedir_path(heap_get_string(dst)->text);
+		savedata_invalidate_file(u_dst);
 		stack_push(file_copy(u_src, u_dst));
 		free(u_src);
 		free(u_dst);
@@ -0,0 +1,175 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include "system4/string.h"
+
+#include "gfx/font.h"
+#include "vm/heap.h"
+#include "vm/page.h"
+#include "../../src/hll/CharSpriteManager.h"
+#include "gl_bench.h"
+
+/*
+ * Creates NR_SPRITES character sprites and times CharSprite_SetChar, then a
+ * save/load/rebuild cycle as after loading a save file.
+ *
+ * Sprites are created twice: once as message text, where the characters
+ * come from a small set and share their textures, and once with a distinct
+ * style per sprite, so that every sprite renders its own texture as they
+ * all did before textures were shared.
+ *
+ * Usage: bench_charsprite
+ */
+
+#define NR_SPRITES 5000
+#define NR_CHARS 100
+
+static int handles[NR_SPRITES];
+static struct string *chars[NR_CHARS];
+
+// ASCII letters and hiragana, as SJIS
+static void init_chars(void)
+{
+	for (int i = 0; i < NR_CHARS; i++) {
+		char buf[3] = {0};
+		if (i < 26) {
+			buf[0] = 'A' + i;
+		} else {
+			buf[0] = 0x82;
+			buf[1] = 0x9f + (i - 26);
+		}
+		chars[i] = make_string(buf, strlen(buf));
+	}
+}
+
+static int alloc_color(int r, int g, int b, int a)
+{
+	struct page *page = alloc_page(STRUCT_PAGE, 0, 4);
+	page->values[0].i = r;
+	page->values[1].i = g;
+	page->values[2].i = b;
+	page->values[3].i = a;
+	return heap_alloc_page(page);
+}
+
+// CASCharSpriteProperty
+static struct page *alloc_property(int size, int r, int g, int b)
+{
+	struct page *page = alloc_page(STRUCT_PAGE, 0, 6);
+	page->values[0].i = FONT_GOTHIC;
+	page->values[1].i = size;
+	page->values[2].i = alloc_color(r, g, b, 255);
+	page->values[3].f = 1.0f;
+	page->values[4].f = 1.0f;
+	page->values[5].i = alloc_color(0, 0, 0, 255);
+	return page;
+}
+
+// Colors are freed by hand: heap_unref would call the struct's destructor,
+// which needs an ain file.
+static void free_color(int slot)
+{
+	free_page(heap_get_page(slot));
+	heap_set_page(slot, NULL);
+	heap_unref(slot);
+}
+
+static void free_property(struct page *page)
+{
+	free_color(page->values[2].i);
+	free_color(page->values[5].i);
+	free_page(page);
+}
+
+static int text_char(int i)
+{
+	return (i * 7) % NR_CHARS;
+}
+
+static void check_chars(void)
+{
+	int nr_wrong = 0;
+	for (int i = 0; i < NR_SPRITES; i += 97) {
+		struct string *s = NULL;
+		CharSprite_GetChar(handles[i], &s);
+		nr_wrong += strcmp(s->text, chars[text_char(i)]->text) != 0;
+		free_string(s);
+	}
+	TEST_EQUAL(nr_wrong, 0);
+}
+
+static void bench_create(const char *name, bool unique)
+{
+	struct page *text_property = alloc_property(32, 255, 255, 255);
+	double start = gl_now();
+	for (int i = 0; i < NR_SPRITES; i++) {
+		handles[i] = CharSpriteManager_CreateHandle();
+		struct page *property = text_property;
+		if (unique)
+			property = alloc_property(16 + i % 32, i & 0xff, (i >> 8) & 0xff, 255);
+		CharSprite_SetChar(handles[i], &chars[text_char(i)], &property);
+		CharSprite_SetPos(handles[i], (i % 40) * 32, (i / 40) % 22 * 32);
+		CharSprite_SetShow(handles[i], true);
+		if (unique)
+			free_property(property);
+	}
+	double t_create = gl_now() - start;
+	free_property(text_property);
+
+	struct page *save = NULL;
+	start = gl_now();
+	TEST_ASSERT(CharSpriteManager_Save(&save));
+	double t_save = now() - start;
+
+	start = now();
+	TEST_ASSERT(CharSpriteManager_Load(&save));
+	double t_load = now() - start;
+
+	start = now();
+	CharSpriteManager_Rebuild();
+	double t_rebuild = gl_now() - start;
+	// handles are kept across the rebuild
+	check_chars();
+
+	start = now();
+	CharSpriteManager_Clear();
+	double t_clear = gl_now() - start;
+
+	printf("%-8s  %8.1f  %6.1f  %6.1f  %8.1f  %6.1f\n", name, t_create * 1e3, t_save * 1e3,
+	       t_load * 1e3, t_rebuild * 1e3, t_clear * 1e3);
+
+	delete_page_vars(save);
+	free_page(save);
+}
+
+int main(int argc, char *argv[])
+{
+	gl_bench_init(1280, 720);
+	gfx_font_init();
+	heap_init();
+	init_chars();
+
+	printf("%d sprites; milliseconds\n", NR_SPRITES);
+	printf("            create    save    load   rebuild   clear\n");
+	// render a few glyphs first, so that font loading isn't counted
+	bench_create("warmup", false);
+	bench_create("text", false);
+	bench_create("unique", true);
+
+	for (int i = 0; i < NR_CHARS; i++)
+		free_string(chars[i]);
+	return test_finish("charsprite bench");
+}
@@ -0,0 +1,92 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include "effect.h"
+#include "gl_bench.h"
+
+/*
+ * Runs every transition in enum effect for nr_frames (default 60) frames at
+ * 1280x720 and reports the setup time and the time per frame. The setup time
+ * of the first shader-based transition includes compiling all of the effect
+ * shaders.
+ * Unimplemented transitions fall back to EFFECT_BLUR_CROSSFADE.
+ *
+ * Before that, compares copying the main surface into a new texture for
+ * every frame (what transitions used to do) against reusing one texture.
+ *
+ * Usage: bench_effect [nr_frames]
+ */
+
+#define WIDTH 1280
+#define HEIGHT 720
+
+static void bench_copy(int nr_frames)
+{
+	struct texture t = {0};
+	double start = gl_now();
+	for (int i = 0; i < nr_frames; i++) {
+		gfx_copy_main_surface(&t);
+		gfx_delete_texture(&t);
+	}
+	double t_alloc = (gl_now() - start) / nr_frames * 1e3;
+
+	start = gl_now();
+	for (int i = 0; i < nr_frames; i++) {
+		gfx_recopy_main_surface(&t);
+	}
+	double t_reuse = (gl_now() - start) / nr_frames * 1e3;
+	gfx_delete_texture(&t);
+
+	printf("main surface copy: %.3f ms allocating, %.3f ms reusing\n", t_alloc, t_reuse);
+}
+
+static void bench_effects(int nr_frames)
+{
+	Texture *main_surface = gfx_main_surface();
+	printf("%-28s  setup ms  ms/frame\n", "effect");
+	for (int type = 1; type < NR_EFFECTS; type++) {
+		if (!effect_names[type])
+			continue;
+		// the old scene is red, the new one blue
+		gfx_fill(main_surface, 0, 0, WIDTH, HEIGHT, 255, 0, 0);
+		double start = gl_now();
+		TEST_ASSERT(effect_init(type));
+		double t_init = gl_now() - start;
+		gfx_fill(main_surface, 0, 0, WIDTH, HEIGHT, 0, 0, 255);
+
+		start = gl_now();
+		for (int i = 0; i < nr_frames; i++) {
+			effect_update((float)(i + 1) / nr_frames);
+		}
+		double t_frame = (gl_now() - start) / nr_frames;
+		effect_fini();
+
+		printf("%-28s  %8.2f  %8.3f\n", effect_names[type], t_init * 1e3, t_frame * 1e3);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int nr_frames = argc > 1 ? atoi(argv[1]) : 60;
+	if (nr_frames <= 0)
+		nr_frames = 60;
+	gl_bench_init(WIDTH, HEIGHT);
+	bench_copy(nr_frames);
+	bench_effects(nr_frames);
+	return test_finish("effect bench");
+}
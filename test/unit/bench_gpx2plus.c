@@ -0,0 +1,195 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include "vm.h"
+#include "gl_bench.h"
+
+/*
+ * Creates and frees NR_SURFACES Gpx2Plus surfaces, then reads pixels back
+ * from a filled surface with GetPixsel.
+ *
+ * Pixels are read from a PixelOnly surface, which answers from a CPU copy,
+ * and from a regular surface, which reads each pixel from the GPU. Both are
+ * filled identically, so the pixels read must be equal.
+ *
+ * The Gpx2Plus functions are static, so they are looked up by name in the
+ * library's export table, as the VM does.
+ *
+ * Usage: bench_gpx2plus
+ */
+
+#define NR_SURFACES 10000
+#define NR_READS 100000
+#define MAP_SIZE 256
+
+extern struct static_library lib_Gpx2Plus;
+
+static void (*Init)(void *imainsystem, struct string *link_file_name);
+static int (*Create)(int width, int height, int bpp);
+static int (*CreatePixelOnly)(int width, int height, int bpp);
+static void (*Free)(int surface);
+static void (*FreeAll)(void);
+static int (*GetPixsel)(int surface, int x, int y);
+static void (*Fill)(int surface, int x, int y, int width, int height, int r, int g, int b);
+
+static void *get_function(const char *name)
+{
+	for (int i = 0; lib_Gpx2Plus.functions[i].name; i++) {
+		if (!strcmp(lib_Gpx2Plus.functions[i].name, name))
+			return lib_Gpx2Plus.functions[i].fun;
+	}
+	fprintf(stderr, "Gpx2Plus.%s not found\n", name);
+	exit(1);
+}
+
+static void init_functions(void)
+{
+	Init = get_function("Init");
+	Create = get_function("Create");
+	CreatePixelOnly = get_function("CreatePixelOnly");
+	Free = get_function("Free");
+	FreeAll = get_function("FreeAll");
+	GetPixsel = get_function("GetPixsel");
+	Fill = get_function("Fill");
+}
+
+static uint32_t rng = 2463534242;
+
+static uint32_t rand32(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+static int surfaces[NR_SURFACES];
+
+static void bench_create_free(void)
+{
+	double start = gl_now();
+	for (int i = 0; i < NR_SURFACES; i++) {
+		surfaces[i] = Create(64, 64, 32);
+	}
+	double t_create = gl_now() - start;
+	// the main surface is 0; new surfaces are numbered from 1 up
+	TEST_EQUAL(surfaces[0], 1);
+	TEST_EQUAL(surfaces[NR_SURFACES-1], NR_SURFACES);
+
+	// free every other surface and create them again; the freed numbers
+	// are reused, lowest first
+	start = gl_now();
+	for (int i = 0; i < NR_SURFACES; i += 2) {
+		Free(surfaces[i]);
+	}
+	for (int i = 0; i < NR_SURFACES; i += 2) {
+		surfaces[i] = Create(64, 64, 32);
+	}
+	double t_churn = gl_now() - start;
+	TEST_EQUAL(surfaces[0], 1);
+	TEST_EQUAL(surfaces[NR_SURFACES-2], NR_SURFACES-1);
+
+	start = gl_now();
+	for (int i = 0; i < NR_SURFACES; i++) {
+		Free(surfaces[i]);
+	}
+	double t_free = gl_now() - start;
+
+	// surfaces that are drawn to get a texture
+	for (int i = 0; i < NR_SURFACES; i++) {
+		surfaces[i] = Create(64, 64, 32);
+		Fill(surfaces[i], 0, 0, 64, 64, i & 0xff, 0, 0);
+	}
+	start = gl_now();
+	FreeAll();
+	double t_free_all = gl_now() - start;
+	TEST_EQUAL(Create(64, 64, 32), 1);
+	FreeAll();
+
+	printf("%d surfaces; milliseconds\n", NR_SURFACES);
+	printf("create %.2f, free and recreate half %.2f, free %.2f, FreeAll with textures %.2f\n",
+	       t_create * 1e3, t_churn * 1e3, t_free * 1e3, t_free_all * 1e3);
+}
+
+// a lookup map of 16x16 blocks
+static void fill_map(int sf)
+{
+	for (int y = 0; y < MAP_SIZE; y += 16) {
+		for (int x = 0; x < MAP_SIZE; x += 16) {
+			Fill(sf, x, y, 16, 16, x, y, (x ^ y) & 0xff);
+		}
+	}
+}
+
+static double read_pixels(int sf, const uint32_t *coords, int nr_reads, int *sum)
+{
+	double start = gl_now();
+	int s = 0;
+	for (int i = 0; i < nr_reads; i++) {
+		s += GetPixsel(sf, coords[i] % MAP_SIZE, coords[i] / MAP_SIZE % MAP_SIZE);
+	}
+	*sum = s;
+	return gl_now() - start;
+}
+
+static void bench_pixels(void)
+{
+	uint32_t *coords = xmalloc(NR_READS * sizeof(uint32_t));
+	for (int i = 0; i < NR_READS; i++) {
+		coords[i] = rand32();
+	}
+
+	int pixel_only = CreatePixelOnly(MAP_SIZE, MAP_SIZE, 32);
+	int regular = Create(MAP_SIZE, MAP_SIZE, 32);
+	fill_map(pixel_only);
+	fill_map(regular);
+
+	int sum_cpu, sum_gpu;
+	double t_cpu = read_pixels(pixel_only, coords, NR_READS, &sum_cpu);
+	// reads from the GPU are slow; time a tenth of them
+	double t_gpu = read_pixels(regular, coords, NR_READS / 10, &sum_gpu) * 10;
+
+	int nr_different = 0;
+	for (int i = 0; i < 1000; i++) {
+		int x = coords[i] % MAP_SIZE, y = coords[i] / MAP_SIZE % MAP_SIZE;
+		nr_different += GetPixsel(pixel_only, x, y) != GetPixsel(regular, x, y);
+	}
+	TEST_EQUAL(nr_different, 0);
+	TEST_EQUAL(GetPixsel(pixel_only, 17, 33), 16 << 16 | 32 << 8 | (16 ^ 32));
+
+	// drawing to the surface drops the CPU copy
+	Fill(pixel_only, 0, 0, MAP_SIZE, MAP_SIZE, 1, 2, 3);
+	TEST_EQUAL(GetPixsel(pixel_only, 17, 33), 1 << 16 | 2 << 8 | 3);
+
+	printf("%d GetPixsel on %dx%d; milliseconds\n", NR_READS, MAP_SIZE, MAP_SIZE);
+	printf("PixelOnly (CPU copy) %.2f, regular (GPU read) %.2f\n", t_cpu * 1e3, t_gpu * 1e3);
+
+	Free(pixel_only);
+	Free(regular);
+	free(coords);
+}
+
+int main(int argc, char *argv[])
+{
+	gl_bench_init(800, 600);
+	init_functions();
+	Init(NULL, NULL);
+	bench_create_free();
+	bench_pixels();
+	return test_finish("gpx2plus bench");
+}
@@ -0,0 +1,285 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include "gl_bench.h"
+
+/*
+ * Draws NR_PARTICLES rain lines, snowflakes and ripple rings per frame, as
+ * DrawRain, DrawSnow and DrawRipple do, and reports the time per frame with
+ * one draw per particle (the old path, copied below for ripples) and with
+ * one instanced draw per frame.
+ *
+ * Ripples are also checked: every pixel of the rings the old CPU rasterizer
+ * drew must be covered by the rings the ellipse shader draws.
+ *
+ * Usage: bench_particles [nr_frames]
+ */
+
+#define WIDTH 1280
+#define HEIGHT 720
+#define NR_PARTICLES 10000
+
+static struct gfx_instance instances[NR_PARTICLES];
+
+static uint32_t rng = 88675123;
+
+static uint32_t rand32(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+static void print_result(const char *name, double t_old, double t_new, int nr_frames)
+{
+	printf("%-8s  %12.2f  %10.2f\n", name, t_old / nr_frames * 1e3, t_new / nr_frames * 1e3);
+}
+
+static void random_lines(void)
+{
+	for (int i = 0; i < NR_PARTICLES; i++) {
+		int x1 = rand32() % WIDTH;
+		int y1 = rand32() % HEIGHT;
+		int len = rand32() % 40;
+		instances[i] = (struct gfx_instance) {
+			.x = x1, .y = y1, .w = len / 4, .h = -len,
+			.a = (128 + rand32() % 128) / 255.f
+		};
+	}
+}
+
+static void bench_rain(int nr_frames)
+{
+	struct texture dst;
+	gfx_init_texture_rgba(&dst, WIDTH, HEIGHT, (SDL_Color){255, 255, 255, 0});
+
+	double t_old = 0, t_new = 0;
+	for (int frame = 0; frame < nr_frames; frame++) {
+		random_lines();
+		double start = gl_now();
+		gfx_fill_amap(&dst, 0, 0, WIDTH, HEIGHT, 0);
+		for (int i = 0; i < NR_PARTICLES; i++) {
+			struct gfx_instance *l = &instances[i];
+			gfx_draw_line_to_amap(&dst, l->x, l->y, l->x + l->w, l->y + l->h, l->a * 255.f + 0.5f);
+		}
+		t_old += gl_now() - start;
+
+		start = gl_now();
+		gfx_fill_amap(&dst, 0, 0, WIDTH, HEIGHT, 0);
+		gfx_draw_lines_to_amap_instanced(&dst, instances, NR_PARTICLES);
+		t_new += gl_now() - start;
+	}
+	print_result("rain", t_old, t_new, nr_frames);
+	gfx_delete_texture(&dst);
+}
+
+static void random_flakes(void)
+{
+	for (int i = 0; i < NR_PARTICLES; i++) {
+		int size = 4 + rand32() % 28;
+		instances[i] = (struct gfx_instance) {
+			.x = (int)(rand32() % WIDTH) - size / 2,
+			.y = (int)(rand32() % HEIGHT) - size / 2,
+			.w = size,
+			.h = size
+		};
+	}
+}
+
+static void bench_snow(int nr_frames, bool amap)
+{
+	struct texture flake;
+	gfx_init_texture_rgba(&flake, 16, 16, (SDL_Color){255, 255, 255, 192});
+	Texture *dst = gfx_main_surface();
+
+	double t_old = 0, t_new = 0;
+	for (int frame = 0; frame < nr_frames; frame++) {
+		random_flakes();
+		double start = gl_now();
+		for (int i = 0; i < NR_PARTICLES; i++) {
+			struct gfx_instance *r = &instances[i];
+			if (amap)
+				gfx_copy_stretch_blend_amap(dst, r->x, r->y, r->w, r->h, &flake, 0, 0, 16, 16);
+			else
+				gfx_copy_stretch_blend_screen(dst, r->x, r->y, r->w, r->h, &flake, 0, 0, 16, 16);
+		}
+		t_old += gl_now() - start;
+
+		start = gl_now();
+		if (amap)
+			gfx_copy_stretch_blend_amap_instanced(dst, &flake, instances, NR_PARTICLES);
+		else
+			gfx_copy_stretch_blend_screen_instanced(dst, &flake, instances, NR_PARTICLES);
+		t_new += gl_now() - start;
+	}
+	print_result(amap ? "snow (a)" : "snow", t_old, t_new, nr_frames);
+	gfx_delete_texture(&flake);
+}
+
+static void ref_draw_point(uint32_t *pixels, int w, int h, int x, int y)
+{
+	if (x < 0 || x >= w || y < 0 || y >= h)
+		return;
+	pixels[y * w + x] = 0xffffffff;
+}
+
+// the old DrawRipple rasterizer (midpoint ellipse algorithm)
+static void ref_draw_ellipse(uint32_t *pixels, int dst_w, int dst_h, int cx, int cy, int rx, int ry)
+{
+	if (rx == 0 || ry == 0)
+		return;
+	const int rx2 = rx * rx;
+	const int ry2 = ry * ry;
+	int x = 0;
+	int y = ry;
+	int px = 0;
+	int py = 2 * rx2 * y;
+
+	// Region 1
+	int p = ry2 - (rx2 * ry) + (0.25 * rx2);
+	while (px < py) {
+		ref_draw_point(pixels, dst_w, dst_h, cx + x, cy + y);
+		ref_draw_point(pixels, dst_w, dst_h, cx - x, cy + y);
+		ref_draw_point(pixels, dst_w, dst_h, cx + x, cy - y);
+		ref_draw_point(pixels, dst_w, dst_h, cx - x, cy - y);
+		x++;
+		px += 2 * ry2;
+		if (p < 0) {
+			p += ry2 + px;
+		} else {
+			y--;
+			py -= 2 * rx2;
+			p += ry2 + px - py;
+		}
+	}
+
+	// Region 2
+	p = ry2 * (x + 0.5) * (x + 0.5) + rx2 * (y - 1) * (y - 1) - rx2 * ry2;
+	while (y > 0) {
+		ref_draw_point(pixels, dst_w, dst_h, cx + x, cy + y);
+		ref_draw_point(pixels, dst_w, dst_h, cx - x, cy + y);
+		ref_draw_point(pixels, dst_w, dst_h, cx + x, cy - y);
+		ref_draw_point(pixels, dst_w, dst_h, cx - x, cy - y);
+		y--;
+		py -= 2 * rx2;
+		if (p > 0) {
+			p += rx2 - py;
+		} else {
+			x++;
+			px += 2 * ry2;
+			p += rx2 - py + px;
+		}
+	}
+	ref_draw_point(pixels, dst_w, dst_h, cx + rx, cy);
+	ref_draw_point(pixels, dst_w, dst_h, cx - rx, cy);
+}
+
+static void ref_draw_ripples(struct texture *dst, int n)
+{
+	uint32_t *pixels = xcalloc(dst->w * dst->h, 4);
+	for (int i = 0; i < n; i++) {
+		struct gfx_instance *e = &instances[i];
+		ref_draw_ellipse(pixels, dst->w, dst->h, e->x, e->y, e->w, e->h);
+	}
+	gfx_update_texture_with_pixels(dst, pixels);
+	free(pixels);
+}
+
+static void draw_ripples(struct texture *dst, int n)
+{
+	gfx_fill_with_alpha(dst, 0, 0, dst->w, dst->h, 0, 0, 0, 0);
+	gfx_draw_ellipses_instanced(dst, instances, n);
+}
+
+static void random_ripples(void)
+{
+	for (int i = 0; i < NR_PARTICLES; i++) {
+		instances[i] = (struct gfx_instance) {
+			.x = rand32() % WIDTH, .y = rand32() % HEIGHT,
+			.w = 1 + rand32() % 120, .h = 1 + rand32() % 40,
+			.r = 1.f, .g = 1.f, .b = 1.f, .a = 1.f
+		};
+	}
+}
+
+// Every pixel of the old rings must be set in the new rings. Only a few
+// ripples are drawn, so that the check isn't passed by rings overlapping.
+static void test_ripples(void)
+{
+	struct texture old, new;
+	gfx_init_texture_rgba(&old, WIDTH, HEIGHT, (SDL_Color){0, 0, 0, 0});
+	gfx_init_texture_rgba(&new, WIDTH, HEIGHT, (SDL_Color){0, 0, 0, 0});
+	random_ripples();
+	ref_draw_ripples(&old, 50);
+	draw_ripples(&new, 50);
+
+	uint8_t *old_pixels = gfx_get_pixels(&old);
+	uint8_t *new_pixels = gfx_get_pixels(&new);
+	int nr_old = 0, nr_missing = 0;
+	for (int i = 0; i < WIDTH * HEIGHT; i++) {
+		if (!old_pixels[i*4 + 3])
+			continue;
+		nr_old++;
+		nr_missing += !new_pixels[i*4 + 3];
+	}
+	TEST_ASSERT(nr_old > 0);
+	TEST_EQUAL(nr_missing, 0);
+	free(old_pixels);
+	free(new_pixels);
+	gfx_delete_texture(&old);
+	gfx_delete_texture(&new);
+}
+
+static void bench_ripple(int nr_frames)
+{
+	struct texture dst;
+	gfx_init_texture_rgba(&dst, WIDTH, HEIGHT, (SDL_Color){0, 0, 0, 0});
+
+	double t_old = 0, t_new = 0;
+	for (int frame = 0; frame < nr_frames; frame++) {
+		random_ripples();
+		double start = gl_now();
+		ref_draw_ripples(&dst, NR_PARTICLES);
+		t_old += gl_now() - start;
+
+		start = gl_now();
+		draw_ripples(&dst, NR_PARTICLES);
+		t_new += gl_now() - start;
+	}
+	print_result("ripple", t_old, t_new, nr_frames);
+	gfx_delete_texture(&dst);
+}
+
+int main(int argc, char *argv[])
+{
+	int nr_frames = argc > 1 ? atoi(argv[1]) : 30;
+	if (nr_frames <= 0)
+		nr_frames = 30;
+	gl_bench_init(WIDTH, HEIGHT);
+
+	test_ripples();
+
+	printf("%d particles at %dx%d; milliseconds per frame\n", NR_PARTICLES, WIDTH, HEIGHT);
+	printf("%-8s  %12s  %10s\n", "", "per-particle", "instanced");
+	bench_rain(nr_frames);
+	bench_snow(nr_frames, false);
+	bench_snow(nr_frames, true);
+	bench_ripple(nr_frames);
+	return test_finish("particles bench");
+}
@@ -0,0 +1,66 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#ifndef XSYSTEM4_GL_BENCH_H
+#define XSYSTEM4_GL_BENCH_H
+
+/*
+ * Helpers for the GPU benchmarks in this directory (bench_*.c).
+ *
+ * Unlike the unit tests, these link against the whole engine (xsystem4_dep)
+ * and render through a real GL context. They run headless under SDL's
+ * offscreen video driver, which creates an EGL context without a display:
+ *
+ *     SDL_VIDEODRIVER=offscreen SDL_AUDIODRIVER=dummy ./bench_effect
+ *
+ * With Mesa installed and no GPU available this is llvmpipe, so absolute
+ * numbers are only comparable between runs on the same machine. The
+ * benchmarks must be run from the source root, where shaders/ and fonts/
+ * are found; meson does this with `meson test --benchmark`.
+ */
+
+#include <time.h>
+
+#include "system4.h"
+#include "xsystem4.h"
+#include "gfx/gfx.h"
+#include "gfx/gl.h"
+#include "test.h"
+
+static void gl_bench_init(int width, int height)
+{
+	config.game_name = xstrdup("bench");
+	config.game_dir = xstrdup(".");
+	config.view_width = width;
+	config.view_height = height;
+	gfx_init();
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// GL calls only queue work; wait for it to finish before reading the clock.
+static double gl_now(void)
+{
+	glFinish();
+	return now();
+}
+
+#endif /* XSYSTEM4_GL_BENCH_H */
@@ -0,0 +1,72 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#ifndef XSYSTEM4_TEST_H
+#define XSYSTEM4_TEST_H
+
+/*
+ * Minimal helpers for the C unit tests in this directory.
+ *
+ * Each test is a standalone program which #includes the source file under
+ * test (so that static functions can be exercised directly) and provides
+ * whatever engine functions that file needs. The exit status is non-zero if
+ * any check failed.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+static int test_failures = 0;
+static int test_checks = 0;
+
+#define TEST_ASSERT(cond) \
+	do { \
+		test_checks++; \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: FAIL: %s\n", __FILE__, __LINE__, #cond); \
+			test_failures++; \
+		} \
+	} while (0)
+
+#define TEST_EQUAL(actual, expected) \
+	do { \
+		long long _a = (actual), _e = (expected); \
+		test_checks++; \
+		if (_a != _e) { \
+			fprintf(stderr, "%s:%d: FAIL: %s (expected %lld; got %lld)\n", \
+				__FILE__, __LINE__, #actual, _e, _a); \
+			test_failures++; \
+		} \
+	} while (0)
+
+#define TEST_STRING(actual, expected) \
+	do { \
+		const char *_a = (actual), *_e = (expected); \
+		test_checks++; \
+		if (!_a || strcmp(_a, _e)) { \
+			fprintf(stderr, "%s:%d: FAIL: %s (expected \"%s\"; got \"%s\")\n", \
+				__FILE__, __LINE__, #actual, _e, _a ? _a : "(null)"); \
+			test_failures++; \
+		} \
+	} while (0)
+
+static inline int test_finish(const char *name)
+{
+	printf("%s: %d failed; %d passed\n", name, test_failures, test_checks - test_failures);
+	return test_failures ? 1 : 0;
+}
+
+#endif /* XSYSTEM4_TEST_H */
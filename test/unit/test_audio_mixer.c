@@ -0,0 +1,585 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <time.h>
+
+#include "../../src/audio_mixer.c"
+#include "test.h"
+
+/*
+ * Headless mixer harness.
+ *
+ * Synthetic WAV (and, if libsndfile was built with Vorbis, OGG) streams are
+ * played through the real mixer hierarchy with loops, fades, LR swapping and
+ * nested mixers. The device is opened with the SDL "dummy" driver and then
+ * paused; the harness calls the audio callback itself so that the output is
+ * deterministic. The output is summarized per 1024-frame block (RMS and peak
+ * of each channel) and compared against the files in golden/.
+ *
+ * Usage: test_audio_mixer [--update] <golden dir>
+ *        test_audio_mixer --latency
+ *        test_audio_mixer --bench
+ *
+ * --update rewrites the golden files from the current output.
+ * --latency runs the mixer in low latency mode and measures how long a sound
+ * takes to reach the device instead.
+ * --bench reports mixing throughput in voices per core instead.
+ */
+
+// mixer hierarchy: Master -> {Music, Sound, Voice -> {Voice1, Voice2}}
+enum { MASTER, MUSIC, SOUND, VOICE, VOICE1, VOICE2, NR_TEST_MIXERS };
+
+static char *test_mixer_names[NR_TEST_MIXERS] = {
+	"Master", "Music", "Sound", "Voice", "Voice1", "Voice2"
+};
+static int test_mixer_volumes[NR_TEST_MIXERS] = { 100, 80, 100, 50, 100, 100 };
+
+struct config config = {
+	.mixer_nr_channels = NR_TEST_MIXERS,
+	.mixer_channels = test_mixer_names,
+	.mixer_volumes = test_mixer_volumes,
+	.default_volume = 100,
+};
+
+struct archive_data *asset_get(enum asset_type type, int no) { return NULL; }
+void bgi_read(const char *path) {}
+struct bgi *bgi_get(int no) { return NULL; }
+void wai_load(const char *path) {}
+struct wai *wai_get(int no) { return NULL; }
+
+#define FREQUENCY 44100
+// frames per audio callback, as with a typical device buffer
+#define CALLBACK_FRAMES 512
+#define BLOCK_FRAMES 1024
+#define GOLDEN_TOLERANCE 1e-3
+#define OGG_TOLERANCE 0.02
+#define BENCH_SECONDS 10
+
+#define STEREO_WAV "audio_mixer_stereo.wav"
+#define MONO_WAV "audio_mixer_mono.wav"
+#define STEREO_OGG "audio_mixer_stereo.ogg"
+
+static const char *golden_dir;
+static bool update_golden = false;
+static bool have_ogg = false;
+
+/*
+ * Stereo: a 440Hz sine on the left which swells from 0.1 to 0.6 over the file
+ * (so that loops show up in the block RMS) and a steady 660Hz sine on the right.
+ * Mono: a 330Hz sine at 22050Hz which decays from 0.4 to 0.1.
+ */
+static bool write_test_file(const char *path, int format, int channels, int rate, int frames)
+{
+	SF_INFO info = {
+		.samplerate = rate,
+		.channels = channels,
+		.format = format,
+	};
+	if (!sf_format_check(&info))
+		return false;
+	SNDFILE *f = sf_open(path, SFM_WRITE, &info);
+	if (!f)
+		return false;
+
+	short *data = xmalloc(sizeof(short) * frames * channels);
+	for (int i = 0; i < frames; i++) {
+		double t = (double)i / rate;
+		double progress = (double)i / frames;
+		if (channels == 2) {
+			data[i*2] = lrint(32767.0 * (0.1 + 0.5 * progress) * sin(2 * M_PI * 440 * t));
+			data[i*2+1] = lrint(32767.0 * 0.25 * sin(2 * M_PI * 660 * t));
+		} else {
+			data[i] = lrint(32767.0 * (0.4 - 0.3 * progress) * sin(2 * M_PI * 330 * t));
+		}
+	}
+	bool ok = sf_writef_short(f, data, frames) == frames;
+	free(data);
+	sf_close(f);
+	return ok;
+}
+
+static void remove_test_files(void)
+{
+	remove(STEREO_WAV);
+	remove(MONO_WAV);
+	remove(STEREO_OGG);
+}
+
+/*
+ * Put the mixer tree back into its post-mixer_init state: sub-mixer streams
+ * at the start of an empty buffer and the statistics cleared. Any callback
+ * run by the audio thread before the device was paused is undone by this.
+ */
+static void reset_mixers(void)
+{
+	SDL_LockAudioDevice(audio_device);
+	for (int i = 0; i < nr_mixers; i++) {
+		struct mixer *m = &mixers[i];
+		memset(m->data, 0, sizeof(m->data));
+		m->muted = false;
+		if (m->voice >= 0)
+			m->parent->mixer.voices[m->voice].position = 0.0f;
+	}
+	memset(&stats, 0, sizeof(stats));
+	SDL_UnlockAudioDevice(audio_device);
+}
+
+static struct channel *open_channel(const char *path, int mixer_no)
+{
+	struct channel *ch = channel_open_file(path);
+	TEST_ASSERT(ch);
+	if (!ch)
+		exit(test_finish("audio_mixer"));
+	ch->mixer_no = mixer_no;
+	return ch;
+}
+
+static float *render_frames(float *out, int frames, int callback_frames)
+{
+	for (int i = 0; i < frames; i += callback_frames) {
+		int n = min(callback_frames, frames - i);
+		audio_callback(NULL, (Uint8*)(out + i * 2), n * sizeof(float) * 2);
+	}
+	return out;
+}
+
+static float *render(float *out, int frames)
+{
+	return render_frames(out, frames, CALLBACK_FRAMES);
+}
+
+static float *alloc_output(int frames)
+{
+	return xcalloc(frames * 2, sizeof(float));
+}
+
+static bool is_silent(float *out, int from, int to)
+{
+	for (int i = from * 2; i < to * 2; i++) {
+		if (out[i] != 0.0f)
+			return false;
+	}
+	return true;
+}
+
+struct block_summary {
+	double rms[2];
+	double peak[2];
+};
+
+static int summarize(float *out, int frames, struct block_summary **summary_out)
+{
+	int nr_blocks = (frames + BLOCK_FRAMES - 1) / BLOCK_FRAMES;
+	struct block_summary *summary = xcalloc(nr_blocks, sizeof(struct block_summary));
+	for (int b = 0; b < nr_blocks; b++) {
+		int start = b * BLOCK_FRAMES;
+		int end = min(frames, start + BLOCK_FRAMES);
+		for (int c = 0; c < 2; c++) {
+			double sum = 0.0, peak = 0.0;
+			for (int i = start; i < end; i++) {
+				double v = out[i*2+c];
+				sum += v * v;
+				peak = max(peak, fabs(v));
+			}
+			summary[b].rms[c] = sqrt(sum / (end - start));
+			summary[b].peak[c] = peak;
+		}
+	}
+	*summary_out = summary;
+	return nr_blocks;
+}
+
+static char *golden_path(const char *name)
+{
+	size_t len = strlen(golden_dir) + strlen(name) + 32;
+	char *path = xmalloc(len);
+	snprintf(path, len, "%s/audio_mixer_%s.txt", golden_dir, name);
+	return path;
+}
+
+static void write_golden(const char *name, struct block_summary *summary, int nr_blocks)
+{
+	char *path = golden_path(name);
+	FILE *f = fopen(path, "w");
+	TEST_ASSERT(f);
+	if (f) {
+		fprintf(f, "# RMS and peak (left, right) per %d-frame block\n", BLOCK_FRAMES);
+		for (int b = 0; b < nr_blocks; b++) {
+			fprintf(f, "%.6f %.6f %.6f %.6f\n", summary[b].rms[0], summary[b].rms[1],
+					summary[b].peak[0], summary[b].peak[1]);
+		}
+		fclose(f);
+		printf("wrote %s\n", path);
+	}
+	free(path);
+}
+
+static bool blocks_match(struct block_summary *a, struct block_summary *b, double tolerance)
+{
+	for (int c = 0; c < 2; c++) {
+		if (fabs(a->rms[c] - b->rms[c]) > tolerance)
+			return false;
+		if (fabs(a->peak[c] - b->peak[c]) > tolerance)
+			return false;
+	}
+	return true;
+}
+
+static void check_golden(const char *name, float *out, int frames)
+{
+	struct block_summary *summary;
+	int nr_blocks = summarize(out, frames, &summary);
+	if (update_golden) {
+		write_golden(name, summary, nr_blocks);
+		free(summary);
+		return;
+	}
+
+	char *path = golden_path(name);
+	FILE *f = fopen(path, "r");
+	if (!f) {
+		fprintf(stderr, "%s: cannot open golden file\n", path);
+		TEST_ASSERT(f);
+		free(summary);
+		free(path);
+		return;
+	}
+	char line[256];
+	int b = 0, mismatches = 0;
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] == '#')
+			continue;
+		struct block_summary expected;
+		if (sscanf(line, "%lf %lf %lf %lf", &expected.rms[0], &expected.rms[1],
+				&expected.peak[0], &expected.peak[1]) != 4)
+			continue;
+		if (b < nr_blocks && !blocks_match(&summary[b], &expected, GOLDEN_TOLERANCE)) {
+			if (mismatches++ < 5) {
+				fprintf(stderr, "%s: block %d: expected %f %f %f %f; got %f %f %f %f\n",
+						name, b, expected.rms[0], expected.rms[1],
+						expected.peak[0], expected.peak[1],
+						summary[b].rms[0], summary[b].rms[1],
+						summary[b].peak[0], summary[b].peak[1]);
+			}
+		}
+		b++;
+	}
+	fclose(f);
+	TEST_EQUAL(b, nr_blocks);
+	TEST_EQUAL(mismatches, 0);
+	free(summary);
+	free(path);
+}
+
+/*
+ * A looped section played three times on a sub-mixer, after which the
+ * stream stops by itself.
+ */
+static void test_loop(void)
+{
+	const int frames = FREQUENCY * 2;
+	reset_mixers();
+	struct channel *ch = open_channel(STEREO_WAV, MUSIC);
+	channel_set_loop_start_pos(ch, FREQUENCY / 4);
+	channel_set_loop_end_pos(ch, FREQUENCY * 3 / 4);
+	channel_set_loop_count(ch, 3);
+	channel_play(ch);
+
+	float *out = render(alloc_output(frames), frames);
+	// one pass to loop_end, two more of the loop, delayed by the Music mixer's buffer
+	int end = FREQUENCY * 3 / 4 + 2 * (FREQUENCY / 2) + CHUNK_SIZE;
+	TEST_ASSERT(!channel_is_playing(ch));
+	TEST_ASSERT(!is_silent(out, end - CHUNK_SIZE, end - CHUNK_SIZE / 2));
+	TEST_ASSERT(is_silent(out, end + CHUNK_SIZE, frames));
+	check_golden("loop", out, frames);
+
+	channel_close(ch);
+	free(out);
+}
+
+/*
+ * Fade in from silence, then fade out and stop.
+ */
+static void test_fade(void)
+{
+	const int fade_in = FREQUENCY, fade_out = FREQUENCY / 2;
+	reset_mixers();
+	struct channel *ch = open_channel(STEREO_WAV, SOUND);
+	channel_set_loop_count(ch, 0);
+	channel_fade(ch, 0, 0, false);
+	channel_fade(ch, 500, 100, false);
+	TEST_ASSERT(channel_is_fading(ch));
+	channel_play(ch);
+
+	float *out = alloc_output(fade_in + fade_out);
+	render(out, fade_in);
+	TEST_ASSERT(!channel_is_fading(ch));
+	TEST_EQUAL(channel_get_volume(ch), 100);
+
+	channel_fade(ch, 250, 0, true);
+	render(out + fade_in * 2, fade_out);
+	TEST_ASSERT(!channel_is_playing(ch));
+	TEST_ASSERT(is_silent(out, fade_in + fade_out - CHUNK_SIZE, fade_in + fade_out));
+	check_golden("fade", out, fade_in + fade_out);
+
+	channel_close(ch);
+	free(out);
+}
+
+static float *play_once(const char *path, int mixer_no, bool swapped, int frames)
+{
+	reset_mixers();
+	struct channel *ch = open_channel(path, mixer_no);
+	if (swapped)
+		channel_reverse_LR(ch);
+	channel_play(ch);
+	float *out = render(alloc_output(frames), frames);
+	channel_close(ch);
+	return out;
+}
+
+/*
+ * Swapping LR must produce exactly the unswapped output with the channels
+ * exchanged.
+ */
+static void test_swap(void)
+{
+	const int frames = FREQUENCY / 2;
+	float *normal = play_once(STEREO_WAV, MUSIC, false, frames);
+	float *swapped = play_once(STEREO_WAV, MUSIC, true, frames);
+	int mismatches = 0;
+	for (int i = 0; i < frames; i++) {
+		if (swapped[i*2] != normal[i*2+1] || swapped[i*2+1] != normal[i*2])
+			mismatches++;
+	}
+	TEST_EQUAL(mismatches, 0);
+	TEST_ASSERT(!is_silent(swapped, 0, frames));
+	check_golden("swap", swapped, frames);
+	free(normal);
+	free(swapped);
+}
+
+/*
+ * Streams on both levels of the hierarchy at once, then the Voice mixer
+ * (and with it Voice1 and Voice2) muted.
+ */
+static void test_nested(void)
+{
+	const int frames = FREQUENCY, muted_frames = FREQUENCY / 4;
+	reset_mixers();
+	struct channel *voice = open_channel(MONO_WAV, VOICE1);
+	channel_play(voice);
+
+	// each level of nesting delays the stream by one buffer
+	float *out = render(alloc_output(frames + muted_frames), CHUNK_SIZE * 3);
+	TEST_ASSERT(is_silent(out, 0, CHUNK_SIZE * 2));
+	TEST_ASSERT(!is_silent(out, CHUNK_SIZE * 2, CHUNK_SIZE * 3));
+
+	struct channel *music = open_channel(STEREO_WAV, MUSIC);
+	struct channel *voice2 = open_channel(STEREO_WAV, VOICE2);
+	channel_reverse_LR(voice2);
+	channel_play(music);
+	channel_play(voice2);
+	render(out + CHUNK_SIZE * 3 * 2, frames - CHUNK_SIZE * 3);
+
+	TEST_ASSERT(mixer_set_mute(VOICE, 1));
+	render(out + frames * 2, muted_frames);
+	check_golden("nested", out, frames + muted_frames);
+
+	channel_close(voice);
+	channel_close(voice2);
+	channel_close(music);
+	free(out);
+}
+
+/*
+ * A Vorbis stream should sound like the WAV it was encoded from.
+ */
+static void test_ogg(void)
+{
+	const int frames = FREQUENCY / 2;
+	float *wav = play_once(STEREO_WAV, MUSIC, false, frames);
+	float *ogg = play_once(STEREO_OGG, MUSIC, false, frames);
+	struct block_summary *wav_summary, *ogg_summary;
+	int nr_blocks = summarize(wav, frames, &wav_summary);
+	summarize(ogg, frames, &ogg_summary);
+	int mismatches = 0;
+	for (int b = 0; b < nr_blocks; b++) {
+		if (!blocks_match(&wav_summary[b], &ogg_summary[b], OGG_TOLERANCE))
+			mismatches++;
+	}
+	TEST_EQUAL(mismatches, 0);
+	free(wav_summary);
+	free(ogg_summary);
+	free(wav);
+	free(ogg);
+}
+
+static int first_audible(float *out, int frames)
+{
+	for (int i = 0; i < frames * 2; i++) {
+		if (fabsf(out[i]) > 1e-4f)
+			return i / 2;
+	}
+	return -1;
+}
+
+/*
+ * Loopback latency in low latency mode: trigger a sound on each leaf mixer
+ * between two callbacks, as the game thread would, and find its first
+ * audible frame in the callback output. When the sound is triggered the
+ * device still has one buffer queued, so that buffer is added to the
+ * measured delay. Nested sub-mixers must not add a buffer each.
+ */
+static void test_latency(void)
+{
+	static const int leaf_mixers[] = { MUSIC, SOUND, VOICE1, VOICE2 };
+	const int buffer = device_buffer_size();
+	const int frames = buffer * 8;
+	TEST_ASSERT(low_latency);
+
+	for (int i = 0; i < 4; i++) {
+		reset_mixers();
+		float *out = alloc_output(frames);
+		// a few buffers of silence first
+		render_frames(out, buffer * 3, buffer);
+		TEST_ASSERT(is_silent(out, 0, buffer * 3));
+
+		struct channel *ch = open_channel(STEREO_WAV, leaf_mixers[i]);
+		channel_play(ch);
+		render_frames(out, frames, buffer);
+		int offset = first_audible(out, frames);
+		int latency = buffer + offset;
+		printf("%s: %d frames (%.1f ms)\n", test_mixer_names[leaf_mixers[i]], latency,
+				latency * 1000.0 / FREQUENCY);
+		TEST_ASSERT(offset >= 0);
+		TEST_ASSERT(latency <= buffer + CHUNK_SIZE);
+
+		channel_close(ch);
+		free(out);
+	}
+}
+
+static double cpu_seconds(void)
+{
+	return (double)clock() / CLOCKS_PER_SEC;
+}
+
+/*
+ * Mix BENCH_SECONDS of audio with increasing numbers of looping voices spread
+ * over the leaf mixers, and report how many voices one core could sustain in
+ * real time.
+ */
+static void bench_format(const char *label, const char *path)
+{
+	static const int leaf_mixers[] = { MUSIC, SOUND, VOICE1, VOICE2 };
+	static const int voice_counts[] = { 1, 8, 32, 64, 120 };
+	const int frames = FREQUENCY * BENCH_SECONDS;
+	float *out = alloc_output(CALLBACK_FRAMES);
+
+	for (unsigned i = 0; i < sizeof(voice_counts) / sizeof(*voice_counts); i++) {
+		int nr_voices = voice_counts[i];
+		struct channel **chs = xcalloc(nr_voices, sizeof(struct channel*));
+		reset_mixers();
+		for (int v = 0; v < nr_voices; v++) {
+			chs[v] = open_channel(path, leaf_mixers[v % 4]);
+			channel_set_loop_count(chs[v], 0);
+			channel_fade(chs[v], 0, 10, false);
+			channel_play(chs[v]);
+		}
+
+		double t = cpu_seconds();
+		for (int f = 0; f < frames; f += CALLBACK_FRAMES) {
+			render(out, CALLBACK_FRAMES);
+		}
+		t = cpu_seconds() - t;
+
+		double realtime = BENCH_SECONDS / t;
+		printf("%-4s %5d %7.2f%% %12.0f\n", label, nr_voices, 100.0 / realtime,
+				nr_voices * realtime);
+		TEST_EQUAL(stats.voice_overflows, 0);
+
+		for (int v = 0; v < nr_voices; v++) {
+			channel_close(chs[v]);
+		}
+		free(chs);
+	}
+	free(out);
+}
+
+static void bench(void)
+{
+	printf("%d seconds of %dHz stereo per run\n", BENCH_SECONDS, FREQUENCY);
+	printf("file voices     load  voices/core\n");
+	bench_format("wav", STEREO_WAV);
+	if (have_ogg)
+		bench_format("ogg", STEREO_OGG);
+}
+
+int main(int argc, char *argv[])
+{
+	bool run_bench = false, run_latency = false;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--update"))
+			update_golden = true;
+		else if (!strcmp(argv[i], "--bench"))
+			run_bench = true;
+		else if (!strcmp(argv[i], "--latency"))
+			run_latency = true;
+		else
+			golden_dir = argv[i];
+	}
+	if (!run_bench && !run_latency && !golden_dir) {
+		fprintf(stderr, "Usage: %s [--update] <golden dir>\n"
+				"       %s --latency\n"
+				"       %s --bench\n", argv[0], argv[0], argv[0]);
+		return 2;
+	}
+	// low latency mode is chosen once, in mixer_init
+	config.audio_low_latency = run_latency;
+
+	atexit(remove_test_files);
+	TEST_ASSERT(write_test_file(STEREO_WAV, SF_FORMAT_WAV | SF_FORMAT_PCM_16, 2, FREQUENCY, FREQUENCY));
+	TEST_ASSERT(write_test_file(MONO_WAV, SF_FORMAT_WAV | SF_FORMAT_PCM_16, 1, FREQUENCY / 2, FREQUENCY / 2));
+	have_ogg = write_test_file(STEREO_OGG, SF_FORMAT_OGG | SF_FORMAT_VORBIS, 2, FREQUENCY, FREQUENCY);
+	if (!have_ogg)
+		printf("libsndfile has no Vorbis support; skipping OGG\n");
+
+	SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+	if (SDL_Init(SDL_INIT_AUDIO) < 0)
+		WARNING("SDL_Init failed: %s", SDL_GetError());
+	mixer_init();
+	// the harness drives the callback itself
+	if (audio_device)
+		SDL_PauseAudioDevice(audio_device, 1);
+
+	if (run_bench) {
+		bench();
+	} else if (run_latency) {
+		test_latency();
+	} else {
+		test_loop();
+		test_fade();
+		test_swap();
+		test_nested();
+		if (have_ogg)
+			test_ogg();
+	}
+
+	SDL_Quit();
+	return test_finish("audio_mixer");
+}
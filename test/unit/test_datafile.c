@@ -0,0 +1,243 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <time.h>
+
+#include "../../src/hll/DataFile.c"
+#include "test.h"
+
+/*
+ * DataFile_SarchString and DataFile_SarchInt must return the same row as a
+ * linear scan of the table (the search they replaced, copied below) for
+ * every value in the table, for values that are not in it and for columns
+ * that only some rows have.
+ *
+ * Usage: test_datafile
+ *        test_datafile --bench
+ *
+ * --bench times searches on a large table with and without the index.
+ */
+
+struct archive_data *asset_get(enum asset_type type, int no)
+{
+	return NULL;
+}
+
+static uint32_t rng = 88675123;
+
+static uint32_t rand32(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+// the old searches
+static int ref_sarch_string(int label, int horizontal, struct string *data)
+{
+	struct gdat_table *tbl = gdat_get_table(current_gdat, label);
+	if (!tbl)
+		return -1;
+	for (uint32_t i = 0; i < tbl->nr_rows; i++) {
+		struct gdat_row *row = &tbl->rows[i];
+		if ((uint32_t)horizontal < row->nr_cols &&
+			row->cols[horizontal].type == GDAT_STRING &&
+			!strcmp(current_gdat->strings[row->cols[horizontal].index]->text, data->text))
+			return i;
+	}
+	return -1;
+}
+
+static int ref_sarch_int(int label, int horizontal, int data)
+{
+	struct gdat_table *tbl = gdat_get_table(current_gdat, label);
+	if (!tbl)
+		return -1;
+	for (uint32_t i = 0; i < tbl->nr_rows; i++) {
+		struct gdat_row *row = &tbl->rows[i];
+		if ((uint32_t)horizontal < row->nr_cols &&
+			row->cols[horizontal].type == GDAT_INT &&
+			current_gdat->ints[row->cols[horizontal].index] == data)
+			return i;
+	}
+	return -1;
+}
+
+static struct string *make_name(unsigned n)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "name%u", n);
+	return make_string(buf, strlen(buf));
+}
+
+/*
+ * Build a gdat of nr_tables tables. Rows have up to max_cols columns of
+ * random type. Values are drawn from nr_values distinct ints and strings,
+ * so most of them occur in several rows.
+ */
+static struct gdat *make_gdat(unsigned nr_tables, unsigned nr_rows, unsigned max_cols,
+		unsigned nr_values)
+{
+	struct gdat *dat = xcalloc(1, sizeof(struct gdat));
+	dat->nr_ints = nr_values;
+	dat->ints = xmalloc(nr_values * sizeof(int32_t));
+	dat->nr_floats = 1;
+	dat->floats = xcalloc(1, sizeof(float));
+	dat->nr_strings = nr_values;
+	dat->strings = xcalloc(nr_values, sizeof(struct string*));
+	for (unsigned i = 0; i < nr_values; i++) {
+		// negative values, and the same int at several indices
+		dat->ints[i] = (int32_t)(rand32() % (nr_values * 2)) - (int32_t)nr_values / 2;
+		dat->strings[i] = make_name(rand32() % (nr_values * 2));
+	}
+
+	dat->nr_labels = nr_tables;
+	dat->labels = xcalloc(nr_tables, sizeof(char*));
+	dat->nr_tables = nr_tables;
+	dat->tables = xcalloc(nr_tables, sizeof(struct gdat_table));
+	for (unsigned t = 0; t < nr_tables; t++) {
+		dat->labels[t] = xstrdup("table");
+		struct gdat_table *tbl = &dat->tables[t];
+		tbl->nr_rows = t ? nr_rows : 0;
+		tbl->rows = xcalloc(tbl->nr_rows, sizeof(struct gdat_row));
+		for (unsigned r = 0; r < tbl->nr_rows; r++) {
+			struct gdat_row *row = &tbl->rows[r];
+			row->nr_cols = rand32() % (max_cols + 1);
+			row->cols = xcalloc(row->nr_cols, sizeof(struct gdat_col));
+			for (unsigned c = 0; c < row->nr_cols; c++) {
+				switch (rand32() % 4) {
+				case 0:
+					row->cols[c].type = GDAT_FLOAT;
+					row->cols[c].index = 0;
+					break;
+				case 1:
+					row->cols[c].type = GDAT_STRING;
+					row->cols[c].index = rand32() % nr_values;
+					break;
+				default:
+					row->cols[c].type = GDAT_INT;
+					row->cols[c].index = rand32() % nr_values;
+					break;
+				}
+			}
+		}
+	}
+	return dat;
+}
+
+static void test_search(void)
+{
+	const unsigned nr_values = 200;
+	current_gdat = make_gdat(4, 500, 6, nr_values);
+
+	int nr_different = 0, nr_found = 0;
+	for (int t = 0; t < 4; t++) {
+		for (int col = -1; col <= 7; col++) {
+			// every value in the table, and as many that are not
+			for (unsigned v = 0; v < nr_values * 2; v++) {
+				struct string *s = make_name(v);
+				int row = DataFile_SarchString(t, col, s);
+				if (row != ref_sarch_string(t, col, s) && nr_different++ < 5)
+					fprintf(stderr, "table %d col %d: \"%s\" differs\n", t, col, s->text);
+				nr_found += row >= 0;
+				free_string(s);
+			}
+			for (int v = -(int)nr_values; v < (int)nr_values * 2; v++) {
+				int row = DataFile_SarchInt(t, col, v);
+				if (row != ref_sarch_int(t, col, v) && nr_different++ < 5)
+					fprintf(stderr, "table %d col %d: %d differs\n", t, col, v);
+				nr_found += row >= 0;
+			}
+		}
+	}
+	TEST_EQUAL(nr_different, 0);
+	// make sure the comparison wasn't vacuous
+	TEST_ASSERT(nr_found > 1000);
+
+	// tables that don't exist
+	struct string *s = make_name(0);
+	TEST_EQUAL(DataFile_SarchString(-1, 0, s), -1);
+	TEST_EQUAL(DataFile_SarchString(4, 0, s), -1);
+	TEST_EQUAL(DataFile_SarchInt(4, 0, 0), -1);
+	free_string(s);
+
+	// indices are freed with the gdat
+	gdat_free(current_gdat);
+	current_gdat = NULL;
+	TEST_EQUAL(DataFile_SarchInt(0, 0, 0), -1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(void)
+{
+	const unsigned nr_rows = 20000;
+	const int nr_queries = 5000;
+	current_gdat = make_gdat(2, nr_rows, 4, nr_rows);
+	struct string **keys = xmalloc(nr_queries * sizeof(struct string*));
+	int *ints = xmalloc(nr_queries * sizeof(int));
+	for (int i = 0; i < nr_queries; i++) {
+		keys[i] = make_name(rand32() % (nr_rows * 2));
+		ints[i] = rand32() % (nr_rows * 2) - nr_rows / 2;
+	}
+
+	printf("%u rows, %d queries per column; milliseconds\n", nr_rows, nr_queries);
+	printf("          linear   index (incl. build)\n");
+	double t = now();
+	int sum_ref = 0, sum = 0;
+	for (int i = 0; i < nr_queries; i++)
+		sum_ref += ref_sarch_string(1, 0, keys[i]);
+	double t_ref = (now() - t) * 1e3;
+	t = now();
+	for (int i = 0; i < nr_queries; i++)
+		sum += DataFile_SarchString(1, 0, keys[i]);
+	printf("string  %8.1f  %8.1f\n", t_ref, (now() - t) * 1e3);
+	TEST_EQUAL(sum, sum_ref);
+
+	t = now();
+	sum_ref = sum = 0;
+	for (int i = 0; i < nr_queries; i++)
+		sum_ref += ref_sarch_int(1, 1, ints[i]);
+	t_ref = (now() - t) * 1e3;
+	t = now();
+	for (int i = 0; i < nr_queries; i++)
+		sum += DataFile_SarchInt(1, 1, ints[i]);
+	printf("int     %8.1f  %8.1f\n", t_ref, (now() - t) * 1e3);
+	TEST_EQUAL(sum, sum_ref);
+
+	for (int i = 0; i < nr_queries; i++)
+		free_string(keys[i]);
+	free(keys);
+	free(ints);
+	gdat_free(current_gdat);
+	current_gdat = NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1 && !strcmp(argv[1], "--bench")) {
+		bench();
+		return test_finish("datafile bench");
+	}
+	test_search();
+	return test_finish("datafile");
+}
@@ -0,0 +1,174 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+
+#include "../../src/dungeon/dgn.c"
+#include "test.h"
+
+/*
+ * dgn_check_look only visits the cells that the sight line crosses. It must
+ * give the same answer as testing every cell in the line's bounding box,
+ * which is what PastelChime2's Field_CheckLook used to do.
+ */
+
+#define MAP_SIZE 24
+#define FLOOR 1
+#define NR_LAYOUTS 200
+#define LINES_PER_LAYOUT 5000
+
+_Noreturn void _vm_error(const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	abort();
+}
+
+static bool check_look_bbox(struct dgn *dgn, float px, float py, float qx, float qy, int floor)
+{
+	struct line_segment sight_line = {{px, py}, {qx, qy}};
+	int min_x = roundf(min(px, qx));
+	int max_x = roundf(max(px, qx));
+	int min_y = roundf(min(py, qy));
+	int max_y = roundf(max(py, qy));
+	for (int y = min_y; y <= max_y; y++) {
+		for (int x = min_x; x <= max_x; x++) {
+			struct line_segment segments[DGN_MAX_WALL_SEGMENTS_PER_CELL];
+			int nr_segments = dgn_wall_segments(dgn, segments, x, floor, y, true);
+			for (int i = 0; i < nr_segments; i++) {
+				vec2 v;
+				if (dgn_segment_intersection(&segments[i], &sight_line, v))
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+static uint32_t rng = 2463534242;
+
+static uint32_t rand32(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+static int random_wall(void)
+{
+	return rand32() % 16 ? -1 : 1;
+}
+
+static void random_layout(struct dgn *dgn)
+{
+	for (int i = 0; i < dgn_nr_cells(dgn); i++) {
+		struct dgn_cell *cell = &dgn->cells[i];
+		cell->north_wall = random_wall();
+		cell->south_wall = random_wall();
+		cell->east_wall = random_wall();
+		cell->west_wall = random_wall();
+		cell->north_door = random_wall();
+		cell->west_door = random_wall();
+		cell->north_door_angle = rand32() % 2 ? 0.f : 45.f;
+		cell->west_door_angle = rand32() % 2 ? 0.f : 45.f;
+		cell->east_door_lock = rand32() % 16 == 0;
+		switch (rand32() % 32) {
+		case 0: cell->ceiling = 10; break;
+		case 1: cell->ceiling = 1; break;
+		default: cell->ceiling = -1; break;
+		}
+	}
+}
+
+// cell centers, cell edges and arbitrary points, some just outside the map
+static float random_coord(void)
+{
+	float cell = (int)(rand32() % (MAP_SIZE + 2)) - 1;
+	switch (rand32() % 4) {
+	case 0: return cell;
+	case 1: return cell + 0.5f;
+	default: return cell + (float)(rand32() % 10000) / 10000.f;
+	}
+}
+
+static void test_random_lines(void)
+{
+	struct dgn *dgn = dgn_new(MAP_SIZE, 2, MAP_SIZE);
+	int mismatches = 0, visible = 0;
+	for (int l = 0; l < NR_LAYOUTS; l++) {
+		random_layout(dgn);
+		for (int i = 0; i < LINES_PER_LAYOUT; i++) {
+			float px = random_coord(), py = random_coord();
+			float qx = random_coord(), qy = random_coord();
+			// axis-aligned and degenerate lines
+			if (rand32() % 8 == 0)
+				qx = px;
+			if (rand32() % 8 == 0)
+				qy = py;
+			bool expected = check_look_bbox(dgn, px, py, qx, qy, FLOOR);
+			bool actual = dgn_check_look(dgn, px, py, qx, qy, FLOOR);
+			if (actual != expected && mismatches++ < 5) {
+				fprintf(stderr, "(%.4f, %.4f) -> (%.4f, %.4f): expected %d; got %d\n",
+						px, py, qx, qy, expected, actual);
+			}
+			visible += expected;
+		}
+	}
+	TEST_EQUAL(mismatches, 0);
+	// both outcomes must actually be exercised
+	TEST_ASSERT(visible > NR_LAYOUTS * LINES_PER_LAYOUT / 10);
+	TEST_ASSERT(visible < NR_LAYOUTS * LINES_PER_LAYOUT * 9 / 10);
+	dgn_free(dgn);
+}
+
+static void test_cases(void)
+{
+	struct dgn *dgn = dgn_new(8, 2, 8);
+	TEST_ASSERT(dgn_check_look(dgn, 0.f, 0.f, 7.f, 5.f, FLOOR));
+
+	// a wall on the north edge of (2, 2)
+	dgn_cell_at(dgn, 2, FLOOR, 2)->north_wall = 1;
+	TEST_ASSERT(!dgn_check_look(dgn, 2.f, 2.f, 2.f, 3.f, FLOOR));
+	TEST_ASSERT(!dgn_check_look(dgn, 1.f, 1.f, 3.f, 4.f, FLOOR));
+	TEST_ASSERT(dgn_check_look(dgn, 1.f, 2.f, 1.f, 3.f, FLOOR));
+	// walls on other floors don't count
+	TEST_ASSERT(dgn_check_look(dgn, 2.f, 2.f, 2.f, 3.f, 0));
+
+	// a door blocks only while closed or locked
+	dgn_cell_at(dgn, 5, FLOOR, 5)->west_door = 1;
+	TEST_ASSERT(!dgn_check_look(dgn, 4.f, 5.f, 5.f, 5.f, FLOOR));
+	dgn_cell_at(dgn, 5, FLOOR, 5)->west_door_angle = 85.f;
+	TEST_ASSERT(dgn_check_look(dgn, 4.f, 5.f, 5.f, 5.f, FLOOR));
+	dgn_cell_at(dgn, 5, FLOOR, 5)->west_door_lock = 1;
+	TEST_ASSERT(!dgn_check_look(dgn, 4.f, 5.f, 5.f, 5.f, FLOOR));
+
+	// a pillar blocks lines through the middle of its cell but not past it
+	dgn_cell_at(dgn, 3, FLOOR, 6)->ceiling = 10;
+	TEST_ASSERT(!dgn_check_look(dgn, 2.f, 6.f, 4.f, 6.f, FLOOR));
+	TEST_ASSERT(!dgn_check_look(dgn, 2.f, 5.f, 4.f, 7.f, FLOOR));
+	TEST_ASSERT(dgn_check_look(dgn, 2.f, 6.45f, 4.f, 6.45f, FLOOR));
+	dgn_free(dgn);
+}
+
+int main(void)
+{
+	test_cases();
+	test_random_lines();
+	return test_finish("dgn_look");
+}
@@ -0,0 +1,573 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "../../src/hll/File.c"
+#include "test.h"
+
+/*
+ * Writes structs with File.Write, reads them back into blank structs of the
+ * same shape with File.Read, and compares. Records are large enough to
+ * cross the stream buffers many times. Also checks that the file can still
+ * be decoded with a plain uncompress(), that a file written by the old
+ * whole-buffer compress() loads, and that a truncated file fails cleanly.
+ *
+ * Usage: test_file
+ *        test_file --bench
+ *
+ * --bench round-trips about 50 MB of records instead, and compares the time
+ * and peak memory with compressing and uncompressing the whole file in one
+ * buffer, as File.Write and File.Read used to.
+ */
+
+#define TEST_FILE "test_file.tmp"
+#define TEST_FILE_OLD "test_file_old.tmp"
+#define TEST_FILE_TRUNCATED "test_file_truncated.tmp"
+
+enum { INNER_T, RECORD_T };
+
+static struct ain_variable inner_members[] = {
+	{ .name = "nX", .type = { .data = AIN_INT } },
+	{ .name = "fY", .type = { .data = AIN_FLOAT } },
+	{ .name = "sName", .type = { .data = AIN_STRING } },
+};
+
+static struct ain_variable record_members[] = {
+	{ .name = "nId", .type = { .data = AIN_INT } },
+	{ .name = "bFlag", .type = { .data = AIN_BOOL } },
+	{ .name = "lnBig", .type = { .data = AIN_LONG_INT } },
+	{ .name = "fScale", .type = { .data = AIN_FLOAT } },
+	{ .name = "sTitle", .type = { .data = AIN_STRING } },
+	{ .name = "Inner", .type = { .data = AIN_STRUCT, .struc = INNER_T } },
+	{ .name = "anValues", .type = { .data = AIN_ARRAY_INT, .rank = 1 } },
+	{ .name = "afWeights", .type = { .data = AIN_ARRAY_FLOAT, .rank = 1 } },
+	{ .name = "abFlags", .type = { .data = AIN_ARRAY_BOOL, .rank = 1 } },
+	{ .name = "asNames", .type = { .data = AIN_ARRAY_STRING, .rank = 1 } },
+	{ .name = "aInner", .type = { .data = AIN_ARRAY_STRUCT, .struc = INNER_T, .rank = 1 } },
+	{ .name = "anGrid", .type = { .data = AIN_ARRAY_INT, .rank = 2 } },
+};
+
+static struct ain_struct structures[] = {
+	[INNER_T] = { .name = "inner_t", .nr_members = 3, .members = inner_members },
+	[RECORD_T] = { .name = "record_t", .nr_members = 12, .members = record_members },
+};
+
+static struct ain test_ain = {
+	.nr_structures = 2,
+	.structures = structures,
+};
+
+struct ain *ain = &test_ain;
+
+/*
+ * A minimal heap: slot i holds a page or a string. Slots are never reused.
+ */
+
+static void **heap_objects = NULL;
+static bool *heap_is_string = NULL;
+static int heap_nr_objects = 1;
+static int heap_cap = 0;
+
+static int heap_put(void *obj, bool is_string)
+{
+	if (heap_nr_objects >= heap_cap) {
+		int new_cap = heap_cap ? heap_cap * 2 : 1024;
+		heap_objects = xrealloc_array(heap_objects, heap_cap, new_cap, sizeof(void*));
+		heap_is_string = xrealloc_array(heap_is_string, heap_cap, new_cap, sizeof(bool));
+		heap_cap = new_cap;
+	}
+	heap_objects[heap_nr_objects] = obj;
+	heap_is_string[heap_nr_objects] = is_string;
+	return heap_nr_objects++;
+}
+
+static void heap_free_all(void)
+{
+	for (int i = 1; i < heap_nr_objects; i++) {
+		if (!heap_objects[i])
+			continue;
+		if (heap_is_string[i])
+			free_string(heap_objects[i]);
+		else
+			free(heap_objects[i]);
+	}
+	free(heap_objects);
+	free(heap_is_string);
+}
+
+struct page *heap_get_page(int index)
+{
+	return heap_objects[index];
+}
+
+struct string *heap_get_string(int index)
+{
+	return heap_objects[index];
+}
+
+int32_t heap_alloc_string(struct string *s)
+{
+	return heap_put(s, true);
+}
+
+void variable_fini(union vm_value v, enum ain_data_type type, bool call_dtor)
+{
+	if (type == AIN_STRING) {
+		free_string(heap_objects[v.i]);
+		heap_objects[v.i] = NULL;
+	}
+}
+
+enum ain_data_type array_type(enum ain_data_type type)
+{
+	switch (type) {
+	case AIN_ARRAY_INT: return AIN_INT;
+	case AIN_ARRAY_FLOAT: return AIN_FLOAT;
+	case AIN_ARRAY_STRING: return AIN_STRING;
+	case AIN_ARRAY_STRUCT: return AIN_STRUCT;
+	case AIN_ARRAY_BOOL: return AIN_BOOL;
+	case AIN_ARRAY_LONG_INT: return AIN_LONG_INT;
+	default: return AIN_VOID;
+	}
+}
+
+void vm_wait_for_save(void) {}
+
+char *unix_path(const char *path)
+{
+	return xstrdup(path);
+}
+
+const char *display_utf0(const char *utf)
+{
+	return utf;
+}
+
+void json_load_page(struct page *page, cJSON *vars, bool call_dtors)
+{
+	ERROR("legacy JSON path reached");
+}
+
+_Noreturn void _vm_error(const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	abort();
+}
+
+/*
+ * Building and comparing values.
+ */
+
+static uint32_t rng = 2654435769;
+
+static uint32_t rand32(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+static struct page *new_page(enum page_type type, int nr_vars)
+{
+	struct page *page = xcalloc(1, sizeof(struct page) + nr_vars * sizeof(union vm_value));
+	page->type = type;
+	page->nr_vars = nr_vars;
+	return page;
+}
+
+// non-NUL bytes, including SJIS lead bytes
+static int random_string(int max_len)
+{
+	char buf[1024];
+	int len = rand32() % (max_len + 1);
+	for (int i = 0; i < len; i++) {
+		buf[i] = 1 + rand32() % 255;
+	}
+	return heap_put(make_string(buf, len), true);
+}
+
+static union vm_value random_value(enum ain_data_type type, int struct_type, int rank, int scale);
+
+static struct page *random_struct(int struct_type, int scale)
+{
+	struct ain_struct *s = &ain->structures[struct_type];
+	struct page *page = new_page(STRUCT_PAGE, s->nr_members);
+	page->index = struct_type;
+	for (int i = 0; i < s->nr_members; i++) {
+		struct ain_type *t = &s->members[i].type;
+		page->values[i] = random_value(t->data, t->struc, t->rank, scale);
+	}
+	return page;
+}
+
+static struct page *random_array(enum ain_data_type a_type, int struct_type, int rank, int scale)
+{
+	// keep multidimensional arrays to a reasonable size
+	if (rank > 1)
+		scale /= 64;
+	int n = rand32() % (scale + 1);
+	struct page *page = new_page(ARRAY_PAGE, n);
+	page->a_type = a_type;
+	page->array.struct_type = struct_type;
+	page->array.rank = rank;
+	for (int i = 0; i < n; i++) {
+		if (rank > 1)
+			page->values[i].i = heap_put(random_array(a_type, struct_type, rank - 1, scale), false);
+		else
+			page->values[i] = random_value(array_type(a_type), struct_type, 0, scale);
+	}
+	return page;
+}
+
+static union vm_value random_value(enum ain_data_type type, int struct_type, int rank, int scale)
+{
+	switch (type) {
+	case AIN_INT:
+	case AIN_LONG_INT:
+		return (union vm_value) { .i = rand32() };
+	case AIN_BOOL:
+		return (union vm_value) { .i = rand32() % 2 };
+	case AIN_FLOAT:
+		return (union vm_value) { .f = (float)(int32_t)rand32() / (1 + rand32() % 1000) };
+	case AIN_STRING:
+		return (union vm_value) { .i = random_string(min(scale, 1000)) };
+	case AIN_STRUCT:
+		return (union vm_value) { .i = heap_put(random_struct(struct_type, scale / 8), false) };
+	default:
+		return (union vm_value) { .i = heap_put(random_array(type, struct_type, rank, scale), false) };
+	}
+}
+
+static union vm_value blank_value(union vm_value v, enum ain_data_type type);
+
+// a page of the same shape with zeros and empty strings
+static struct page *blank_copy(struct page *src)
+{
+	struct page *page = new_page(src->type, src->nr_vars);
+	page->index = src->index;
+	page->array = src->array;
+	for (int i = 0; i < src->nr_vars; i++) {
+		enum ain_data_type type;
+		if (src->type == STRUCT_PAGE)
+			type = ain->structures[src->index].members[i].type.data;
+		else
+			type = src->array.rank > 1 ? src->a_type : array_type(src->a_type);
+		page->values[i] = blank_value(src->values[i], type);
+	}
+	return page;
+}
+
+static union vm_value blank_value(union vm_value v, enum ain_data_type type)
+{
+	switch (type) {
+	case AIN_INT:
+	case AIN_LONG_INT:
+	case AIN_BOOL:
+	case AIN_FLOAT:
+		return (union vm_value) { .i = 0 };
+	case AIN_STRING:
+		return (union vm_value) { .i = heap_put(make_string("", 0), true) };
+	default:
+		return (union vm_value) { .i = heap_put(blank_copy(heap_get_page(v.i)), false) };
+	}
+}
+
+static struct page *blank_record(struct page *src)
+{
+	struct page *page = blank_copy(src);
+	heap_put(page, false);
+	return page;
+}
+
+static bool pages_equal(struct page *a, struct page *b)
+{
+	if (a->type != b->type || a->nr_vars != b->nr_vars)
+		return false;
+	for (int i = 0; i < a->nr_vars; i++) {
+		enum ain_data_type type;
+		if (a->type == STRUCT_PAGE)
+			type = ain->structures[a->index].members[i].type.data;
+		else
+			type = a->array.rank > 1 ? a->a_type : array_type(a->a_type);
+		union vm_value va = a->values[i], vb = b->values[i];
+		switch (type) {
+		case AIN_INT:
+		case AIN_LONG_INT:
+		case AIN_BOOL:
+		case AIN_FLOAT:
+			// floats are compared bitwise
+			if (va.i != vb.i)
+				return false;
+			break;
+		case AIN_STRING: {
+			struct string *sa = heap_get_string(va.i), *sb = heap_get_string(vb.i);
+			if (sa->size != sb->size || memcmp(sa->text, sb->text, sa->size))
+				return false;
+			break;
+		}
+		default:
+			if (!pages_equal(heap_get_page(va.i), heap_get_page(vb.i)))
+				return false;
+			break;
+		}
+	}
+	return true;
+}
+
+static long file_size(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f)
+		return -1;
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fclose(f);
+	return size;
+}
+
+static uint8_t *read_file(const char *path, long *size)
+{
+	*size = file_size(path);
+	uint8_t *buf = xmalloc(*size);
+	FILE *f = fopen(path, "rb");
+	TEST_ASSERT(fread(buf, *size, 1, f) == 1);
+	fclose(f);
+	return buf;
+}
+
+static void write_file(const char *path, const uint8_t *data, long size)
+{
+	FILE *f = fopen(path, "wb");
+	TEST_ASSERT(fwrite(data, size, 1, f) == 1);
+	fclose(f);
+}
+
+static int file_open(const char *path, int mode)
+{
+	struct string *name = make_string(path, strlen(path));
+	int r = File_Open(name, mode);
+	free_string(name);
+	return r;
+}
+
+/*
+ * Tests.
+ */
+
+#define NR_RECORDS 3
+
+static struct page *records[NR_RECORDS];
+
+static void write_records(void)
+{
+	for (int i = 0; i < NR_RECORDS; i++) {
+		// the last record is large: several megabytes of data
+		records[i] = random_struct(RECORD_T, i == NR_RECORDS - 1 ? 20000 : 12);
+		heap_put(records[i], false);
+	}
+	TEST_ASSERT(file_open(TEST_FILE, FILE_WRITE));
+	for (int i = 0; i < NR_RECORDS; i++) {
+		TEST_EQUAL(File_Write(records[i]), 1);
+	}
+	TEST_EQUAL(File_Close(), 1);
+}
+
+static void test_read_records(const char *path)
+{
+	TEST_ASSERT(file_open(path, FILE_READ));
+	for (int i = 0; i < NR_RECORDS; i++) {
+		struct page *page = blank_record(records[i]);
+		TEST_EQUAL(File_Read(&page), 1);
+		TEST_ASSERT(pages_equal(page, records[i]));
+	}
+	// reading past the end fails
+	struct page *page = blank_record(records[0]);
+	TEST_EQUAL(File_Read(&page), 0);
+	TEST_EQUAL(File_Close(), 1);
+}
+
+// the header is the uncompressed size, followed by a plain zlib stream
+static void test_format(void)
+{
+	long size;
+	uint8_t *data = read_file(TEST_FILE, &size);
+	uLongf raw_size = LittleEndian_getDW(data, 0);
+	TEST_ASSERT(raw_size > STREAM_BUFFER_SIZE * 16);
+	uint8_t *raw = xmalloc(raw_size);
+	uLongf len = raw_size;
+	TEST_EQUAL(uncompress(raw, &len, data + 4, size - 4), Z_OK);
+	TEST_EQUAL(len, raw_size);
+
+	// a file written by the old File.Write, which compressed all at once
+	uLongf old_size = compressBound(raw_size);
+	uint8_t *old = xmalloc(4 + old_size);
+	LittleEndian_putDW(old, 0, raw_size);
+	TEST_EQUAL(compress(old + 4, &old_size, raw, raw_size), Z_OK);
+	write_file(TEST_FILE_OLD, old, 4 + old_size);
+	test_read_records(TEST_FILE_OLD);
+
+	// truncated in the middle of the large record
+	write_file(TEST_FILE_TRUNCATED, data, size / 2);
+	TEST_ASSERT(file_open(TEST_FILE_TRUNCATED, FILE_READ));
+	for (int i = 0; i < NR_RECORDS - 1; i++) {
+		struct page *page = blank_record(records[i]);
+		TEST_EQUAL(File_Read(&page), 1);
+	}
+	struct page *page = blank_record(records[NR_RECORDS - 1]);
+	TEST_EQUAL(File_Read(&page), 0);
+	TEST_EQUAL(File_Close(), 1);
+
+	free(old);
+	free(raw);
+	free(data);
+}
+
+/*
+ * Benchmark.
+ */
+
+#define BENCH_FILE "test_file_bench.tmp"
+#define BENCH_SIZE (50 * 1024 * 1024)
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double max_rss_mb(void)
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_maxrss / 1024.0;
+}
+
+static void bench(void)
+{
+	// Build records until they make up BENCH_SIZE, counting the bytes
+	// written to the stream so far. This pass is not timed.
+	int nr_records = 0, cap = 64;
+	struct page **bench_records = xmalloc(cap * sizeof(struct page*));
+	TEST_ASSERT(file_open(BENCH_FILE, FILE_WRITE));
+	while (stream.z.total_in + stream.len < BENCH_SIZE) {
+		if (nr_records == cap) {
+			cap *= 2;
+			bench_records = xrealloc(bench_records, cap * sizeof(struct page*));
+		}
+		struct page *record = random_struct(RECORD_T, 2000);
+		heap_put(record, false);
+		File_Write(record);
+		bench_records[nr_records++] = record;
+	}
+	File_Close();
+
+	struct page **blanks = xmalloc(nr_records * sizeof(struct page*));
+	for (int i = 0; i < nr_records; i++) {
+		blanks[i] = blank_record(bench_records[i]);
+	}
+
+	// Reading allocates the records' arrays and strings either way, so
+	// only the memory used for writing is compared.
+	double rss = max_rss_mb();
+	double t = now();
+	TEST_ASSERT(file_open(BENCH_FILE, FILE_WRITE));
+	for (int i = 0; i < nr_records; i++) {
+		TEST_EQUAL(File_Write(bench_records[i]), 1);
+	}
+	TEST_EQUAL(File_Close(), 1);
+	double t_write = now() - t;
+	double rss_stream = max_rss_mb() - rss;
+
+	t = now();
+	TEST_ASSERT(file_open(BENCH_FILE, FILE_READ));
+	for (int i = 0; i < nr_records; i++) {
+		TEST_EQUAL(File_Read(&blanks[i]), 1);
+	}
+	TEST_EQUAL(File_Close(), 1);
+	double t_read = now() - t;
+
+	int nr_different = 0;
+	for (int i = 0; i < nr_records; i++) {
+		nr_different += !pages_equal(blanks[i], bench_records[i]);
+	}
+	TEST_EQUAL(nr_different, 0);
+
+	// the zlib part of the old File.Read and File.Write alone
+	t = now();
+	long size;
+	uint8_t *data = read_file(BENCH_FILE, &size);
+	uLongf raw_size = LittleEndian_getDW(data, 0);
+	uint8_t *raw = xmalloc(raw_size);
+	uLongf len = raw_size;
+	TEST_EQUAL(uncompress(raw, &len, data + 4, size - 4), Z_OK);
+	double t_uncompress = now() - t;
+	free(data);
+
+	rss = max_rss_mb();
+	t = now();
+	uLongf compressed_size = compressBound(raw_size);
+	uint8_t *compressed = xmalloc(4 + compressed_size);
+	LittleEndian_putDW(compressed, 0, raw_size);
+	TEST_EQUAL(compress(compressed + 4, &compressed_size, raw, raw_size), Z_OK);
+	write_file(BENCH_FILE, compressed, 4 + compressed_size);
+	double t_compress = now() - t;
+	// the old writer also held the uncompressed document
+	double rss_whole = max_rss_mb() - rss + raw_size / (1024.0 * 1024.0);
+	free(compressed);
+	free(raw);
+
+	printf("%d records, %.1f MB (%.1f MB compressed)\n", nr_records,
+	       raw_size / (1024.0 * 1024.0), size / (1024.0 * 1024.0));
+	printf("streamed:     write %.2f s, read %.2f s, memory for writing +%.1f MB\n",
+	       t_write, t_read, rss_stream);
+	printf("whole buffer: compress %.2f s, uncompress %.2f s (zlib alone), memory for writing +%.1f MB\n",
+	       t_compress, t_uncompress, rss_whole);
+
+	free(bench_records);
+	free(blanks);
+	remove(BENCH_FILE);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1 && !strcmp(argv[1], "--bench")) {
+		bench();
+		heap_free_all();
+		return test_finish("file bench");
+	}
+
+	write_records();
+	test_read_records(TEST_FILE);
+	test_format();
+
+	// a file can be rewritten after it was read
+	write_records();
+	test_read_records(TEST_FILE);
+
+	remove(TEST_FILE);
+	remove(TEST_FILE_OLD);
+	remove(TEST_FILE_TRUNCATED);
+	heap_free_all();
+	return test_finish("file");
+}
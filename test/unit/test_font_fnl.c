@@ -0,0 +1,233 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <time.h>
+
+#include "../../src/font_fnl.c"
+#include "test.h"
+
+/*
+ * Downscales random full-size FNL glyphs with fnl_font_get_glyph at every
+ * denominator a font offers, and checks that the result is identical to the
+ * per-block loop the box filter replaced (copied below).
+ *
+ * Usage: test_font_fnl
+ *        test_font_fnl --bench
+ *
+ * --bench reports the time per downscaled glyph for both filters instead.
+ */
+
+#define NR_DENOMINATORS 12
+#define NR_GLYPHS 300
+
+bool game_rance7_mg = false;
+bool gfx_text_advance_edges = false;
+
+static uint32_t rng = 1597334677;
+
+static uint32_t rand32(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+// the old filter
+static void ref_downscale(struct fnl_bitmap_glyph *fullsize, unsigned denominator,
+		struct glyph_bitmap *glyph)
+{
+	const unsigned block_width = fullsize->width / denominator;
+	const unsigned block_height = fullsize->height / denominator;
+	const unsigned width = block_width + GLYPH_BORDER_SIZE*2;
+	const unsigned height = block_height + GLYPH_BORDER_SIZE*2;
+	const unsigned off_x = GLYPH_BORDER_SIZE;
+	const unsigned off_y = GLYPH_BORDER_SIZE;
+
+	uint8_t *pixels = xcalloc(1, width * height);
+	unsigned *acc = xcalloc(block_width * block_height, sizeof(unsigned));
+	for (unsigned i = 0; i < block_width * block_height; i++) {
+		unsigned dst_row = i / block_width;
+		unsigned dst_col = i % block_width;
+		for (unsigned r = 0; r < denominator; r++) {
+			unsigned src_row = dst_row * denominator + r;
+			for (unsigned c = 0; c < denominator; c++) {
+				unsigned src_col = dst_col * denominator + c;
+				acc[i] += fullsize->pixels[src_row*fullsize->width + src_col];
+			}
+		}
+		uint8_t p = acc[i] / (denominator * denominator);
+		pixels[(dst_row+off_y)*width + (dst_col+off_x)] = p;
+	}
+
+	glyph->width = width;
+	glyph->height = height;
+	glyph->pixels = pixels;
+	glyph->rect.x = off_x;
+	glyph->rect.y = off_y;
+	glyph->rect.w = block_width;
+	glyph->rect.h = block_height;
+	glyph->advance = fullsize->advance / (float)denominator;
+	free(acc);
+}
+
+/*
+ * A font with one face whose glyph for 'A' is already decoded, so that
+ * fnl_get_bitmap_glyph returns it without reading FNL data.
+ */
+struct test_font {
+	struct fnl_font_face face;
+	struct fnl_bitmap_size bitmap_size;
+	struct fnl_font_size sizes[NR_DENOMINATORS];
+	struct fnl_bitmap_glyph fullsize;
+	unsigned index;
+};
+
+static void init_font(struct test_font *font)
+{
+	font->index = fnl_char_to_index('A');
+	font->face.nr_glyphs = font->index + 1;
+	font->face.glyphs = xcalloc(font->index + 1, sizeof(struct fnl_glyph));
+	font->face.glyphs[font->index].data_pos = 1;
+	font->bitmap_size.face = &font->face;
+	font->bitmap_size.nr_glyphs = font->index + 1;
+	font->bitmap_size.glyphs = xcalloc(font->index + 1, sizeof(struct fnl_bitmap_glyph*));
+	font->bitmap_size.glyphs[font->index] = &font->fullsize;
+	for (unsigned i = 0; i < NR_DENOMINATORS; i++) {
+		font->sizes[i].bitmap_size = &font->bitmap_size;
+		font->sizes[i].denominator = i + 1;
+	}
+}
+
+static void free_font(struct test_font *font)
+{
+	free(font->face.glyphs);
+	free(font->bitmap_size.glyphs);
+}
+
+// Full-size glyphs are 1-bit bitmaps expanded to 0/255, with widths padded
+// to whole bytes.
+static void random_glyph(struct fnl_bitmap_glyph *glyph, bool any_value)
+{
+	glyph->width = 8 * (1 + rand32() % 16);
+	glyph->height = 1 + rand32() % 128;
+	glyph->advance = rand32() % (glyph->width + 1);
+	glyph->pixels = xmalloc(glyph->width * glyph->height);
+	for (unsigned i = 0; i < glyph->width * glyph->height; i++) {
+		uint32_t r = rand32();
+		glyph->pixels[i] = any_value ? r : (r & 1) ? 255 : 0;
+	}
+}
+
+static bool glyphs_equal(struct glyph_bitmap *a, struct glyph_bitmap *b)
+{
+	return a->width == b->width && a->height == b->height
+		&& a->rect.x == b->rect.x && a->rect.y == b->rect.y
+		&& a->rect.w == b->rect.w && a->rect.h == b->rect.h
+		&& a->advance == b->advance
+		&& !memcmp(a->pixels, b->pixels, (size_t)a->width * a->height);
+}
+
+static void test_equal(void)
+{
+	struct test_font font;
+	init_font(&font);
+
+	int nr_different = 0;
+	for (int g = 0; g < NR_GLYPHS; g++) {
+		// any_value also covers sums that 0/255 pixels can't produce
+		random_glyph(&font.fullsize, g % 4 == 0);
+		for (unsigned d = 1; d <= NR_DENOMINATORS; d++) {
+			struct glyph_bitmap actual, expected;
+			TEST_ASSERT(fnl_font_get_glyph(&font.sizes[d-1].super, &actual, 'A', FONT_WEIGHT_NORMAL));
+			ref_downscale(&font.fullsize, d, &expected);
+			if (!glyphs_equal(&actual, &expected) && nr_different++ < 5) {
+				fprintf(stderr, "%ux%u glyph, denominator %u differs\n",
+						font.fullsize.width, font.fullsize.height, d);
+			}
+			free(actual.pixels);
+			free(expected.pixels);
+		}
+		free(font.fullsize.pixels);
+	}
+	TEST_EQUAL(nr_different, 0);
+
+	// glyphs smaller than the denominator downscale to nothing
+	font.fullsize = (struct fnl_bitmap_glyph) { .width = 8, .height = 3, .advance = 8 };
+	font.fullsize.pixels = xcalloc(8, 3);
+	struct glyph_bitmap glyph;
+	TEST_ASSERT(fnl_font_get_glyph(&font.sizes[NR_DENOMINATORS-1].super, &glyph, 'A', FONT_WEIGHT_NORMAL));
+	TEST_EQUAL(glyph.rect.w, 0);
+	TEST_EQUAL(glyph.rect.h, 0);
+	TEST_EQUAL(glyph.width, GLYPH_BORDER_SIZE*2);
+	free(glyph.pixels);
+	free(font.fullsize.pixels);
+
+	free_font(&font);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// a typical full-size face: 64px, downscaled for text at every size
+static void bench(void)
+{
+	const int nr_runs = 200;
+	struct test_font font;
+	init_font(&font);
+	font.fullsize.width = 64;
+	font.fullsize.height = 64;
+	font.fullsize.advance = 60;
+	font.fullsize.pixels = xmalloc(64 * 64);
+	for (int i = 0; i < 64 * 64; i++) {
+		font.fullsize.pixels[i] = (rand32() & 1) ? 255 : 0;
+	}
+
+	printf("64x64 glyph; microseconds per glyph\n");
+	printf("denominator  box filter  per-block\n");
+	for (unsigned d = 1; d <= NR_DENOMINATORS; d++) {
+		struct glyph_bitmap glyph;
+		double t = now();
+		for (int i = 0; i < nr_runs; i++) {
+			fnl_font_get_glyph(&font.sizes[d-1].super, &glyph, 'A', FONT_WEIGHT_NORMAL);
+			free(glyph.pixels);
+		}
+		double t_new = (now() - t) / nr_runs * 1e6;
+		t = now();
+		for (int i = 0; i < nr_runs; i++) {
+			ref_downscale(&font.fullsize, d, &glyph);
+			free(glyph.pixels);
+		}
+		double t_old = (now() - t) / nr_runs * 1e6;
+		printf("%11u  %10.2f  %9.2f\n", d, t_new, t_old);
+	}
+	free(font.fullsize.pixels);
+	free_font(&font);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1 && !strcmp(argv[1], "--bench")) {
+		bench();
+		return test_finish("font_fnl bench");
+	}
+	test_equal();
+	return test_finish("font_fnl");
+}
@@ -0,0 +1,325 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <time.h>
+#include <uchar.h>
+
+#include "../../src/font_freetype.c"
+#include "test.h"
+
+/*
+ * Measures a Japanese paragraph with the cached advance/kerning path and
+ * checks the widths against direct FreeType queries (the code the caches
+ * replaced, copied below).
+ *
+ * Usage: test_font_freetype <font file>
+ *        test_font_freetype --bench <font file>
+ *
+ * Also requests thousands of font sizes and checks that only the most
+ * recently used ones stay resident while every font_size pointer handed out
+ * remains valid.
+ *
+ * --bench times the paragraph with and without the caches instead.
+ */
+
+static unsigned nr_trimmed;
+
+void gfx_font_size_free_glyphs(struct font_size *size)
+{
+	nr_trimmed++;
+}
+
+static const char32_t paragraph[] =
+	U"吾輩は猫である。名前はまだ無い。どこで生れたかとんと見当がつかぬ。"
+	U"何でも薄暗いじめじめした所でニャーニャー泣いていた事だけは記憶している。"
+	U"吾輩はここで始めて人間というものを見た。しかもあとで聞くとそれは書生という"
+	U"人間中で一番獰悪な種族であったそうだ。この書生というのは時々我々を捕えて"
+	U"煮て食うという話である。しかしその当時は何という考もなかったから別段恐しい"
+	U"とも思わなかった。ただ彼の掌に載せられてスーと持ち上げられた時何だかフワフワ"
+	U"した感じがあったばかりである。(Natsume Soseki, 1905) ＡＢＣ ｱｲｳ AVAWAYTo.";
+#define PARAGRAPH_LEN (sizeof(paragraph) / sizeof(*paragraph) - 1)
+
+static const float sizes[] = { 12, 16, 20, 24, 28, 32 };
+#define NR_SIZES (sizeof(sizes) / sizeof(*sizes))
+
+// the old, uncached ft_font_size_char_kerning
+static float ref_size_char_kerning(struct font_size *size, uint32_t code, uint32_t code_next)
+{
+	struct font_ft *font = (struct font_ft*)size->font;
+	ft_font_set_size(font, size->size);
+
+	FT_Fixed advance;
+	FT_UInt index = FT_Get_Char_Index(font->font, code);
+	FT_UInt next_index = FT_Get_Char_Index(font->font, code_next);
+	FT_Get_Advance(font->font, index, FT_LOAD_DEFAULT, &advance);
+	if (!FT_HAS_KERNING(font->font)) {
+		return advance / 65536.f;
+	}
+	FT_Vector delta;
+	FT_Get_Kerning(font->font, index, next_index, FT_KERNING_DEFAULT, &delta);
+	return (advance / 65536.f) + (delta.x / 64.f);
+}
+
+typedef float (*size_char_kerning_fn)(struct font_size*, uint32_t, uint32_t);
+
+// Lay out the paragraph as NewFont does: one call per character pair.
+static float measure(size_char_kerning_fn fn, struct font_size *size)
+{
+	float x = 0.f;
+	for (unsigned i = 0; i < PARAGRAPH_LEN; i++) {
+		x += fn(size, paragraph[i], paragraph[i+1]);
+	}
+	return x;
+}
+
+static void test_identical(struct font *font)
+{
+	int nr_different = 0;
+	// the second pass is served from the caches
+	for (int pass = 0; pass < 2; pass++) {
+		for (unsigned s = 0; s < NR_SIZES; s++) {
+			struct font_size *size = font->get_size(font, sizes[s]);
+			for (unsigned i = 0; i < PARAGRAPH_LEN; i++) {
+				uint32_t code = paragraph[i], next = paragraph[i+1];
+				float cached = font->size_char_kerning(size, code, next);
+				if (cached != ref_size_char_kerning(size, code, next) && nr_different++ < 5) {
+					fprintf(stderr, "size %g, U+%04X U+%04X differs\n",
+							size->size, code, next);
+				}
+			}
+		}
+	}
+	TEST_EQUAL(nr_different, 0);
+
+	// every code point of a few dense ranges, so that neighbouring entries
+	// in an advance page are exercised
+	static const uint32_t ranges[][2] = {
+		{ 0x20, 0x17f }, { 0x3000, 0x30ff }, { 0x4e00, 0x4fff }, { 0xff00, 0xffef },
+	};
+	nr_different = 0;
+	for (int pass = 0; pass < 2; pass++) {
+		struct font_size *size = font->get_size(font, sizes[1]);
+		for (unsigned r = 0; r < sizeof(ranges) / sizeof(*ranges); r++) {
+			for (uint32_t code = ranges[r][0]; code <= ranges[r][1]; code++) {
+				float cached = font->size_char_kerning(size, code, 'A');
+				if (cached != ref_size_char_kerning(size, code, 'A') && nr_different++ < 5) {
+					fprintf(stderr, "U+%04X differs\n", code);
+				}
+			}
+		}
+	}
+	TEST_EQUAL(nr_different, 0);
+
+	// code points outside the BMP bypass the caches
+	struct font_size *size = font->get_size(font, sizes[0]);
+	TEST_ASSERT(font->size_char_kerning(size, 0x1F600, 'A')
+			== ref_size_char_kerning(size, 0x1F600, 'A'));
+}
+
+// The fonts shipped with xsystem4 have no kerning table, so exercise the
+// kerning memo directly: FreeType reports 0 for every pair.
+static void test_kerning_memo(struct font *font)
+{
+	struct ft_font_size *size = (struct ft_font_size*)font->get_size(font, sizes[0]);
+	const unsigned nr_pairs = 5000;
+	for (unsigned i = 0; i < nr_pairs; i++) {
+		TEST_EQUAL(ft_font_get_kerning(size, 0x3000 + i, 0x3000 + i * 7), 0);
+	}
+	TEST_EQUAL(size->nr_kerning, nr_pairs);
+	TEST_ASSERT(size->nr_kerning * 2 <= size->kerning_cap);
+	unsigned nr_missing = 0;
+	for (unsigned i = 0; i < nr_pairs; i++) {
+		uint32_t pair = (0x3000 + i) << 16 | (0x3000 + i * 7);
+		if (kerning_lookup(size, pair)->pair != pair)
+			nr_missing++;
+	}
+	TEST_EQUAL(nr_missing, 0);
+
+	// a repeated pair is not stored twice
+	ft_font_get_kerning(size, 0x3000, 0x3000);
+	TEST_EQUAL(size->nr_kerning, nr_pairs);
+
+	// the memo is cleared once it is full
+	for (unsigned i = 0; size->nr_kerning >= nr_pairs; i++) {
+		ft_font_get_kerning(size, 'A' + i / 0x8000, i % 0x8000);
+		TEST_ASSERT(size->nr_kerning <= KERNING_CACHE_MAX);
+	}
+	TEST_EQUAL(size->nr_kerning, 1);
+}
+
+#define NR_STRESS_SIZES 4000
+
+static uint32_t rng = 2463534242;
+
+static uint32_t rand32(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+// Check the LRU list against the last use of every size.
+static void check_lru(struct font_ft *font, struct font_size **sizes, unsigned *last_use)
+{
+	unsigned nr_listed = 0;
+	bool list_ok = true;
+	for (struct ft_font_size *fs = font->lru_head; fs; fs = fs->next) {
+		list_ok = list_ok && fs->resident && (fs->next ? fs->next->prev == fs : font->lru_tail == fs);
+		nr_listed++;
+	}
+	TEST_ASSERT(list_ok);
+	TEST_EQUAL(nr_listed, font->nr_resident);
+	TEST_EQUAL(font->nr_resident, MAX_RESIDENT_SIZES);
+
+	// the resident sizes are exactly the MAX_RESIDENT_SIZES most recently used
+	unsigned *sorted = xmalloc(NR_STRESS_SIZES * sizeof(unsigned));
+	memcpy(sorted, last_use, NR_STRESS_SIZES * sizeof(unsigned));
+	unsigned threshold = 0;
+	for (unsigned i = 0; i < MAX_RESIDENT_SIZES; i++) {
+		// partial selection: the i-th largest last use
+		unsigned max = i;
+		for (unsigned j = i + 1; j < NR_STRESS_SIZES; j++) {
+			if (sorted[j] > sorted[max])
+				max = j;
+		}
+		unsigned tmp = sorted[i];
+		sorted[i] = sorted[max];
+		sorted[max] = tmp;
+		threshold = sorted[i];
+	}
+	free(sorted);
+
+	unsigned nr_wrong = 0;
+	for (unsigned i = 0; i < NR_STRESS_SIZES; i++) {
+		struct ft_font_size *fs = (struct ft_font_size*)sizes[i];
+		bool recent = last_use[i] >= threshold;
+		if (fs->resident != recent)
+			nr_wrong++;
+		// trimmed sizes hold no metric caches
+		if (!fs->resident && (fs->advances || fs->kerning))
+			nr_wrong++;
+	}
+	TEST_EQUAL(nr_wrong, 0);
+}
+
+static void test_size_lru(const char *path)
+{
+	struct font *font = ft_font_load(path);
+	struct font_ft *ft = (struct font_ft*)font;
+	struct font_size *sizes[NR_STRESS_SIZES];
+	unsigned last_use[NR_STRESS_SIZES];
+	float widths[NR_STRESS_SIZES];
+	unsigned clock = 0;
+
+	nr_trimmed = 0;
+	for (unsigned i = 0; i < NR_STRESS_SIZES; i++) {
+		sizes[i] = font->get_size(font, i + 1);
+		last_use[i] = ++clock;
+		widths[i] = font->size_char_kerning(sizes[i], 0x3042, 'A');
+	}
+	TEST_EQUAL(nr_trimmed, NR_STRESS_SIZES - MAX_RESIDENT_SIZES);
+	check_lru(ft, sizes, last_use);
+
+	// sizes are keyed on the rounded pixel size, and never reallocated
+	unsigned nr_moved = 0;
+	for (unsigned i = 0; i < NR_STRESS_SIZES; i++) {
+		if (font->get_size(font, i + 1.3f) != sizes[i] || sizes[i]->size != i + 1)
+			nr_moved++;
+		last_use[i] = ++clock;
+	}
+	TEST_EQUAL(nr_moved, 0);
+	check_lru(ft, sizes, last_use);
+
+	// Mix requests, glyph lookups (touch_size) and measurement at random.
+	// Trimmed sizes must still measure the same as before.
+	unsigned nr_different = 0;
+	for (unsigned n = 0; n < 100000; n++) {
+		unsigned i = rand32() % NR_STRESS_SIZES;
+		// favour a small working set, as games do
+		if (rand32() % 4)
+			i %= 48;
+		switch (rand32() % 3) {
+		case 0:
+			TEST_ASSERT(font->get_size(font, i + 1) == sizes[i]);
+			break;
+		case 1:
+			font->touch_size(sizes[i]);
+			break;
+		case 2:
+			if (font->size_char_kerning(sizes[i], 0x3042, 'A') != widths[i])
+				nr_different++;
+			break;
+		}
+		last_use[i] = ++clock;
+		if (n % 10000 == 0)
+			check_lru(ft, sizes, last_use);
+	}
+	TEST_EQUAL(nr_different, 0);
+	check_lru(ft, sizes, last_use);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(struct font *font)
+{
+	const int nr_runs = 200;
+	printf("%u character paragraph; microseconds per layout\n", (unsigned)PARAGRAPH_LEN);
+	printf("size  uncached  cached (first)  cached\n");
+	for (unsigned s = 0; s < NR_SIZES; s++) {
+		struct font_size *size = font->get_size(font, sizes[s]);
+		double t = now();
+		for (int i = 0; i < nr_runs; i++)
+			measure(ref_size_char_kerning, size);
+		double t_ref = (now() - t) / nr_runs * 1e6;
+		t = now();
+		measure(font->size_char_kerning, size);
+		double t_first = (now() - t) * 1e6;
+		t = now();
+		for (int i = 0; i < nr_runs; i++)
+			measure(font->size_char_kerning, size);
+		double t_cached = (now() - t) / nr_runs * 1e6;
+		printf("%4g  %8.1f  %14.1f  %6.1f\n", size->size, t_ref, t_first, t_cached);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	bool do_bench = argc == 3 && !strcmp(argv[1], "--bench");
+	if (argc != 2 && !do_bench) {
+		fprintf(stderr, "Usage: %s [--bench] <font file>\n", argv[0]);
+		return 2;
+	}
+	ft_font_init();
+	struct font *font = ft_font_load(argv[argc-1]);
+	TEST_ASSERT(font);
+	if (!font)
+		return test_finish("font_freetype");
+
+	if (do_bench) {
+		bench(font);
+		return test_finish("font_freetype bench");
+	}
+	test_identical(font);
+	test_kerning_memo(font);
+	test_size_lru(argv[1]);
+	return test_finish("font_freetype");
+}
@@ -0,0 +1,181 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <unistd.h>
+
+#include "../../src/font_freetype.c"
+#include "../../src/glyph_cache.c"
+#include "test.h"
+
+/*
+ * Rasterizes glyphs with FreeType into a glyph cache, then reopens the cache
+ * file as a later run would and checks that every cached glyph is
+ * byte-identical to a freshly rasterized one.
+ *
+ * Usage: test_glyph_cache <font file>
+ */
+
+#define HOME_DIR "test_glyph_cache.tmp"
+
+struct config config = { .home_dir = HOME_DIR };
+
+void gfx_font_size_free_glyphs(struct font_size *size) {}
+
+static const uint32_t codes[] = {
+	'A', 'g', 'W', '0', '.', 0xe9,    // half width
+	0x3042, 0x30a2, 0x6f22, 0x5b57,   // あ, ア, 漢, 字
+	0xff71, 0xff9f,                   // half width katakana
+	0x3000,                           // ideographic space (empty bitmap)
+};
+#define NR_CODES (sizeof(codes) / sizeof(*codes))
+
+static const float sizes[] = { 9, 16, 24, 33, 64 };
+#define NR_SIZES (sizeof(sizes) / sizeof(*sizes))
+
+static bool bitmaps_equal(struct glyph_bitmap *a, struct glyph_bitmap *b)
+{
+	return a->width == b->width && a->height == b->height
+		&& a->rect.x == b->rect.x && a->rect.y == b->rect.y
+		&& a->rect.w == b->rect.w && a->rect.h == b->rect.h
+		&& a->advance == b->advance
+		&& !memcmp(a->pixels, b->pixels, (size_t)a->width * a->height);
+}
+
+// Drop the open caches, as if xsystem4 had exited.
+static void close_caches(void)
+{
+	for (unsigned i = 0; i < nr_caches; i++) {
+		struct glyph_cache *cache = caches[i];
+		if (cache->out)
+			fclose(cache->out);
+		for (unsigned s = 0; s < cache->nr_sizes; s++) {
+			ht_free_int(cache->sizes[s].glyphs);
+		}
+		free(cache->sizes);
+		free(cache->data);
+		remove(cache->path);
+		free(cache->path);
+		free(cache);
+	}
+	free(caches);
+	caches = NULL;
+	nr_caches = 0;
+}
+
+static void fill_cache(struct font *font, struct glyph_cache *cache)
+{
+	for (unsigned s = 0; s < NR_SIZES; s++) {
+		struct font_size *size = font->get_size(font, sizes[s]);
+		for (unsigned c = 0; c < NR_CODES; c++) {
+			for (int w = 0; w < NR_FONT_WEIGHTS; w++) {
+				struct glyph_bitmap bitmap;
+				TEST_ASSERT(font->get_glyph(size, &bitmap, codes[c], w));
+				glyph_cache_put(cache, size->size, codes[c], w, &bitmap);
+				free(bitmap.pixels);
+			}
+		}
+	}
+}
+
+static void test_identical(struct font *font, const char *path)
+{
+	struct glyph_cache *cache = glyph_cache_open(path, 0, font->render_key);
+	TEST_ASSERT(cache);
+	if (!cache)
+		return;
+	fill_cache(font, cache);
+	TEST_ASSERT(!cache->write_failed);
+
+	// The file must survive a restart. Keep a copy, since close_caches
+	// deletes it.
+	size_t file_size;
+	uint8_t *file = file_read(cache->path, &file_size);
+	char *cache_path = xstrdup(cache->path);
+	close_caches();
+	FILE *f = fopen(cache_path, "wb");
+	fwrite(file, file_size, 1, f);
+	fclose(f);
+	free(file);
+
+	cache = glyph_cache_open(path, 0, font->render_key);
+	TEST_ASSERT(cache && !strcmp(cache->path, cache_path));
+	free(cache_path);
+	if (!cache)
+		return;
+	TEST_EQUAL(cache->valid_size, cache->data_size);
+
+	int nr_missing = 0, nr_different = 0;
+	for (unsigned s = 0; s < NR_SIZES; s++) {
+		struct font_size *size = font->get_size(font, sizes[s]);
+		for (unsigned c = 0; c < NR_CODES; c++) {
+			for (int w = 0; w < NR_FONT_WEIGHTS; w++) {
+				struct glyph_bitmap cached, fresh;
+				if (!glyph_cache_get(cache, size->size, codes[c], w, &cached)) {
+					nr_missing++;
+					continue;
+				}
+				TEST_ASSERT(font->get_glyph(size, &fresh, codes[c], w));
+				if (!bitmaps_equal(&cached, &fresh) && nr_different++ < 5) {
+					fprintf(stderr, "size %g, U+%04X, weight %d differs\n",
+							size->size, codes[c], w);
+				}
+				free(fresh.pixels);
+			}
+		}
+	}
+	TEST_EQUAL(nr_missing, 0);
+	TEST_EQUAL(nr_different, 0);
+	close_caches();
+}
+
+// A different rasterizer (e.g. another FreeType release) gets a new cache.
+static void test_render_key(struct font *font, const char *path)
+{
+	struct glyph_cache *cache = glyph_cache_open(path, 0, font->render_key);
+	TEST_ASSERT(cache);
+	if (!cache)
+		return;
+	fill_cache(font, cache);
+
+	struct glyph_cache *other = glyph_cache_open(path, 0, font->render_key ^ (1ULL << 32));
+	TEST_ASSERT(other && other != cache);
+	if (other) {
+		TEST_ASSERT(strcmp(other->path, cache->path));
+		struct glyph_bitmap bitmap;
+		TEST_ASSERT(!glyph_cache_get(other, sizes[0], 'A', FONT_WEIGHT_NORMAL, &bitmap));
+	}
+	TEST_ASSERT(font->render_key != 0);
+	close_caches();
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s <font file>\n", argv[0]);
+		return 2;
+	}
+	ft_font_init();
+	struct font *font = ft_font_load(argv[1]);
+	TEST_ASSERT(font);
+	if (!font)
+		return test_finish("glyph_cache");
+
+	test_identical(font, argv[1]);
+	test_render_key(font, argv[1]);
+	rmdir(HOME_DIR "/glyph-cache");
+	rmdir(HOME_DIR);
+	return test_finish("glyph_cache");
+}
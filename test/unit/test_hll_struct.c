@@ -0,0 +1,366 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "../../src/hll/hll.c"
+#include "test.h"
+
+/*
+ * hll_struct_member_slot must agree with a linear scan of the struct's
+ * member list (the lookup it replaced) for every member of every struct.
+ *
+ * Usage: test_hll_struct
+ *        test_hll_struct --bench
+ *
+ * --bench times an enemy update loop like PastelChime2's
+ * Field_UpdateEnemyPos over a synthetic dungeon instead.
+ */
+
+#define NR_BIG_MEMBERS 500
+
+struct ain *ain;
+
+static jmp_buf error_jmp;
+static bool expect_error = false;
+
+_Noreturn void _vm_error(const char *fmt, ...)
+{
+	if (!expect_error) {
+		va_list ap;
+		va_start(ap, fmt);
+		vfprintf(stderr, fmt, ap);
+		va_end(ap);
+		abort();
+	}
+	longjmp(error_jmp, 1);
+}
+
+// VM_ERROR exits without returning in release builds
+#ifndef RELEASE
+#define TEST_VM_ERROR(expr) \
+	do { \
+		volatile bool _raised = false; \
+		expect_error = true; \
+		if (setjmp(error_jmp)) \
+			_raised = true; \
+		else \
+			expr; \
+		expect_error = false; \
+		TEST_ASSERT(_raised && #expr); \
+	} while (0)
+#else
+#define TEST_VM_ERROR(expr)
+#endif
+
+static struct ain_variable pos_members[] = {
+	{ .name = "nX" }, { .name = "nY" }, { .name = "nDir" }, { .name = "nLock" },
+	{ .name = "fX1" }, { .name = "fY1" }, { .name = "fX2" }, { .name = "fY2" },
+};
+
+static struct ain_variable sjis_members[] = {
+	{ .name = "m_dsd" },
+	{ .name = "\x83\x58\x83\x65\x81\x5b\x83\x5e\x83\x58" },
+	{ .name = "" },
+	// duplicate names resolve to the first, as with a linear scan
+	{ .name = "m_dsd" },
+	{ .name = "m_dsd2" },
+};
+
+static struct ain_variable big_members[NR_BIG_MEMBERS];
+
+static struct ain_struct structures[] = {
+	{ .name = "pos_t", .nr_members = 8, .members = pos_members },
+	{ .name = "empty_t", .nr_members = 0, .members = NULL },
+	{ .name = "sjis_t", .nr_members = 5, .members = sjis_members },
+	{ .name = "big_t", .nr_members = NR_BIG_MEMBERS, .members = big_members },
+};
+
+static struct ain test_ain = {
+	.nr_structures = sizeof(structures) / sizeof(*structures),
+	.structures = structures,
+};
+
+static int linear_slot(int struct_type, const char *name)
+{
+	struct ain_struct *s = &ain->structures[struct_type];
+	for (int i = 0; i < s->nr_members; i++) {
+		if (!strcmp(s->members[i].name, name))
+			return i;
+	}
+	return -1;
+}
+
+static void test_all_members(void)
+{
+	for (int t = 0; t < ain->nr_structures; t++) {
+		struct ain_struct *s = &ain->structures[t];
+		for (int i = 0; i < s->nr_members; i++) {
+			int slot = hll_struct_member_slot(t, s->members[i].name);
+			if (slot != linear_slot(t, s->members[i].name))
+				TEST_EQUAL(slot, linear_slot(t, s->members[i].name));
+		}
+	}
+	TEST_EQUAL(hll_struct_member_slot(0, "fY2"), 7);
+	TEST_EQUAL(hll_struct_member_slot(2, "m_dsd"), 0);
+	TEST_EQUAL(hll_struct_member_slot(2, ""), 2);
+	TEST_EQUAL(hll_struct_member_slot(2, "m_dsd2"), 4);
+	TEST_EQUAL(hll_struct_member_slot(3, "m0"), 0);
+	TEST_EQUAL(hll_struct_member_slot(3, "m499"), NR_BIG_MEMBERS - 1);
+}
+
+static void test_member_pointer(void)
+{
+	struct page *page = xcalloc(1, sizeof(struct page) + 8 * sizeof(union vm_value));
+	page->type = STRUCT_PAGE;
+	page->index = 0;
+	page->nr_vars = 8;
+	for (int i = 0; i < 8; i++) {
+		page->values[i].i = i * 10;
+	}
+	TEST_ASSERT(hll_struct_member(page, "nDir") == &page->values[2]);
+	TEST_EQUAL(hll_struct_member(page, "fX2")->i, 60);
+
+	page->type = ARRAY_PAGE;
+	TEST_VM_ERROR(hll_struct_member(page, "nDir"));
+	free(page);
+}
+
+static void test_errors(void)
+{
+	TEST_VM_ERROR(hll_struct_member_slot(0, "nx"));
+	TEST_VM_ERROR(hll_struct_member_slot(0, "nX "));
+	TEST_VM_ERROR(hll_struct_member_slot(1, "nX"));
+	TEST_VM_ERROR(hll_struct_member_slot(-1, "nX"));
+	TEST_VM_ERROR(hll_struct_member_slot(ain->nr_structures, "nX"));
+	TEST_VM_ERROR(hll_struct_member_slot(3, "m500"));
+}
+
+/*
+ * A dungeon of enemies. Enemy structs have as many members as the game's,
+ * with the ones the update reads among them. Positions are separate
+ * structs, referenced by index as the VM heap would.
+ */
+#define NR_ENEMIES 400
+#define NR_FRAMES 2000
+
+enum { ENEMY_T, POS_T };
+
+static struct ain_variable enemy_members[] = {
+	{ .name = "nID" }, { .name = "nType" }, { .name = "nNo" }, { .name = "sName" },
+	{ .name = "nHP" }, { .name = "nMaxHP" }, { .name = "nAttack" }, { .name = "nDefense" },
+	{ .name = "nLevel" }, { .name = "nExp" }, { .name = "nGold" }, { .name = "nItem" },
+	{ .name = "nDropRate" }, { .name = "nSprite" }, { .name = "nAnime" }, { .name = "nAnimeCount" },
+	{ .name = "nDir" }, { .name = "nEventNo" }, { .name = "nFlag" }, { .name = "bShow" },
+	{ .name = "bActive" }, { .name = "bBoss" }, { .name = "fposPrev" }, { .name = "fAngle" },
+	{ .name = "fScale" }, { .name = "fHeight" }, { .name = "fRadius" }, { .name = "nWaitCount" },
+	{ .name = "fpos" }, { .name = "fposBase" }, { .name = "nEventType" }, { .name = "bFound" },
+	{ .name = "fWalkStep" }, { .name = "fSenseRange" }, { .name = "nAppearanceCount" },
+	{ .name = "nStopCount" },
+};
+
+static struct ain_variable fpos_members[] = {
+	{ .name = "x" }, { .name = "y" },
+};
+
+static struct ain_struct bench_structures[] = {
+	[ENEMY_T] = { .name = "enemy_t", .nr_members = sizeof(enemy_members) / sizeof(*enemy_members),
+		.members = enemy_members },
+	[POS_T] = { .name = "fpos_t", .nr_members = 2, .members = fpos_members },
+};
+
+static struct ain bench_ain = {
+	.nr_structures = sizeof(bench_structures) / sizeof(*bench_structures),
+	.structures = bench_structures,
+};
+
+struct dungeon {
+	struct page *enemies[NR_ENEMIES];
+	// fpos and fposBase of each enemy
+	struct page *positions[NR_ENEMIES * 2];
+};
+
+static struct page *alloc_struct_page(int type)
+{
+	int nr_vars = bench_structures[type].nr_members;
+	struct page *page = xcalloc(1, sizeof(struct page) + nr_vars * sizeof(union vm_value));
+	page->type = STRUCT_PAGE;
+	page->index = type;
+	page->nr_vars = nr_vars;
+	return page;
+}
+
+static uint32_t rng = 88675123;
+
+static uint32_t rand32(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+static void make_dungeon(struct dungeon *d)
+{
+	rng = 88675123;
+	for (int i = 0; i < NR_ENEMIES; i++) {
+		struct page *e = alloc_struct_page(ENEMY_T);
+		for (int j = 0; j < 2; j++) {
+			struct page *pos = alloc_struct_page(POS_T);
+			pos->values[0].f = rand32() % 64;
+			pos->values[1].f = rand32() % 64;
+			d->positions[i*2 + j] = pos;
+		}
+		e->values[linear_slot(ENEMY_T, "fpos")].i = i * 2;
+		e->values[linear_slot(ENEMY_T, "fposBase")].i = i * 2 + 1;
+		e->values[linear_slot(ENEMY_T, "bFound")].i = rand32() % 4 != 0;
+		e->values[linear_slot(ENEMY_T, "fWalkStep")].f = 0.01f;
+		e->values[linear_slot(ENEMY_T, "fSenseRange")].f = 8.f;
+		e->values[linear_slot(ENEMY_T, "nAppearanceCount")].i = rand32() % 500;
+		e->values[linear_slot(ENEMY_T, "nStopCount")].i = rand32() % 1000;
+		d->enemies[i] = e;
+	}
+}
+
+static void free_dungeon(struct dungeon *d)
+{
+	for (int i = 0; i < NR_ENEMIES; i++) {
+		free(d->enemies[i]);
+		free(d->positions[i*2]);
+		free(d->positions[i*2 + 1]);
+	}
+}
+
+/*
+ * The member accesses of Field_UpdateEnemyPos, resolving every member by
+ * name on every access as struct_get_var does. Enemies walk towards the
+ * player, or back to their base when it is out of range.
+ */
+static int nr_moves = 0;
+
+static void update_enemies(struct dungeon *d, int (*slot)(int, const char*), int delta_time)
+{
+	const float player_x = 32.f, player_y = 32.f;
+	for (int i = 0; i < NR_ENEMIES; i++) {
+		union vm_value *e = d->enemies[i]->values;
+		union vm_value *appearance_count = &e[slot(ENEMY_T, "nAppearanceCount")];
+		if (appearance_count->i > 0) {
+			appearance_count->i = max(appearance_count->i - delta_time, 0);
+			continue;
+		}
+		union vm_value *stop_count = &e[slot(ENEMY_T, "nStopCount")];
+		if (stop_count->i > 0) {
+			stop_count->i = max(stop_count->i - delta_time, 0);
+			continue;
+		}
+		float walk_step = e[slot(ENEMY_T, "fWalkStep")].f;
+		float sense_range = e[slot(ENEMY_T, "fSenseRange")].f;
+		if (walk_step == 0.f || sense_range == 0.f || !e[slot(ENEMY_T, "bFound")].i)
+			continue;
+
+		union vm_value *pos = d->positions[e[slot(ENEMY_T, "fpos")].i]->values;
+		union vm_value *base = d->positions[e[slot(ENEMY_T, "fposBase")].i]->values;
+		float x = pos[slot(POS_T, "x")].f, y = pos[slot(POS_T, "y")].f;
+		float dx = player_x - x, dy = player_y - y;
+		if (dx * dx + dy * dy > sense_range * sense_range) {
+			e[slot(ENEMY_T, "nEventType")].i = 0;
+			dx = base[slot(POS_T, "x")].f - x;
+			dy = base[slot(POS_T, "y")].f - y;
+		}
+		float norm = sqrtf(dx * dx + dy * dy);
+		if (norm < 1e-3f)
+			continue;
+		float step = min(walk_step * delta_time, norm);
+		pos[slot(POS_T, "x")].f = x + dx / norm * step;
+		pos[slot(POS_T, "y")].f = y + dy / norm * step;
+		nr_moves++;
+	}
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double run_frames(struct dungeon *d, int (*slot)(int, const char*))
+{
+	make_dungeon(d);
+	double t = now();
+	for (int frame = 0; frame < NR_FRAMES; frame++) {
+		update_enemies(d, slot, 16);
+	}
+	return (now() - t) / NR_FRAMES * 1e6;
+}
+
+static bool dungeons_equal(struct dungeon *a, struct dungeon *b)
+{
+	for (int i = 0; i < NR_ENEMIES * 2; i++) {
+		if (memcmp(a->positions[i]->values, b->positions[i]->values, 2 * sizeof(union vm_value)))
+			return false;
+	}
+	return true;
+}
+
+static void bench(void)
+{
+	ain = &bench_ain;
+	static struct dungeon linear, hashed;
+	double t_linear = run_frames(&linear, linear_slot);
+	double t_hashed = run_frames(&hashed, hll_struct_member_slot);
+	TEST_ASSERT(dungeons_equal(&linear, &hashed));
+	// make sure the comparison wasn't vacuous
+	TEST_ASSERT(nr_moves > NR_ENEMIES * NR_FRAMES / 10);
+
+	printf("%d enemies, %d frames; microseconds per frame\n", NR_ENEMIES, NR_FRAMES);
+	printf("linear scan %.2f, hashed %.2f\n", t_linear, t_hashed);
+
+	free_dungeon(&linear);
+	free_dungeon(&hashed);
+	hll_struct_members_fini();
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1 && !strcmp(argv[1], "--bench")) {
+		bench();
+		return test_finish("hll_struct bench");
+	}
+
+	char names[NR_BIG_MEMBERS][8];
+	for (int i = 0; i < NR_BIG_MEMBERS; i++) {
+		snprintf(names[i], sizeof(names[i]), "m%d", i);
+		big_members[i].name = names[i];
+	}
+	ain = &test_ain;
+
+	test_all_members();
+	// the second pass is served from the tables built by the first
+	test_all_members();
+	test_member_pointer();
+	test_errors();
+
+	// tables are rebuilt after being freed (e.g. when the VM is reset)
+	hll_struct_members_fini();
+	test_all_members();
+	hll_struct_members_fini();
+
+	return test_finish("hll_struct");
+}
@@ -0,0 +1,762 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+#include <time.h>
+
+#include "../../src/hll/iarray.c"
+#include "test.h"
+
+/*
+ * Serializes random nested structs and arrays with iarray_write_struct and
+ * iarray_write_array, reads them back and compares. Also pins the output
+ * format on a hand-written example, checks that the output is the same as
+ * the old writer's (copied below), and that truncated input is reported.
+ *
+ * Usage: test_iarray
+ *        test_iarray --bench
+ *
+ * --bench times writing and reading a few hundred random save_t structs
+ * with the old writer and reader and with the current ones.
+ */
+
+#define NR_ROUND_TRIPS 500
+
+enum { POINT_T, ITEM_T, SAVE_T };
+
+static struct ain_variable point_members[] = {
+	{ .name = "x", .type = { .data = AIN_INT } },
+	{ .name = "y", .type = { .data = AIN_INT } },
+};
+
+static struct ain_variable item_members[] = {
+	{ .name = "name", .type = { .data = AIN_STRING } },
+	{ .name = "weight", .type = { .data = AIN_FLOAT } },
+	{ .name = "flag", .type = { .data = AIN_BOOL } },
+	{ .name = "ids", .type = { .data = AIN_ARRAY_INT, .rank = 1 } },
+	{ .name = "pos", .type = { .data = AIN_STRUCT, .struc = POINT_T } },
+};
+
+static struct ain_variable save_members[] = {
+	{ .name = "id", .type = { .data = AIN_INT } },
+	{ .name = "title", .type = { .data = AIN_STRING } },
+	{ .name = "items", .type = { .data = AIN_ARRAY_STRUCT, .struc = ITEM_T, .rank = 1 } },
+	{ .name = "names", .type = { .data = AIN_ARRAY_STRING, .rank = 1 } },
+	{ .name = "grid", .type = { .data = AIN_ARRAY_FLOAT, .rank = 2 } },
+	{ .name = "flags", .type = { .data = AIN_ARRAY_BOOL, .rank = 1 } },
+	{ .name = "points", .type = { .data = AIN_ARRAY_STRUCT, .struc = POINT_T, .rank = 1 } },
+	{ .name = "main", .type = { .data = AIN_STRUCT, .struc = ITEM_T } },
+};
+
+static struct ain_struct structures[] = {
+	[POINT_T] = { .name = "point_t", .nr_members = 2, .members = point_members },
+	[ITEM_T] = { .name = "item_t", .nr_members = 5, .members = item_members },
+	[SAVE_T] = { .name = "save_t", .nr_members = 8, .members = save_members },
+};
+
+static struct ain test_ain = {
+	.nr_structures = 3,
+	.structures = structures,
+};
+
+struct ain *ain = &test_ain;
+
+/*
+ * A minimal heap: slot i holds a page or a string; slot 0 is a NULL page.
+ */
+
+static void **heap_objects = NULL;
+static bool *heap_is_string = NULL;
+static int heap_nr_objects = 1;
+static int heap_cap = 0;
+
+static int heap_put(void *obj, bool is_string)
+{
+	if (heap_nr_objects >= heap_cap) {
+		int new_cap = heap_cap ? heap_cap * 2 : 1024;
+		heap_objects = xrealloc_array(heap_objects, heap_cap, new_cap, sizeof(void*));
+		heap_is_string = xrealloc_array(heap_is_string, heap_cap, new_cap, sizeof(bool));
+		heap_cap = new_cap;
+		heap_objects[0] = NULL;
+	}
+	heap_objects[heap_nr_objects] = obj;
+	heap_is_string[heap_nr_objects] = is_string;
+	return heap_nr_objects++;
+}
+
+static void heap_free_all(void)
+{
+	for (int i = 1; i < heap_nr_objects; i++) {
+		if (heap_is_string[i])
+			free_string(heap_objects[i]);
+		else
+			free(heap_objects[i]);
+	}
+	free(heap_objects);
+	free(heap_is_string);
+}
+
+struct page *heap_get_page(int index)
+{
+	return heap_objects[index];
+}
+
+struct string *heap_get_string(int index)
+{
+	return heap_objects[index];
+}
+
+int32_t heap_alloc_page(struct page *page)
+{
+	return heap_put(page, false);
+}
+
+int32_t heap_alloc_string(struct string *s)
+{
+	return heap_put(s, true);
+}
+
+struct page *alloc_page(enum page_type type, int type_index, int nr_vars)
+{
+	struct page *page = xcalloc(1, sizeof(struct page) + nr_vars * sizeof(union vm_value));
+	page->type = type;
+	page->index = type_index;
+	page->nr_vars = nr_vars;
+	return page;
+}
+
+struct page *alloc_array(int rank, union vm_value *dimensions, enum ain_data_type data_type,
+		int struct_type, bool init_structs)
+{
+	struct page *page = alloc_page(ARRAY_PAGE, data_type, dimensions[0].i);
+	page->array.rank = rank;
+	page->array.struct_type = struct_type;
+	return page;
+}
+
+enum ain_data_type array_type(enum ain_data_type type)
+{
+	switch (type) {
+	case AIN_ARRAY_INT: return AIN_INT;
+	case AIN_ARRAY_FLOAT: return AIN_FLOAT;
+	case AIN_ARRAY_STRING: return AIN_STRING;
+	case AIN_ARRAY_STRUCT: return AIN_STRUCT;
+	case AIN_ARRAY_BOOL: return AIN_BOOL;
+	default: return AIN_VOID;
+	}
+}
+
+_Noreturn void _vm_error(const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	abort();
+}
+
+/*
+ * Building and comparing values.
+ */
+
+static uint32_t rng = 362436069;
+
+static uint32_t rand32(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+// ASCII, half-width kana and 2-byte SJIS characters
+static int random_string(void)
+{
+	char buf[256];
+	int len = 0;
+	int nr_chars = rand32() % 40;
+	for (int i = 0; i < nr_chars; i++) {
+		switch (rand32() % 4) {
+		case 0:
+			buf[len++] = 0xa1 + rand32() % (0xdf - 0xa1 + 1);
+			break;
+		case 1:
+			buf[len++] = 0x82;
+			buf[len++] = 0x9f + rand32() % 83;
+			break;
+		case 2:
+			buf[len++] = 0xe0 + rand32() % 16;
+			buf[len++] = 0x40 + rand32() % 63;
+			break;
+		default:
+			buf[len++] = 0x20 + rand32() % 95;
+			break;
+		}
+	}
+	return heap_alloc_string(make_string(buf, len));
+}
+
+static int random_value(struct ain_type *t, int depth);
+
+static struct page *random_struct(int struct_type, int depth)
+{
+	struct ain_struct *s = &ain->structures[struct_type];
+	struct page *page = alloc_page(STRUCT_PAGE, struct_type, s->nr_members);
+	for (int i = 0; i < s->nr_members; i++) {
+		page->values[i].i = random_value(&s->members[i].type, depth + 1);
+	}
+	return page;
+}
+
+static int random_array(struct ain_type *t, int depth)
+{
+	// NULL arrays are written as empty ones
+	if (rand32() % 8 == 0)
+		return 0;
+	int n = rand32() % (depth > 1 ? 8 : 300);
+	struct page *page = alloc_page(ARRAY_PAGE, t->data, n);
+	page->array.rank = t->rank;
+	page->array.struct_type = t->struc;
+	struct ain_type elem = array_element_type(t->data, t->struc, t->rank);
+	for (int i = 0; i < n; i++) {
+		page->values[i].i = random_value(&elem, depth + 1);
+	}
+	return heap_alloc_page(page);
+}
+
+static int random_value(struct ain_type *t, int depth)
+{
+	switch (t->data) {
+	case AIN_INT:
+	case AIN_FLOAT:
+		return rand32();
+	case AIN_BOOL:
+		return rand32() % 2;
+	case AIN_STRING:
+		return random_string();
+	case AIN_STRUCT:
+		return heap_alloc_page(random_struct(t->struc, depth));
+	default:
+		return random_array(t, depth);
+	}
+}
+
+static bool values_equal(struct ain_type *t, int a, int b);
+
+static bool structs_equal(struct page *a, struct page *b)
+{
+	struct ain_struct *s = &ain->structures[a->index];
+	if (b->type != STRUCT_PAGE || b->index != a->index || b->nr_vars != s->nr_members)
+		return false;
+	for (int i = 0; i < s->nr_members; i++) {
+		if (!values_equal(&s->members[i].type, a->values[i].i, b->values[i].i))
+			return false;
+	}
+	return true;
+}
+
+static bool arrays_equal(struct ain_type *t, struct page *a, struct page *b)
+{
+	int n = a ? a->nr_vars : 0;
+	if (b->type != ARRAY_PAGE || b->nr_vars != n || b->a_type != t->data
+			|| b->array.rank != t->rank || b->array.struct_type != t->struc)
+		return false;
+	struct ain_type elem = array_element_type(t->data, t->struc, t->rank);
+	for (int i = 0; i < n; i++) {
+		if (!values_equal(&elem, a->values[i].i, b->values[i].i))
+			return false;
+	}
+	return true;
+}
+
+static bool values_equal(struct ain_type *t, int a, int b)
+{
+	switch (t->data) {
+	case AIN_INT:
+	case AIN_FLOAT:
+	case AIN_BOOL:
+		return a == b;
+	case AIN_STRING:
+		return !strcmp(heap_get_string(a)->text, heap_get_string(b)->text);
+	case AIN_STRUCT:
+		return structs_equal(heap_get_page(a), heap_get_page(b));
+	default:
+		return arrays_equal(t, heap_get_page(a), heap_get_page(b));
+	}
+}
+
+static struct iarray_reader *reader_from(struct iarray_writer *w, struct page **page,
+		const char *header)
+{
+	static struct iarray_reader r;
+	*page = iarray_to_page(w);
+	heap_alloc_page(*page);
+	TEST_ASSERT(iarray_init_reader(&r, *page, header));
+	return &r;
+}
+
+/*
+ * The old writer and reader, from before serialization plans. They check the
+ * capacity for every int written and switch on the ain type of every member.
+ */
+
+static void ref_write_struct(struct iarray_writer *w, struct page *page, bool with_type);
+static void ref_write_array(struct iarray_writer *w, struct page *page);
+
+static void ref_write_string(struct iarray_writer *w, struct string *s)
+{
+	for (char *p = s->text; *p ;p++) {
+		if (SJIS_2BYTE(*p)) {
+			int c = (uint8_t)p[0] | ((uint8_t)p[1] << 8);
+			iarray_write(w, c);
+			p++;
+		} else {
+			iarray_write(w, *p);
+		}
+	}
+	iarray_write(w, 0);
+}
+
+static void ref_write_value(struct iarray_writer *w, struct ain_type *t, int value)
+{
+	switch (t->data) {
+	case AIN_VOID:
+	case AIN_INT:
+	case AIN_FLOAT:
+	case AIN_BOOL:
+		iarray_write(w, value);
+		break;
+	case AIN_STRING:
+		ref_write_string(w, heap_get_string(value));
+		break;
+	case AIN_STRUCT:
+		ref_write_struct(w, heap_get_page(value), false);
+		break;
+	case AIN_ARRAY_INT:
+	case AIN_ARRAY_FLOAT:
+	case AIN_ARRAY_STRING:
+	case AIN_ARRAY_STRUCT:
+	case AIN_ARRAY_BOOL:
+		ref_write_array(w, heap_get_page(value));
+		break;
+	default:
+		VM_ERROR("Unsupported data type for serialization: %d", t->data);
+	}
+}
+
+static void ref_write_struct(struct iarray_writer *w, struct page *page, bool with_type)
+{
+	struct ain_struct *s = &ain->structures[page->index];
+	for (int i = 0; i < s->nr_members; i++) {
+		if (with_type)
+			iarray_write(w, s->members[i].type.data);
+		ref_write_value(w, &s->members[i].type, page->values[i].i);
+	}
+}
+
+static void ref_write_array(struct iarray_writer *w, struct page *page)
+{
+	if (!page) {
+		iarray_write(w, 0);
+		return;
+	}
+	struct ain_type t = array_element_type(page->a_type, page->array.struct_type, page->array.rank);
+	iarray_write(w, page->nr_vars);
+	for (int i = 0; i < page->nr_vars; i++) {
+		ref_write_value(w, &t, page->values[i].i);
+	}
+}
+
+static struct page *ref_read_struct(struct iarray_reader *r, int struct_type, bool with_type);
+static struct page *ref_read_array(struct iarray_reader *r, struct ain_type *t);
+
+static int32_t ref_read_member(struct iarray_reader *r, struct ain_type *t)
+{
+	switch (t->data) {
+	case AIN_INT:
+	case AIN_FLOAT:
+	case AIN_BOOL:
+		return iarray_read(r);
+	case AIN_STRING:
+		return heap_alloc_string(iarray_read_string(r));
+	case AIN_STRUCT:
+		return heap_alloc_page(ref_read_struct(r, t->struc, false));
+	case AIN_ARRAY_INT:
+	case AIN_ARRAY_FLOAT:
+	case AIN_ARRAY_STRING:
+	case AIN_ARRAY_STRUCT:
+	case AIN_ARRAY_BOOL:
+		return heap_alloc_page(ref_read_array(r, t));
+	default:
+		VM_ERROR("Unsupported data type for (de)serialization: %d", t->data);
+	}
+}
+
+static struct page *ref_read_struct(struct iarray_reader *r, int struct_type, bool with_type)
+{
+	struct ain_struct *s = &ain->structures[struct_type];
+	struct page *page = alloc_page(STRUCT_PAGE, struct_type, s->nr_members);
+	for (int i = 0; i < s->nr_members; i++) {
+		if (with_type) {
+			int type = iarray_read(r);
+			if (type != s->members[i].type.data)
+				VM_ERROR("iarray_read_struct: type mismatch");
+		}
+		page->values[i].i = ref_read_member(r, &s->members[i].type);
+	}
+	return page;
+}
+
+static struct page *ref_read_array(struct iarray_reader *r, struct ain_type *t)
+{
+	struct ain_type next_t = array_element_type(t->data, t->struc, t->rank);
+	int nr_vars = iarray_read(r);
+	struct page *page = alloc_page(ARRAY_PAGE, t->data, nr_vars);
+	page->array.struct_type = t->struc;
+	page->array.rank = t->rank;
+	for (int i = 0; i < nr_vars; i++) {
+		page->values[i].i = ref_read_member(r, &next_t);
+	}
+	return page;
+}
+
+
+/*
+ * Tests.
+ */
+
+static void test_format(void)
+{
+	struct page *pos = alloc_page(STRUCT_PAGE, POINT_T, 2);
+	pos->values[0].i = 3;
+	pos->values[1].i = -4;
+	struct page *ids = alloc_page(ARRAY_PAGE, AIN_ARRAY_INT, 2);
+	ids->array.rank = 1;
+	ids->values[0].i = 7;
+	ids->values[1].i = 8;
+	struct page *item = alloc_page(STRUCT_PAGE, ITEM_T, 5);
+	item->values[0].i = heap_alloc_string(make_string("a\x82\xa0", 3));
+	item->values[1].f = 1.5f;
+	item->values[2].i = 1;
+	item->values[3].i = heap_alloc_page(ids);
+	item->values[4].i = heap_alloc_page(pos);
+	heap_alloc_page(item);
+
+	union { float f; int i; } w15 = { .f = 1.5f };
+	const int expected[] = {
+		'H', 'D', 0,
+		// item_t without types
+		'a', 0xa082, 0, w15.i, 1, 2, 7, 8, 3, -4,
+		// point_t with types
+		AIN_INT, 3, AIN_INT, -4,
+		// item_t with types
+		AIN_STRING, 'a', 0xa082, 0, AIN_FLOAT, w15.i, AIN_BOOL, 1,
+		AIN_ARRAY_INT, 2, 7, 8, AIN_STRUCT, 3, -4,
+		// array<int>, and a NULL array
+		2, 7, 8, 0,
+	};
+	struct iarray_writer w;
+	iarray_init_writer(&w, "HD");
+	iarray_write_struct(&w, item, false);
+	iarray_write_struct(&w, pos, true);
+	iarray_write_struct(&w, item, true);
+	iarray_write_array(&w, ids);
+	iarray_write_array(&w, NULL);
+	TEST_EQUAL(w.size, sizeof(expected) / sizeof(*expected));
+	for (unsigned i = 0; i < w.size && i < sizeof(expected) / sizeof(*expected); i++) {
+		if (w.data[i] != expected[i])
+			TEST_EQUAL(w.data[i], expected[i]);
+	}
+
+	size_t size;
+	uint8_t *buf = iarray_to_buffer(&w, &size);
+	TEST_EQUAL(size, w.size * 4);
+	TEST_EQUAL(LittleEndian_getDW(buf, 4 * 4), 0xa082);
+	free(buf);
+	iarray_free_writer(&w);
+}
+
+static void test_round_trip(void)
+{
+	struct ain_type items_type = { .data = AIN_ARRAY_STRUCT, .struc = ITEM_T, .rank = 1 };
+	int nr_failed = 0;
+	for (int i = 0; i < NR_ROUND_TRIPS; i++) {
+		bool with_type = rand32() % 2;
+		const char *header = rand32() % 2 ? "IARRAY" : NULL;
+		struct page *save = random_struct(SAVE_T, 0);
+		heap_alloc_page(save);
+		int items = random_array(&items_type, 0);
+
+		struct iarray_writer w;
+		iarray_init_writer(&w, header);
+		iarray_write(&w, 42);
+		iarray_write_struct(&w, save, with_type);
+		iarray_write_array(&w, heap_get_page(items));
+		iarray_write_float(&w, 0.25f);
+
+		// the old writer gives the same data
+		struct iarray_writer ref_w;
+		iarray_init_writer(&ref_w, header);
+		iarray_write(&ref_w, 42);
+		ref_write_struct(&ref_w, save, with_type);
+		ref_write_array(&ref_w, heap_get_page(items));
+		iarray_write_float(&ref_w, 0.25f);
+		TEST_ASSERT(ref_w.size == w.size && !memcmp(ref_w.data, w.data, w.size * sizeof(int)));
+		iarray_free_writer(&ref_w);
+
+		struct page *page;
+		struct iarray_reader *r = reader_from(&w, &page, header);
+		TEST_EQUAL(iarray_read(r), 42);
+		struct page *save2 = iarray_read_struct(r, SAVE_T, with_type);
+		heap_alloc_page(save2);
+		struct page *items2 = iarray_read_array(r, &items_type);
+		heap_alloc_page(items2);
+		TEST_ASSERT(iarray_read_float(r) == 0.25f);
+		bool ok = !r->error && r->pos == r->size
+			&& structs_equal(save, save2)
+			&& arrays_equal(&items_type, heap_get_page(items), items2);
+
+		// writing what was read gives the same data again
+		struct iarray_writer w2;
+		iarray_init_writer(&w2, header);
+		iarray_write(&w2, 42);
+		iarray_write_struct(&w2, save2, with_type);
+		iarray_write_array(&w2, items2);
+		iarray_write_float(&w2, 0.25f);
+		ok = ok && w2.size == w.size && !memcmp(w2.data, w.data, w.size * sizeof(int));
+
+		if (!ok && nr_failed++ < 5)
+			fprintf(stderr, "round trip %d failed (with_type=%d)\n", i, with_type);
+		iarray_free_writer(&w);
+		iarray_free_writer(&w2);
+	}
+	TEST_EQUAL(nr_failed, 0);
+}
+
+// Values written in bulk reserve enough room for themselves, however full
+// the writer already is.
+static void test_reserve(void)
+{
+	struct page *pos = alloc_page(STRUCT_PAGE, POINT_T, 2);
+	heap_alloc_page(pos);
+	struct page *ids = alloc_page(ARRAY_PAGE, AIN_ARRAY_INT, 5);
+	ids->array.rank = 1;
+	heap_alloc_page(ids);
+	struct string *s = make_string("abc", 3);
+	heap_alloc_string(s);
+
+	int nr_overflows = 0;
+	for (unsigned room = 0; room < 16; room++) {
+		struct iarray_writer w;
+		iarray_init_writer(&w, NULL);
+		while (w.size < w.allocated - room)
+			iarray_write(&w, 0);
+		iarray_write_struct(&w, pos, true);
+		nr_overflows += w.size > w.allocated;
+		iarray_write_array(&w, ids);
+		nr_overflows += w.size > w.allocated;
+		iarray_write_string(&w, s);
+		nr_overflows += w.size > w.allocated;
+		iarray_free_writer(&w);
+	}
+	TEST_EQUAL(nr_overflows, 0);
+}
+
+// Every prefix of the data is reported as short, by the bulk and the
+// member-by-member paths alike.
+static void test_truncated(void)
+{
+	struct ain_type points_type = { .data = AIN_ARRAY_STRUCT, .struc = POINT_T, .rank = 1 };
+	struct page *save = random_struct(SAVE_T, 2);
+	heap_alloc_page(save);
+	struct iarray_writer w;
+	iarray_init_writer(&w, NULL);
+	iarray_write_struct(&w, save, false);
+	unsigned full_size = w.size;
+
+	int nr_unreported = 0;
+	for (unsigned size = 0; size < full_size; size++) {
+		w.size = size;
+		struct page *page;
+		struct iarray_reader *r = reader_from(&w, &page, NULL);
+		heap_alloc_page(iarray_read_struct(r, SAVE_T, false));
+		if (!r->error)
+			nr_unreported++;
+	}
+	TEST_EQUAL(nr_unreported, 0);
+
+	// a scalar-only struct array cut inside the last element
+	iarray_free_writer(&w);
+	iarray_init_writer(&w, NULL);
+	iarray_write(&w, 3);
+	for (int i = 0; i < 5; i++) {
+		iarray_write(&w, i);
+	}
+	struct page *page;
+	struct iarray_reader *r = reader_from(&w, &page, NULL);
+	struct page *points = iarray_read_array(r, &points_type);
+	heap_alloc_page(points);
+	TEST_ASSERT(r->error);
+	TEST_EQUAL(points->nr_vars, 3);
+	TEST_EQUAL(heap_get_page(points->values[2].i)->values[0].i, 4);
+	iarray_free_writer(&w);
+}
+
+/*
+ * Benchmark.
+ */
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Frees the objects allocated since the heap held `nr_objects`, so that
+// every read starts from the same heap.
+static void heap_truncate(int nr_objects)
+{
+	for (int i = nr_objects; i < heap_nr_objects; i++) {
+		if (heap_is_string[i])
+			free_string(heap_objects[i]);
+		else
+			free(heap_objects[i]);
+	}
+	heap_nr_objects = nr_objects;
+}
+
+#define BENCH_SAVES 500
+#define BENCH_RUNS 10
+
+static struct page *bench_saves[BENCH_SAVES];
+
+static void write_saves(struct iarray_writer *w, bool ref)
+{
+	iarray_init_writer(w, "IARRAY");
+	for (int i = 0; i < BENCH_SAVES; i++) {
+		if (ref)
+			ref_write_struct(w, bench_saves[i], i % 2);
+		else
+			iarray_write_struct(w, bench_saves[i], i % 2);
+	}
+}
+
+// Reads the saves back and, if `check`, compares them with the originals.
+static int read_saves(struct page *data, bool ref, bool check)
+{
+	struct iarray_reader r;
+	TEST_ASSERT(iarray_init_reader(&r, data, "IARRAY"));
+	int nr_different = 0;
+	for (int i = 0; i < BENCH_SAVES; i++) {
+		struct page *save = ref ? ref_read_struct(&r, SAVE_T, i % 2)
+			: iarray_read_struct(&r, SAVE_T, i % 2);
+		if (check)
+			nr_different += !structs_equal(bench_saves[i], save);
+		free(save);
+	}
+	TEST_ASSERT(!r.error && r.pos == r.size);
+	return nr_different;
+}
+
+static double time_write(bool ref)
+{
+	struct iarray_writer w;
+	double t = now();
+	write_saves(&w, ref);
+	t = now() - t;
+	iarray_free_writer(&w);
+	return t;
+}
+
+static double time_read(struct page *data, bool ref)
+{
+	int nr_objects = heap_nr_objects;
+	double t = now();
+	read_saves(data, ref, false);
+	t = now() - t;
+	heap_truncate(nr_objects);
+	return t;
+}
+
+static void bench(void)
+{
+	for (int i = 0; i < BENCH_SAVES; i++) {
+		bench_saves[i] = random_struct(SAVE_T, 0);
+		heap_alloc_page(bench_saves[i]);
+	}
+
+	// both writers produce the same data, and both readers read it back
+	struct iarray_writer w, ref_w;
+	write_saves(&w, false);
+	write_saves(&ref_w, true);
+	TEST_EQUAL(w.size, ref_w.size);
+	TEST_ASSERT(!memcmp(w.data, ref_w.data, w.size * sizeof(int)));
+	struct page *data = iarray_to_page(&w);
+	int nr_objects = heap_nr_objects;
+	TEST_EQUAL(read_saves(data, false, true), 0);
+	TEST_EQUAL(read_saves(data, true, true), 0);
+	heap_truncate(nr_objects);
+
+	// the fastest of BENCH_RUNS runs, alternating between old and new so
+	// that neither gets a fresher heap
+	double t_write_ref = 1e9, t_write = 1e9, t_read_ref = 1e9, t_read = 1e9;
+	for (int i = 0; i < BENCH_RUNS; i++) {
+		t_write_ref = min(t_write_ref, time_write(true));
+		t_write = min(t_write, time_write(false));
+		t_read_ref = min(t_read_ref, time_read(data, true));
+		t_read = min(t_read, time_read(data, false));
+	}
+
+	printf("%d save_t structs, %.1f MB serialized; milliseconds\n", BENCH_SAVES,
+	       w.size * 4 / 1e6);
+	printf("%-6s  %8s  %8s\n", "", "old", "new");
+	printf("%-6s  %8.2f  %8.2f\n", "write", t_write_ref * 1e3, t_write * 1e3);
+	printf("%-6s  %8.2f  %8.2f\n", "read", t_read_ref * 1e3, t_read * 1e3);
+
+	iarray_free_writer(&w);
+	iarray_free_writer(&ref_w);
+	free(data);
+}
+
+static void free_plans(void)
+{
+	for (int i = 0; i < ain->nr_structures; i++) {
+		if (plans[i]) {
+			free(plans[i]->members);
+			free(plans[i]);
+		}
+	}
+	free(plans);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1 && !strcmp(argv[1], "--bench")) {
+		bench();
+		free_plans();
+		heap_free_all();
+		return test_finish("iarray bench");
+	}
+
+	test_format();
+	test_round_trip();
+	test_reserve();
+	test_truncated();
+	free_plans();
+	heap_free_all();
+	return test_finish("iarray");
+}
@@ -0,0 +1,138 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include "../../src/id_heap.c"
+#include "test.h"
+
+/*
+ * Gpx2Plus hands out surface numbers from an id_heap. Games rely on getting
+ * the same numbers as before, when create_surface took the first empty slot
+ * of surfaces[]. Replays random Create/Free/FreeAll sequences against that
+ * scan.
+ */
+
+#define MAX_IDS 8192
+#define NR_STEPS 400000
+
+static uint32_t rng = 1234567;
+
+static uint32_t rand32(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+// the old create_surface
+static bool used[MAX_IDS];
+
+static int scan_alloc(void)
+{
+	int id;
+	for (id = 0; used[id]; id++);
+	used[id] = true;
+	return id;
+}
+
+static struct id_heap heap;
+static int live[MAX_IDS];
+static int nr_live = 0;
+static int nr_mismatches = 0;
+
+static void alloc(void)
+{
+	int expected = scan_alloc();
+	int actual = id_heap_alloc(&heap);
+	if (actual != expected && nr_mismatches++ < 5)
+		fprintf(stderr, "alloc: expected %d; got %d\n", expected, actual);
+	live[nr_live++] = expected;
+}
+
+// live[0] is the main surface, which is never freed
+static void release_random(void)
+{
+	int i = 1 + rand32() % (nr_live - 1);
+	int id = live[i];
+	live[i] = live[--nr_live];
+	used[id] = false;
+	id_heap_release(&heap, id);
+}
+
+// Gpx2Plus_FreeAll keeps the main surface, number 0
+static void release_all(void)
+{
+	memset(used, 0, sizeof(used));
+	used[0] = true;
+	live[0] = 0;
+	nr_live = 1;
+	id_heap_reset(&heap, 1);
+}
+
+static void test_random(void)
+{
+	// the main surface
+	alloc();
+	for (int step = 0; step < NR_STEPS; step++) {
+		// phases that grow, shrink and churn the set of live ids
+		int phase = (step / 5000) % 3;
+		int alloc_percent = phase == 0 ? 70 : phase == 1 ? 30 : 50;
+		if (rand32() % 50000 == 0) {
+			release_all();
+		} else if (nr_live > 1 && (nr_live == MAX_IDS - 1 || (int)(rand32() % 100) >= alloc_percent)) {
+			release_random();
+		} else {
+			alloc();
+		}
+	}
+	TEST_EQUAL(nr_mismatches, 0);
+}
+
+static void test_cases(void)
+{
+	struct id_heap h = {0};
+	TEST_EQUAL(id_heap_alloc(&h), 0);
+	TEST_EQUAL(id_heap_alloc(&h), 1);
+	TEST_EQUAL(id_heap_alloc(&h), 2);
+	TEST_EQUAL(id_heap_alloc(&h), 3);
+	TEST_EQUAL(h.end, 4);
+
+	// released ids come back lowest first, before new ones
+	id_heap_release(&h, 2);
+	id_heap_release(&h, 0);
+	id_heap_release(&h, 3);
+	TEST_EQUAL(id_heap_alloc(&h), 0);
+	TEST_EQUAL(id_heap_alloc(&h), 2);
+	TEST_EQUAL(id_heap_alloc(&h), 3);
+	TEST_EQUAL(id_heap_alloc(&h), 4);
+
+	id_heap_release(&h, 1);
+	id_heap_reset(&h, 1);
+	TEST_EQUAL(id_heap_alloc(&h), 1);
+	TEST_EQUAL(id_heap_alloc(&h), 2);
+
+	id_heap_delete(&h);
+	TEST_EQUAL(id_heap_alloc(&h), 0);
+	id_heap_delete(&h);
+}
+
+int main(void)
+{
+	test_cases();
+	test_random();
+	id_heap_delete(&heap);
+	return test_finish("id_heap");
+}
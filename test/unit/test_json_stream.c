@@ -0,0 +1,178 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include "../../src/json_stream.c"
+#include "test.h"
+
+/*
+ * Writes a document larger than the reader's buffer (with a string that is
+ * larger still) and reads it back, both from memory and from the file.
+ */
+
+#define NR_ENTRIES 20000
+#define LONG_STRING_SIZE (JSON_READER_BUFFER_SIZE * 3 / 2)
+
+static const char *entry_string(int i)
+{
+	static char buf[64];
+	// quotes, backslashes, control characters and SJIS bytes
+	snprintf(buf, sizeof(buf), "s%d \"q\" \\ \t\n \x82\xa0%d", i, i % 7);
+	return buf;
+}
+
+static int entry_int(int i)
+{
+	return i % 3 ? i * 7919 : -i * 104729;
+}
+
+static char *long_string(void)
+{
+	char *s = xmalloc(LONG_STRING_SIZE + 1);
+	for (int i = 0; i < LONG_STRING_SIZE; i++) {
+		s[i] = i % 97 == 0 ? '"' : 'a' + i % 26;
+	}
+	s[LONG_STRING_SIZE] = '\0';
+	return s;
+}
+
+static void write_document(FILE *f, const char *long_str)
+{
+	struct json_writer *w = xmalloc(sizeof(struct json_writer));
+	json_writer_init(w, f);
+	json_write_begin_object(w);
+	json_write_key(w, "entries");
+	json_write_begin_array(w);
+	for (int i = 0; i < NR_ENTRIES; i++) {
+		json_write_begin_object(w);
+		json_write_key(w, "int");
+		json_write_int(w, entry_int(i));
+		json_write_key(w, "string");
+		json_write_string(w, entry_string(i));
+		json_write_key(w, "skipped");
+		json_write_begin_array(w);
+		json_write_null(w);
+		json_write_int(w, i);
+		json_write_end_array(w);
+		json_write_end_object(w);
+	}
+	json_write_end_array(w);
+	json_write_key(w, "long");
+	json_write_string(w, long_str);
+	json_write_key(w, "null");
+	json_write_null(w);
+	json_write_end_object(w);
+	TEST_ASSERT(json_writer_finish(w));
+	free(w);
+}
+
+static void read_document(struct json_reader *r, const char *long_str)
+{
+	const char *key;
+	int n = 0;
+	bool have_long = false, have_null = false;
+
+	TEST_ASSERT(json_read_begin_object(r));
+	while (json_read_object_next(r, &key)) {
+		if (!strcmp(key, "entries")) {
+			TEST_ASSERT(json_read_begin_array(r));
+			while (json_read_array_next(r)) {
+				int v;
+				TEST_ASSERT(json_read_begin_object(r));
+				while (json_read_object_next(r, &key)) {
+					if (!strcmp(key, "int")) {
+						TEST_ASSERT(json_read_int(r, &v));
+						if (v != entry_int(n))
+							TEST_EQUAL(v, entry_int(n));
+					} else if (!strcmp(key, "string")) {
+						const char *s = json_read_string(r, NULL);
+						if (!s || strcmp(s, entry_string(n)))
+							TEST_STRING(s, entry_string(n));
+					} else {
+						TEST_ASSERT(json_skip_value(r));
+					}
+				}
+				n++;
+			}
+		} else if (!strcmp(key, "long")) {
+			size_t len;
+			const char *s = json_read_string(r, &len);
+			TEST_EQUAL(len, LONG_STRING_SIZE);
+			TEST_ASSERT(s && !strcmp(s, long_str));
+			have_long = true;
+		} else if (!strcmp(key, "null")) {
+			TEST_ASSERT(json_read_null(r));
+			have_null = true;
+		}
+	}
+	TEST_ASSERT(!r->error);
+	TEST_EQUAL(n, NR_ENTRIES);
+	TEST_ASSERT(have_long);
+	TEST_ASSERT(have_null);
+	TEST_EQUAL(json_reader_peek(r), JSON_TOKEN_EOF);
+}
+
+static void test_truncated(FILE *f, long size)
+{
+	// a document cut off in the middle of a string must be an error
+	rewind(f);
+	char *data = xmalloc(size / 2);
+	TEST_EQUAL(fread(data, 1, size / 2, f), size / 2);
+	struct json_reader r;
+	json_reader_init(&r, data, size / 2);
+	TEST_ASSERT(json_read_begin_object(&r));
+	const char *key;
+	while (json_read_object_next(&r, &key)) {
+		if (!json_skip_value(&r))
+			break;
+	}
+	TEST_ASSERT(r.error);
+	json_reader_fini(&r);
+	free(data);
+}
+
+int main(void)
+{
+	char *long_str = long_string();
+	FILE *f = tmpfile();
+	TEST_ASSERT(f);
+	if (!f)
+		return test_finish("json_stream");
+	write_document(f, long_str);
+	long size = ftell(f);
+	TEST_ASSERT(size > JSON_READER_BUFFER_SIZE * 4);
+
+	// from memory
+	rewind(f);
+	char *data = xmalloc(size);
+	TEST_EQUAL(fread(data, 1, size, f), size);
+	struct json_reader r;
+	json_reader_init(&r, data, size);
+	read_document(&r, long_str);
+	json_reader_fini(&r);
+	free(data);
+
+	// from the file
+	rewind(f);
+	json_reader_init_file(&r, f);
+	read_document(&r, long_str);
+	json_reader_fini(&r);
+
+	test_truncated(f, size);
+
+	fclose(f);
+	free(long_str);
+	return test_finish("json_stream");
+}
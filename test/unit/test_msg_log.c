@@ -0,0 +1,257 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <time.h>
+
+#include "../../src/hll/MsgLogManager.c"
+#include "test.h"
+
+/*
+ * The message log is a ring buffer. Checks it against a plain list of the
+ * newest entries while it fills, wraps around and is resized with
+ * SetLineMax, and that dropped strings are released.
+ *
+ * Usage: test_msg_log
+ *        test_msg_log --bench
+ *
+ * --bench appends a million lines and reports the cost per append over the
+ * run and its distribution, for the ring buffer and for the halving log it
+ * replaced (copied below).
+ */
+
+#define NR_ENTRIES 12000
+
+// every entry ever added; odd ids are strings
+static struct string *strings[NR_ENTRIES];
+static int nr_added = 0;
+
+// ids of the entries that should be in the log, oldest first
+static int expected[NR_ENTRIES];
+static int expected_start = 0, expected_end = 0;
+static int expected_max = LOG_MAX;
+
+static void expect_drop_oldest(void)
+{
+	int id = expected[expected_start++];
+	// the log's reference is released when an entry is dropped
+	if (strings[id])
+		TEST_EQUAL(strings[id]->ref, 1);
+}
+
+static void add(void)
+{
+	int id = nr_added++;
+	if (id % 2) {
+		char buf[32];
+		int len = snprintf(buf, sizeof(buf), "entry %d", id);
+		strings[id] = make_string(buf, len);
+		MsgLogManager_AddString(id % 7, strings[id]);
+	} else {
+		MsgLogManager_AddInt(id % 7, id * 3);
+	}
+	expected[expected_end++] = id;
+	if (expected_end - expected_start > expected_max)
+		expect_drop_oldest();
+}
+
+static void set_line_max(int line_max)
+{
+	MsgLogManager_SetLineMax(line_max);
+	if (line_max <= 0)
+		return;
+	expected_max = line_max;
+	while (expected_end - expected_start > expected_max)
+		expect_drop_oldest();
+}
+
+static bool log_matches(void)
+{
+	if (MsgLogManager_Numof() != expected_end - expected_start)
+		return false;
+	for (int i = 0; i < MsgLogManager_Numof(); i++) {
+		int id = expected[expected_start + i];
+		struct msg_log_entry *e = msg_log_get(i);
+		if (e->type != id % 7)
+			return false;
+		if (id % 2) {
+			if (e->data_type != MSG_LOG_STRING || e->s != strings[id] || e->s->ref != 2)
+				return false;
+		} else {
+			if (e->data_type != MSG_LOG_INT || e->i != id * 3)
+				return false;
+		}
+	}
+	return true;
+}
+
+static void add_n(int n)
+{
+	for (int i = 0; i < n; i++) {
+		add();
+		// checking every step is quadratic; the first pass through each
+		// ring position is enough
+		if (i < 64 || i % 97 == 0)
+			TEST_ASSERT(log_matches());
+	}
+	TEST_ASSERT(log_matches());
+}
+
+// the old log: rotated by freeing the oldest half and moving the rest down
+static size_t ref_log_size = 0;
+static size_t ref_log_i = 0;
+static struct msg_log_entry *ref_log = NULL;
+
+static void ref_log_alloc(void)
+{
+	if (ref_log_i < ref_log_size)
+		return;
+	if (!ref_log_size)
+		ref_log_size = 1;
+
+	if (ref_log_i >= LOG_MAX) {
+		for (size_t i = 0; i < ref_log_i - LOG_MAX/2; i++) {
+			if (ref_log[i].data_type == MSG_LOG_STRING)
+				free_string(ref_log[i].s);
+		}
+		memcpy(ref_log, ref_log + (ref_log_i - LOG_MAX/2), sizeof(struct msg_log_entry) * LOG_MAX/2);
+		ref_log_i = LOG_MAX/2;
+		return;
+	}
+
+	ref_log = xrealloc(ref_log, sizeof(struct msg_log_entry) * ref_log_size * 2);
+	ref_log_size *= 2;
+}
+
+static void ref_add_string(int type, struct string *str)
+{
+	ref_log_alloc();
+	ref_log[ref_log_i++] = (struct msg_log_entry) {
+		.data_type = MSG_LOG_STRING,
+		.type = type,
+		.s = string_ref(str)
+	};
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#define BENCH_LINES 1000000
+#define BENCH_BUCKETS 10
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double*)a, y = *(const double*)b;
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Append BENCH_LINES lines as a game does: a fresh string per line, which
+ * the caller releases after logging it. Each append is timed on its own.
+ */
+static void bench_run(const char *name, void (*add_string)(int, struct string*))
+{
+	double *t = xmalloc(BENCH_LINES * sizeof(double));
+	for (int i = 0; i < BENCH_LINES; i++) {
+		char buf[64];
+		int len = snprintf(buf, sizeof(buf), "line %d of the message log", i);
+		struct string *s = make_string(buf, len);
+		double start = now();
+		add_string(i % 7, s);
+		t[i] = (now() - start) * 1e9;
+		free_string(s);
+	}
+
+	printf("%-6s", name);
+	for (int b = 0; b < BENCH_BUCKETS; b++) {
+		double sum = 0;
+		for (int i = 0; i < BENCH_LINES / BENCH_BUCKETS; i++)
+			sum += t[b * (BENCH_LINES / BENCH_BUCKETS) + i];
+		printf(" %5.0f", sum / (BENCH_LINES / BENCH_BUCKETS));
+	}
+	qsort(t, BENCH_LINES, sizeof(double), cmp_double);
+	printf("  %5.0f %8.0f %8.0f\n", t[BENCH_LINES / 2], t[BENCH_LINES - BENCH_LINES / 10000],
+			t[BENCH_LINES - 1]);
+	free(t);
+}
+
+// The old log rotates once every LOG_MAX/2 appends, i.e. in about 0.1% of
+// them, which shows up in the 99.99th percentile.
+static void bench(void)
+{
+	printf("%d appends; ns per append\n", BENCH_LINES);
+	printf("%-6s%-*s%7s%9s%9s\n", "", 6 * BENCH_BUCKETS, " mean by tenth of the run",
+			"median", "99.99%", "max");
+	bench_run("ring", MsgLogManager_AddString);
+	bench_run("halve", ref_add_string);
+	TEST_EQUAL(MsgLogManager_Numof(), LOG_MAX);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1 && !strcmp(argv[1], "--bench")) {
+		bench();
+		return test_finish("msg_log bench");
+	}
+
+
+	TEST_EQUAL(MsgLogManager_Numof(), 0);
+
+	// fill, then wrap around several times
+	add_n(LOG_MAX + 500);
+	TEST_EQUAL(MsgLogManager_Numof(), LOG_MAX);
+	TEST_EQUAL(msg_log_get(0)->i, 500 * 3);
+	add_n(LOG_MAX * 2 + 17);
+
+	// shrink while the ring is wrapped, then keep going
+	set_line_max(100);
+	TEST_ASSERT(log_matches());
+	TEST_EQUAL(MsgLogManager_Numof(), 100);
+	add_n(250);
+
+	// invalid sizes are ignored
+	set_line_max(0);
+	set_line_max(-5);
+	TEST_ASSERT(log_matches());
+	add_n(3);
+
+	// growing keeps what is there and fills up to the new size
+	set_line_max(300);
+	TEST_ASSERT(log_matches());
+	TEST_EQUAL(MsgLogManager_Numof(), 100);
+	add_n(450);
+	TEST_EQUAL(MsgLogManager_Numof(), 300);
+
+	set_line_max(1);
+	TEST_ASSERT(log_matches());
+	add_n(5);
+	TEST_EQUAL(MsgLogManager_Numof(), 1);
+	TEST_EQUAL(msg_log_get(0)->type, (nr_added - 1) % 7);
+
+	set_line_max(LOG_MAX);
+	add_n(1000);
+	TEST_EQUAL(MsgLogManager_Numof(), 1001);
+
+	// the test's own references
+	for (int i = 0; i < nr_added; i++) {
+		if (strings[i])
+			free_string(strings[i]);
+	}
+	return test_finish("msg_log");
+}
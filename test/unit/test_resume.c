@@ -0,0 +1,742 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <limits.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "../../src/resume.c"
+#include "test.h"
+
+/*
+ * Builds a VM heap image by hand, writes it with write_json_image and checks
+ * that it parses to the same document as the cJSON tree the old
+ * vm_image_to_json built (copied below). Then loads it back with
+ * load_json_image and compares the heap, call stack and stack.
+ *
+ * Also starts an asynchronous RSM save, mutates the heap while it is being
+ * written, and checks that the file holds the state from before the
+ * mutation.
+ *
+ * Usage: test_resume
+ *        test_resume --bench
+ *
+ * --bench reports the cost of an RSM save at each save-compression-level
+ * instead: building the snapshot, and writing it with write_rsave_file.
+ */
+
+#define JSON_FILE "test_resume.json"
+#define SYNC_FILE "test_resume_sync.rsm"
+#define ASYNC_FILE "test_resume_async.rsm"
+#define MUTATED_FILE "test_resume_mutated.rsm"
+
+/*
+ * The parts of the VM that resume.c works on.
+ */
+
+struct ain *ain;
+struct config config;
+
+struct vm_pointer *heap = NULL;
+size_t heap_size = 0;
+int32_t *heap_free_stack = NULL;
+size_t heap_free_ptr = 0;
+uint32_t heap_next_seq = 0;
+
+static union vm_value stack_buf[64];
+union vm_value *stack = stack_buf;
+int32_t stack_ptr = 0;
+
+struct function_call call_stack[4096];
+int32_t call_stack_ptr = 0;
+size_t instr_ptr = 0;
+
+void heap_grow(size_t new_size)
+{
+	heap = xrealloc_array(heap, heap_size, new_size, sizeof(struct vm_pointer));
+	heap_free_stack = xrealloc_array(heap_free_stack, heap_size, new_size, sizeof(int32_t));
+	for (size_t i = heap_size; i < new_size; i++) {
+		heap_free_stack[i] = i;
+	}
+	heap_size = new_size;
+}
+
+struct page *alloc_page(enum page_type type, int type_index, int nr_vars)
+{
+	struct page *page = xcalloc(1, sizeof(struct page) + nr_vars * sizeof(union vm_value));
+	page->type = type;
+	page->index = type_index;
+	page->nr_vars = nr_vars;
+	return page;
+}
+
+void free_page(struct page *page)
+{
+	free(page);
+}
+
+union vm_value stack_pop(void)
+{
+	return stack[--stack_ptr];
+}
+
+char *savedir_path(const char *path)
+{
+	return xstrdup(path);
+}
+
+const char *display_sjis0(const char *sjis)
+{
+	return sjis;
+}
+
+const char *display_utf0(const char *utf)
+{
+	return utf;
+}
+
+_Noreturn void _vm_error(const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	abort();
+}
+
+// only used for save comments, which aren't tested here
+struct page *alloc_array(int rank, union vm_value *dimensions, enum ain_data_type data_type,
+		int struct_type, bool init_structs)
+{
+	abort();
+}
+
+int32_t heap_alloc_slot(enum vm_pointer_type type)
+{
+	abort();
+}
+
+struct string *heap_get_string(int index)
+{
+	abort();
+}
+
+int save_json(const char *filename, cJSON *json)
+{
+	abort();
+}
+
+/*
+ * The cJSON writer that write_json_image replaced.
+ */
+
+static int ref_get_number(int i, void *data)
+{
+	return ((union vm_value*)data)[i].i;
+}
+
+static cJSON *ref_page_to_json(struct page *page)
+{
+	if (!page)
+		return cJSON_CreateNull();
+
+	cJSON *json = cJSON_CreateObject();
+	cJSON_AddStringToObject(json, "type", page_type_strtab[page->type]);
+	cJSON_AddNumberToObject(json, "subtype", page->index);
+	if (page->type == ARRAY_PAGE) {
+		cJSON_AddNumberToObject(json, "struct-type", page->array.struct_type);
+		cJSON_AddNumberToObject(json, "rank", page->array.rank);
+	}
+
+	cJSON *values = cJSON_CreateIntArray_cb(page->nr_vars, ref_get_number, page->values);
+
+	cJSON_AddItemToObject(json, "values", values);
+	return json;
+}
+
+static cJSON *ref_heap_item_to_json(int i, possibly_unused void *_)
+{
+	if (!heap[i].ref)
+		return NULL;
+
+	cJSON *item = cJSON_CreateArray();
+	cJSON_AddItemToArray(item, cJSON_CreateNumber(i));
+	cJSON_AddItemToArray(item, cJSON_CreateNumber(heap[i].ref));
+	switch (heap[i].type) {
+	case VM_PAGE:
+		cJSON_AddItemToArray(item, ref_page_to_json(heap[i].page));
+		break;
+	case VM_STRING:
+		cJSON_AddItemToArray(item, cJSON_CreateString(heap[i].s->text));
+		break;
+	}
+	if (ain->nr_delegates > 0) {
+		cJSON_AddItemToArray(item, cJSON_CreateNumber(heap[i].seq));
+	}
+	return item;
+}
+
+static cJSON *ref_funcall_to_json(struct function_call *call)
+{
+	cJSON *json = cJSON_CreateObject();
+	cJSON_AddNumberToObject(json, "function", call->fno);
+	cJSON_AddNumberToObject(json, "return-address", call->return_address);
+	cJSON_AddNumberToObject(json, "local-page", call->page_slot);
+	cJSON_AddNumberToObject(json, "struct-page", call->struct_page);
+	return json;
+}
+
+static cJSON *ref_vm_image_to_json(const char *key)
+{
+	cJSON *image = cJSON_CreateObject();
+	cJSON_AddStringToObject(image, "key", key);
+	cJSON_AddItemToObject(image, "heap", cJSON_CreateArray_cb(heap_size, ref_heap_item_to_json, NULL));
+	cJSON *calls = cJSON_CreateArray();
+	for (int i = 0; i < call_stack_ptr; i++) {
+		cJSON_AddItemToArray(calls, ref_funcall_to_json(&call_stack[i]));
+	}
+	cJSON_AddItemToObject(image, "call-stack", calls);
+	cJSON *values = cJSON_CreateArray();
+	for (int i = 0; i < stack_ptr; i++) {
+		cJSON_AddItemToArray(values, cJSON_CreateNumber(stack[i].i));
+	}
+	cJSON_AddItemToObject(image, "stack", values);
+	cJSON_AddNumberToObject(image, "ip", instr_ptr);
+	if (ain->nr_delegates > 0) {
+		cJSON_AddNumberToObject(image, "next_seq", heap_next_seq);
+	}
+	return image;
+}
+
+/*
+ * Test image.
+ */
+
+static uint32_t rng = 2463534242;
+
+static uint32_t rand32(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+static const char * const strings[] = {
+	"",
+	"plain",
+	"quote \" backslash \\ slash /",
+	"control \b\f\n\r\t\x01\x1f",
+	"UTF-8 \xe3\x81\x82\xe3\x81\x84\xe3\x81\x86 \xf0\x9f\x8e\xb2",
+};
+#define NR_STRINGS (sizeof(strings) / sizeof(*strings))
+
+static void set_slot(int slot, int ref, enum vm_pointer_type type)
+{
+	if ((size_t)slot >= heap_size)
+		heap_grow(heap_size * 2);
+	heap[slot].ref = ref;
+	heap[slot].seq = ain->nr_delegates > 0 ? 1000 + slot * 3 : slot;
+	heap[slot].type = type;
+}
+
+static struct page *random_page(void)
+{
+	static const enum page_type types[] = {
+		GLOBAL_PAGE, LOCAL_PAGE, STRUCT_PAGE, ARRAY_PAGE, DELEGATE_PAGE
+	};
+	enum page_type type = types[rand32() % 5];
+	// some pages are large enough to span the writer's buffer
+	int nr_vars = rand32() % 8 == 0 ? 20000 : rand32() % 20;
+	struct page *page = alloc_page(type, rand32() % 100, nr_vars);
+	if (type == ARRAY_PAGE) {
+		page->array.struct_type = (int)(rand32() % 10) - 1;
+		page->array.rank = 1 + rand32() % 3;
+	} else if (type == LOCAL_PAGE) {
+		page->local.struct_ptr = -1;
+	}
+	for (int i = 0; i < nr_vars; i++) {
+		page->values[i].i = rand32() % 4 ? (int)(rand32() % 2001) - 1000 : (int32_t)rand32();
+	}
+	return page;
+}
+
+static void build_image(int nr_slots)
+{
+	heap_grow(16);
+	for (int slot = 0; slot < nr_slots; slot++) {
+		switch (rand32() % 6) {
+		case 0:
+			// free slot; not written
+			break;
+		case 1:
+			set_slot(slot, 1 + rand32() % 3, VM_STRING);
+			const char *s = strings[rand32() % NR_STRINGS];
+			heap[slot].s = make_string(s, strlen(s));
+			break;
+		case 2:
+			// empty array
+			set_slot(slot, 1, VM_PAGE);
+			heap[slot].page = NULL;
+			break;
+		default:
+			set_slot(slot, 1 + rand32() % 3, VM_PAGE);
+			heap[slot].page = random_page();
+			break;
+		}
+	}
+	heap_next_seq = 1000 + nr_slots * 3;
+
+	call_stack_ptr = 0;
+	for (int i = 0; i < 5; i++) {
+		call_stack[call_stack_ptr++] = (struct function_call) {
+			.fno = rand32() % 100,
+			.return_address = i ? rand32() % 100000 : 0xFFFFFFFF,
+			.page_slot = rand32() % nr_slots,
+			.struct_page = i % 2 ? -1 : (int)(rand32() % nr_slots),
+		};
+	}
+	stack_ptr = 0;
+	for (int i = 0; i < 10; i++) {
+		stack_push((int32_t)rand32());
+	}
+	instr_ptr = rand32() % 100000;
+}
+
+struct image {
+	struct vm_pointer *heap;
+	size_t heap_size;
+	struct function_call call_stack[16];
+	int call_stack_ptr;
+	union vm_value stack[64];
+	int stack_ptr;
+	size_t instr_ptr;
+	uint32_t next_seq;
+};
+
+// Moves the VM state into an image, leaving the VM empty.
+static void take_image(struct image *image)
+{
+	image->heap = heap;
+	image->heap_size = heap_size;
+	memcpy(image->call_stack, call_stack, call_stack_ptr * sizeof(struct function_call));
+	image->call_stack_ptr = call_stack_ptr;
+	memcpy(image->stack, stack, stack_ptr * sizeof(union vm_value));
+	image->stack_ptr = stack_ptr;
+	image->instr_ptr = instr_ptr;
+	image->next_seq = heap_next_seq;
+
+	heap = NULL;
+	heap_size = 0;
+	free(heap_free_stack);
+	heap_free_stack = NULL;
+	heap_free_ptr = 0;
+	heap_grow(16);
+	call_stack_ptr = 0;
+	stack_ptr = 0;
+	instr_ptr = 0;
+	heap_next_seq = 0;
+}
+
+static bool pages_equal(struct page *a, struct page *b)
+{
+	if (!a || !b)
+		return a == b;
+	if (a->type != b->type || a->index != b->index || a->nr_vars != b->nr_vars)
+		return false;
+	if (a->type == ARRAY_PAGE && (a->array.struct_type != b->array.struct_type
+				      || a->array.rank != b->array.rank))
+		return false;
+	return !memcmp(a->values, b->values, a->nr_vars * sizeof(union vm_value));
+}
+
+static int compare_heap(struct image *image)
+{
+	int nr_different = 0;
+	for (size_t i = 0; i < max(heap_size, image->heap_size); i++) {
+		struct vm_pointer *a = i < image->heap_size ? &image->heap[i] : NULL;
+		struct vm_pointer *b = i < heap_size ? &heap[i] : NULL;
+		int a_ref = a ? a->ref : 0;
+		int b_ref = b ? b->ref : 0;
+		bool equal = a_ref == b_ref;
+		if (equal && a_ref) {
+			equal = a->type == b->type && a->seq == b->seq;
+			if (equal && a->type == VM_STRING)
+				equal = a->s->size == b->s->size && !memcmp(a->s->text, b->s->text, a->s->size);
+			else if (equal)
+				equal = pages_equal(a->page, b->page);
+		}
+		if (!equal && nr_different++ < 5)
+			fprintf(stderr, "heap slot %zu differs\n", i);
+	}
+	return nr_different;
+}
+
+static void free_image(struct image *image)
+{
+	for (size_t i = 0; i < image->heap_size; i++) {
+		if (!image->heap[i].ref)
+			continue;
+		if (image->heap[i].type == VM_STRING)
+			free_string(image->heap[i].s);
+		else
+			free(image->heap[i].page);
+	}
+	free(image->heap);
+}
+
+static void reset_vm(void)
+{
+	delete_heap();
+	free(heap);
+	free(heap_free_stack);
+	heap = NULL;
+	heap_free_stack = NULL;
+	heap_size = 0;
+	call_stack_ptr = 0;
+	stack_ptr = 0;
+}
+
+static void write_image(const char *key)
+{
+	FILE *f = fopen(JSON_FILE, "wb");
+	struct json_writer w;
+	json_writer_init(&w, f);
+	write_json_image(&w, key);
+	TEST_ASSERT(json_writer_finish(&w));
+	TEST_ASSERT(!fclose(f));
+}
+
+static void test_json_image(int nr_delegates, int nr_slots)
+{
+	struct ain a = { .nr_delegates = nr_delegates };
+	ain = &a;
+	build_image(nr_slots);
+
+	// same document as the cJSON writer
+	write_image("test-key");
+	char *text = file_read(JSON_FILE, NULL);
+	cJSON *streamed = cJSON_Parse(text);
+	cJSON *reference = ref_vm_image_to_json("test-key");
+	TEST_ASSERT(streamed);
+	TEST_ASSERT(cJSON_Compare(streamed, reference, true));
+	cJSON_Delete(streamed);
+	cJSON_Delete(reference);
+	free(text);
+
+	// round trip
+	struct image image;
+	take_image(&image);
+	load_json_image("test-key", JSON_FILE);
+	TEST_EQUAL(compare_heap(&image), 0);
+	TEST_EQUAL(call_stack_ptr, image.call_stack_ptr);
+	for (int i = 0; i < min(call_stack_ptr, image.call_stack_ptr); i++) {
+		struct function_call *a = &image.call_stack[i], *b = &call_stack[i];
+		TEST_EQUAL(b->fno, a->fno);
+		// VM_RETURN doesn't fit in an int and comes back as INT_MAX, as
+		// it did with cJSON's valueint
+		TEST_EQUAL(b->return_address, min(a->return_address, INT_MAX));
+		TEST_EQUAL(b->page_slot, a->page_slot);
+		TEST_EQUAL(b->struct_page, a->struct_page);
+	}
+	// the loader pops the two arguments of SYS_RESUME_SAVE
+	TEST_EQUAL(stack_ptr, image.stack_ptr - 2);
+	TEST_ASSERT(!memcmp(stack, image.stack, (image.stack_ptr - 2) * sizeof(union vm_value)));
+	TEST_EQUAL(instr_ptr, image.instr_ptr);
+	TEST_EQUAL(heap_next_seq, nr_delegates > 0 ? image.next_seq : heap_size);
+
+	free_image(&image);
+	reset_vm();
+	remove(JSON_FILE);
+}
+
+/*
+ * Asynchronous RSM saves.
+ */
+
+static struct ain_variable int_vars[5] = {
+	{ .name = "a", .type = { .data = AIN_INT } },
+	{ .name = "b", .type = { .data = AIN_INT } },
+	{ .name = "c", .type = { .data = AIN_INT } },
+	{ .name = "d", .type = { .data = AIN_INT } },
+	{ .name = "e", .type = { .data = AIN_INT } },
+};
+
+static struct ain_function rsave_functions[] = {
+	{ .name = "main", .address = 0, .nr_vars = 4, .vars = int_vars, .crc = 1 },
+	{ .name = "f", .address = 100, .nr_vars = 4, .vars = int_vars, .crc = 2 },
+};
+
+static struct ain_struct rsave_structures[] = {
+	{ .name = "S", .constructor = -1, .destructor = 1, .nr_members = 3, .members = int_vars },
+};
+
+static struct ain rsave_ain = {
+	.version = 4,
+	.nr_functions = 2,
+	.functions = rsave_functions,
+	.nr_globals = 5,
+	.globals = int_vars,
+	.nr_structures = 1,
+	.structures = rsave_structures,
+};
+
+static void fill_page(struct page *page)
+{
+	for (int i = 0; i < page->nr_vars; i++) {
+		page->values[i].i = (int32_t)rand32();
+	}
+}
+
+static void build_rsave_image(int nr_slots)
+{
+	ain = &rsave_ain;
+	heap_grow(16);
+	set_slot(0, 1, VM_PAGE);
+	heap[0].page = alloc_page(GLOBAL_PAGE, 0, ain->nr_globals);
+	fill_page(heap[0].page);
+	for (int slot = 1; slot < nr_slots; slot++) {
+		struct page *page = NULL;
+		switch (rand32() % 7) {
+		case 0:
+			continue;
+		case 1:
+			set_slot(slot, 1, VM_STRING);
+			const char *s = strings[rand32() % NR_STRINGS];
+			heap[slot].s = make_string(s, strlen(s));
+			continue;
+		case 2:
+			page = alloc_page(LOCAL_PAGE, 1, rsave_functions[1].nr_vars);
+			page->local.struct_ptr = -1;
+			break;
+		case 3:
+			page = alloc_page(STRUCT_PAGE, 0, rsave_structures[0].nr_members);
+			break;
+		case 4:
+			page = alloc_page(ARRAY_PAGE, AIN_ARRAY_INT, rand32() % 2000);
+			page->array.struct_type = -1;
+			page->array.rank = 1;
+			break;
+		case 5:
+			page = alloc_page(DELEGATE_PAGE, 0, 2 * (rand32() % 4));
+			break;
+		case 6:
+			// empty array
+			break;
+		}
+		set_slot(slot, 1 + rand32() % 3, VM_PAGE);
+		heap[slot].page = page;
+		if (page)
+			fill_page(page);
+	}
+	heap_next_seq = nr_slots;
+
+	call_stack[0] = (struct function_call) {
+		.fno = 0, .return_address = 0xFFFFFFFF, .page_slot = -1, .struct_page = -1
+	};
+	call_stack[1] = (struct function_call) {
+		.fno = 1, .return_address = 50, .page_slot = -1, .struct_page = -1
+	};
+	call_stack_ptr = 2;
+	stack_ptr = 0;
+	for (int i = 0; i < 8; i++) {
+		stack_push((int32_t)rand32());
+	}
+	instr_ptr = 150;
+}
+
+// Changes every live heap object, frees some and reuses their memory.
+static void mutate_image(void)
+{
+	for (size_t slot = 0; slot < heap_size; slot++) {
+		if (!heap[slot].ref)
+			continue;
+		if (heap[slot].type == VM_STRING) {
+			free_string(heap[slot].s);
+			heap[slot].s = make_string("mutated", 7);
+		} else if (heap[slot].page && slot > 0 && rand32() % 4 == 0) {
+			free_page(heap[slot].page);
+			heap[slot].ref = 0;
+		} else if (heap[slot].page) {
+			for (int i = 0; i < heap[slot].page->nr_vars; i++) {
+				heap[slot].page->values[i].i ^= 0x5a5a5a5a;
+			}
+		}
+	}
+	for (int i = 0; i < stack_ptr; i++) {
+		stack[i].i++;
+	}
+}
+
+static bool slots_equal(int32_t *a, int nr_a, int32_t *b, int nr_b)
+{
+	return nr_a == nr_b && !memcmp(a, b, nr_a * sizeof(int32_t));
+}
+
+static bool rsave_objects_equal(void *a, void *b)
+{
+	enum rsave_heap_tag tag = *(enum rsave_heap_tag*)a;
+	if (tag != *(enum rsave_heap_tag*)b)
+		return false;
+	switch (tag) {
+	case RSAVE_GLOBALS:
+	case RSAVE_LOCALS: {
+		struct rsave_heap_frame *x = a, *y = b;
+		return x->ref == y->ref && x->seq == y->seq
+			&& slots_equal(x->slots, x->nr_slots, y->slots, y->nr_slots);
+	}
+	case RSAVE_STRING: {
+		struct rsave_heap_string *x = a, *y = b;
+		return x->ref == y->ref && x->seq == y->seq
+			&& x->len == y->len && !memcmp(x->text, y->text, x->len);
+	}
+	case RSAVE_ARRAY: {
+		struct rsave_heap_array *x = a, *y = b;
+		return x->ref == y->ref && x->seq == y->seq
+			&& slots_equal(x->slots, x->nr_slots, y->slots, y->nr_slots);
+	}
+	case RSAVE_STRUCT: {
+		struct rsave_heap_struct *x = a, *y = b;
+		return x->ref == y->ref && x->seq == y->seq
+			&& slots_equal(x->slots, x->nr_slots, y->slots, y->nr_slots);
+	}
+	case RSAVE_DELEGATE: {
+		struct rsave_heap_delegate *x = a, *y = b;
+		return x->ref == y->ref && x->seq == y->seq
+			&& slots_equal(x->slots, x->nr_slots, y->slots, y->nr_slots);
+	}
+	case RSAVE_NULL:
+		return true;
+	}
+	return false;
+}
+
+// Compares the saved heaps and stacks; returns the number of differences.
+static int compare_rsave_files(const char *path_a, const char *path_b)
+{
+	enum savefile_error error;
+	struct rsave *a = rsave_read(path_a, RSAVE_READ_ALL, &error);
+	TEST_EQUAL(error, SAVEFILE_SUCCESS);
+	struct rsave *b = rsave_read(path_b, RSAVE_READ_ALL, &error);
+	TEST_EQUAL(error, SAVEFILE_SUCCESS);
+	if (!a || !b)
+		return -1;
+
+	int nr_different = 0;
+	if (a->nr_heap_objs != b->nr_heap_objs)
+		nr_different++;
+	for (int i = 0; i < min(a->nr_heap_objs, b->nr_heap_objs); i++) {
+		if (!rsave_objects_equal(a->heap[i], b->heap[i]))
+			nr_different++;
+	}
+	if (!slots_equal(a->stack, a->stack_size, b->stack, b->stack_size))
+		nr_different++;
+	rsave_free(a);
+	rsave_free(b);
+	return nr_different;
+}
+
+static void test_async_save(void)
+{
+	config.save_format = SAVE_FORMAT_RSM;
+	build_rsave_image(20000);
+
+	config.save_async = false;
+	TEST_ASSERT(vm_save_image("test-key", SYNC_FILE));
+
+	// mutate the heap while the worker is compressing and writing
+	config.save_async = true;
+	TEST_ASSERT(vm_save_image("test-key", ASYNC_FILE));
+	TEST_ASSERT(save_thread != NULL);
+	mutate_image();
+	vm_wait_for_save();
+	TEST_ASSERT(save_thread == NULL);
+	TEST_EQUAL(compare_rsave_files(SYNC_FILE, ASYNC_FILE), 0);
+
+	// the mutation is visible to the next save
+	config.save_async = false;
+	TEST_ASSERT(vm_save_image("test-key", MUTATED_FILE));
+	TEST_ASSERT(compare_rsave_files(SYNC_FILE, MUTATED_FILE) > 0);
+
+	reset_vm();
+	remove(SYNC_FILE);
+	remove(ASYNC_FILE);
+	remove(MUTATED_FILE);
+}
+
+/*
+ * Benchmark.
+ */
+
+#define BENCH_SLOTS 20000
+#define BENCH_FILE "test_resume_bench.rsm"
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(void)
+{
+	build_rsave_image(BENCH_SLOTS);
+	// mostly small integers and flags, like a real heap
+	size_t nr_values = 0;
+	for (size_t slot = 0; slot < heap_size; slot++) {
+		if (!heap[slot].ref || heap[slot].type != VM_PAGE || !heap[slot].page)
+			continue;
+		struct page *page = heap[slot].page;
+		for (int i = 0; i < page->nr_vars; i++) {
+			uint32_t r = rand32();
+			page->values[i].i = r % 4 ? (int)(r >> 28) : (int)(r >> 8) % 1000;
+		}
+		nr_values += page->nr_vars;
+	}
+	printf("%d heap slots, %zu values\n", BENCH_SLOTS, nr_values);
+	printf("level  snapshot ms  write ms  size KB\n");
+	config.save_async = false;
+	for (int level = 0; level <= 9; level++) {
+		config.save_compression_level = level;
+		double t0 = now();
+		struct rsave *save = vm_image_to_rsave("bench-key");
+		double t1 = now();
+		FILE *fp = open_rsave_file(BENCH_FILE);
+		write_rsave_file(save, fp);
+		double t2 = now();
+		rsave_free(save);
+
+		struct stat st;
+		TEST_EQUAL(stat(BENCH_FILE, &st), 0);
+		printf("%5d  %11.1f  %8.1f  %7lld\n", level, (t1 - t0) * 1000, (t2 - t1) * 1000,
+				(long long)st.st_size / 1024);
+	}
+	reset_vm();
+	remove(BENCH_FILE);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1 && !strcmp(argv[1], "--bench")) {
+		bench();
+		return test_finish("resume bench");
+	}
+	test_json_image(0, 3000);
+	test_json_image(2, 3000);
+	test_json_image(0, 1);
+	test_async_save();
+	return test_finish("resume");
+}
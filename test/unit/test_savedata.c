@@ -0,0 +1,459 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "../../src/savedata.c"
+#include "test.h"
+
+/*
+ * Checks that save_globals skips rewriting a gsave whose globals haven't
+ * changed, and rewrites it when any value reachable from the group's globals
+ * has changed or the file was touched by someone else.
+ *
+ * A skipped write is detected by overwriting the file with zeros of the same
+ * size and restoring its mtime; save_globals can't tell the difference, so the
+ * zeros survive if and only if it skipped the write.
+ *
+ * Usage: test_savedata
+ *        test_savedata --bench
+ *
+ * --bench reports the cost of save_globals with and without changes instead,
+ * and of a changed save at each save-compression-level.
+ */
+
+#define SAVE_FILE "test_savedata_save.asd"
+#define SYSTEM_FILE "test_savedata_system.asd"
+
+/*
+ * The parts of the VM that savedata.c works on.
+ */
+
+struct ain *ain;
+struct config config = { .save_compression_level = -1 };
+
+struct vm_pointer *heap = NULL;
+size_t heap_size = 0;
+static size_t heap_used = 0;
+
+static union vm_value *globals;
+
+union vm_value global_get(int varno)
+{
+	return globals[varno];
+}
+
+struct page *heap_get_page(int index)
+{
+	return heap[index].page;
+}
+
+enum ain_data_type variable_type(struct page *page, int varno, int *struct_type, int *array_rank)
+{
+	if (page->type == STRUCT_PAGE)
+		return ain->structures[page->index].members[varno].type.data;
+	// only int and string arrays here
+	return page->a_type == AIN_ARRAY_STRING ? AIN_STRING : AIN_INT;
+}
+
+void vm_wait_for_save(void)
+{
+}
+
+char *savedir_path(const char *path)
+{
+	return xstrdup(path);
+}
+
+const char *display_sjis0(const char *sjis)
+{
+	return sjis;
+}
+
+const char *display_sjis1(const char *sjis)
+{
+	return sjis;
+}
+
+const char *display_utf0(const char *utf)
+{
+	return utf;
+}
+
+_Noreturn void _vm_error(const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	abort();
+}
+
+// only used when loading, which isn't tested here
+void global_set(int varno, union vm_value val, bool call_dtors)
+{
+	abort();
+}
+
+int alloc_struct(int no)
+{
+	abort();
+}
+
+int32_t heap_alloc_slot(enum vm_pointer_type type)
+{
+	abort();
+}
+
+struct page *alloc_array(int rank, union vm_value *dimensions, enum ain_data_type data_type,
+		int struct_type, bool init_structs)
+{
+	abort();
+}
+
+void variable_set(struct page *page, int varno, enum ain_data_type type, union vm_value val)
+{
+	abort();
+}
+
+static int new_slot(void)
+{
+	if (heap_used == heap_size) {
+		size_t new_size = heap_size ? heap_size * 2 : 256;
+		heap = xrealloc_array(heap, heap_size, new_size, sizeof(struct vm_pointer));
+		heap_size = new_size;
+	}
+	heap[heap_used].ref = 1;
+	return heap_used++;
+}
+
+static int new_string(const char *s)
+{
+	int slot = new_slot();
+	heap[slot].type = VM_STRING;
+	heap[slot].s = make_string(s, strlen(s));
+	return slot;
+}
+
+static void set_string(int slot, const char *s)
+{
+	free_string(heap[slot].s);
+	heap[slot].s = make_string(s, strlen(s));
+}
+
+static int new_page(enum page_type type, int index, int nr_vars)
+{
+	int slot = new_slot();
+	heap[slot].type = VM_PAGE;
+	heap[slot].page = xcalloc(1, sizeof(struct page) + nr_vars * sizeof(union vm_value));
+	heap[slot].page->type = type;
+	heap[slot].page->index = index;
+	heap[slot].page->nr_vars = nr_vars;
+	if (type == ARRAY_PAGE) {
+		heap[slot].page->array.rank = 1;
+		heap[slot].page->array.struct_type = -1;
+	}
+	return slot;
+}
+
+static void free_heap(void)
+{
+	for (size_t i = 0; i < heap_used; i++) {
+		if (heap[i].type == VM_STRING)
+			free_string(heap[i].s);
+		else
+			free(heap[i].page);
+	}
+	free(heap);
+	heap = NULL;
+	heap_size = 0;
+	heap_used = 0;
+}
+
+/*
+ * Test program: globals in two groups, "Save" and "System".
+ */
+
+enum {
+	G_SCORE,   // int
+	G_NAME,    // string
+	G_PLAYER,  // struct Player { int level; string title; }
+	G_FLAGS,   // array@int
+	G_VOLUME,  // int, group System
+	NR_GLOBALS
+};
+
+static struct ain_variable player_members[] = {
+	{ .name = "level", .type = { .data = AIN_INT } },
+	{ .name = "title", .type = { .data = AIN_STRING } },
+};
+
+static struct ain_struct test_structures[] = {
+	{ .name = "Player", .constructor = -1, .destructor = -1, .nr_members = 2, .members = player_members },
+};
+
+static struct ain_variable test_globals[NR_GLOBALS] = {
+	[G_SCORE]  = { .name = "Score",  .type = { .data = AIN_INT },           .group_index = 0 },
+	[G_NAME]   = { .name = "Name",   .type = { .data = AIN_STRING },        .group_index = 0 },
+	[G_PLAYER] = { .name = "Player", .type = { .data = AIN_STRUCT, .struc = 0 }, .group_index = 0 },
+	[G_FLAGS]  = { .name = "Flags",  .type = { .data = AIN_ARRAY_INT, .rank = 1 }, .group_index = 0 },
+	[G_VOLUME] = { .name = "Volume", .type = { .data = AIN_INT },           .group_index = 1 },
+};
+
+static char *test_group_names[] = { "Save", "System" };
+
+static struct ain test_ain = {
+	.version = 4,
+	.nr_globals = NR_GLOBALS,
+	.globals = test_globals,
+	.nr_structures = 1,
+	.structures = test_structures,
+	.nr_global_groups = 2,
+	.global_group_names = test_group_names,
+};
+
+static union vm_value test_values[NR_GLOBALS];
+
+static void init_test_globals(void)
+{
+	ain = &test_ain;
+	globals = test_values;
+	globals[G_SCORE].i = 100;
+	globals[G_NAME].i = new_string("Rance");
+	int player = new_page(STRUCT_PAGE, 0, 2);
+	heap[player].page->values[0].i = 7;
+	heap[player].page->values[1].i = new_string("Warrior");
+	globals[G_PLAYER].i = player;
+	globals[G_FLAGS].i = new_page(ARRAY_PAGE, AIN_ARRAY_INT, 64);
+	globals[G_VOLUME].i = 80;
+}
+
+// Overwrites the file with zeros, keeping its size and timestamps.
+static void scribble(const char *path)
+{
+	struct stat s;
+	if (stat(path, &s) < 0) {
+		TEST_ASSERT(!"stat failed");
+		return;
+	}
+	FILE *f = fopen(path, "r+b");
+	for (off_t i = 0; i < s.st_size; i++) {
+		fputc(0, f);
+	}
+	fclose(f);
+	struct timespec times[2] = { s.st_atim, s.st_mtim };
+	TEST_EQUAL(utimensat(AT_FDCWD, path, times, 0), 0);
+}
+
+static bool is_scribbled(const char *path)
+{
+	size_t size;
+	uint8_t *data = file_read(path, &size);
+	bool zero = data && size > 0;
+	for (size_t i = 0; zero && i < size; i++) {
+		zero = data[i] == 0;
+	}
+	free(data);
+	return zero;
+}
+
+static int32_t saved_int(const char *path, int index)
+{
+	enum savefile_error error;
+	struct gsave *save = gsave_read(path, &error);
+	TEST_EQUAL(error, SAVEFILE_SUCCESS);
+	if (!save)
+		return -1;
+	int32_t v = index < save->nr_globals ? save->globals[index].value : -1;
+	gsave_free(save);
+	return v;
+}
+
+// Saves the group over a scribbled copy of its file; returns true if written.
+static bool save_written(const char *path, const char *group)
+{
+	scribble(path);
+	int n = -1;
+	TEST_EQUAL(save_globals("test-key", path, group, &n), 1);
+	TEST_EQUAL(n, group && !strcmp(group, "System") ? 1 : NR_GLOBALS - 1);
+	return !is_scribbled(path);
+}
+
+static void test_skip(void)
+{
+	init_test_globals();
+
+	int n = -1;
+	TEST_EQUAL(save_globals("test-key", SAVE_FILE, "Save", &n), 1);
+	TEST_EQUAL(n, NR_GLOBALS - 1);
+	TEST_EQUAL(saved_int(SAVE_FILE, 0), 100);
+	TEST_EQUAL(save_globals("test-key", SYSTEM_FILE, "System", &n), 1);
+
+	// unchanged
+	TEST_ASSERT(!save_written(SAVE_FILE, "Save"));
+	TEST_ASSERT(!save_written(SYSTEM_FILE, "System"));
+
+	// a global in the group
+	globals[G_SCORE].i = 101;
+	TEST_ASSERT(save_written(SAVE_FILE, "Save"));
+	TEST_EQUAL(saved_int(SAVE_FILE, 0), 101);
+	TEST_ASSERT(!save_written(SAVE_FILE, "Save"));
+
+	// a global in another group
+	globals[G_VOLUME].i = 60;
+	TEST_ASSERT(!save_written(SAVE_FILE, "Save"));
+	TEST_ASSERT(save_written(SYSTEM_FILE, "System"));
+	TEST_EQUAL(saved_int(SYSTEM_FILE, 0), 60);
+
+	// a string, a struct member and an array element reached from a global
+	set_string(globals[G_NAME].i, "Ranse");
+	TEST_ASSERT(save_written(SAVE_FILE, "Save"));
+	struct page *player = heap[globals[G_PLAYER].i].page;
+	set_string(player->values[1].i, "Warlock");
+	TEST_ASSERT(save_written(SAVE_FILE, "Save"));
+	player->values[0].i++;
+	TEST_ASSERT(save_written(SAVE_FILE, "Save"));
+	heap[globals[G_FLAGS].i].page->values[63].i = 1;
+	TEST_ASSERT(save_written(SAVE_FILE, "Save"));
+	TEST_ASSERT(!save_written(SAVE_FILE, "Save"));
+
+	// same data under another key
+	scribble(SAVE_FILE);
+	TEST_EQUAL(save_globals("other-key", SAVE_FILE, "Save", NULL), 1);
+	TEST_ASSERT(!is_scribbled(SAVE_FILE));
+	scribble(SAVE_FILE);
+	TEST_EQUAL(save_globals("test-key", SAVE_FILE, "Save", NULL), 1);
+	TEST_ASSERT(!is_scribbled(SAVE_FILE));
+
+	// the file was truncated by someone else
+	FILE *f = fopen(SAVE_FILE, "wb");
+	fclose(f);
+	TEST_EQUAL(save_globals("test-key", SAVE_FILE, "Save", NULL), 1);
+	TEST_EQUAL(saved_int(SAVE_FILE, 0), 101);
+	TEST_ASSERT(!save_written(SAVE_FILE, "Save"));
+
+	// the file was deleted
+	TEST_EQUAL(delete_save_file(SAVE_FILE), 1);
+	TEST_EQUAL(save_globals("test-key", SAVE_FILE, "Save", NULL), 1);
+	TEST_EQUAL(saved_int(SAVE_FILE, 0), 101);
+
+	// another writer invalidated it
+	savedata_invalidate_file(SAVE_FILE);
+	TEST_ASSERT(save_written(SAVE_FILE, "Save"));
+
+	remove(SAVE_FILE);
+	remove(SYSTEM_FILE);
+	free_heap();
+}
+
+/*
+ * Benchmark: a large "Save" group, saved unchanged and after changing one
+ * value.
+ */
+
+#define BENCH_INTS 4000
+#define BENCH_STRINGS 1000
+#define BENCH_ARRAYS 40
+#define BENCH_ARRAY_SIZE 5000
+#define BENCH_GLOBALS (BENCH_INTS + BENCH_STRINGS + BENCH_ARRAYS)
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void init_bench_globals(void)
+{
+	static struct ain bench_ain;
+	static char *group_names[] = { "Save" };
+	struct ain_variable *vars = xcalloc(BENCH_GLOBALS, sizeof(struct ain_variable));
+	globals = xcalloc(BENCH_GLOBALS, sizeof(union vm_value));
+	for (int i = 0; i < BENCH_GLOBALS; i++) {
+		char name[32];
+		sprintf(name, "g%d", i);
+		vars[i].name = xstrdup(name);
+		if (i < BENCH_INTS) {
+			vars[i].type.data = AIN_INT;
+			globals[i].i = i;
+		} else if (i < BENCH_INTS + BENCH_STRINGS) {
+			vars[i].type.data = AIN_STRING;
+			globals[i].i = new_string("\x83\x65\x83\x58\x83\x67 string value");
+		} else {
+			vars[i].type.data = AIN_ARRAY_INT;
+			vars[i].type.rank = 1;
+			globals[i].i = new_page(ARRAY_PAGE, AIN_ARRAY_INT, BENCH_ARRAY_SIZE);
+			struct page *page = heap[globals[i].i].page;
+			for (int j = 0; j < BENCH_ARRAY_SIZE; j++) {
+				page->values[j].i = (i * j) % 7;
+			}
+		}
+	}
+	bench_ain = (struct ain) {
+		.version = 4,
+		.nr_globals = BENCH_GLOBALS,
+		.globals = vars,
+		.nr_global_groups = 1,
+		.global_group_names = group_names,
+	};
+	ain = &bench_ain;
+}
+
+static double bench_saves(int nr_saves, bool change)
+{
+	double t = now();
+	for (int i = 0; i < nr_saves; i++) {
+		if (change)
+			globals[i % BENCH_INTS].i++;
+		TEST_EQUAL(save_globals("bench-key", SAVE_FILE, "Save", NULL), 1);
+	}
+	return (now() - t) / nr_saves * 1000;
+}
+
+static void bench(void)
+{
+	init_bench_globals();
+	printf("%d ints, %d strings, %d arrays of %d ints\n", BENCH_INTS, BENCH_STRINGS,
+			BENCH_ARRAYS, BENCH_ARRAY_SIZE);
+	bench_saves(1, true);
+	printf("changed:   %8.3f ms/save\n", bench_saves(20, true));
+	printf("unchanged: %8.3f ms/save\n", bench_saves(200, false));
+
+	// gsave_write at each save-compression-level
+	printf("level  ms/save  size KB\n");
+	for (int level = 0; level <= 9; level++) {
+		config.save_compression_level = level;
+		double ms = bench_saves(5, true);
+		struct stat st;
+		TEST_EQUAL(stat(SAVE_FILE, &st), 0);
+		printf("%5d  %7.2f  %7lld\n", level, ms, (long long)st.st_size / 1024);
+	}
+	config.save_compression_level = -1;
+	remove(SAVE_FILE);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1 && !strcmp(argv[1], "--bench")) {
+		bench();
+		return test_finish("savedata bench");
+	}
+	test_skip();
+	return test_finish("savedata");
+}
@@ -0,0 +1,403 @@
+/* Copyright (C) 2026 Nunuhara Cabbage <nunuhara@haniwa.technology>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+#include <time.h>
+
+#include "../../src/hll/vmArray.c"
+#include "test.h"
+
+/*
+ * Calls every bulk operation of vmArray and of vmArray_reference.c (the
+ * callback-per-element implementation it replaced) with the same random
+ * arguments, and checks that the results and both arrays come out the same.
+ *
+ * Usage: test_vm_array
+ *        test_vm_array --bench
+ *
+ * --bench reports the throughput of both implementations of every operation
+ * on million-element arrays instead.
+ */
+
+#define NR_TRIALS 2000
+
+extern struct static_library lib_vmArray_reference;
+
+_Noreturn void _vm_error(const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	abort();
+}
+
+enum op_kind {
+	OP_NUM,           // void f(struct page **array, int index, int num)
+	OP_ARRAY,         // void f(struct page **d_array, int index, struct page *s_array)
+	OP_ENUM,          // int f(struct page *array, int index, int num)
+	OP_ENUM_RANGE,    // int f(struct page *array, int index, int min, int max)
+	OP_CHANGE,        // void f(struct page **array, int index, int num, int exg)
+	OP_CHANGE_RANGE,  // void f(struct page **array, int index, int min, int max, int exg)
+	OP_GREP,          // int f(struct page *array, int index, int num, int *out_index)
+	OP_GREP_RANGE,    // int f(struct page *array, int index, int min, int max, int *out_index)
+	OP_GREP_ORDER,    // int f(struct page *s_array, int index, struct page **d_array, int *out_index)
+	OP_SET,           // void f(struct page *s_array, int index, int num, struct page **d_array)
+	OP_SET_RANGE,     // void f(struct page *s_array, int index, int min, int max, struct page **d_array)
+};
+
+static const struct {
+	const char *name;
+	enum op_kind kind;
+} ops[] = {
+	{ "AddNum", OP_NUM }, { "SubNum", OP_NUM }, { "MulNum", OP_NUM }, { "DivNum", OP_NUM },
+	{ "AndNum", OP_NUM }, { "OrNum", OP_NUM }, { "XorNum", OP_NUM },
+	{ "AddArray", OP_ARRAY }, { "SubArray", OP_ARRAY }, { "MulArray", OP_ARRAY },
+	{ "DivArray", OP_ARRAY }, { "AndArray", OP_ARRAY }, { "OrArray", OP_ARRAY },
+	{ "XorArray", OP_ARRAY },
+	{ "EnumEquNum", OP_ENUM }, { "EnumNotNum", OP_ENUM }, { "EnumLowNum", OP_ENUM },
+	{ "EnumHighNum", OP_ENUM }, { "EnumRangeNum", OP_ENUM_RANGE },
+	{ "ChangeEquNum", OP_CHANGE }, { "ChangeNotNum", OP_CHANGE }, { "ChangeLowNum", OP_CHANGE },
+	{ "ChangeHighNum", OP_CHANGE }, { "ChangeRangeNum", OP_CHANGE_RANGE },
+	{ "GrepEquNum", OP_GREP }, { "GrepNotNum", OP_GREP }, { "GrepLowNum", OP_GREP },
+	{ "GrepHighNum", OP_GREP }, { "GrepRangeNum", OP_GREP_RANGE },
+	{ "GrepLowOrder", OP_GREP_ORDER }, { "GrepHighOrder", OP_GREP_ORDER },
+	{ "SetEquNum", OP_SET }, { "SetNotNum", OP_SET }, { "SetLowNum", OP_SET },
+	{ "SetHighNum", OP_SET }, { "SetRangeNum", OP_SET_RANGE },
+	{ "OrEquNum", OP_SET }, { "OrNotNum", OP_SET }, { "OrLowNum", OP_SET },
+	{ "OrHighNum", OP_SET }, { "OrRangeNum", OP_SET_RANGE },
+};
+
+#define NR_OPS (sizeof(ops) / sizeof(*ops))
+
+static void *get_function(struct static_library *lib, const char *name)
+{
+	for (int i = 0; lib->functions[i].name; i++) {
+		if (!strcmp(lib->functions[i].name, name))
+			return lib->functions[i].fun;
+	}
+	return NULL;
+}
+
+static uint32_t rng = 88172645;
+
+static uint32_t rand32(void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng;
+}
+
+// mostly small values so that the predicates match often, plus the extremes
+static int random_value(void)
+{
+	switch (rand32() % 8) {
+	case 0: return INT32_MIN + (int)(rand32() % 4);
+	case 1: return INT32_MAX - (int)(rand32() % 4);
+	case 2: return (int32_t)rand32();
+	default: return (int)(rand32() % 17) - 8;
+	}
+}
+
+static struct page *make_array(int nr_vars)
+{
+	struct page *page = xcalloc(1, sizeof(struct page) + nr_vars * sizeof(union vm_value));
+	page->type = ARRAY_PAGE;
+	page->a_type = AIN_ARRAY_INT;
+	page->array.rank = 1;
+	page->nr_vars = nr_vars;
+	return page;
+}
+
+static struct page *copy_array(struct page *src)
+{
+	struct page *page = make_array(src->nr_vars);
+	memcpy(page->values, src->values, src->nr_vars * sizeof(union vm_value));
+	return page;
+}
+
+static bool arrays_equal(struct page *a, struct page *b)
+{
+	if (a->nr_vars != b->nr_vars)
+		return false;
+	for (int i = 0; i < a->nr_vars; i++) {
+		if (a->values[i].i != b->values[i].i)
+			return false;
+	}
+	return true;
+}
+
+struct args {
+	struct page *d;
+	struct page *s;  // may be the same page as d
+	int index;
+	int num, num2, exg;
+};
+
+// Returns the return value in the low 32 bits and out_index in the high 32 bits.
+static int64_t call(enum op_kind kind, void *fun, struct args *a)
+{
+	int out = -12345;
+	int r = 0;
+	switch (kind) {
+	case OP_NUM:
+		((void(*)(struct page**,int,int))fun)(&a->d, a->index, a->num);
+		break;
+	case OP_ARRAY:
+		((void(*)(struct page**,int,struct page*))fun)(&a->d, a->index, a->s);
+		break;
+	case OP_ENUM:
+		r = ((int(*)(struct page*,int,int))fun)(a->d, a->index, a->num);
+		break;
+	case OP_ENUM_RANGE:
+		r = ((int(*)(struct page*,int,int,int))fun)(a->d, a->index, a->num, a->num2);
+		break;
+	case OP_CHANGE:
+		((void(*)(struct page**,int,int,int))fun)(&a->d, a->index, a->num, a->exg);
+		break;
+	case OP_CHANGE_RANGE:
+		((void(*)(struct page**,int,int,int,int))fun)(&a->d, a->index, a->num, a->num2, a->exg);
+		break;
+	case OP_GREP:
+		r = ((int(*)(struct page*,int,int,int*))fun)(a->d, a->index, a->num, &out);
+		break;
+	case OP_GREP_RANGE:
+		r = ((int(*)(struct page*,int,int,int,int*))fun)(a->d, a->index, a->num, a->num2, &out);
+		break;
+	case OP_GREP_ORDER:
+		r = ((int(*)(struct page*,int,struct page**,int*))fun)(a->s, a->index, &a->d, &out);
+		break;
+	case OP_SET:
+		((void(*)(struct page*,int,int,struct page**))fun)(a->s, a->index, a->num, &a->d);
+		break;
+	case OP_SET_RANGE:
+		((void(*)(struct page*,int,int,int,struct page**))fun)(a->s, a->index, a->num, a->num2, &a->d);
+		break;
+	}
+	return (int64_t)((uint64_t)(uint32_t)out << 32 | (uint32_t)r);
+}
+
+static int random_length(void)
+{
+	// long arrays exercise the vectorized loop bodies, short ones the tails
+	switch (rand32() % 8) {
+	case 0: return 0;
+	case 1: return 200 + rand32() % 800;
+	default: return 1 + rand32() % 40;
+	}
+}
+
+static int random_index(enum op_kind kind, int n)
+{
+	// the reference reads out of bounds for a negative index in
+	// Enum*/Change*, and GrepLowOrder/GrepHighOrder reject it
+	bool negative_ok = kind != OP_ENUM && kind != OP_ENUM_RANGE
+		&& kind != OP_CHANGE && kind != OP_CHANGE_RANGE
+		&& kind != OP_GREP_ORDER;
+	if (n > 0 && negative_ok && rand32() % 2)
+		return -1 - (int)(rand32() % n);
+	return rand32() % (n + 3);
+}
+
+static int nr_mismatches = 0;
+
+static void test_op(int op)
+{
+	void *fun = get_function(&lib_vmArray, ops[op].name);
+	void *ref = get_function(&lib_vmArray_reference, ops[op].name);
+	TEST_ASSERT(fun && ref);
+	if (!fun || !ref)
+		return;
+
+	enum op_kind kind = ops[op].kind;
+	for (int trial = 0; trial < NR_TRIALS; trial++) {
+		int n = random_length();
+		struct page *d = make_array(n);
+		struct page *s = make_array(n);
+		for (int i = 0; i < n; i++) {
+			d->values[i].i = random_value();
+			s->values[i].i = random_value();
+			if (kind == OP_GREP_ORDER)
+				d->values[i].i = rand32() % 4 == 0;
+		}
+		// INT32_MIN / -1 overflows in both implementations
+		if (!strcmp(ops[op].name, "DivArray")) {
+			for (int i = 0; i < n; i++) {
+				d->values[i].i = max(d->values[i].i, INT32_MIN + 1);
+			}
+		}
+		bool aliased = (kind == OP_ARRAY || kind == OP_SET || kind == OP_SET_RANGE)
+			&& rand32() % 4 == 0;
+
+		struct args a = {
+			.index = random_index(kind, n),
+			.num = random_value(),
+			.num2 = random_value(),
+			.exg = random_value(),
+		};
+		struct args b = a;
+		a.d = copy_array(d);
+		a.s = aliased ? a.d : copy_array(s);
+		b.d = copy_array(d);
+		b.s = aliased ? b.d : copy_array(s);
+
+		// GrepLowOrder/GrepHighOrder mark what they found; run until exhausted
+		int nr_calls = kind == OP_GREP_ORDER ? n + 1 : 1;
+		bool ok = true;
+		for (int i = 0; i < nr_calls && ok; i++) {
+			ok = call(kind, fun, &a) == call(kind, ref, &b);
+		}
+		ok = ok && arrays_equal(a.d, b.d) && arrays_equal(a.s, b.s);
+		if (!ok && nr_mismatches++ < 5) {
+			fprintf(stderr, "%s: mismatch (n=%d, index=%d, num=%d, num2=%d, aliased=%d)\n",
+					ops[op].name, n, a.index, a.num, a.num2, aliased);
+		}
+
+		free(a.d);
+		free(b.d);
+		if (!aliased) {
+			free(a.s);
+			free(b.s);
+		}
+		free(d);
+		free(s);
+	}
+
+	// NULL arrays are ignored
+	if (kind != OP_GREP_ORDER) {
+		struct page *s = make_array(4);
+		struct args a = { .d = NULL, .s = s, .index = 0, .num = 1, .num2 = 2, .exg = 3 };
+		TEST_EQUAL(call(kind, fun, &a), call(kind, ref, &a));
+		free(s);
+	}
+}
+
+// every implemented bulk operation is covered by ops[]
+static void test_coverage(void)
+{
+	for (int i = 0; lib_vmArray.functions[i].name; i++) {
+		const char *name = lib_vmArray.functions[i].name;
+		if (!lib_vmArray.functions[i].fun)
+			continue;
+		// the board operations were not rewritten
+		if (strstr(name, "Rect") || strstr(name, "Hexa"))
+			continue;
+		bool found = false;
+		for (unsigned op = 0; op < NR_OPS; op++) {
+			if (!strcmp(ops[op].name, name))
+				found = true;
+		}
+		if (!found)
+			fprintf(stderr, "vmArray.%s is not tested\n", name);
+		TEST_ASSERT(found);
+	}
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#define BENCH_SIZE 1000000
+#define BENCH_RUNS 20
+
+// millions of elements per second, in the fastest of BENCH_RUNS calls
+static double throughput(enum op_kind kind, void *fun, struct page *d, struct page *s, int num)
+{
+	struct args a = {
+		.d = copy_array(d), .s = copy_array(s),
+		.index = 0, .num = num, .num2 = 9, .exg = 1
+	};
+	double best = 1e9;
+	for (int i = 0; i < BENCH_RUNS; i++) {
+		double t = now();
+		call(kind, fun, &a);
+		best = min(best, now() - t);
+	}
+	free(a.d);
+	free(a.s);
+	return BENCH_SIZE / best / 1e6;
+}
+
+/*
+ * Grep*Num stop at the first match. They search an array of zeros whose
+ * last element is 3, with a num that matches only that element or nothing.
+ */
+static int grep_num(const char *name)
+{
+	if (!strcmp(name, "GrepNotNum"))
+		return 0;
+	if (!strcmp(name, "GrepLowNum"))
+		return -1;
+	return 3;
+}
+
+static void bench(void)
+{
+	struct page *d = make_array(BENCH_SIZE);
+	struct page *s = make_array(BENCH_SIZE);
+	for (int i = 0; i < BENCH_SIZE; i++) {
+		d->values[i].i = (int)(rand32() % 17) - 8;
+		// no zero divisors for DivArray
+		s->values[i].i = 1 + rand32() % 16;
+	}
+	struct page *zeros = make_array(BENCH_SIZE);
+	zeros->values[BENCH_SIZE-1].i = 3;
+	// GrepLowOrder/GrepHighOrder: nothing is marked yet, so every call
+	// scans the whole array
+	struct page *marks = make_array(BENCH_SIZE);
+
+	printf("%d ints; millions of elements per second\n", BENCH_SIZE);
+	printf("%-16s  %9s  %9s\n", "", "callback", "vmArray");
+	for (unsigned op = 0; op < NR_OPS; op++) {
+		enum op_kind kind = ops[op].kind;
+		void *fun = get_function(&lib_vmArray, ops[op].name);
+		void *ref = get_function(&lib_vmArray_reference, ops[op].name);
+		struct page *dst = d;
+		int num = 3;
+		if (kind == OP_GREP || kind == OP_GREP_RANGE) {
+			dst = zeros;
+			num = grep_num(ops[op].name);
+		} else if (kind == OP_GREP_ORDER) {
+			dst = marks;
+		}
+		double t_ref = throughput(kind, ref, dst, s, num);
+		double t_new = throughput(kind, fun, dst, s, num);
+		printf("%-16s  %9.1f  %9.1f\n", ops[op].name, t_ref, t_new);
+	}
+	free(d);
+	free(s);
+	free(zeros);
+	free(marks);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1 && !strcmp(argv[1], "--bench")) {
+		bench();
+		return test_finish("vm_array bench");
+	}
+
+	test_coverage();
+	for (unsigned op = 0; op < NR_OPS; op++) {
+		test_op(op);
+	}
+	TEST_EQUAL(nr_mismatches, 0);
+	return test_finish("vm_array");
+}